@@ -0,0 +1,31 @@
+# Generates the client header and glue code of Wayland protocol extensions with wayland-scanner
+
+function(wayland_generate_protocols)
+    set(oneValueArgs TARGET_NAME)
+    set(multiValueArgs PROTOCOL_FILES)
+    cmake_parse_arguments(WAYLAND_PROTOCOL "" "${oneValueArgs}" "${multiValueArgs}" ${ARGN})
+
+    find_program(WAYLAND_SCANNER wayland-scanner REQUIRED)
+
+    cmake_path(APPEND CMAKE_CURRENT_BINARY_DIR "wayland" OUTPUT_VARIABLE PROTOCOL_DIR)
+    file(MAKE_DIRECTORY ${PROTOCOL_DIR})
+
+    foreach (PROTOCOL_FILE IN LISTS WAYLAND_PROTOCOL_PROTOCOL_FILES)
+        cmake_path(GET PROTOCOL_FILE STEM PROTOCOL_NAME)
+
+        cmake_path(APPEND PROTOCOL_DIR "${PROTOCOL_NAME}-client-protocol.h" OUTPUT_VARIABLE PROTOCOL_HEADER)
+        cmake_path(APPEND PROTOCOL_DIR "${PROTOCOL_NAME}-protocol.c" OUTPUT_VARIABLE PROTOCOL_CODE)
+
+        add_custom_command(
+                OUTPUT ${PROTOCOL_HEADER} ${PROTOCOL_CODE}
+                COMMENT "Generating Wayland protocol ${PROTOCOL_NAME}"
+                COMMAND ${WAYLAND_SCANNER} client-header ${PROTOCOL_FILE} ${PROTOCOL_HEADER}
+                COMMAND ${WAYLAND_SCANNER} private-code ${PROTOCOL_FILE} ${PROTOCOL_CODE}
+                DEPENDS ${PROTOCOL_FILE}
+        )
+
+        target_sources(${WAYLAND_PROTOCOL_TARGET_NAME} PRIVATE ${PROTOCOL_HEADER} ${PROTOCOL_CODE})
+    endforeach ()
+
+    target_include_directories(${WAYLAND_PROTOCOL_TARGET_NAME} PRIVATE ${PROTOCOL_DIR})
+endfunction()
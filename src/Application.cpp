@@ -1,65 +1,204 @@
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <exception>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <memory_resource>
+#include <optional>
 #include <set>
-#include <unordered_map>
+#include <thread>
 
 #include "Application.h"
 
+#include "StaticMesh.h"
+#include "Memory/AllocationCounter.h"
 #include "Vertex.h"
+#include "Window/HeadlessWindow.h"
+#ifdef WIN32
 #include "Window/Win32Window.h"
+#elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
+#include "Window/WaylandWindow.h"
+#endif
+#include "hiz.h"
+#include "tonemap.h"
 #include "triangle.h"
 #include "utils.h"
 
-#define MAX_VERTICES 100
+constexpr vk::DeviceSize staging_buffer_size = 1 << 20;
+// Dirty ranges closer than this are uploaded as one copy region
+constexpr size_t upload_merge_gap = 256;
+// World matrices the GPU holds, slot 0 is the identity
+constexpr uint32_t world_matrix_capacity = 1024;
+// Of the default triangle, in radians per second
+constexpr float triangle_spin_rate = 0.5f;
+// Stack space for the layer and extension name pointers handed to instance and device creation
+constexpr size_t name_list_storage = 512;
+// Window events buffered between two frames before new ones are dropped
+constexpr size_t event_queue_capacity = 256;
+// Initial size of each frame in flight's arena, it grows to the largest frame seen
+constexpr size_t frame_arena_capacity = 64 * 1024;
+// Frames after the start or a swapchain rebuild that may still allocate, while every frame slot, swapchain image and
+// per-thread trace buffer is used for the first time
+constexpr unsigned int allocation_warmup_frames = 16;
+// Frames a run without a frame limit keeps the timings of, the newest ones, about 18 minutes at 60 Hz
+constexpr size_t frame_timing_history = 1 << 16;
+// How often a minimised window checks whether it is visible again
+constexpr std::chrono::milliseconds paused_poll_interval(10);
+
+// Render target of every draw, tonemapped to the swapchain at the end of the frame
+constexpr vk::Format hdr_format = vk::Format::eR16G16B16A16Sfloat;
+// Matches the 8x8 tiles of tonemap.slang
+constexpr uint32_t tonemap_tile_size = 8;
+constexpr vk::Format depth_format = vk::Format::eD32Sfloat;
+constexpr vk::Format depth_pyramid_format = vk::Format::eR32Sfloat;
+// Matches the 8x8 groups of hiz.slang
+constexpr uint32_t hiz_tile_size = 8;
+// Threads running the optimized pipeline compiles, which take long enough that more would only compete with the
+// frame's own work
+constexpr unsigned int pipeline_compile_threads = 2;
+// Luminance an HDR10 output maps 1.0 to, the reference white of BT.2408, and the highlight peak it rolls off to
+constexpr float paper_white_nits = 203.0f;
+constexpr float hdr_peak_nits = 1000.0f;
+
+// GPU timestamp scopes of every frame
+constexpr uint32_t gpu_scope_frame = 0;
+constexpr uint32_t gpu_scope_tonemap = 1;
+// The frame's passes before the particles, what the async particle update should run alongside
+constexpr uint32_t gpu_scope_scene = 2;
+constexpr uint32_t gpu_scope_count = 3;
+// Of the compute profiler
+constexpr uint32_t compute_scope_particles = 0;
+constexpr uint32_t compute_scope_count = 1;
+// How long the readback writer waits for a frame before checking whether it should stop
+constexpr std::chrono::milliseconds readback_poll_interval(10);
+// Longest the main thread waits on window messages before checking whether the render thread has finished
+constexpr std::chrono::milliseconds event_wait_timeout(10);
+// Bounds a present wait, presents can be dropped without ever completing, e.g. when the window is hidden
+constexpr uint64_t present_wait_timeout_ns = 100'000'000;
 
 #ifndef NDEBUG
 #define VALIDATION_LAYERS // CMake only sets NDEBUG on Release builds
+constexpr bool debug_build = true;
+#else
+constexpr bool debug_build = false;
 #endif
 
-static const std::vector<Vertex> vertices{
-    {{0.0f, -0.5f}, {1.0f, 0.0f, 0.0f}},
-    {{0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}},
-    {{-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}},
+// Matches DrawConstants in triangle.slang
+struct DrawConstants
+{
+    uint32_t firstVertex;
+    uint32_t firstCluster;
+    uint32_t clusterCount;
+    float errorThreshold;
+    uint32_t frameSlot;
+    uint32_t phase;
+    float depth;
+    float requestThreshold;
+    glm::vec2 boundsMin;
+    glm::vec2 boundsMax;
+    uint32_t pyramidSize[2];
+    uint32_t pageCount;
+    uint32_t transform;
 };
 
+// Matches phaseEarly, phaseLate and phaseAll in triangle.slang
+constexpr uint32_t draw_phase_early = 0;
+constexpr uint32_t draw_phase_late = 1;
+constexpr uint32_t draw_phase_all = 2;
+
+// Matches clustersPerTask and maxGroupsX in triangle.slang
+constexpr uint32_t clusters_per_task = 32;
+constexpr uint32_t max_task_groups_x = 65535;
+
+// Candidates of the DrawPathTuner, which draws this many frames with each before timing as many trial frames
+constexpr uint32_t draw_path_mesh = 0;
+constexpr uint32_t draw_path_vertex = 1;
+constexpr uint32_t draw_path_count = 2;
+constexpr uint32_t draw_path_warmup_frames = 8;
+constexpr uint32_t draw_path_trial_frames = 32;
 
-[[nodiscard]] static int rate_surface_format(const vk::SurfaceFormatKHR& surface_format)
+// Matches HizConstants in hiz.slang
+struct HizConstants
 {
-    int total = 0;
+    uint32_t sourceSize[2];
+    uint32_t destinationSize[2];
+};
 
-    switch (surface_format.format)
-    {
-    case vk::Format::eB8G8R8A8Unorm:
-        total += 500;
-        break;
-    default:
-        return 0;
-    }
+// Matches TonemapConstants in tonemap.slang
+struct TonemapConstants
+{
+    uint32_t extent[2];
+    uint32_t renderExtent[2];
+    float exposure;
+    uint32_t outputTransfer;
+    float paperWhiteNits;
+    float peakNits;
+};
 
-    switch (surface_format.colorSpace)
-    {
-    case vk::ColorSpaceKHR::eSrgbNonlinear:
-        total += 500;
-        break;
-    default:
-        return 0;
-    }
+// Matches outputSrgb and outputPq in tonemap.slang
+constexpr uint32_t output_srgb = 0;
+constexpr uint32_t output_pq = 1;
+
+// Matches isOffscreen in triangle.slang
+[[nodiscard]] static bool is_offscreen(const glm::vec2 bounds_min, const glm::vec2 bounds_max)
+{
+    return bounds_max.x < -1.0f || bounds_max.y < -1.0f || bounds_min.x > 1.0f || bounds_min.y > 1.0f;
+}
+
+// The box around the box transformed by the part of world that maps the xy plane onto itself. Matches toWorldBounds
+// in triangle.slang.
+[[nodiscard]] static std::pair<glm::vec2, glm::vec2> transform_bounds(const glm::mat4& world,
+                                                                      const glm::vec2 bounds_min,
+                                                                      const glm::vec2 bounds_max)
+{
+    const glm::vec2 center = (bounds_min + bounds_max) * 0.5f;
+    const glm::vec2 half_size = (bounds_max - bounds_min) * 0.5f;
+    const glm::vec2 world_center = glm::vec2(world[0]) * center.x + glm::vec2(world[1]) * center.y +
+                                   glm::vec2(world[3]);
+    const glm::vec2 half_extent = glm::abs(glm::vec2(world[0])) * half_size.x +
+                                  glm::abs(glm::vec2(world[1])) * half_size.y;
+    return {world_center - half_extent, world_center + half_extent};
+}
 
-    return total;
+// Cluster errors are in the draw's own units, which world stretches by at most this much
+[[nodiscard]] static float get_world_scale(const glm::mat4& world)
+{
+    return std::max(glm::length(glm::vec2(world[0])), glm::length(glm::vec2(world[1])));
 }
 
-[[nodiscard]] static uint32_t find_memory_type(const vk::PhysicalDeviceMemoryProperties& memory_properties,
-                                               uint32_t type_filter, vk::MemoryPropertyFlags property_flags)
+// The tonemap pass does the encoding itself, so only UNORM formats are wanted, never _SRGB ones
+[[nodiscard]] static int rate_surface_format(const vk::SurfaceFormatKHR& surface_format, const bool hdr)
 {
-    for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++)
+    switch (surface_format.colorSpace)
     {
-        if (type_filter & (1 << i) &&
-            (memory_properties.memoryTypes[i].propertyFlags & property_flags) == property_flags)
+    case vk::ColorSpaceKHR::eSrgbNonlinear:
+        switch (surface_format.format)
         {
-            return i;
+        case vk::Format::eB8G8R8A8Unorm:
+        case vk::Format::eR8G8B8A8Unorm:
+            return 500;
+        case vk::Format::eA2B10G10R10UnormPack32:
+        case vk::Format::eA2R10G10B10UnormPack32:
+            return 400;
+        default:
+            return 0;
         }
+    case vk::ColorSpaceKHR::eHdr10St2084EXT:
+        switch (surface_format.format)
+        {
+        case vk::Format::eA2B10G10R10UnormPack32:
+        case vk::Format::eA2R10G10B10UnormPack32:
+            return hdr ? 1000 : 0;
+        default:
+            return 0;
+        }
+    default:
+        return 0;
     }
-
-    throw std::runtime_error("Failed to find suitable memory type");
 }
 
 template <class... Ts>
@@ -68,31 +207,110 @@ struct Overloaded : Ts...
     using Ts::operator()...;
 };
 
+void Application::processEvents()
+{
+    TRACE_SCOPE("processEvents");
+
+    std::optional<events::Resize> resize;
+    bool visible = !paused;
+    bool close = false;
+
+    eventQueue.drain([&](const events::event& event)
+    {
+        std::visit(Overloaded{
+                       [&](const events::Resize& ev) { resize = ev; },
+                       [&](const events::VisibilityChange& ev) { visible = ev.isVisible; },
+                       [&](const events::Close&) { close = true; }
+                   },
+                   event);
+    });
+
+    // Only the final state matters, a minimise and restore within one frame changes nothing
+    if (visible == paused)
+        windowCallback(events::VisibilityChange{visible});
+    // Minimising reports a zero size, the restore that ends the pause brings the real one
+    if (resize && !paused)
+        windowCallback(*resize);
+    if (close)
+        windowCallback(events::Close{});
+}
+
 void Application::windowCallback(events::event event)
 {
+    if (frameRecorder)
+        frameRecorder->record(event);
+
     std::visit(Overloaded{
-                   [this](const events::Resize&) { recreateSwapChain(); },
+                   [this](const events::Resize&)
+                   {
+                       // A replay rebuilds where the capture's SwapchainRecreate commands say, resizing its window
+                       // was all the event had to do
+                       if (!settings.replayPath.empty())
+                           return;
+
+                       recreateSwapChain();
+                       // eSuccess, as no acquire or present asked for it
+                       if (frameRecorder)
+                           frameRecorder->recordSwapchainRecreate(static_cast<int32_t>(vk::Result::eSuccess),
+                                                                  swapChainExtent.width, swapChainExtent.height);
+                   },
                    [this](const events::VisibilityChange& ev)
                    {
                        paused = !ev.isVisible;
-                       timer.stop();
-                       while (paused)
-                       {
-                           std::printf("Paused");
-                       }
-                       timer.start();
+                       if (paused)
+                           timer.stop();
+                       else
+                           timer.start();
                    },
                    [this](const events::Close&) { windowOpen = false; }
                },
                event);
 }
 
-Application::Application()
+Application::Application(const ApplicationSettings& settings) : settings(settings),
+                                                                 eventQueue(event_queue_capacity),
+                                                                 drawList(settings.maxVertices)
 {
-    auto event_handler = [this](const events::event event) { this->windowCallback(event); };
+    auto event_handler = [this](const events::event& event) { eventQueue.push(event); };
+
+    if (settings.headless)
+    {
+        window = std::make_unique<window::HeadlessWindow>(settings.windowSize, event_handler);
+    }
+    else
+    {
+#ifdef WIN32
+        window = std::make_unique<window::Win32Window>(settings.windowSize, "Triangle", false, true, event_handler);
+#elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
+        window = std::make_unique<window::WaylandWindow>(settings.windowSize, "Triangle", event_handler);
+#else
+        throw std::runtime_error("No window backend on this platform, run with --headless");
+#endif
+    }
+
+    if (!settings.capturePath.empty())
+        frameRecorder = std::make_unique<capture::FrameRecorder>(settings.capturePath);
+
+    if (!settings.tracePath.empty())
+    {
+        trace::set_enabled(true);
+        trace::set_thread_name("main");
+        gpuTrack = &trace::create_track("GPU graphics queue");
+    }
+
+    maxFramesInFlight = settings.framesInFlight;
 
-    window = std::make_unique<window::Win32Window>(glm::ivec2(1280, 720), "Triangle", false, true, event_handler);
     initVulkan();
+
+    // The validation layers allocate inside the Vulkan calls of every frame, so the check can only report then
+    checkAllocations = (debug_build || settings.benchmark) && !validationLayersEnabled;
+
+    // A replay starts from an empty scene, the capture holds the drawables and transforms the recorded run had.
+    // Benchmarks draw only what they measure.
+    if (!settings.replayPath.empty())
+        replayFrames = capture::load_capture(settings.replayPath);
+    else if (!settings.benchmark && !settings.benchmarkParticles)
+        createScene();
 }
 
 Application::~Application() = default;
@@ -121,20 +339,32 @@ bool Application::checkDeviceExtensions(const vk::raii::PhysicalDevice& device,
     return required_extensions.empty();
 }
 
-vk::SurfaceFormatKHR Application::chooseSwapSurfaceFormat(const std::vector<vk::SurfaceFormatKHR>& available_formats)
+vk::SurfaceFormatKHR Application::chooseSwapSurfaceFormat(
+    const std::vector<vk::SurfaceFormatKHR>& available_formats) const
 {
+    const bool hdr = settings.hdr && window->isHdrSupported();
+
     int max = 0;
     vk::SurfaceFormatKHR best_format;
 
     for (auto& available_format : available_formats)
     {
-        if (const int rating = rate_surface_format(available_format); rating > max)
+        const vk::FormatProperties format_properties = physicalDevice.getFormatProperties(available_format.format);
+        if (!(format_properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eStorageImage))
+            continue;
+
+        if (const int rating = rate_surface_format(available_format, hdr); rating > max)
         {
             best_format = available_format;
             max = rating;
         }
     }
 
+    if (max == 0)
+        throw std::runtime_error("No surface format the tonemap pass can write to");
+    if (settings.hdr && best_format.colorSpace != vk::ColorSpaceKHR::eHdr10St2084EXT)
+        std::cout << "HDR10 is not available on this display, presenting in SDR" << std::endl;
+
     std::cout << "Selected format: " << vk::to_string(best_format.format) << " "
         << vk::to_string(best_format.colorSpace) << std::endl;
 
@@ -142,18 +372,11 @@ vk::SurfaceFormatKHR Application::chooseSwapSurfaceFormat(const std::vector<vk::
 }
 
 vk::PresentModeKHR Application::choosePresentMode(const std::vector<vk::PresentModeKHR>& available_present_modes,
-                                                  const std::vector<vk::PresentModeKHR>& present_mode_preferences)
+                                                  const std::span<const vk::PresentModeKHR> present_mode_preferences)
 {
-    std::unordered_map<vk::PresentModeKHR, bool> present_mode_availability;
-
-    for (auto& available_present_mode : available_present_modes)
-    {
-        present_mode_availability[available_present_mode] = true;
-    }
-
     for (auto& present_mode : present_mode_preferences)
     {
-        if (present_mode_availability[present_mode])
+        if (std::ranges::find(available_present_modes, present_mode) != available_present_modes.end())
             return present_mode;
     }
 
@@ -162,664 +385,2565 @@ vk::PresentModeKHR Application::choosePresentMode(const std::vector<vk::PresentM
 
 void Application::run()
 {
-    timer.restart();
+    renderThreadDone = false;
+    std::exception_ptr render_error;
 
-    while (windowOpen)
+    // The device, queue and swapchain are only used from this thread, so a blocked acquire or fence wait never
+    // delays the message pump, and a modal resize loop inside the pump never delays a frame
+    std::thread render_thread([this, &render_error]
     {
-        window->pollEvents();
-        drawFrame();
+        trace::set_thread_name("render");
+        try
+        {
+            renderLoop();
+        }
+        catch (...)
+        {
+            render_error = std::current_exception();
+        }
+        renderThreadDone.store(true, std::memory_order_release);
+    });
+
+    while (!renderThreadDone.load(std::memory_order_acquire))
+    {
+        window->waitEvents(event_wait_timeout);
     }
 
-    device.waitIdle();
+    render_thread.join();
 
-    const float fps = static_cast<float>(frameCount) / timer.reset().asSeconds();
-    std::cout << "Framerate: " << fps << " FPS" << std::endl;
+    if (!settings.tracePath.empty())
+        trace::write_chrome_trace(settings.tracePath);
+
+    if (render_error)
+        std::rethrow_exception(render_error);
 }
 
-void Application::initVulkan()
+void Application::renderLoop()
 {
-    /*if (!sf::Vulkan::isAvailable())
-    {
-        throw std::runtime_error("Vulkan is not available");
-    }*/
-
-    const auto layers = selectLayers();
+    timer.restart();
 
-    const auto instance_extensions = selectExtensions();
+    const unsigned int first_frame = frameCount;
+    const bool replaying = !settings.replayPath.empty();
+
+    // Reserved up front, so keeping them never allocates in the frame
+    frameTimings.clear();
+    frameTimingCapacity = replaying ? replayFrames.size() : settings.frameLimit;
+    if (frameTimingCapacity == 0)
+        frameTimingCapacity = frame_timing_history;
+    frameTimings.reserve(frameTimingCapacity);
+    frameTimingCount = 0;
+
+    steadyStateFrame = frameCount + allocation_warmup_frames;
+    steadyFrames = 0;
+    allocatingFrames = 0;
+    steadyDriverAllocations = 0;
+
+    lastSnapshotFrame = UINT64_MAX;
+    simulationUpdates = 0;
+    simulationMs = 0.0;
+    simulationOverlapMs = 0.0;
+    staleSnapshotFrames = 0;
+    particleGpuMs = 0.0;
+    particleOverlapMs = 0.0;
+    particleGpuFrames = 0;
+    // The first frame has nothing to overlap its update with
+    sceneStartTime = std::chrono::steady_clock::now();
+    sceneTimeNs = 0;
+    simulation.requestFrame(frameCount, std::chrono::nanoseconds(sceneTimeNs));
+    simulation.waitIdle();
+
+    while (windowOpen && (settings.frameLimit == 0 || frameCount - first_frame < settings.frameLimit))
+    {
+        // Replays run flat out, the capture already holds the event that ends the pause
+        if (paused && !replaying)
+        {
+            std::this_thread::sleep_for(paused_poll_interval);
+            processEvents();
+            continue;
+        }
 
-    createInstance(layers, instance_extensions);
+        const size_t frame = frameCount - first_frame;
+        if (replaying && frame >= replayFrames.size())
+            break;
 
-#ifdef VALIDATION_LAYERS
-    setupDebugMessenger();
-#endif
+        const auto frame_start = std::chrono::steady_clock::now();
+        frameUploadBytes = 0;
 
-    createSurface();
+        if (frameRecorder)
+            frameRecorder->beginFrame(frame);
 
-    const std::vector<std::string_view> device_extensions = {
-        vk::EXTMeshShaderExtensionName, vk::KHRSwapchainExtensionName, vk::EXTHdrMetadataExtensionName
-    };
+        const unsigned int frame_index = frameCount;
+        const memory::AllocationScope frame_allocations;
+        const uint64_t driver_allocations = hostAllocator.getAllocationCount();
 
-    selectPhysicalDevice(device_extensions);
+        if (replaying)
+            replayFrame(replayFrames[frame]);
 
-    createLogicalDevice(layers, device_extensions);
+        processEvents();
 
-    createSwapChain();
-    createImageViews();
+        advanceSimulation();
 
-    createRenderPass();
+        lastDrawStart = std::chrono::steady_clock::now();
+        drawFrame();
+        lastDrawEnd = std::chrono::steady_clock::now();
+
+        const auto cpu_time = std::chrono::steady_clock::now() - frame_start;
+        const auto cpu_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(cpu_time).count();
+
+        if (frameRecorder)
+            frameRecorder->endFrame(cpu_time_ns, sceneTimeNs);
+
+        // Before the allocation check, which covers it too. Once full the oldest timing is overwritten.
+        const capture::FrameTiming timing{
+            frame, static_cast<double>(cpu_time_ns) / 1e6,
+            replaying ? static_cast<double>(replayFrames[frame].cpuTimeNs) / 1e6 : 0.0,
+            frameUploadBytes
+        };
+        if (frameTimings.size() < frameTimingCapacity)
+            frameTimings.push_back(timing);
+        else
+            frameTimings[frameTimingCount % frameTimingCapacity] = timing;
+        frameTimingCount++;
+
+        // Recording a capture and replaying draw list edits allocate by design
+        if (!frameRecorder && !(replaying && !replayFrames[frame].commands.empty()))
+            checkFrameAllocations(frame_index, frame_allocations.getCount(),
+                                  hostAllocator.getAllocationCount() - driver_allocations);
+    }
 
-    createDescriptorSetLayout();
+    simulation.waitIdle();
+    device.waitIdle();
 
-    createGraphicsPipeline();
+    // Oldest first, so read back frames are delivered in order
+    for (uint32_t i = 0; i < maxFramesInFlight; i++)
+    {
+        const uint32_t slot = (currentFrame + i) % maxFramesInFlight;
+        collectGpuTimings(slot);
+        if (frameReadback)
+            frameReadback->collect(slot);
+    }
+    // Oldest first again once the history wrapped around
+    if (frameTimingCount > frameTimingCapacity)
+        std::ranges::rotate(frameTimings, frameTimings.begin() + frameTimingCount % frameTimingCapacity);
 
-    createFramebuffers();
+    frameRate = static_cast<float>(frameCount - first_frame) / timer.reset().asSeconds();
+    std::cout << "Framerate: " << frameRate << " FPS" << std::endl;
 
-    createCommandPool();
+    memoryTracker->update();
+    for (const auto& heap : memoryTracker->getHeaps())
+    {
+        std::cout << "Memory heap " << heap.heap << (heap.deviceLocal ? " (device local): " : ": ")
+            << (heap.usage >> 20) << " of " << (heap.budget >> 20) << " MiB budget, " << (heap.tracked >> 20)
+            << " MiB tracked" << std::endl;
+    }
 
-    createVertexBuffer();
-    createIndexBuffer();
+    size_t arena_peak = 0;
+    for (const auto& arena : frameArenas)
+    {
+        arena_peak = std::max(arena_peak, arena.getPeak());
+    }
+    std::cout << "Steady-state frames with heap allocations: " << allocatingFrames << " of " << steadyFrames
+        << ", Vulkan host allocations during them: " << steadyDriverAllocations << ", frame arena peak: "
+        << arena_peak << " bytes" << std::endl;
 
-    createDescriptorSets();
+    if (textureStreamer)
+    {
+        const auto texture_stats = textureStreamer->getStats();
+        std::cout << "Textures: " << texture_stats.textures << ", " << (texture_stats.residentBytes >> 20) << " of "
+            << (texture_stats.budget >> 20) << " MiB budget resident, " << texture_stats.streamedLevels
+            << " levels streamed in, " << texture_stats.evictedLevels << " evicted" << std::endl;
+    }
 
-    createCommandBuffers();
+    if (geometryStreamer)
+    {
+        const auto geometry_stats = geometryStreamer->getStats();
+        std::cout << "Geometry: " << geometry_stats.meshes << " meshes, " << geometry_stats.residentPages << " of "
+            << geometry_stats.pages << " pages resident in a pool of " << geometry_stats.poolPages << " ("
+            << geometry_stats.pinnedPages << " pinned), " << geometry_stats.streamedPages << " streamed in, "
+            << geometry_stats.evictedPages << " evicted, "
+            << static_cast<double>(geometry_stats.missingPages) / static_cast<double>(
+                std::max<uint64_t>(geometry_stats.frames, 1)) << " wanted pages missing per frame" << std::endl;
+    }
 
-    createSyncObjects();
-}
+    const double update_count = static_cast<double>(std::max<uint64_t>(simulationUpdates, 1));
+    std::cout << "Simulation: " << simulationMs / update_count << " ms per update, "
+        << (simulationMs > 0.0 ? 100.0 * simulationOverlapMs / simulationMs : 0.0)
+        << "% of it overlapped with recording, " << staleSnapshotFrames << " of " << frameCount - first_frame
+        << " frames drew an older snapshot" << std::endl;
 
-void Application::createInstance(const std::vector<std::string_view>& layers,
-                                 const std::vector<std::string_view>& extensions)
-{
-    const auto vk_version = context.enumerateInstanceVersion();
-    std::cout << "Vulkan version: " << vk::apiVersionMajor(vk_version) << "." << vk::apiVersionMinor(vk_version)
-        << std::endl;
+    const auto pipeline_stats = pipelineManager->getStats();
+    std::cout << "Graphics pipelines: " << pipeline_stats.pipelines << " (" << pipeline_stats.optimized
+        << " optimized, " << pipeline_stats.libraries << " libraries), compile queue " << pipeline_stats.queueDepth
+        << " deep, " << pipeline_stats.maxQueueDepth << " max, compile latency " << pipeline_stats.meanCompileMs
+        << " ms mean, " << pipeline_stats.maxCompileMs << " ms max, " << pipeline_stats.fallbackBinds
+        << " fast-linked binds" << std::endl;
 
-    constexpr vk::ApplicationInfo application_info("Triangle", vk::makeApiVersion(0, 0, 1, 0), "No Engine",
-                                                   vk::makeApiVersion(0, 0, 1, 0), vk::ApiVersion12);
+    if (!settings.statsPath.empty())
+        writeStats();
 
-    auto instance_flags = vk::InstanceCreateFlags();
+    if (presentWaitEnabled)
+    {
+        const auto pacing = framePacer.getStats();
+        std::cout << "Present to present: " << pacing.meanPresentIntervalMs << " ms mean" << std::endl;
+        std::cout << "CPU start to present: " << pacing.meanLatencyMs << " ms mean, " << pacing.maxLatencyMs
+            << " ms max over " << pacing.frames << " frames" << std::endl;
+    }
 
-#ifdef __APPLE__
-    // Add VK_KHR_PORTABILITY_subset extension for MoltenVK
-    instance_flags |= vk::InstanceCreateFlagBits::eEnumeratePortabilityKHR;
-#endif
+    if (const auto presentation = window->getPresentationStats())
+    {
+        std::cout << "Present to display: " << presentation->meanLatencyMs << " ms mean, "
+            << presentation->maxLatencyMs << " ms max over " << presentation->presented << " frames ("
+            << presentation->discarded << " discarded, " << presentation->refreshMs << " ms refresh)" << std::endl;
+    }
 
-    auto c_extensions = to_c_strings(extensions);
-    auto c_layers = to_c_strings(layers);
+    reportFrameTimings();
+}
 
-    const vk::InstanceCreateInfo instance_info(instance_flags, &application_info, c_layers, c_extensions);
+renderer::DrawHandle Application::addDrawable(const Drawable& drawable)
+{
+    const renderer::DrawHandle handle = drawList.add(drawable);
 
-    vk::StructureChain instance_info_chain(instance_info
-#ifdef VALIDATION_LAYERS
-                                           ,
-                                           debug_utils_messenger_create_info
-#endif
-    );
+    if (frameRecorder)
+    {
+        const auto draw = drawList.getDraw(handle);
+        frameRecorder->recordDrawAdd(handle, drawList.getVertices().subspan(draw.firstVertex, draw.vertexCount));
+    }
 
-    instance = context.createInstance(instance_info_chain.get<vk::InstanceCreateInfo>());
+    return handle;
 }
 
-std::vector<std::string_view> Application::selectLayers() const
+void Application::updateDrawable(const renderer::DrawHandle handle, const Drawable& drawable)
 {
-    std::vector<std::string_view> requested_layers;
-
-#ifdef VALIDATION_LAYERS
-    requested_layers.emplace_back("VK_LAYER_KHRONOS_validation");
-#endif
+    drawList.update(handle, drawable);
 
-    std::vector<vk::LayerProperties> layers = context.enumerateInstanceLayerProperties();
-    std::vector<std::string_view> available_layers;
-    for (auto& requested_layer : requested_layers)
+    if (frameRecorder)
     {
-        bool found = false;
-        for (auto& layer : layers)
-        {
-            if (static_cast<std::string_view>(layer.layerName.data()) == requested_layer.data())
-            {
-                available_layers.push_back(requested_layer);
-                std::cout << "Found layer: " << requested_layer << std::endl;
-                found = true;
-            }
-        }
-        if (!found)
-        {
-            std::cout << "Requested layer not found: " << std::string(requested_layer) << "; Expect issues"
-                << std::endl;
-        }
+        const auto draw = drawList.getDraw(handle);
+        frameRecorder->recordDrawUpdate(handle, drawList.getVertices().subspan(draw.firstVertex, draw.vertexCount));
     }
-
-    return available_layers;
 }
 
-std::vector<std::string_view> Application::selectExtensions() const
+void Application::removeDrawable(const renderer::DrawHandle handle)
 {
-    std::vector<vk::ExtensionProperties> extensions = context.enumerateInstanceExtensionProperties();
+    drawList.remove(handle);
+    if (handle.index < drawTransforms.size())
+        drawTransforms[handle.index] = {};
 
-    auto required_extensions = window->getVulkanRequiredInstanceExtensions();
+    if (frameRecorder)
+        frameRecorder->recordDrawRemove(handle);
+}
 
-    required_extensions.emplace_back(vk::EXTSwapchainColorSpaceExtensionName);
+void Application::flushUploads()
+{
+    auto& vertex_ranges = drawList.getDirtyRanges();
+    auto& cluster_ranges = drawList.getClusterDirtyRanges();
+    vertex_ranges.coalesce(upload_merge_gap);
+    cluster_ranges.coalesce(upload_merge_gap);
+    worldMatrixDirtyRanges.coalesce(upload_merge_gap);
+    const vk::DeviceSize size = vertex_ranges.getPendingBytes() + cluster_ranges.getPendingBytes() +
+                                worldMatrixDirtyRanges.getPendingBytes();
+    if (size == 0)
+        return;
 
-#ifdef VALIDATION_LAYERS
-    required_extensions.emplace_back(vk::EXTDebugUtilsExtensionName);
-#endif
-#ifdef __APPLE__
-    // Add VK_KHR_PORTABILITY_subset extension for MoltenVK
-    required_extensions.push_back(vk::KHRPortabilityEnumerationExtensionName);
-#endif
+    // Sized for everything, unlike the staging buffers of the frames in flight
+    vk::raii::Buffer staging_buffer = nullptr;
+    renderer::TrackedDeviceMemory staging_memory = nullptr;
+    std::tie(staging_buffer, staging_memory) =
+        createBuffer(size, vk::BufferUsageFlagBits::eTransferSrc,
+                     vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                     renderer::MemoryCategory::Staging, "upload flush");
+    auto* staging = static_cast<std::byte*>(staging_memory.mapMemory(0, size));
 
-    std::vector<std::string_view> available_extensions;
-    for (const auto& required_extension : required_extensions)
+    const vk::CommandBufferAllocateInfo command_buffer_allocate_info(commandPool, vk::CommandBufferLevel::ePrimary, 1);
+    vk::raii::CommandBuffer command_buffer =
+        std::move(device.allocateCommandBuffers(command_buffer_allocate_info).front());
+    command_buffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+
+    vk::DeviceSize staging_offset = 0;
+    const auto upload = [&](renderer::DirtyRanges& dirty_ranges, const std::span<const std::byte> source,
+                            const vk::raii::Buffer& buffer)
     {
-        bool found = false;
-        for (auto& extension : extensions)
-        {
-            if (static_cast<std::string_view>(extension.extensionName.data()) == required_extension)
-            {
-                std::cout << "Found extension: " << required_extension << std::endl;
-                available_extensions.push_back(required_extension);
-                found = true;
-            }
-        }
-        if (!found)
+        std::pmr::vector<renderer::DirtyRanges::Range> ranges;
+        dirty_ranges.take(size, ranges);
+
+        std::vector<vk::BufferCopy> regions;
+        regions.reserve(ranges.size());
+        for (const auto& range : ranges)
         {
-            throw std::runtime_error("Required extension not found: " + std::string(required_extension));
+            std::memcpy(staging + staging_offset, source.data() + range.offset, range.size);
+            regions.emplace_back(staging_offset, range.offset, range.size);
+            staging_offset += range.size;
         }
-    }
+        if (!regions.empty())
+            command_buffer.copyBuffer(staging_buffer, buffer, regions);
+    };
+    upload(vertex_ranges, std::as_bytes(drawList.getVertices()), vertexBuffer);
+    upload(cluster_ranges, std::as_bytes(drawList.getClusters()), clusterBuffer);
+    upload(worldMatrixDirtyRanges, std::as_bytes(std::span(worldMatrices)), worldMatrixBuffer);
 
-    return available_extensions;
+    command_buffer.end();
+
+    const vk::CommandBufferSubmitInfo command_buffer_info(*command_buffer);
+    graphicsTimeline->wait(graphicsTimeline->submit(graphicsQueue, {}, command_buffer_info));
 }
 
-void Application::setupDebugMessenger()
+void Application::createScene()
 {
-    debugMessenger = instance.createDebugUtilsMessengerEXT(debug_utils_messenger_create_info);
+    triangleDraw = addDrawable(StaticMesh::triangle());
+
+    // A spinning pivot at the centre of its bounds, with the triangle under it offset back to where it was
+    const renderer::DrawList::Draw draw = drawList.getDraw(triangleDraw);
+    const glm::vec2 center = (draw.boundsMin + draw.boundsMax) * 0.5f;
+    const scene::TransformHandle pivot = createTransform({}, glm::vec3(center, 0.0f));
+    addSpin(pivot, triangle_spin_rate);
+    setDrawTransform(triangleDraw, createTransform(pivot, glm::vec3(-center, 0.0f)));
 }
 
-int Application::ratePhysicalDevice(const vk::raii::PhysicalDevice& physical_device,
-                                    const std::vector<std::string_view>& requested_extensions) const
+scene::TransformHandle Application::createTransform(const scene::TransformHandle parent, const glm::vec3 position)
 {
-    const auto properties = physical_device.getProperties();
-    const auto features = physical_device.getFeatures();
+    const glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+    const glm::vec3 scale(1.0f);
+    const scene::TransformHandle handle = simulation.getTransforms().create(parent, position, rotation, scale);
 
-    std::cout << "Found Device: " << properties.deviceName << " " << properties.vendorID << " " << properties.deviceID
-        << std::endl;
-    std::cout << "\t"
-        << "API Version: " << vk::apiVersionMajor(properties.apiVersion) << "."
-        << vk::apiVersionMinor(properties.apiVersion) << "." << vk::apiVersionPatch(properties.apiVersion)
-        << std::endl;
-    std::cout << "\t" << "Driver Version: " << vk::apiVersionMajor(properties.driverVersion) << "."
-        << vk::apiVersionMinor(properties.driverVersion) << "." << vk::apiVersionPatch(properties.driverVersion)
-        << std::endl;
-    std::cout << "\t" << to_string(properties.deviceType) << std::endl;
+    if (frameRecorder)
+        frameRecorder->recordTransformCreate(handle, parent, position, rotation, scale);
 
-    int score = 0;
+    return handle;
+}
 
-    if (properties.deviceType == vk::PhysicalDeviceType::eDiscreteGpu)
-    {
-        score += 1000;
-    }
+void Application::addSpin(const scene::TransformHandle handle, const float radians_per_second)
+{
+    simulation.addSpin(handle, radians_per_second);
 
-    score += static_cast<int>(properties.limits.maxImageDimension2D);
+    if (frameRecorder)
+        frameRecorder->recordTransformSpin(handle, radians_per_second);
+}
 
-    auto features2 = physical_device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan11Features>();
+void Application::setDrawTransform(const renderer::DrawHandle handle, const scene::TransformHandle transform)
+{
+    if (simulation.getTransforms().size() >= world_matrix_capacity)
+        throw std::runtime_error("The scene has more transforms than the world matrix buffer holds");
 
-    if (!(ApplicationQueueFamilies(physical_device, surface).isComplete() && features.geometryShader &&
-        checkDeviceExtensions(physical_device, requested_extensions) &&
-        ApplicationSwapChainDetails(physical_device, surface).isValid() &&
-        features2.get<vk::PhysicalDeviceVulkan11Features>().shaderDrawParameters))
-    {
+    if (handle.index >= drawTransforms.size())
+        drawTransforms.resize(handle.index + 1);
+    drawTransforms[handle.index] = transform;
+
+    if (frameRecorder)
+        frameRecorder->recordDrawTransform(handle, transform);
+}
+
+uint32_t Application::getWorldMatrixSlot(const uint32_t draw_index) const
+{
+    if (draw_index >= drawTransforms.size() || !drawTransforms[draw_index].isValid())
         return 0;
-    }
 
-    return score;
+    const uint32_t id = drawTransforms[draw_index].id;
+    return id < sceneSnapshot->worldIndices.size() ? sceneSnapshot->worldIndices[id] + 1 : 0;
 }
 
-void Application::selectPhysicalDevice(const std::vector<std::string_view>& requested_extensions)
+void Application::createFrameReadback()
 {
-    const std::vector<vk::raii::PhysicalDevice> physical_devices = instance.enumeratePhysicalDevices();
-    if (physical_devices.empty())
-    {
-        throw std::runtime_error("No physical devices found");
-    }
+    if (settings.readbackPath.empty())
+        return;
 
-    int max = 0;
+    readbackFile.open(settings.readbackPath, std::ios::binary);
+    if (!readbackFile)
+        throw std::runtime_error("Failed to open " + settings.readbackPath.string());
 
-    // TODO: Use std::max_element with custom comparator
-    for (auto& item : physical_devices)
+    frameReadback = std::make_unique<capture::FrameReadback>(device, physicalDevice, *memoryTracker, maxFramesInFlight,
+                                                             settings.readbackDepth, capture::FrameReadback::Callback(),
+                                                             hostAllocator.getCallbacks());
+    readbackWriter = std::jthread([this](const std::stop_token& stop_token)
     {
-        if (const int rating = ratePhysicalDevice(item, requested_extensions); rating > max)
+        trace::set_thread_name("readback writer");
+        writeReadbackFrames(stop_token);
+    });
+}
+
+void Application::writeReadbackFrames(const std::stop_token& stop_token)
+{
+    vk::Extent2D extent;
+    vk::Format format = vk::Format::eUndefined;
+    while (true)
+    {
+        const auto frame = frameReadback->acquire(readback_poll_interval);
+        if (!frame)
         {
-            physicalDevice = item;
-            max = rating;
+            // The last frames are collected once the device is idle, they are queued before the writer is stopped
+            if (stop_token.stop_requested())
+                return;
+            continue;
         }
-    }
 
-    if (physicalDevice == nullptr)
-        throw std::runtime_error("No suitable physical device found");
+        if (frame->extent != extent || frame->format != format)
+        {
+            extent = frame->extent;
+            format = frame->format;
+            std::cout << "Reading back " << extent.width << "x" << extent.height << " " << vk::to_string(format)
+                << " frames from frame " << frame->number << " on" << std::endl;
+        }
 
-    queueFamilies = ApplicationQueueFamilies(physicalDevice, surface);
-    swapChainDetails = ApplicationSwapChainDetails(physicalDevice, surface);
+        // Straight from the mapped buffer
+        readbackFile.write(reinterpret_cast<const char*>(frame->pixels.data()),
+                           static_cast<std::streamsize>(frame->pixels.size()));
+        frameReadback->release(*frame);
+    }
+}
+
+void Application::replayFrame(const capture::CapturedFrame& frame)
+{
+    TRACE_SCOPE("replayFrame");
+
+    const auto handle_key = [](const renderer::DrawHandle handle)
+    {
+        return static_cast<uint64_t>(handle.index) << 32 | handle.generation;
+    };
+    const auto transform = [this](const scene::TransformHandle handle)
+    {
+        return handle.isValid() ? replayTransforms.at(handle.id) : scene::TransformHandle{};
+    };
+
+    replaySceneTimeNs = frame.sceneTimeNs;
+
+    const bool edits_scene = std::ranges::any_of(frame.commands, [](const capture::command& command)
+    {
+        return std::holds_alternative<capture::commands::TransformCreate>(command) ||
+            std::holds_alternative<capture::commands::TransformSpin>(command);
+    });
+    // The transforms may only change while the simulation is idle
+    if (edits_scene)
+        simulation.waitIdle();
+
+    for (const auto& command : frame.commands)
+    {
+        std::visit(Overloaded{
+                       [this](const events::event& event)
+                       {
+                           // Goes through the window so its size matches what the capture saw. A headless window
+                           // raises no events of its own, so this thread stays the queue's only producer.
+                           if (const auto* resize = std::get_if<events::Resize>(&event))
+                               window->setSize(resize->size);
+                           else
+                               eventQueue.push(event);
+                       },
+                       [&](const capture::commands::DrawAdd& add)
+                       {
+                           replayHandles[handle_key(add.handle)] = drawList.add(add.vertices);
+                       },
+                       [&](const capture::commands::DrawUpdate& update)
+                       {
+                           drawList.update(replayHandles.at(handle_key(update.handle)), update.vertices);
+                       },
+                       [&](const capture::commands::DrawRemove& remove)
+                       {
+                           drawList.remove(replayHandles.at(handle_key(remove.handle)));
+                           replayHandles.erase(handle_key(remove.handle));
+                       },
+                       [&](const capture::commands::TransformCreate& create)
+                       {
+                           replayTransforms[create.handle.id] = simulation.getTransforms().create(
+                               transform(create.parent), create.position, create.rotation, create.scale);
+                       },
+                       [&](const capture::commands::TransformSpin& spin)
+                       {
+                           simulation.addSpin(transform(spin.handle), spin.rate);
+                       },
+                       [&](const capture::commands::DrawTransform& draw_transform)
+                       {
+                           setDrawTransform(replayHandles.at(handle_key(draw_transform.draw)),
+                                            transform(draw_transform.transform));
+                       },
+                       // Uploads follow from the draw list edits, they are only kept for comparison
+                       [](const capture::commands::Upload&)
+                       {
+                       },
+                       [this](const capture::commands::SwapchainRecreate&) { recreateSwapChain(); }
+                   },
+                   command);
+    }
+
+    // The recorded run made these edits before the update this frame draws, so it is made again to include them
+    if (edits_scene)
+    {
+        simulation.requestFrame(frameCount, std::chrono::nanoseconds(sceneTimeNs));
+        simulation.waitIdle();
+    }
+}
+
+void Application::createMemoryTracker(const bool budget_supported)
+{
+    memoryTracker = std::make_unique<renderer::MemoryTracker>(physicalDevice, budget_supported);
+
+    memoryTracker->addSoftLimit(settings.memorySoftLimit, [](const renderer::MemoryTracker::HeapStats& heap)
+    {
+        std::cerr << "Memory heap " << heap.heap << " is using " << (heap.usage >> 20) << " of its "
+            << (heap.budget >> 20) << " MiB budget" << std::endl;
+    });
+}
+
+void Application::writeStats() const
+{
+    std::ofstream file(settings.statsPath);
+    if (!file)
+        throw std::runtime_error("Failed to open " + settings.statsPath.string());
+
+    // A run without frames, or too short for the timer, has no rate, and JSON has no infinity or NaN
+    file << "{\"frames\":" << frameTimingCount << ",\"frameRate\":";
+    if (std::isfinite(frameRate))
+        file << frameRate;
+    else
+        file << "null";
+    file << ",\"memory\":";
+    memoryTracker->writeJson(file);
+    file << "}\n";
+}
+
+void Application::checkFrameAllocations(const unsigned int frame_index, const uint64_t allocations,
+                                        const uint64_t driver_allocations)
+{
+    if (frame_index < steadyStateFrame)
+        return;
+
+    steadyFrames++;
+    steadyDriverAllocations += driver_allocations;
+    if (allocations == 0)
+        return;
+
+    allocatingFrames++;
+    if (checkAllocations)
+        throw std::runtime_error("Frame " + std::to_string(frame_index) + " made " + std::to_string(allocations) +
+                                 " heap allocations after warming up");
+}
+
+void Application::reportFrameTimings() const
+{
+    if (!frameTimings.empty())
+    {
+        uint64_t triangles = 0, drawn_clusters = 0, culled_clusters = 0;
+        for (const auto& timing : frameTimings)
+        {
+            triangles += timing.triangles;
+            drawn_clusters += timing.drawnClusters;
+            culled_clusters += timing.culledClusters;
+        }
+        const size_t frames = frameTimings.size();
+        std::cout << "Triangles emitted: " << triangles / frames << " per frame mean, LOD error "
+            << settings.lodErrorPixels << " px" << std::endl;
+        const bool occlusion_culling = settings.occlusionCulling && meshPathActive;
+        std::cout << "Clusters drawn: " << drawn_clusters / frames << " per frame mean, culled: "
+            << culled_clusters / frames << (occlusion_culling ? "" : " (occlusion culling off)") << std::endl;
+    }
+
+    if (resolutionController)
+    {
+        const auto resolution = resolutionController->getStats();
+        std::cout << "Render scale: " << resolution.meanScale << " mean, " << resolution.minScale << " min, "
+            << resolution.changes << " changes, holding " << settings.targetGpuMs << " ms" << std::endl;
+    }
+
+    if (gpuProfiler->isSupported() && !frameTimings.empty())
+    {
+        double gpu_ms = 0.0, tonemap_ms = 0.0;
+        for (const auto& timing : frameTimings)
+        {
+            gpu_ms += timing.gpuMs;
+            tonemap_ms += timing.tonemapGpuMs;
+        }
+        const auto frames = static_cast<double>(frameTimings.size());
+        std::cout << "GPU frame: " << gpu_ms / frames << " ms mean, tonemap: " << tonemap_ms / frames << " ms mean"
+            << std::endl;
+        if (particleSystem)
+        {
+            std::cout << "Particles: " << particleSystem->getCapacity() << ", update " << getParticleGpuMs()
+                << " ms mean, " << getParticleOverlapMs() << " ms of it alongside the scene" << std::endl;
+        }
+    }
+
+    if (frameReadback)
+    {
+        const auto readback = frameReadback->getStats();
+        std::cout << "Frames read back: " << readback.copied << ", dropped: " << readback.dropped
+            << " with " << settings.readbackDepth << " queued at most" << std::endl;
+    }
+
+    if (!settings.timingsPath.empty())
+        capture::write_timings(settings.timingsPath, frameTimings);
+
+    if (!settings.comparePath.empty())
+        capture::print_timing_comparison(capture::load_timings(settings.comparePath), frameTimings, std::cout);
+}
+
+float Application::getFrameRate() const
+{
+    return frameRate;
+}
+
+bool Application::hasParticles() const
+{
+    return particleSystem != nullptr;
+}
+
+double Application::getParticleGpuMs() const
+{
+    return particleGpuFrames > 0 ? particleGpuMs / static_cast<double>(particleGpuFrames) : 0.0;
+}
+
+double Application::getParticleOverlapMs() const
+{
+    return particleGpuFrames > 0 ? particleOverlapMs / static_cast<double>(particleGpuFrames) : 0.0;
+}
+
+void Application::initVulkan()
+{
+    /*if (!sf::Vulkan::isAvailable())
+    {
+        throw std::runtime_error("Vulkan is not available");
+    }*/
+
+    std::vector<std::string_view> layers;
+    std::vector<std::string_view> device_extensions = {
+        vk::KHRSwapchainExtensionName, vk::EXTHdrMetadataExtensionName
+    };
+
+    // Everything up to the logical device is a chain, after it swapchain, pipelines and buffers only meet again at
+    // the descriptor sets and command buffers. Each step touches its own objects, the device, the memory tracker and
+    // the thread-safe parts of the physical device.
+    jobs::TaskGraph startup;
+
+    const auto instance_step = startup.add("instance", [&]
+    {
+        layers = selectLayers();
+        validationLayersEnabled = std::ranges::find(layers, "VK_LAYER_KHRONOS_validation") != layers.end();
+        createInstance(layers, selectExtensions());
+#ifdef VALIDATION_LAYERS
+        setupDebugMessenger();
+#endif
+    });
+    const auto surface_step = startup.add("surface", [this] { createSurface(); }, {instance_step});
+    const auto physical_device_step = startup.add("physical device", [&]
+    {
+        selectPhysicalDevice(device_extensions);
+        selectDeviceExtensions(device_extensions);
+    }, {surface_step});
+    const auto device_step = startup.add("logical device", [&]
+    {
+        createLogicalDevice(layers, device_extensions);
+        createMemoryTracker(checkDeviceExtensions(physicalDevice, {vk::EXTMemoryBudgetExtensionName}));
+        createSyncObjects();
+        createCommandPool();
+    }, {physical_device_step});
+
+    const auto swapchain_step = startup.add("swapchain", [this]
+    {
+        createSwapChain();
+        createImageViews();
+        createHdrImage();
+        createDepthImages();
+    }, {device_step});
+
+    const auto render_pass_step = startup.add("render pass", [this] { createRenderPass(); }, {device_step});
+    const auto layout_step = startup.add("descriptor layout", [this] { createDescriptorSetLayout(); }, {device_step});
+    // The viewport and scissor are dynamic, so the pipelines compile alongside the swapchain
+    const auto graphics_pipeline_step = startup.add("graphics pipeline", [this] { createGraphicsPipeline(); },
+                                                    {render_pass_step, layout_step});
+    startup.add("particles", [this] { createParticleSystem(); }, {graphics_pipeline_step});
+    const auto tonemap_pipeline_step = startup.add("tonemap pipeline", [this] { createTonemapPipeline(); },
+                                                   {device_step});
+    const auto hiz_pipeline_step = startup.add("depth pyramid pipeline", [this] { createHizPipeline(); },
+                                               {device_step});
+
+    startup.add("framebuffers", [this] { createFramebuffers(); }, {swapchain_step, render_pass_step});
+    startup.add("tonemap descriptors", [this] { createTonemapDescriptorSets(); },
+                {swapchain_step, tonemap_pipeline_step});
+
+    // The index buffer upload and the command buffers both allocate from commandPool, so they stay in one chain
+    const auto buffers_step = startup.add("buffers", [this]
+    {
+        createVertexBuffer();
+        createClusterBuffers();
+        createWorldMatrixBuffer();
+        createIndexBuffer();
+        createStagingBuffers();
+    }, {device_step});
+    const auto geometry_step = startup.add("geometry", [this] { createGeometryStreamer(); }, {device_step});
+    const auto descriptor_sets_step = startup.add("descriptor sets", [this] { createDescriptorSets(); },
+                                                  {buffers_step, layout_step, geometry_step});
+    startup.add("depth pyramid descriptors", [this] { createHizDescriptorSets(); },
+                {swapchain_step, hiz_pipeline_step, descriptor_sets_step});
+    startup.add("command buffers", [this] { createCommandBuffers(); }, {buffers_step});
+    startup.add("frame readback", [this] { createFrameReadback(); }, {device_step});
+    startup.add("textures", [this] { createTextureStreamer(); }, {device_step});
+
+    startup.run(threadPool);
+    startup.printReport(std::cout);
+}
+
+void Application::selectDeviceExtensions(std::vector<std::string_view>& device_extensions)
+{
+    // The vertex path draws the same clusters without mesh shaders, just without occlusion culling
+    if (settings.drawPath != DrawPath::Vertex &&
+        checkDeviceExtensions(physicalDevice, {vk::EXTMeshShaderExtensionName}))
+    {
+        const auto features = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2,
+                                                          vk::PhysicalDeviceMeshShaderFeaturesEXT>();
+        meshShadersEnabled = features.get<vk::PhysicalDeviceMeshShaderFeaturesEXT>().taskShader &&
+            features.get<vk::PhysicalDeviceMeshShaderFeaturesEXT>().meshShader;
+    }
+    if (meshShadersEnabled)
+    {
+        device_extensions.emplace_back(vk::EXTMeshShaderExtensionName);
+    }
+    else
+    {
+        // Streamed clusters are only ever drawn by the task shader, whichever path was asked for
+        if (!settings.geometryPath.empty())
+            throw std::runtime_error("Streaming geometry needs VK_EXT_mesh_shader");
+        if (settings.drawPath != DrawPath::Vertex)
+            std::cout << "Mesh shaders are not supported, drawing with vertex shaders" << std::endl;
+    }
+    meshPathActive = meshShadersEnabled;
+
+    // Lines GPU scopes up with the CPU threads in traces
+    if (const auto host_domain = renderer::GpuProfiler::getHostTimeDomain();
+        !settings.tracePath.empty() && host_domain &&
+        checkDeviceExtensions(physicalDevice, {vk::EXTCalibratedTimestampsExtensionName}))
+    {
+        const auto domains = physicalDevice.getCalibrateableTimeDomainsEXT();
+        calibratedTimestampsEnabled =
+            std::find(domains.begin(), domains.end(), vk::TimeDomainEXT::eDevice) != domains.end() &&
+            std::find(domains.begin(), domains.end(), *host_domain) != domains.end();
+        if (calibratedTimestampsEnabled)
+            device_extensions.emplace_back(vk::EXTCalibratedTimestampsExtensionName);
+    }
+
+    if (checkDeviceExtensions(physicalDevice, {vk::EXTMemoryBudgetExtensionName}))
+        device_extensions.emplace_back(vk::EXTMemoryBudgetExtensionName);
+
+    if (settings.pipelineLibraries)
+    {
+        const std::vector<std::string_view> library_extensions = {
+            vk::KHRPipelineLibraryExtensionName, vk::EXTGraphicsPipelineLibraryExtensionName
+        };
+        const auto features = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2,
+                                                          vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>();
+
+        pipelineLibrariesEnabled = checkDeviceExtensions(physicalDevice, library_extensions) &&
+            features.get<vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>().graphicsPipelineLibrary;
+
+        if (pipelineLibrariesEnabled)
+            device_extensions.insert(device_extensions.end(), library_extensions.begin(), library_extensions.end());
+    }
+
+    if (settings.lowLatency)
+    {
+        const std::vector<std::string_view> present_wait_extensions = {
+            vk::KHRPresentIdExtensionName, vk::KHRPresentWaitExtensionName
+        };
+        const auto features = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2,
+                                                          vk::PhysicalDevicePresentIdFeaturesKHR,
+                                                          vk::PhysicalDevicePresentWaitFeaturesKHR>();
+
+        presentWaitEnabled = checkDeviceExtensions(physicalDevice, present_wait_extensions) &&
+            features.get<vk::PhysicalDevicePresentIdFeaturesKHR>().presentId &&
+            features.get<vk::PhysicalDevicePresentWaitFeaturesKHR>().presentWait;
+
+        if (presentWaitEnabled)
+            device_extensions.insert(device_extensions.end(), present_wait_extensions.begin(),
+                                     present_wait_extensions.end());
+        else
+            std::cout << "Present wait is not supported, low latency pacing disabled" << std::endl;
+    }
+}
+
+void Application::createInstance(const std::vector<std::string_view>& layers,
+                                 const std::vector<std::string_view>& extensions)
+{
+    const auto vk_version = context.enumerateInstanceVersion();
+    std::cout << "Vulkan version: " << vk::apiVersionMajor(vk_version) << "." << vk::apiVersionMinor(vk_version)
+        << std::endl;
+
+    constexpr vk::ApplicationInfo application_info("Triangle", vk::makeApiVersion(0, 0, 1, 0), "No Engine",
+                                                   vk::makeApiVersion(0, 0, 1, 0), vk::ApiVersion13);
+
+    auto instance_flags = vk::InstanceCreateFlags();
+
+#ifdef __APPLE__
+    // Add VK_KHR_PORTABILITY_subset extension for MoltenVK
+    instance_flags |= vk::InstanceCreateFlagBits::eEnumeratePortabilityKHR;
+#endif
+
+    std::array<std::byte, name_list_storage> name_storage;
+    std::pmr::monotonic_buffer_resource names(name_storage.data(), name_storage.size());
+    const auto c_extensions = to_c_strings(extensions, &names);
+    const auto c_layers = to_c_strings(layers, &names);
+
+    const vk::InstanceCreateInfo instance_info(instance_flags, &application_info, c_layers, c_extensions);
+
+    vk::StructureChain instance_info_chain(instance_info
+#ifdef VALIDATION_LAYERS
+                                           ,
+                                           debug_utils_messenger_create_info
+#endif
+    );
+
+    instance = context.createInstance(instance_info_chain.get<vk::InstanceCreateInfo>(), hostAllocator.getCallbacks());
+}
+
+std::vector<std::string_view> Application::selectLayers() const
+{
+    std::vector<std::string_view> requested_layers;
+
+#ifdef VALIDATION_LAYERS
+    requested_layers.emplace_back("VK_LAYER_KHRONOS_validation");
+#endif
+
+    std::vector<vk::LayerProperties> layers = context.enumerateInstanceLayerProperties();
+    std::vector<std::string_view> available_layers;
+    for (auto& requested_layer : requested_layers)
+    {
+        bool found = false;
+        for (auto& layer : layers)
+        {
+            if (static_cast<std::string_view>(layer.layerName.data()) == requested_layer.data())
+            {
+                available_layers.push_back(requested_layer);
+                std::cout << "Found layer: " << requested_layer << std::endl;
+                found = true;
+            }
+        }
+        if (!found)
+        {
+            std::cout << "Requested layer not found: " << std::string(requested_layer) << "; Expect issues"
+                << std::endl;
+        }
+    }
+
+    return available_layers;
+}
+
+std::vector<std::string_view> Application::selectExtensions() const
+{
+    std::vector<vk::ExtensionProperties> extensions = context.enumerateInstanceExtensionProperties();
+
+    auto required_extensions = window->getVulkanRequiredInstanceExtensions();
+
+    required_extensions.emplace_back(vk::EXTSwapchainColorSpaceExtensionName);
+
+#ifdef VALIDATION_LAYERS
+    required_extensions.emplace_back(vk::EXTDebugUtilsExtensionName);
+#endif
+#ifdef __APPLE__
+    // Add VK_KHR_PORTABILITY_subset extension for MoltenVK
+    required_extensions.push_back(vk::KHRPortabilityEnumerationExtensionName);
+#endif
+
+    std::vector<std::string_view> available_extensions;
+    for (const auto& required_extension : required_extensions)
+    {
+        bool found = false;
+        for (auto& extension : extensions)
+        {
+            if (static_cast<std::string_view>(extension.extensionName.data()) == required_extension)
+            {
+                std::cout << "Found extension: " << required_extension << std::endl;
+                available_extensions.push_back(required_extension);
+                found = true;
+            }
+        }
+        if (!found)
+        {
+            throw std::runtime_error("Required extension not found: " + std::string(required_extension));
+        }
+    }
+
+    return available_extensions;
+}
+
+void Application::setupDebugMessenger()
+{
+    debugMessenger = instance.createDebugUtilsMessengerEXT(debug_utils_messenger_create_info,
+                                                           hostAllocator.getCallbacks());
+}
+
+int Application::ratePhysicalDevice(const vk::raii::PhysicalDevice& physical_device,
+                                    const std::vector<std::string_view>& requested_extensions) const
+{
+    const auto properties = physical_device.getProperties();
+    const auto features = physical_device.getFeatures();
+
+    std::cout << "Found Device: " << properties.deviceName << " " << properties.vendorID << " " << properties.deviceID
+        << std::endl;
+    std::cout << "\t"
+        << "API Version: " << vk::apiVersionMajor(properties.apiVersion) << "."
+        << vk::apiVersionMinor(properties.apiVersion) << "." << vk::apiVersionPatch(properties.apiVersion)
+        << std::endl;
+    std::cout << "\t" << "Driver Version: " << vk::apiVersionMajor(properties.driverVersion) << "."
+        << vk::apiVersionMinor(properties.driverVersion) << "." << vk::apiVersionPatch(properties.driverVersion)
+        << std::endl;
+    std::cout << "\t" << to_string(properties.deviceType) << std::endl;
+
+    int score = 0;
+
+    if (properties.deviceType == vk::PhysicalDeviceType::eDiscreteGpu)
+    {
+        score += 1000;
+    }
+
+    score += static_cast<int>(properties.limits.maxImageDimension2D);
+
+    // Prefer more device local memory, one point per 16 MiB
+    const auto memory_properties = physical_device.getMemoryProperties();
+    for (uint32_t i = 0; i < memory_properties.memoryHeapCount; i++)
+    {
+        if (memory_properties.memoryHeaps[i].flags & vk::MemoryHeapFlagBits::eDeviceLocal)
+            score += static_cast<int>(memory_properties.memoryHeaps[i].size >> 24);
+    }
+
+    auto features2 = physical_device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceVulkan11Features,
+                                                  vk::PhysicalDeviceVulkan12Features,
+                                                  vk::PhysicalDeviceVulkan13Features>();
+
+    if (!(ApplicationQueueFamilies(physical_device, surface).isComplete() && features.geometryShader &&
+        properties.apiVersion >= vk::ApiVersion13 &&
+        checkDeviceExtensions(physical_device, requested_extensions) &&
+        ApplicationSwapChainDetails(physical_device, surface).isValid() &&
+        (physical_device.getSurfaceCapabilitiesKHR(surface).supportedUsageFlags &
+            vk::ImageUsageFlagBits::eStorage) &&
+        features.shaderStorageImageReadWithoutFormat && features.shaderStorageImageWriteWithoutFormat &&
+        features2.get<vk::PhysicalDeviceVulkan11Features>().shaderDrawParameters &&
+        features2.get<vk::PhysicalDeviceVulkan12Features>().timelineSemaphore &&
+        features2.get<vk::PhysicalDeviceVulkan13Features>().synchronization2))
+    {
+        return 0;
+    }
+
+    return score;
+}
+
+void Application::selectPhysicalDevice(const std::vector<std::string_view>& requested_extensions)
+{
+    const std::vector<vk::raii::PhysicalDevice> physical_devices = instance.enumeratePhysicalDevices();
+    if (physical_devices.empty())
+    {
+        throw std::runtime_error("No physical devices found");
+    }
+
+    int max = 0;
+
+    // TODO: Use std::max_element with custom comparator
+    for (auto& item : physical_devices)
+    {
+        if (const int rating = ratePhysicalDevice(item, requested_extensions); rating > max)
+        {
+            physicalDevice = item;
+            max = rating;
+        }
+    }
+
+    if (physicalDevice == nullptr)
+        throw std::runtime_error("No suitable physical device found");
+
+    queueFamilies = ApplicationQueueFamilies(physicalDevice, surface);
+    swapChainDetails = ApplicationSwapChainDetails(physicalDevice, surface);
 
     std::cout << "Selected Device: " << physicalDevice.getProperties().deviceName << std::endl;
 }
 
-void Application::createLogicalDevice(const std::vector<std::string_view>& layers,
-                                      const std::vector<std::string_view>& extensions)
+void Application::createLogicalDevice(const std::vector<std::string_view>& layers,
+                                      const std::vector<std::string_view>& extensions)
+{
+    // Graphics feeds the display and gets the GPU first, compute overlaps it and streaming copies fill the gaps.
+    // A family shared between roles gets a single queue at the highest of their priorities.
+    static constexpr float graphics_priority = 1.0f;
+    static constexpr float compute_priority = 0.5f;
+    static constexpr float transfer_priority = 0.25f;
+
+    std::map<uint32_t, float> family_priorities;
+    const auto request_queue = [&family_priorities](const uint32_t family, const float priority)
+    {
+        float& family_priority = family_priorities[family];
+        family_priority = std::max(family_priority, priority);
+    };
+    request_queue(queueFamilies.graphicsFamily.value(), graphics_priority);
+    request_queue(queueFamilies.presentFamily.value(), graphics_priority);
+    request_queue(queueFamilies.computeFamily.value(), compute_priority);
+    request_queue(queueFamilies.transferFamily.value(), transfer_priority);
+
+    std::vector<vk::DeviceQueueCreateInfo> queue_create_infos;
+    for (const auto& [family, priority] : family_priorities)
+    {
+        queue_create_infos.emplace_back(vk::DeviceQueueCreateFlags(), family, 1, &priority);
+    }
+
+    vk::PhysicalDeviceFeatures features = textures::TextureStreamer::getCompressionFeatures(physicalDevice);
+    features.geometryShader = true;
+    features.fillModeNonSolid = true;
+    // The tonemap pass writes swapchain formats that have no SPIR-V image format
+    features.shaderStorageImageReadWithoutFormat = true;
+    features.shaderStorageImageWriteWithoutFormat = true;
+#ifdef NDEBUG
+    features.robustBufferAccess = false;
+#endif
+
+    vk::PhysicalDeviceVulkan11Features vulkan11_features;
+    vulkan11_features.shaderDrawParameters = true;
+
+    vk::PhysicalDeviceVulkan12Features vulkan12_features;
+    vulkan12_features.scalarBlockLayout = true;
+    vulkan12_features.timelineSemaphore = true;
+
+    vk::PhysicalDeviceVulkan13Features vulkan13_features;
+    vulkan13_features.synchronization2 = true;
+
+    vk::PhysicalDeviceMeshShaderFeaturesEXT mesh_shader_features;
+    mesh_shader_features.meshShader = true;
+    mesh_shader_features.taskShader = true;
+
+    vk::PhysicalDevicePresentIdFeaturesKHR present_id_features(true);
+    vk::PhysicalDevicePresentWaitFeaturesKHR present_wait_features(true);
+    vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipeline_library_features(true);
+
+    vk::PhysicalDeviceFeatures2 features2(features);
+    vk::StructureChain enabled_features(features2, vulkan11_features, vulkan12_features, vulkan13_features,
+                                        mesh_shader_features, present_id_features, present_wait_features,
+                                        pipeline_library_features);
+    if (!presentWaitEnabled)
+    {
+        enabled_features.unlink<vk::PhysicalDevicePresentIdFeaturesKHR>();
+        enabled_features.unlink<vk::PhysicalDevicePresentWaitFeaturesKHR>();
+    }
+    if (!pipelineLibrariesEnabled)
+        enabled_features.unlink<vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>();
+    if (!meshShadersEnabled)
+        enabled_features.unlink<vk::PhysicalDeviceMeshShaderFeaturesEXT>();
+
+    std::array<std::byte, name_list_storage> name_storage;
+    std::pmr::monotonic_buffer_resource names(name_storage.data(), name_storage.size());
+    const auto c_layers = to_c_strings(layers, &names);
+    const auto c_extensions = to_c_strings(extensions, &names);
+
+    vk::StructureChain device_create_info_chain{
+        vk::DeviceCreateInfo({}, queue_create_infos, c_layers, c_extensions, {}), enabled_features.get()
+    };
+
+    device = physicalDevice.createDevice(device_create_info_chain.get<vk::DeviceCreateInfo>(),
+                                         hostAllocator.getCallbacks());
+
+    graphicsQueue = device.getQueue(queueFamilies.graphicsFamily.value(), 0);
+    computeQueue = device.getQueue(queueFamilies.computeFamily.value(), 0);
+    transferQueue = device.getQueue(queueFamilies.transferFamily.value(), 0);
+
+    std::cout << "Async compute: " << (queueFamilies.hasAsyncCompute() ? "yes" : "no") << ", dedicated transfer: "
+        << (queueFamilies.hasDedicatedTransfer() ? "yes" : "no") << ", pipeline libraries: "
+        << (pipelineLibrariesEnabled ? "yes" : "no") << ", mesh shaders: " << (meshShadersEnabled ? "yes" : "no")
+        << std::endl;
+}
+
+void Application::createSurface() { surface = window->createVulkanSurface(instance, hostAllocator.getCallbacks()); }
+
+vk::Extent2D Application::chooseSwapExtent(const vk::SurfaceCapabilitiesKHR& capabilities) const
+{
+    const glm::ivec2 window_size = window->getSize();
+
+    if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max())
+    {
+        return capabilities.currentExtent;
+    }
+    const vk::Extent2D extent(std::clamp(static_cast<uint32_t>(window_size.x), capabilities.minImageExtent.width,
+                                         capabilities.maxImageExtent.width),
+                              std::clamp(static_cast<uint32_t>(window_size.y), capabilities.minImageExtent.height,
+                                         capabilities.maxImageExtent.height));
+    return extent;
+}
+
+void Application::createSwapChain()
+{
+    static constexpr std::array present_mode_preferences{
+        vk::PresentModeKHR::eMailbox,
+        vk::PresentModeKHR::eFifoRelaxed,
+        vk::PresentModeKHR::eFifo,
+    };
+
+    const vk::SurfaceFormatKHR surface_format = chooseSwapSurfaceFormat(swapChainDetails.formats);
+    // Paced frames are shown at the refresh they were timed for, mailbox would replace them as soon as they are ready
+    const vk::PresentModeKHR present_mode =
+        presentWaitEnabled
+            ? vk::PresentModeKHR::eFifo
+            : choosePresentMode(swapChainDetails.presentModes, present_mode_preferences);
+
+    const vk::Extent2D extent = chooseSwapExtent(swapChainDetails.capabilities);
+
+    uint32_t image_count = settings.swapchainImages > 0
+                               ? settings.swapchainImages
+                               : swapChainDetails.capabilities.minImageCount + 1;
+    image_count = std::max(image_count, swapChainDetails.capabilities.minImageCount);
+    if (swapChainDetails.capabilities.maxImageCount > 0 && image_count > swapChainDetails.capabilities.maxImageCount)
+    {
+        image_count = swapChainDetails.capabilities.maxImageCount;
+    }
+
+    vk::ImageUsageFlags usage = vk::ImageUsageFlagBits::eStorage;
+    if (!settings.readbackPath.empty())
+    {
+        if (!(swapChainDetails.capabilities.supportedUsageFlags & vk::ImageUsageFlagBits::eTransferSrc))
+            throw std::runtime_error("The surface's images cannot be copied, so they cannot be read back");
+        if (capture::FrameReadback::getTexelSize(surface_format.format) == 0)
+            throw std::runtime_error("Reading back " + vk::to_string(surface_format.format) + " is not supported");
+        usage |= vk::ImageUsageFlagBits::eTransferSrc;
+    }
+
+    vk::SwapchainCreateInfoKHR swap_chain_create_info({}, surface, image_count, surface_format.format,
+                                                      surface_format.colorSpace, extent, 1, usage);
+
+    swap_chain_create_info.preTransform = swapChainDetails.capabilities.currentTransform;
+    swap_chain_create_info.compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque;
+    swap_chain_create_info.presentMode = present_mode;
+    swap_chain_create_info.clipped = true;
+
+    if (queueFamilies.areUnique())
+    {
+        const auto queue_families = queueFamilies.getQueueFamilyIndices();
+        swap_chain_create_info.imageSharingMode = vk::SharingMode::eConcurrent;
+        swap_chain_create_info.setQueueFamilyIndices(queue_families);
+    }
+    else
+    {
+        swap_chain_create_info.imageSharingMode = vk::SharingMode::eExclusive;
+    }
+
+    swapChain = device.createSwapchainKHR(swap_chain_create_info, hostAllocator.getCallbacks());
+
+    swapChainImageFormat = surface_format.format;
+    swapChainColorSpace = surface_format.colorSpace;
+    swapChainExtent = extent;
+    swapChainImages = swapChain.getImages();
+    swapChainImageCount = swapChainImages.size();
+
+    // Present ids belong to a swapchain, the new one starts over
+    presentId = 0;
+
+    if (swapChainColorSpace == vk::ColorSpaceKHR::eHdr10St2084EXT)
+    {
+        // BT.2020 primaries and D65 white, mastered for the peak the tonemap pass rolls off to
+        const vk::HdrMetadataEXT metadata({0.708f, 0.292f}, {0.170f, 0.797f}, {0.131f, 0.046f}, {0.3127f, 0.3290f},
+                                          hdr_peak_nits, 0.001f, hdr_peak_nits, paper_white_nits);
+        device.setHdrMetadataEXT(*swapChain, metadata);
+    }
+
+    createPresentSemaphores();
+}
+
+void Application::recreateSwapChain()
 {
-    std::vector<uint32_t> indices = queueFamilies.getQueueFamilyIndices();
-    std::set unique_queue_indices(indices.begin(), indices.end());
+    TRACE_SCOPE("recreateSwapChain");
 
-    std::vector<vk::DeviceQueueCreateInfo> queue_create_infos;
-    for (uint32_t queue_family_index : unique_queue_indices)
+    device.waitIdle();
+    graphicsTimeline->collect();
+
+    // Everything below is reallocated, and so are the containers the next frames touch first
+    steadyStateFrame = frameCount + allocation_warmup_frames;
+
+    tonemapDescriptorSets.clear();
+    tonemapDescriptorPool = nullptr;
+    hizDescriptorSets.clear();
+    hizDescriptorPool = nullptr;
+    hdrFramebuffer = nullptr;
+    depthPyramidLevelViews.clear();
+    depthPyramidView = nullptr;
+    depthPyramid = nullptr;
+    depthPyramidMemory = nullptr;
+    depthImageView = nullptr;
+    depthImage = nullptr;
+    depthImageMemory = nullptr;
+    hdrImageView = nullptr;
+    hdrImage = nullptr;
+    hdrImageMemory = nullptr;
+    swapChainImageViews.clear();
+    swapChain = nullptr;
+
+    swapChainDetails = ApplicationSwapChainDetails(physicalDevice, surface);
+
+    createSwapChain();
+    createImageViews();
+    createHdrImage();
+    createDepthImages();
+    createFramebuffers();
+    createTonemapDescriptorSets();
+    createHizDescriptorSets();
+}
+
+void Application::createImageViews()
+{
+    swapChainImageViews.reserve(swapChainImageCount);
+
+    constexpr vk::ImageSubresourceRange subresource_range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+
+    for (const auto& image : swapChainImages)
     {
-        auto queue_priority = {1.0f};
-        vk::DeviceQueueCreateInfo queue_create_info({}, queue_family_index, queue_priority);
-        queue_create_infos.push_back(queue_create_info);
+        vk::ImageViewCreateInfo create_info({}, image, vk::ImageViewType::e2D, swapChainImageFormat, {},
+                                            subresource_range);
+
+        swapChainImageViews.emplace_back(device, create_info, hostAllocator.getCallbacks());
     }
+}
 
-    vk::PhysicalDeviceFeatures features;
-    features.geometryShader = true;
-    features.fillModeNonSolid = true;
-#ifdef NDEBUG
-    features.robustBufferAccess = false;
-#endif
+void Application::createDescriptorSetLayout()
+{
+    // Only the mesh path reads them, the vertex stage stands in so the layout stays valid without mesh shaders
+    const vk::ShaderStageFlags task_stages =
+        meshShadersEnabled ? vk::ShaderStageFlagBits::eTaskEXT : vk::ShaderStageFlagBits::eVertex;
+    const vk::ShaderStageFlags task_mesh_stages =
+        meshShadersEnabled ? task_stages | vk::ShaderStageFlagBits::eMeshEXT : task_stages;
+    const std::array layout_bindings{
+        vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, task_mesh_stages, nullptr),
+        vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, task_mesh_stages, nullptr),
+        vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageBuffer, 1, task_stages, nullptr),
+        vk::DescriptorSetLayoutBinding(3, vk::DescriptorType::eSampledImage, 1, task_stages, nullptr),
+        vk::DescriptorSetLayoutBinding(4, vk::DescriptorType::eStorageBuffer, 1, task_stages, nullptr),
+        vk::DescriptorSetLayoutBinding(5, vk::DescriptorType::eStorageBuffer, 1, task_mesh_stages, nullptr),
+        vk::DescriptorSetLayoutBinding(6, vk::DescriptorType::eStorageBuffer, 1, task_stages, nullptr),
+        // Both paths transform their vertices
+        vk::DescriptorSetLayoutBinding(7, vk::DescriptorType::eStorageBuffer, 1,
+                                       task_mesh_stages | vk::ShaderStageFlagBits::eVertex, nullptr)
+    };
 
-    vk::PhysicalDeviceVulkan11Features vulkan11_features;
-    vulkan11_features.shaderDrawParameters = true;
+    const vk::DescriptorSetLayoutCreateInfo layout_info({}, layout_bindings);
+    descriptorSetLayout = vk::raii::DescriptorSetLayout(device, layout_info, hostAllocator.getCallbacks());
+}
 
-    vk::PhysicalDeviceVulkan12Features vulkan12_features;
-    vulkan12_features.scalarBlockLayout = true;
+void Application::createDescriptorSets()
+{
+    const uint32_t set_count = geometryStreamer ? 2 : 1;
+    const std::array pool_size{
+        vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, 7 * set_count),
+        vk::DescriptorPoolSize(vk::DescriptorType::eSampledImage, set_count),
+    };
+    const vk::DescriptorPoolCreateInfo pool_info(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, set_count,
+                                                 pool_size);
+    descriptorPool = device.createDescriptorPool(pool_info, hostAllocator.getCallbacks());
+
+    const std::vector<vk::DescriptorSetLayout> layouts(set_count, *descriptorSetLayout);
+    descriptorSets = device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo(descriptorPool, layouts));
+
+    const vk::DescriptorBufferInfo vertex_info(vertexBuffer, 0, sizeof(Vertex) * drawList.getVertexCapacity());
+    const vk::DescriptorBufferInfo cluster_info(clusterBuffer, 0,
+                                                sizeof(renderer::Cluster) * drawList.getClusterCapacity());
+    const vk::DescriptorBufferInfo stats_info(drawStatsBuffer, 0, vk::WholeSize);
+    const vk::DescriptorBufferInfo visibility_info(clusterVisibilityBuffer, 0, vk::WholeSize);
+    const vk::DescriptorBufferInfo world_matrix_info(worldMatrixBuffer, 0, vk::WholeSize);
+
+    // The depth pyramid at binding 3 is written by createHizDescriptorSets(), it changes with the swapchain. Draw list
+    // draws are not streamed and never read the page table or feedback, any buffer will do for those.
+    const std::array descriptor_writes{
+        vk::WriteDescriptorSet(*descriptorSets[0], 0, 0, vk::DescriptorType::eStorageBuffer, {}, vertex_info),
+        vk::WriteDescriptorSet(*descriptorSets[0], 1, 0, vk::DescriptorType::eStorageBuffer, {}, cluster_info),
+        vk::WriteDescriptorSet(*descriptorSets[0], 2, 0, vk::DescriptorType::eStorageBuffer, {}, stats_info),
+        vk::WriteDescriptorSet(*descriptorSets[0], 4, 0, vk::DescriptorType::eStorageBuffer, {}, visibility_info),
+        vk::WriteDescriptorSet(*descriptorSets[0], 5, 0, vk::DescriptorType::eStorageBuffer, {}, visibility_info),
+        vk::WriteDescriptorSet(*descriptorSets[0], 6, 0, vk::DescriptorType::eStorageBuffer, {}, visibility_info),
+        vk::WriteDescriptorSet(*descriptorSets[0], 7, 0, vk::DescriptorType::eStorageBuffer, {}, world_matrix_info),
+    };
+    device.updateDescriptorSets(descriptor_writes, {});
 
-    vk::PhysicalDeviceMeshShaderFeaturesEXT mesh_shader_features;
-    mesh_shader_features.meshShader = true;
-    mesh_shader_features.taskShader = true;
+    if (!geometryStreamer)
+        return;
 
-    vk::PhysicalDeviceFeatures2 features2(features);
-    vk::StructureChain enabled_features(features2, vulkan11_features, vulkan12_features, mesh_shader_features);
+    // Streamed draws read vertices from the page pool and their own clusters, and share the draw statistics
+    const vk::DescriptorBufferInfo page_pool_info(geometryStreamer->getPagePool(), 0, vk::WholeSize);
+    const vk::DescriptorBufferInfo streamed_cluster_info(geometryStreamer->getClusterBuffer(), 0, vk::WholeSize);
+    const vk::DescriptorBufferInfo streamed_visibility_info(geometryStreamer->getVisibilityBuffer(), 0,
+                                                            vk::WholeSize);
+    const vk::DescriptorBufferInfo page_table_info(geometryStreamer->getPageTable(), 0, vk::WholeSize);
+    const vk::DescriptorBufferInfo feedback_info(geometryStreamer->getFeedbackBuffer(), 0, vk::WholeSize);
+    const std::array streamed_writes{
+        vk::WriteDescriptorSet(*descriptorSets[1], 0, 0, vk::DescriptorType::eStorageBuffer, {}, page_pool_info),
+        vk::WriteDescriptorSet(*descriptorSets[1], 1, 0, vk::DescriptorType::eStorageBuffer, {},
+                               streamed_cluster_info),
+        vk::WriteDescriptorSet(*descriptorSets[1], 2, 0, vk::DescriptorType::eStorageBuffer, {}, stats_info),
+        vk::WriteDescriptorSet(*descriptorSets[1], 4, 0, vk::DescriptorType::eStorageBuffer, {},
+                               streamed_visibility_info),
+        vk::WriteDescriptorSet(*descriptorSets[1], 5, 0, vk::DescriptorType::eStorageBuffer, {}, page_table_info),
+        vk::WriteDescriptorSet(*descriptorSets[1], 6, 0, vk::DescriptorType::eStorageBuffer, {}, feedback_info),
+        vk::WriteDescriptorSet(*descriptorSets[1], 7, 0, vk::DescriptorType::eStorageBuffer, {}, world_matrix_info),
+    };
+    device.updateDescriptorSets(streamed_writes, {});
+}
+
+void Application::createRenderPass()
+{
+    // The early pass leaves color in the general layout, which is what the tonemap pass reads when there is no late
+    // pass, and depth ready to be sampled by the depth pyramid pass
+    const std::array early_attachments{
+        vk::AttachmentDescription({}, hdr_format, vk::SampleCountFlagBits::e1, vk::AttachmentLoadOp::eClear,
+                                  vk::AttachmentStoreOp::eStore, vk::AttachmentLoadOp::eDontCare,
+                                  vk::AttachmentStoreOp::eDontCare, vk::ImageLayout::eUndefined,
+                                  vk::ImageLayout::eGeneral),
+        vk::AttachmentDescription({}, depth_format, vk::SampleCountFlagBits::e1, vk::AttachmentLoadOp::eClear,
+                                  vk::AttachmentStoreOp::eStore, vk::AttachmentLoadOp::eDontCare,
+                                  vk::AttachmentStoreOp::eDontCare, vk::ImageLayout::eUndefined,
+                                  vk::ImageLayout::eShaderReadOnlyOptimal),
+    };
+    // Nothing reads depth after the late pass, the next frame clears it
+    const std::array late_attachments{
+        vk::AttachmentDescription({}, hdr_format, vk::SampleCountFlagBits::e1, vk::AttachmentLoadOp::eLoad,
+                                  vk::AttachmentStoreOp::eStore, vk::AttachmentLoadOp::eDontCare,
+                                  vk::AttachmentStoreOp::eDontCare, vk::ImageLayout::eGeneral,
+                                  vk::ImageLayout::eGeneral),
+        vk::AttachmentDescription({}, depth_format, vk::SampleCountFlagBits::e1, vk::AttachmentLoadOp::eLoad,
+                                  vk::AttachmentStoreOp::eDontCare, vk::AttachmentLoadOp::eDontCare,
+                                  vk::AttachmentStoreOp::eDontCare, vk::ImageLayout::eShaderReadOnlyOptimal,
+                                  vk::ImageLayout::eDepthStencilAttachmentOptimal),
+    };
 
-    auto c_layers = to_c_strings(layers);
-    auto c_extensions = to_c_strings(extensions);
+    constexpr vk::AttachmentReference color_attachment(0, vk::ImageLayout::eColorAttachmentOptimal);
+    constexpr vk::AttachmentReference depth_attachment(1, vk::ImageLayout::eDepthStencilAttachmentOptimal);
+    const vk::SubpassDescription subpass({}, vk::PipelineBindPoint::eGraphics, {}, color_attachment, {},
+                                         &depth_attachment);
+
+    constexpr vk::PipelineStageFlags depth_stages =
+        vk::PipelineStageFlagBits::eEarlyFragmentTests | vk::PipelineStageFlagBits::eLateFragmentTests;
+    const vk::PipelineStageFlags task_stage =
+        meshShadersEnabled ? vk::PipelineStageFlagBits::eTaskShaderEXT : vk::PipelineStageFlagBits::eVertexShader;
+
+    // The previous frame has to be done with both images before they are cleared: its tonemap pass reading color,
+    // its depth pyramid pass reading depth and its late pass writing it. The task shaders of both passes read and
+    // write the cluster visibility and the draw statistics, so they are ordered too.
+    const std::array early_dependencies{
+        vk::SubpassDependency(vk::SubpassExternal, 0,
+                              vk::PipelineStageFlagBits::eColorAttachmentOutput |
+                              vk::PipelineStageFlagBits::eComputeShader | depth_stages | task_stage,
+                              vk::PipelineStageFlagBits::eColorAttachmentOutput | depth_stages | task_stage,
+                              vk::AccessFlagBits::eDepthStencilAttachmentWrite | vk::AccessFlagBits::eShaderWrite,
+                              vk::AccessFlagBits::eColorAttachmentWrite |
+                              vk::AccessFlagBits::eDepthStencilAttachmentRead |
+                              vk::AccessFlagBits::eDepthStencilAttachmentWrite | vk::AccessFlagBits::eShaderRead |
+                              vk::AccessFlagBits::eShaderWrite),
+        vk::SubpassDependency(0, vk::SubpassExternal,
+                              vk::PipelineStageFlagBits::eColorAttachmentOutput | depth_stages | task_stage,
+                              vk::PipelineStageFlagBits::eComputeShader |
+                              vk::PipelineStageFlagBits::eColorAttachmentOutput | task_stage,
+                              vk::AccessFlagBits::eColorAttachmentWrite |
+                              vk::AccessFlagBits::eDepthStencilAttachmentWrite | vk::AccessFlagBits::eShaderWrite,
+                              vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eColorAttachmentRead |
+                              vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eShaderWrite),
+    };
 
-    vk::StructureChain device_create_info_chain{
-        vk::DeviceCreateInfo({}, queue_create_infos, c_layers, c_extensions, {}), enabled_features.get()
+    // The late pass culls against the pyramid and keeps testing against the early pass's depth, and this frame's
+    // tonemap pass has to wait for its draws
+    const std::array late_dependencies{
+        vk::SubpassDependency(vk::SubpassExternal, 0, vk::PipelineStageFlagBits::eComputeShader,
+                              task_stage | depth_stages, vk::AccessFlagBits::eShaderWrite,
+                              vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eDepthStencilAttachmentRead |
+                              vk::AccessFlagBits::eDepthStencilAttachmentWrite),
+        vk::SubpassDependency(0, vk::SubpassExternal, vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                              vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eColorAttachmentWrite,
+                              vk::AccessFlagBits::eShaderStorageRead),
+    };
+
+    // Particles draw over the finished scene in a pass of their own, so they can be submitted apart from it. They do
+    // not test depth, its attachment only keeps the pass compatible with the pipelines and its contents are dropped.
+    const std::array particle_attachments{
+        vk::AttachmentDescription({}, hdr_format, vk::SampleCountFlagBits::e1, vk::AttachmentLoadOp::eLoad,
+                                  vk::AttachmentStoreOp::eStore, vk::AttachmentLoadOp::eDontCare,
+                                  vk::AttachmentStoreOp::eDontCare, vk::ImageLayout::eGeneral,
+                                  vk::ImageLayout::eGeneral),
+        vk::AttachmentDescription({}, depth_format, vk::SampleCountFlagBits::e1, vk::AttachmentLoadOp::eDontCare,
+                                  vk::AttachmentStoreOp::eDontCare, vk::AttachmentLoadOp::eDontCare,
+                                  vk::AttachmentStoreOp::eDontCare, vk::ImageLayout::eUndefined,
+                                  vk::ImageLayout::eDepthStencilAttachmentOptimal),
+    };
+
+    // After the scene's draws, and before this frame's tonemap pass reads the result
+    const std::array particle_dependencies{
+        vk::SubpassDependency(vk::SubpassExternal, 0, vk::PipelineStageFlagBits::eColorAttachmentOutput | depth_stages,
+                              vk::PipelineStageFlagBits::eColorAttachmentOutput | depth_stages,
+                              vk::AccessFlagBits::eColorAttachmentWrite |
+                              vk::AccessFlagBits::eDepthStencilAttachmentWrite,
+                              vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite |
+                              vk::AccessFlagBits::eDepthStencilAttachmentWrite),
+        vk::SubpassDependency(0, vk::SubpassExternal, vk::PipelineStageFlagBits::eColorAttachmentOutput,
+                              vk::PipelineStageFlagBits::eComputeShader, vk::AccessFlagBits::eColorAttachmentWrite,
+                              vk::AccessFlagBits::eShaderStorageRead),
+    };
+
+    renderPass = device.createRenderPass(vk::RenderPassCreateInfo({}, early_attachments, subpass, early_dependencies),
+                                         hostAllocator.getCallbacks());
+    lateRenderPass = device.createRenderPass(vk::RenderPassCreateInfo({}, late_attachments, subpass,
+                                                                      late_dependencies),
+                                             hostAllocator.getCallbacks());
+    particleRenderPass = device.createRenderPass(vk::RenderPassCreateInfo({}, particle_attachments, subpass,
+                                                                          particle_dependencies),
+                                                 hostAllocator.getCallbacks());
+}
+
+void Application::createGraphicsPipeline()
+{
+    drawConstantStages = vk::ShaderStageFlagBits::eVertex;
+    if (meshShadersEnabled)
+        drawConstantStages |= vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT;
+    vk::PushConstantRange push_constant_range(drawConstantStages, 0, sizeof(DrawConstants));
+
+    pipelineLayout = device.createPipelineLayout(
+        vk::PipelineLayoutCreateInfo({}, *descriptorSetLayout, push_constant_range), hostAllocator.getCallbacks());
+
+    pipelineManager = std::make_unique<renderer::PipelineManager>(device, pipelineLibrariesEnabled,
+                                                                  pipeline_compile_threads,
+                                                                  hostAllocator.getCallbacks());
+
+    // Draws at equal depth still overwrite each other in order, which the default eLessOrEqual keeps
+    renderer::GraphicsPipelineDesc desc;
+    desc.code = std::span<const uint32_t>(triangle, triangle_sizeInBytes / sizeof(uint32_t));
+    desc.layout = pipelineLayout;
+    desc.renderPass = renderPass;
+    if (meshShadersEnabled)
+        trianglePipeline = pipelineManager->request(desc);
+    if (!meshShadersEnabled || drawPathTuner)
+    {
+        desc.vertexEntry = "vertexMain";
+        triangleVertexPipeline = pipelineManager->request(desc);
+    }
+
+    // The first frames draw with them, fast-linked when libraries are in use
+    for (const auto handle : {trianglePipeline, triangleVertexPipeline})
+    {
+        if (handle.isValid())
+            pipelineManager->wait(handle);
+    }
+}
+
+void Application::createFramebuffers()
+{
+    vk::ImageView attachments[] = {hdrImageView, depthImageView};
+
+    vk::FramebufferCreateInfo framebuffer_info({}, renderPass, attachments, swapChainExtent.width,
+                                               swapChainExtent.height, 1);
+
+    hdrFramebuffer = vk::raii::Framebuffer(device, framebuffer_info, hostAllocator.getCallbacks());
+}
+
+void Application::createHdrImage()
+{
+    std::tie(hdrImage, hdrImageMemory) =
+        createImage(swapChainExtent, hdr_format,
+                    vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eStorage, "HDR color");
+
+    constexpr vk::ImageSubresourceRange subresource_range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+    const vk::ImageViewCreateInfo create_info({}, hdrImage, vk::ImageViewType::e2D, hdr_format, {},
+                                              subresource_range);
+
+    hdrImageView = vk::raii::ImageView(device, create_info, hostAllocator.getCallbacks());
+}
+
+void Application::createDepthImages()
+{
+    std::tie(depthImage, depthImageMemory) =
+        createImage(swapChainExtent, depth_format,
+                    vk::ImageUsageFlagBits::eDepthStencilAttachment | vk::ImageUsageFlagBits::eSampled, "depth");
+
+    constexpr vk::ImageSubresourceRange depth_range(vk::ImageAspectFlagBits::eDepth, 0, 1, 0, 1);
+    depthImageView = vk::raii::ImageView(
+        device, vk::ImageViewCreateInfo({}, depthImage, vk::ImageViewType::e2D, depth_format, {}, depth_range),
+        hostAllocator.getCallbacks());
+
+    // Level 0 is half the render size, so even the first reduction gathers a 2x2 block
+    // A scaled down render only uses the top left of both images
+    const vk::Extent2D pyramid_extent(std::max(swapChainExtent.width / 2, 1u),
+                                      std::max(swapChainExtent.height / 2, 1u));
+    depthPyramidLevels = static_cast<uint32_t>(std::bit_width(std::max(pyramid_extent.width, pyramid_extent.height)));
+
+    std::tie(depthPyramid, depthPyramidMemory) =
+        createImage(pyramid_extent, depth_pyramid_format,
+                    vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eSampled, "depth pyramid",
+                    depthPyramidLevels);
+
+    const vk::ImageSubresourceRange pyramid_range(vk::ImageAspectFlagBits::eColor, 0, depthPyramidLevels, 0, 1);
+    depthPyramidView = vk::raii::ImageView(
+        device,
+        vk::ImageViewCreateInfo({}, depthPyramid, vk::ImageViewType::e2D, depth_pyramid_format, {}, pyramid_range),
+        hostAllocator.getCallbacks());
+
+    depthPyramidLevelViews.reserve(depthPyramidLevels);
+    for (uint32_t level = 0; level < depthPyramidLevels; level++)
+    {
+        const vk::ImageSubresourceRange level_range(vk::ImageAspectFlagBits::eColor, level, 1, 0, 1);
+        depthPyramidLevelViews.emplace_back(
+            device,
+            vk::ImageViewCreateInfo({}, depthPyramid, vk::ImageViewType::e2D, depth_pyramid_format, {}, level_range),
+            hostAllocator.getCallbacks());
+    }
+}
+
+void Application::createHizPipeline()
+{
+    assert((void("Invalid SPIR-V magic number"), hiz[0] == 0x07230203));
+
+    constexpr std::array layout_bindings{
+        vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eSampledImage, 1, vk::ShaderStageFlagBits::eCompute,
+                                       nullptr),
+        vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute,
+                                       nullptr),
+    };
+
+    const vk::DescriptorSetLayoutCreateInfo layout_info({}, layout_bindings);
+    hizDescriptorSetLayout = vk::raii::DescriptorSetLayout(device, layout_info, hostAllocator.getCallbacks());
+
+    const vk::PushConstantRange push_constant_range(vk::ShaderStageFlagBits::eCompute, 0, sizeof(HizConstants));
+    hizPipelineLayout = device.createPipelineLayout(
+        vk::PipelineLayoutCreateInfo({}, *hizDescriptorSetLayout, push_constant_range), hostAllocator.getCallbacks());
+
+    const vk::ShaderModuleCreateInfo shader_module_create_info({}, hiz_sizeInBytes, hiz);
+    const auto shader_module = device.createShaderModule(shader_module_create_info, hostAllocator.getCallbacks());
+
+    const vk::PipelineShaderStageCreateInfo compute_stage_info({}, vk::ShaderStageFlagBits::eCompute, shader_module,
+                                                               "hizMain");
+
+    hizPipeline = device.createComputePipeline(
+        nullptr, vk::ComputePipelineCreateInfo({}, compute_stage_info, hizPipelineLayout),
+        hostAllocator.getCallbacks());
+}
+
+void Application::createHizDescriptorSets()
+{
+    const std::array pool_size{
+        vk::DescriptorPoolSize(vk::DescriptorType::eSampledImage, depthPyramidLevels),
+        vk::DescriptorPoolSize(vk::DescriptorType::eStorageImage, depthPyramidLevels),
+    };
+    const vk::DescriptorPoolCreateInfo pool_info(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet,
+                                                 depthPyramidLevels, pool_size);
+    hizDescriptorPool = device.createDescriptorPool(pool_info, hostAllocator.getCallbacks());
+
+    const std::vector<vk::DescriptorSetLayout> layouts(depthPyramidLevels, *hizDescriptorSetLayout);
+    hizDescriptorSets = device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo(hizDescriptorPool, layouts));
+
+    for (uint32_t level = 0; level < depthPyramidLevels; level++)
+    {
+        const vk::DescriptorImageInfo source_info =
+            level == 0
+                ? vk::DescriptorImageInfo({}, depthImageView, vk::ImageLayout::eShaderReadOnlyOptimal)
+                : vk::DescriptorImageInfo({}, depthPyramidLevelViews[level - 1], vk::ImageLayout::eGeneral);
+        const vk::DescriptorImageInfo destination_info({}, depthPyramidLevelViews[level], vk::ImageLayout::eGeneral);
+
+        const std::array descriptor_writes{
+            vk::WriteDescriptorSet(*hizDescriptorSets[level], 0, 0, vk::DescriptorType::eSampledImage, source_info),
+            vk::WriteDescriptorSet(*hizDescriptorSets[level], 1, 0, vk::DescriptorType::eStorageImage,
+                                   destination_info),
+        };
+        device.updateDescriptorSets(descriptor_writes, {});
+    }
+
+    // Only ever updated while the device is idle, at startup or when the swapchain is rebuilt
+    const vk::DescriptorImageInfo pyramid_info({}, depthPyramidView, vk::ImageLayout::eGeneral);
+    for (const auto& descriptor_set : descriptorSets)
+    {
+        device.updateDescriptorSets(
+            vk::WriteDescriptorSet(*descriptor_set, 3, 0, vk::DescriptorType::eSampledImage, pyramid_info), {});
+    }
+}
+
+void Application::createTonemapPipeline()
+{
+    assert((void("Invalid SPIR-V magic number"), tonemap[0] == 0x07230203));
+
+    constexpr std::array layout_bindings{
+        vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute,
+                                       nullptr),
+        vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageImage, 1, vk::ShaderStageFlagBits::eCompute,
+                                       nullptr),
     };
 
-    device = physicalDevice.createDevice(device_create_info_chain.get<vk::DeviceCreateInfo>());
+    const vk::DescriptorSetLayoutCreateInfo layout_info({}, layout_bindings);
+    tonemapDescriptorSetLayout = vk::raii::DescriptorSetLayout(device, layout_info, hostAllocator.getCallbacks());
+
+    const vk::PushConstantRange push_constant_range(vk::ShaderStageFlagBits::eCompute, 0, sizeof(TonemapConstants));
+    tonemapPipelineLayout = device.createPipelineLayout(
+        vk::PipelineLayoutCreateInfo({}, *tonemapDescriptorSetLayout, push_constant_range),
+        hostAllocator.getCallbacks());
+
+    const vk::ShaderModuleCreateInfo shader_module_create_info({}, tonemap_sizeInBytes, tonemap);
+    const auto shader_module = device.createShaderModule(shader_module_create_info, hostAllocator.getCallbacks());
+
+    const vk::PipelineShaderStageCreateInfo compute_stage_info({}, vk::ShaderStageFlagBits::eCompute, shader_module,
+                                                               "tonemapMain");
+
+    tonemapPipeline = device.createComputePipeline(
+        nullptr, vk::ComputePipelineCreateInfo({}, compute_stage_info, tonemapPipelineLayout),
+        hostAllocator.getCallbacks());
+}
+
+void Application::createTonemapDescriptorSets()
+{
+    const auto image_count = static_cast<uint32_t>(swapChainImageViews.size());
+
+    const std::array pool_size{vk::DescriptorPoolSize(vk::DescriptorType::eStorageImage, image_count * 2)};
+    const vk::DescriptorPoolCreateInfo pool_info(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, image_count,
+                                                 pool_size);
+    tonemapDescriptorPool = device.createDescriptorPool(pool_info, hostAllocator.getCallbacks());
+
+    const std::vector<vk::DescriptorSetLayout> layouts(image_count, *tonemapDescriptorSetLayout);
+    tonemapDescriptorSets = device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo(tonemapDescriptorPool, layouts));
+
+    for (uint32_t i = 0; i < image_count; i++)
+    {
+        const vk::DescriptorImageInfo hdr_info({}, hdrImageView, vk::ImageLayout::eGeneral);
+        const vk::DescriptorImageInfo output_info({}, swapChainImageViews[i], vk::ImageLayout::eGeneral);
+
+        const std::array descriptor_writes{
+            vk::WriteDescriptorSet(*tonemapDescriptorSets[i], 0, 0, vk::DescriptorType::eStorageImage, hdr_info),
+            vk::WriteDescriptorSet(*tonemapDescriptorSets[i], 1, 0, vk::DescriptorType::eStorageImage, output_info),
+        };
+        device.updateDescriptorSets(descriptor_writes, {});
+    }
+}
+
+void Application::createCommandPool()
+{
+    const vk::CommandPoolCreateInfo pool_info(vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+                                              queueFamilies.graphicsFamily.value());
+
+    commandPool = device.createCommandPool(pool_info, hostAllocator.getCallbacks());
+
+    const vk::CommandPoolCreateInfo compute_pool_info(vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+                                                      queueFamilies.computeFamily.value());
+
+    computeCommandPool = device.createCommandPool(compute_pool_info, hostAllocator.getCallbacks());
+
+    const vk::CommandPoolCreateInfo transfer_pool_info(vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
+                                                       queueFamilies.transferFamily.value());
+
+    transferCommandPool = device.createCommandPool(transfer_pool_info, hostAllocator.getCallbacks());
+}
+
+uint64_t Application::copyBuffer(const vk::raii::Buffer& src_buffer, const vk::raii::Buffer& dst_buffer,
+                                 const vk::DeviceSize size)
+{
+    const vk::CommandBufferAllocateInfo command_buffer_allocate_info(commandPool, vk::CommandBufferLevel::ePrimary, 1);
+    vk::raii::CommandBuffer command_copy_buffer =
+        std::move(device.allocateCommandBuffers(command_buffer_allocate_info).front());
+
+    command_copy_buffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+
+    command_copy_buffer.copyBuffer(src_buffer, dst_buffer, vk::BufferCopy(0, 0, size));
+
+    command_copy_buffer.end();
+
+    const vk::CommandBufferSubmitInfo command_buffer_info(*command_copy_buffer);
+    const uint64_t value = graphicsTimeline->submit(graphicsQueue, {}, command_buffer_info);
+    graphicsTimeline->retire(std::move(command_copy_buffer));
+    return value;
+}
+
+std::pair<vk::raii::Image, renderer::TrackedDeviceMemory>
+Application::createImage(const vk::Extent2D extent, const vk::Format format, const vk::ImageUsageFlags usage,
+                         const std::string_view owner, const uint32_t mip_levels) const
+{
+    const vk::ImageCreateInfo image_create_info({}, vk::ImageType::e2D, format, vk::Extent3D(extent, 1), mip_levels, 1,
+                                                vk::SampleCountFlagBits::e1, vk::ImageTiling::eOptimal, usage,
+                                                vk::SharingMode::eExclusive);
+    vk::raii::Image image(device, image_create_info, hostAllocator.getCallbacks());
+    const vk::MemoryRequirements memory_requirements = image.getMemoryRequirements();
+    const vk::MemoryAllocateInfo alloc_info(
+        memory_requirements.size,
+        renderer::find_memory_type(physicalDevice.getMemoryProperties(), memory_requirements.memoryTypeBits,
+                                   vk::MemoryPropertyFlagBits::eDeviceLocal));
+    renderer::TrackedDeviceMemory image_memory(device, alloc_info, *memoryTracker, renderer::MemoryCategory::Images,
+                                               owner, hostAllocator.getCallbacks());
+    image.bindMemory(*image_memory, 0);
+    return {std::move(image), std::move(image_memory)};
+}
+
+std::pair<vk::raii::Buffer, renderer::TrackedDeviceMemory>
+Application::createBuffer(const vk::DeviceSize size, const vk::BufferUsageFlags usage,
+                          const vk::MemoryPropertyFlags properties, const renderer::MemoryCategory category,
+                          const std::string_view owner) const
+{
+    const vk::BufferCreateInfo buffer_create_info({}, size, usage, vk::SharingMode::eExclusive);
+    vk::raii::Buffer buffer(device, buffer_create_info, hostAllocator.getCallbacks());
+    const vk::MemoryRequirements memory_requirements = buffer.getMemoryRequirements();
+    const vk::MemoryAllocateInfo alloc_info(
+        memory_requirements.size,
+        renderer::find_memory_type(physicalDevice.getMemoryProperties(), memory_requirements.memoryTypeBits,
+                                   properties));
+    renderer::TrackedDeviceMemory buffer_memory(device, alloc_info, *memoryTracker, category, owner,
+                                                hostAllocator.getCallbacks());
+    buffer.bindMemory(*buffer_memory, 0);
+    return {std::move(buffer), std::move(buffer_memory)};
+};
+
+void Application::createVertexBuffer()
+{
+    // Sized for the whole draw list, the contents arrive through the per-frame uploads
+    const vk::DeviceSize buffer_size = sizeof(Vertex) * drawList.getVertexCapacity();
+
+    std::tie(vertexBuffer, vertexBufferMemory) =
+        createBuffer(buffer_size,
+                     vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eVertexBuffer |
+                     vk::BufferUsageFlagBits::eTransferDst,
+                     vk::MemoryPropertyFlagBits::eDeviceLocal, renderer::MemoryCategory::Geometry, "vertex buffer");
+}
+
+void Application::createClusterBuffers()
+{
+    // An empty draw list still needs a buffer to bind
+    const vk::DeviceSize buffer_size = sizeof(renderer::Cluster) * std::max(drawList.getClusterCapacity(), 1u);
+
+    std::tie(clusterBuffer, clusterBufferMemory) =
+        createBuffer(buffer_size, vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                     vk::MemoryPropertyFlagBits::eDeviceLocal, renderer::MemoryCategory::Geometry, "cluster buffer");
+
+    // Starts out undefined, which at worst makes the first frame's early pass draw clusters the late pass culls
+    std::tie(clusterVisibilityBuffer, clusterVisibilityMemory) =
+        createBuffer(sizeof(uint32_t) * std::max(drawList.getClusterCapacity(), 1u),
+                     vk::BufferUsageFlagBits::eStorageBuffer, vk::MemoryPropertyFlagBits::eDeviceLocal,
+                     renderer::MemoryCategory::Geometry, "cluster visibility");
+
+    const vk::DeviceSize stats_size = sizeof(DrawStats) * maxFramesInFlight;
+    std::tie(drawStatsBuffer, drawStatsMemory) =
+        createBuffer(stats_size, vk::BufferUsageFlagBits::eStorageBuffer,
+                     vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                     renderer::MemoryCategory::Other, "draw statistics");
+    drawStats = static_cast<DrawStats*>(drawStatsMemory.mapMemory(0, stats_size));
+    std::fill_n(drawStats, maxFramesInFlight, DrawStats{});
+}
+
+void Application::createWorldMatrixBuffer()
+{
+    std::tie(worldMatrixBuffer, worldMatrixMemory) =
+        createBuffer(sizeof(glm::mat4) * world_matrix_capacity,
+                     vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                     vk::MemoryPropertyFlagBits::eDeviceLocal, renderer::MemoryCategory::Other, "world matrices");
+
+    // Everything is uploaded once, the snapshots only mark what changed since
+    worldMatrices.assign(world_matrix_capacity, glm::mat4(1.0f));
+    worldMatrixDirtyRanges.add(0, sizeof(glm::mat4) * world_matrix_capacity);
+}
+
+void Application::createIndexBuffer()
+{
+    const std::vector<uint16_t> indices = {0, 1, 2, 2, 3, 0};
+
+    const vk::DeviceSize buffer_size = sizeof(indices[0]) * indices.size();
+
+    auto [stage_buffer, stage_buffer_memory] =
+        createBuffer(buffer_size, vk::BufferUsageFlagBits::eTransferSrc,
+                     vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                     renderer::MemoryCategory::Staging, "index staging buffer");
+
+    void* data_location = stage_buffer_memory.mapMemory(0, buffer_size);
+    std::memcpy(data_location, indices.data(), buffer_size);
+    stage_buffer_memory.unmapMemory();
+
+    std::tie(indexBuffer, indexBufferMemory) =
+        createBuffer(buffer_size, vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst,
+                     vk::MemoryPropertyFlagBits::eDeviceLocal, renderer::MemoryCategory::Geometry, "index buffer");
+
+    copyBuffer(stage_buffer, indexBuffer, buffer_size);
+    graphicsTimeline->retire(std::move(stage_buffer), std::move(stage_buffer_memory));
+}
+
+void Application::createStagingBuffers()
+{
+    stagingBuffers.reserve(maxFramesInFlight);
+    stagingBufferMemories.reserve(maxFramesInFlight);
+    stagingBufferMappings.reserve(maxFramesInFlight);
+
+    for (size_t i = 0; i < maxFramesInFlight; i++)
+    {
+        auto [buffer, memory] =
+            createBuffer(staging_buffer_size, vk::BufferUsageFlagBits::eTransferSrc,
+                         vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                         renderer::MemoryCategory::Staging, "upload staging buffer");
+
+        stagingBufferMappings.push_back(memory.mapMemory(0, staging_buffer_size));
+        stagingBuffers.push_back(std::move(buffer));
+        stagingBufferMemories.push_back(std::move(memory));
+    }
+}
+
+void Application::createCommandBuffers()
+{
+    commandBuffers.reserve(maxFramesInFlight);
+
+    const vk::CommandBufferAllocateInfo command_buffer_allocate_info(commandPool, vk::CommandBufferLevel::ePrimary,
+                                                                     maxFramesInFlight);
+
+    commandBuffers = device.allocateCommandBuffers(command_buffer_allocate_info);
+
+    const vk::CommandBufferAllocateInfo transfer_allocate_info(transferCommandPool, vk::CommandBufferLevel::ePrimary,
+                                                               maxFramesInFlight);
+
+    transferCommandBuffers = device.allocateCommandBuffers(transfer_allocate_info);
+
+    const vk::CommandBufferAllocateInfo compute_allocate_info(computeCommandPool, vk::CommandBufferLevel::ePrimary,
+                                                              maxFramesInFlight);
+
+    computeCommandBuffers = device.allocateCommandBuffers(compute_allocate_info);
+
+    // Only recorded with particles, which split the frame into three graphics submits
+    particleCommandBuffers = device.allocateCommandBuffers(command_buffer_allocate_info);
+    tonemapCommandBuffers = device.allocateCommandBuffers(command_buffer_allocate_info);
+}
+
+void Application::recordUploads(const vk::raii::CommandBuffer& command_buffer)
+{
+    TRACE_SCOPE("recordUploads");
 
-    graphicsQueue = device.getQueue(indices[0], 0);
-}
+    auto& vertex_ranges = drawList.getDirtyRanges();
+    auto& cluster_ranges = drawList.getClusterDirtyRanges();
+    if (vertex_ranges.empty() && cluster_ranges.empty() && worldMatrixDirtyRanges.empty())
+        return;
 
-void Application::createSurface() { surface = window->createVulkanSurface(instance); }
+    memory::FrameArena& arena = frameArenas[currentFrame];
 
-vk::Extent2D Application::chooseSwapExtent(const vk::SurfaceCapabilitiesKHR& capabilities) const
-{
-    const glm::ivec2 window_size = window->getSize();
+    std::pmr::vector<vk::BufferCopy> vertex_regions(&arena);
+    std::pmr::vector<vk::BufferCopy> cluster_regions(&arena);
+    std::pmr::vector<vk::BufferCopy> world_matrix_regions(&arena);
+    vk::DeviceSize staging_offset = 0;
+    // World matrices first, they change every frame something moves and are only a few bytes
+    stageUploads(worldMatrixDirtyRanges, std::as_bytes(std::span(worldMatrices)), world_matrix_regions,
+                 staging_offset);
+    stageUploads(vertex_ranges, std::as_bytes(drawList.getVertices()), vertex_regions, staging_offset);
+    stageUploads(cluster_ranges, std::as_bytes(drawList.getClusters()), cluster_regions, staging_offset);
 
-    if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max())
+    frameUploadBytes += staging_offset;
+    if (frameRecorder)
     {
-        return capabilities.currentExtent;
+        frameRecorder->recordUpload(staging_offset,
+                                    static_cast<uint32_t>(vertex_regions.size() + cluster_regions.size() +
+                                                          world_matrix_regions.size()));
     }
-    const vk::Extent2D extent(std::clamp(static_cast<uint32_t>(window_size.x), capabilities.minImageExtent.width,
-                                         capabilities.maxImageExtent.width),
-                              std::clamp(static_cast<uint32_t>(window_size.y), capabilities.minImageExtent.height,
-                                         capabilities.maxImageExtent.height));
-    return extent;
+
+    const vk::PipelineStageFlags2 geometry_stages = getGeometryStages();
+
+    // Frames still in flight may be reading the vertices, clusters and world matrices about to be overwritten
+    const vk::MemoryBarrier2 read_barrier(geometry_stages, {}, vk::PipelineStageFlagBits2::eCopy, {});
+    command_buffer.pipelineBarrier2(vk::DependencyInfo({}, read_barrier));
+
+    if (!vertex_regions.empty())
+        command_buffer.copyBuffer(stagingBuffers[currentFrame], vertexBuffer, vertex_regions);
+    if (!cluster_regions.empty())
+        command_buffer.copyBuffer(stagingBuffers[currentFrame], clusterBuffer, cluster_regions);
+    if (!world_matrix_regions.empty())
+        command_buffer.copyBuffer(stagingBuffers[currentFrame], worldMatrixBuffer, world_matrix_regions);
+
+    const vk::MemoryBarrier2 upload_barrier(vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite,
+                                            geometry_stages,
+                                            vk::AccessFlagBits2::eShaderStorageRead |
+                                            vk::AccessFlagBits2::eVertexAttributeRead);
+    command_buffer.pipelineBarrier2(vk::DependencyInfo({}, upload_barrier));
 }
 
-void Application::createSwapChain()
+void Application::stageUploads(renderer::DirtyRanges& dirty_ranges, const std::span<const std::byte> source,
+                               std::pmr::vector<vk::BufferCopy>& regions, vk::DeviceSize& staging_offset)
 {
-    const vk::SurfaceFormatKHR surface_format = chooseSwapSurfaceFormat(swapChainDetails.formats);
-    const vk::PresentModeKHR present_mode =
-        choosePresentMode(swapChainDetails.presentModes, {
-                              vk::PresentModeKHR::eMailbox,
-                              vk::PresentModeKHR::eFifoRelaxed,
-                              vk::PresentModeKHR::eFifo,
-                          });
+    if (dirty_ranges.empty())
+        return;
 
-    const vk::Extent2D extent = chooseSwapExtent(swapChainDetails.capabilities);
+    dirty_ranges.coalesce(upload_merge_gap);
 
-    uint32_t image_count = swapChainDetails.capabilities.minImageCount + 1;
-    if (swapChainDetails.capabilities.maxImageCount > 0 && image_count > swapChainDetails.capabilities.maxImageCount)
+    // Whatever does not fit in this frame's staging buffer stays dirty for the next frame
+    std::pmr::vector<renderer::DirtyRanges::Range> ranges(regions.get_allocator());
+    dirty_ranges.take(staging_buffer_size - staging_offset, ranges);
+
+    auto* staging = static_cast<std::byte*>(stagingBufferMappings[currentFrame]);
+    regions.reserve(ranges.size());
+    for (const auto& range : ranges)
     {
-        image_count = swapChainDetails.capabilities.maxImageCount;
+        std::memcpy(staging + staging_offset, source.data() + range.offset, range.size);
+        regions.emplace_back(staging_offset, range.offset, range.size);
+        staging_offset += range.size;
     }
+}
 
-    vk::SwapchainCreateInfoKHR swap_chain_create_info({}, surface, image_count, surface_format.format,
-                                                      surface_format.colorSpace, extent, 1,
-                                                      vk::ImageUsageFlagBits::eColorAttachment);
+void Application::createTextureStreamer()
+{
+    if (settings.texturePaths.empty())
+        return;
 
-    swap_chain_create_info.preTransform = swapChainDetails.capabilities.currentTransform;
-    swap_chain_create_info.compositeAlpha = vk::CompositeAlphaFlagBitsKHR::eOpaque;
-    swap_chain_create_info.presentMode = present_mode;
-    swap_chain_create_info.clipped = true;
+    // Sampled by graphics and async compute, written by the transfer queue
+    const std::array queue_families{
+        queueFamilies.graphicsFamily.value(), queueFamilies.computeFamily.value(),
+        queueFamilies.transferFamily.value()
+    };
+    textureStreamer = std::make_unique<textures::TextureStreamer>(
+        device, physicalDevice, *memoryTracker, *graphicsTimeline, *transferTimeline, queue_families,
+        maxFramesInFlight, static_cast<vk::DeviceSize>(settings.textureBudgetMiB) << 20, hostAllocator.getCallbacks());
 
-    if (queueFamilies.areUnique())
-    {
-        const auto queue_families = queueFamilies.getQueueFamilyIndices();
-        swap_chain_create_info.imageSharingMode = vk::SharingMode::eConcurrent;
-        swap_chain_create_info.setQueueFamilyIndices(queue_families);
-    }
-    else
+    for (const auto& path : settings.texturePaths)
     {
-        swap_chain_create_info.imageSharingMode = vk::SharingMode::eExclusive;
+        textureHandles.push_back(textureStreamer->load(path));
     }
+}
 
-    swapChain = device.createSwapchainKHR(swap_chain_create_info);
+void Application::createGeometryStreamer()
+{
+    if (settings.geometryPath.empty())
+        return;
 
-    swapChainImageFormat = surface_format.format;
-    swapChainExtent = extent;
-    swapChainImages = swapChain.getImages();
-    swapChainImageCount = swapChainImages.size();
+    // Read by graphics, written by the transfer queue
+    const std::array queue_families{queueFamilies.graphicsFamily.value(), queueFamilies.transferFamily.value()};
+    geometryStreamer = std::make_unique<geometry::GeometryStreamer>(
+        device, physicalDevice, *memoryTracker, *graphicsTimeline, *transferTimeline, queue_families,
+        maxFramesInFlight, settings.geometryPath, static_cast<vk::DeviceSize>(settings.geometryBudgetMiB) << 20,
+        hostAllocator.getCallbacks());
 }
 
-void Application::recreateSwapChain()
+void Application::createParticleSystem()
 {
-    device.waitIdle();
-
-    swapChainFramebuffers.clear();
-    swapChainImageViews.clear();
-    swapChain = nullptr;
+    if (settings.particleCount == 0)
+        return;
 
-    swapChainDetails = ApplicationSwapChainDetails(physicalDevice, surface);
+    if (!meshShadersEnabled)
+    {
+        std::cout << "Particles need mesh shaders, drawing none" << std::endl;
+        return;
+    }
 
-    createSwapChain();
-    createImageViews();
-    createFramebuffers();
+    // Updated on the async compute queue and drawn on graphics, in the particle pass, which is compatible with the
+    // early pass the pipeline is built for
+    const std::array queue_families{queueFamilies.graphicsFamily.value(), queueFamilies.computeFamily.value()};
+    particleSystem = std::make_unique<particles::ParticleSystem>(device, physicalDevice, *memoryTracker,
+                                                                 *pipelineManager, renderPass, settings.particleCount,
+                                                                 queue_families, hostAllocator.getCallbacks());
 }
 
-void Application::createImageViews()
+void Application::streamAssets()
 {
-    swapChainImageViews.reserve(swapChainImageCount);
+    TRACE_SCOPE("streamAssets");
 
-    constexpr vk::ImageSubresourceRange subresource_range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
+    // Nothing samples the textures yet, so each one asks for the size it would have covering the window
+    const auto window_pixels = static_cast<float>(std::max(swapChainExtent.width, swapChainExtent.height));
+    for (const auto handle : textureHandles)
+    {
+        textureStreamer->requestSize(handle, window_pixels);
+    }
 
-    for (const auto& image : swapChainImages)
+    const auto& command_buffer = transferCommandBuffers[currentFrame];
+    transferTimeline->wait(transferTimelineValues[currentFrame]);
+
+    command_buffer.reset();
+    command_buffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    bool recorded = false;
+    if (textureStreamer)
+        recorded |= textureStreamer->recordUploads(command_buffer, currentFrame);
+    if (geometryStreamer)
+        recorded |= geometryStreamer->recordUploads(command_buffer, currentFrame);
+    command_buffer.end();
+
+    if (recorded)
     {
-        vk::ImageViewCreateInfo create_info({}, image, vk::ImageViewType::e2D, swapChainImageFormat, {},
-                                            subresource_range);
+        const vk::CommandBufferSubmitInfo command_buffer_info(*command_buffer);
+        latestTransferValue = transferTimeline->submit(transferQueue, {}, command_buffer_info);
+        transferTimelineValues[currentFrame] = latestTransferValue;
+    }
 
-        swapChainImageViews.emplace_back(device, create_info);
+    // Not just this frame's upload: a page table points at every page uploaded since its frame slot last ran, and a
+    // wait on a value that was reached long ago costs nothing
+    if (latestTransferValue > 0)
+    {
+        frameWaits.push_back(transferTimeline->getWaitInfo(
+            latestTransferValue, getGeometryStages() | vk::PipelineStageFlagBits2::eFragmentShader |
+                                 vk::PipelineStageFlagBits2::eComputeShader));
     }
+
+    // New images, retired ones and queued reads all allocate
+    if (recorded || (textureStreamer && textureStreamer->isStreaming()) ||
+        (geometryStreamer && geometryStreamer->isStreaming()))
+        steadyStateFrame = std::max(steadyStateFrame, frameCount + 1);
+
+    transferTimeline->collect();
 }
 
-void Application::createDescriptorSetLayout()
+void Application::updateParticles()
 {
-    constexpr std::array layout_bindings{
-        vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1,
-                                       vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT, nullptr)
-    };
+    TRACE_SCOPE("updateParticles");
+
+    // Free, the graphics submit the slot waited for waited for it
+    const auto& command_buffer = computeCommandBuffers[currentFrame];
+    command_buffer.reset();
+    command_buffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    computeProfiler->beginFrame(command_buffer, currentFrame);
+    computeProfiler->beginScope(command_buffer, currentFrame, compute_scope_particles);
+    particleSystem->recordUpdate(command_buffer);
+    computeProfiler->endScope(command_buffer, currentFrame, compute_scope_particles);
+    command_buffer.end();
 
-    const vk::DescriptorSetLayoutCreateInfo layout_info({}, layout_bindings);
-    descriptorSetLayout = vk::raii::DescriptorSetLayout(device, layout_info);
+    // The update overwrites the counters and the particles the last particle draw read, so it waits for that draw
+    // alone and runs alongside the rest of the previous frame and this frame's scene. drawFrame() makes the particle
+    // draw wait for it.
+    const std::array waits{
+        graphicsTimeline->getWaitInfo(particleDrawValue, vk::PipelineStageFlagBits2::eAllCommands)
+    };
+    const vk::CommandBufferSubmitInfo command_buffer_info(*command_buffer);
+    particleUpdateValue = submitCompute(command_buffer_info, waits);
+    computeProfiler->frameSubmitted(currentFrame);
 }
 
-void Application::createDescriptorSets()
+void Application::recordCommandBuffer(const vk::raii::CommandBuffer& command_buffer, const uint32_t image_index)
 {
-    constexpr std::array pool_size{vk::DescriptorPoolSize(vk::DescriptorType::eStorageBuffer, 1)};
-    const vk::DescriptorPoolCreateInfo pool_info(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, 1, pool_size);
-    descriptorPool = device.createDescriptorPool(pool_info);
+    TRACE_SCOPE("recordCommandBuffer");
 
-    const vk::DescriptorSetAllocateInfo allocate_info(descriptorPool, *descriptorSetLayout);
-    descriptorSets = device.allocateDescriptorSets(allocate_info);
+    command_buffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
 
-    vk::DescriptorBufferInfo buffer_infos = {vertexBuffer, 0, sizeof(Vertex) * MAX_VERTICES};
-    const vk::WriteDescriptorSet descriptor_set(*descriptorSets[0], 0, 0, vk::DescriptorType::eStorageBuffer, {},
-                                                buffer_infos, {});
-    device.updateDescriptorSets(descriptor_set, {});
-}
+    gpuProfiler->beginFrame(command_buffer, currentFrame);
+    gpuProfiler->beginScope(command_buffer, currentFrame, gpu_scope_frame);
+    gpuProfiler->beginScope(command_buffer, currentFrame, gpu_scope_scene);
+
+    recordUploads(command_buffer);
+
+    // Rebuilt from scratch every frame. The task shader binds it even when it never reads it, so it is always moved
+    // to the general layout, once last frame's pyramid pass and late pass are done with it.
+    const vk::PipelineStageFlags2 geometry_stages = getGeometryStages();
+    const vk::ImageMemoryBarrier2 pyramid_barrier(
+        vk::PipelineStageFlagBits2::eComputeShader | geometry_stages, {},
+        vk::PipelineStageFlagBits2::eComputeShader | geometry_stages,
+        vk::AccessFlagBits2::eShaderStorageWrite, vk::ImageLayout::eUndefined, vk::ImageLayout::eGeneral,
+        vk::QueueFamilyIgnored, vk::QueueFamilyIgnored, depthPyramid,
+        vk::ImageSubresourceRange(vk::ImageAspectFlagBits::eColor, 0, depthPyramidLevels, 0, 1));
+    command_buffer.pipelineBarrier2(vk::DependencyInfo({}, {}, {}, pyramid_barrier));
+
+    constexpr std::array clear_values{
+        vk::ClearValue(vk::ClearColorValue(std::array{0.0f, 0.0f, 0.0f, 1.0f})),
+        vk::ClearValue(vk::ClearDepthStencilValue(1.0f, 0)),
+    };
+    const vk::Rect2D render_area({}, renderExtent);
 
-void Application::createRenderPass()
-{
-    const vk::AttachmentDescription color_attachments({}, swapChainImageFormat, vk::SampleCountFlagBits::e1,
-                                                      vk::AttachmentLoadOp::eClear, vk::AttachmentStoreOp::eStore,
-                                                      vk::AttachmentLoadOp::eDontCare, vk::AttachmentStoreOp::eDontCare,
-                                                      vk::ImageLayout::eUndefined, vk::ImageLayout::ePresentSrcKHR);
+    // The vertex path has no task shader to cull with, it draws everything the LOD selects in one pass
+    const bool occlusion_culling = settings.occlusionCulling && meshPathActive;
 
-    constexpr vk::AttachmentReference color_attachment(0, vk::ImageLayout::eColorAttachmentOptimal);
-    const vk::SubpassDescription subpass({}, vk::PipelineBindPoint::eGraphics, {}, color_attachment);
+    command_buffer.beginRenderPass(vk::RenderPassBeginInfo(renderPass, hdrFramebuffer, render_area, clear_values),
+                                   vk::SubpassContents::eInline);
+    recordDraws(command_buffer, occlusion_culling ? draw_phase_early : draw_phase_all);
+    command_buffer.endRenderPass();
 
-    constexpr vk::SubpassDependency subpass_dependency(
-        vk::SubpassExternal, 0, vk::PipelineStageFlagBits::eColorAttachmentOutput,
-        vk::PipelineStageFlagBits::eColorAttachmentOutput, {}, vk::AccessFlagBits::eColorAttachmentWrite);
+    if (occlusion_culling)
+    {
+        recordDepthPyramid(command_buffer);
 
-    const vk::RenderPassCreateInfo render_pass_info({}, color_attachments, subpass, subpass_dependency);
+        command_buffer.beginRenderPass(vk::RenderPassBeginInfo(lateRenderPass, hdrFramebuffer, render_area),
+                                       vk::SubpassContents::eInline);
+        recordDraws(command_buffer, draw_phase_late);
+        command_buffer.endRenderPass();
+    }
 
-    renderPass = device.createRenderPass(render_pass_info);
-}
+    // The draw statistics are read on the host once the frame's submit has completed
+    const vk::MemoryBarrier2 stats_barrier(geometry_stages, vk::AccessFlagBits2::eShaderStorageWrite,
+                                           vk::PipelineStageFlagBits2::eHost, vk::AccessFlagBits2::eHostRead);
+    command_buffer.pipelineBarrier2(vk::DependencyInfo({}, stats_barrier));
 
-void Application::createGraphicsPipeline()
-{
-    assert((void("Invalid SPIR-V magic number"), triangle[0] == 0x07230203));
+    gpuProfiler->endScope(command_buffer, currentFrame, gpu_scope_scene);
 
-    vk::ShaderModuleCreateInfo shader_module_create_info({}, triangle_sizeInBytes, triangle);
+    // The particle draw waits for the async update in a submit of its own, see drawFrame()
+    const vk::raii::CommandBuffer* output_command_buffer = &command_buffer;
+    if (particleSystem)
+    {
+        command_buffer.end();
+        recordParticleDraw(particleCommandBuffers[currentFrame]);
 
-    auto shader_module = device.createShaderModule(shader_module_create_info);
+        output_command_buffer = &tonemapCommandBuffers[currentFrame];
+        output_command_buffer->reset();
+        output_command_buffer->begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
+    }
 
-    vk::PipelineShaderStageCreateInfo vertex_stage_info({}, vk::ShaderStageFlagBits::eVertex, shader_module,
-                                                        "vertexMain");
+    recordTonemap(*output_command_buffer, image_index);
 
-    vk::PipelineShaderStageCreateInfo task_shader_info({}, vk::ShaderStageFlagBits::eTaskEXT, shader_module,
-                                                       "taskMain");
+    gpuProfiler->endScope(*output_command_buffer, currentFrame, gpu_scope_frame);
 
-    vk::PipelineShaderStageCreateInfo mesh_shader_info({}, vk::ShaderStageFlagBits::eMeshEXT, shader_module,
-                                                       "meshMain");
+    output_command_buffer->end();
+}
 
-    vk::PipelineShaderStageCreateInfo fragment_stage_info({}, vk::ShaderStageFlagBits::eFragment, shader_module,
-                                                          "fragmentMain");
+void Application::recordParticleDraw(const vk::raii::CommandBuffer& command_buffer)
+{
+    command_buffer.reset();
+    command_buffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
 
-    vk::PipelineShaderStageCreateInfo shader_stages[] = {task_shader_info, mesh_shader_info, fragment_stage_info};
+    // Over everything else, they do not test depth
+    command_buffer.beginRenderPass(vk::RenderPassBeginInfo(particleRenderPass, hdrFramebuffer,
+                                                           vk::Rect2D({}, renderExtent)),
+                                   vk::SubpassContents::eInline);
+    command_buffer.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(renderExtent.width),
+                                               static_cast<float>(renderExtent.height), 0.0f, 1.0f));
+    command_buffer.setScissor(0, vk::Rect2D({}, renderExtent));
+    particleSystem->recordDraw(command_buffer);
+    command_buffer.endRenderPass();
 
-    auto binding_descriptions = Vertex::getBindingDescriptions();
-    auto attribute_descriptions = Vertex::getAttributeDescriptions();
-    vk::PipelineVertexInputStateCreateInfo vertex_input_info{{}, binding_descriptions, attribute_descriptions};
+    command_buffer.end();
+}
 
-    vk::PipelineInputAssemblyStateCreateInfo input_assembly_info({}, vk::PrimitiveTopology::eTriangleList, false);
+void Application::recordDraws(const vk::raii::CommandBuffer& command_buffer, const uint32_t phase)
+{
+    command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics,
+                                pipelineManager->get(meshPathActive ? trianglePipeline : triangleVertexPipeline));
+    command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, *descriptorSets[0], {});
 
-    vk::Viewport viewport(0.0f, 0.0f, static_cast<float>(swapChainExtent.width),
-                          static_cast<float>(swapChainExtent.height), 0.0f, 1.0f);
+    command_buffer.setViewport(0, vk::Viewport(0.0f, 0.0f, static_cast<float>(renderExtent.width),
+                                               static_cast<float>(renderExtent.height), 0.0f, 1.0f));
+    command_buffer.setScissor(0, vk::Rect2D({}, renderExtent));
 
-    vk::Rect2D scissor({}, swapChainExtent);
+    // Positions are in NDC, where a pixel is 2 / extent wide. A scaled down render hides less error.
+    const float error_threshold =
+        settings.lodErrorPixels * 2.0f / static_cast<float>(std::max(renderExtent.width, renderExtent.height));
+    if (!meshPathActive)
+    {
+        recordVertexDraws(command_buffer, error_threshold);
+        return;
+    }
 
-    vk::PipelineViewportStateCreateInfo viewport_state_info({}, viewport, scissor);
+    const vk::Extent2D pyramid_size = getPyramidExtent(0);
 
-    vk::PipelineRasterizationStateCreateInfo rasterization_info({}, false, false, vk::PolygonMode::eFill,
-                                                                vk::CullModeFlagBits::eBack, vk::FrontFace::eClockwise,
-                                                                false, 0.0f, 0.0f, 0.0f, 1.0f);
+    // Each draw is nearer than the ones before it, so later draws cover earlier ones as they did without depth.
+    // Floats keep 1 / n distinct far beyond any draw count.
+    uint32_t draw_index = 0;
+    drawList.forEachHandle([&](const renderer::DrawHandle handle, const renderer::DrawList::Draw& draw)
+    {
+        if (draw.vertexCount == 0)
+            return;
+
+        const float depth = 1.0f / static_cast<float>(draw_index++ + 2);
+        const uint32_t slot = getWorldMatrixSlot(handle.index);
+        const auto [bounds_min, bounds_max] = transform_bounds(worldMatrices[slot], draw.boundsMin, draw.boundsMax);
+        const float draw_threshold = error_threshold / get_world_scale(worldMatrices[slot]);
+
+        command_buffer.pushConstants<DrawConstants>(
+            pipelineLayout, drawConstantStages, 0,
+            DrawConstants{
+                draw.firstVertex, draw.firstCluster, draw.clusterCount, draw_threshold, currentFrame, phase, depth,
+                draw_threshold, bounds_min, bounds_max, {pyramid_size.width, pyramid_size.height}, 0, slot
+            });
+
+        const uint32_t group_count = (draw.clusterCount + clusters_per_task - 1) / clusters_per_task;
+        command_buffer.drawMeshTasksEXT(std::min(group_count, max_task_groups_x),
+                                        (group_count + max_task_groups_x - 1) / max_task_groups_x, 1);
+    });
+
+    if (!geometryStreamer)
+        return;
 
-    vk::PipelineMultisampleStateCreateInfo multisampling_info({}, vk::SampleCountFlagBits::e1, false, 1.0f);
+    // Streamed meshes draw the finest cut that is resident, and still ask for the pages of the one they want. A mesh
+    // whose coarsest cut is not resident yet draws nothing and asks for it.
+    command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, *descriptorSets[1], {});
+    const uint32_t page_count = geometryStreamer->getPageCount();
+    const auto meshes = geometryStreamer->getMeshes();
+    for (uint32_t mesh = 0; mesh < meshes.size(); mesh++)
+    {
+        const geometry::ClusterPageFile::Mesh& info = meshes[mesh];
+        const float depth = 1.0f / static_cast<float>(draw_index++ + 2);
+
+        command_buffer.pushConstants<DrawConstants>(
+            pipelineLayout, drawConstantStages, 0,
+            DrawConstants{
+                0, info.firstCluster, info.clusterCount, geometryStreamer->getDrawThreshold(mesh, error_threshold),
+                currentFrame, phase, depth, error_threshold, info.boundsMin, info.boundsMax,
+                {pyramid_size.width, pyramid_size.height}, page_count, 0
+            });
+
+        const uint32_t group_count = (info.clusterCount + clusters_per_task - 1) / clusters_per_task;
+        command_buffer.drawMeshTasksEXT(std::min(group_count, max_task_groups_x),
+                                        (group_count + max_task_groups_x - 1) / max_task_groups_x, 1);
+    }
+}
 
-    auto color_write_mask =
-        vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB;
+void Application::recordVertexDraws(const vk::raii::CommandBuffer& command_buffer, const float error_threshold)
+{
+    command_buffer.bindVertexBuffers(0, *vertexBuffer, {0});
 
-    vk::PipelineColorBlendAttachmentState color_blend_attachment(
-        false, vk::BlendFactor::eOne, vk::BlendFactor::eZero, vk::BlendOp::eAdd, vk::BlendFactor::eOne,
-        vk::BlendFactor::eZero, vk::BlendOp::eAdd, color_write_mask);
+    // Counted here instead of in the task shader, the slot's statistics were reset once its last frame completed
+    DrawStats& stats = drawStats[currentFrame];
+    const auto clusters = drawList.getClusters();
 
-    vk::PipelineColorBlendStateCreateInfo color_blend_state({}, false, vk::LogicOp::eCopy, color_blend_attachment,
-                                                            {0.0f, 0.0f, 0.0f, 0.0f});
+    // Same depths as on the mesh path, so both draw the same image
+    uint32_t draw_index = 0;
+    drawList.forEachHandle([&](const renderer::DrawHandle handle, const renderer::DrawList::Draw& draw)
+    {
+        if (draw.vertexCount == 0)
+            return;
+
+        const float depth = 1.0f / static_cast<float>(draw_index++ + 2);
+        const uint32_t slot = getWorldMatrixSlot(handle.index);
+        const glm::mat4& world = worldMatrices[slot];
+        const auto [bounds_min, bounds_max] = transform_bounds(world, draw.boundsMin, draw.boundsMax);
+        const float draw_threshold = error_threshold / get_world_scale(world);
+
+        command_buffer.pushConstants<DrawConstants>(
+            pipelineLayout, drawConstantStages, 0,
+            DrawConstants{
+                draw.firstVertex, draw.firstCluster, draw.clusterCount, draw_threshold, currentFrame, draw_phase_all,
+                depth, draw_threshold, bounds_min, bounds_max, {0, 0}, 0, slot
+            });
+
+        // The selection the task shader makes. Selected clusters whose vertices follow each other, as those of a
+        // level mostly do, are drawn together.
+        uint32_t first_vertex = 0, vertex_count = 0;
+        for (const renderer::Cluster& cluster : clusters.subspan(draw.firstCluster, draw.clusterCount))
+        {
+            if (cluster.error > draw_threshold || cluster.parentError <= draw_threshold)
+                continue;
+            const auto [cluster_min, cluster_max] = transform_bounds(world, cluster.boundsMin, cluster.boundsMax);
+            if (is_offscreen(cluster_min, cluster_max))
+            {
+                stats.culledClusters++;
+                continue;
+            }
 
-    vk::PushConstantRange push_constant_range(vk::ShaderStageFlagBits::eMeshEXT | vk::ShaderStageFlagBits::eTaskEXT, 0,
-                                              sizeof(unsigned int));
+            stats.drawnClusters++;
+            stats.triangles += cluster.triangleCount;
+            if (vertex_count > 0 && first_vertex + vertex_count == cluster.firstVertex)
+            {
+                vertex_count += cluster.triangleCount * 3;
+                continue;
+            }
 
-    pipelineLayout =
-        device.createPipelineLayout(vk::PipelineLayoutCreateInfo({}, *descriptorSetLayout, push_constant_range));
-    vk::GraphicsPipelineCreateInfo graphics_pipeline_create_info(
-        {}, shader_stages, &vertex_input_info, &input_assembly_info, {}, &viewport_state_info, &rasterization_info,
-        &multisampling_info, {}, &color_blend_state, {}, pipelineLayout, renderPass, 0);
+            if (vertex_count > 0)
+                command_buffer.draw(vertex_count, 1, draw.firstVertex + first_vertex, 0);
+            first_vertex = cluster.firstVertex;
+            vertex_count = cluster.triangleCount * 3;
+        }
+        if (vertex_count > 0)
+            command_buffer.draw(vertex_count, 1, draw.firstVertex + first_vertex, 0);
+    });
+}
 
-    graphicsPipeline = device.createGraphicsPipeline(nullptr, graphics_pipeline_create_info);
+vk::PipelineStageFlags2 Application::getGeometryStages() const
+{
+    vk::PipelineStageFlags2 stages =
+        vk::PipelineStageFlagBits2::eVertexAttributeInput | vk::PipelineStageFlagBits2::eVertexShader;
+    if (meshShadersEnabled)
+        stages |= vk::PipelineStageFlagBits2::eTaskShaderEXT | vk::PipelineStageFlagBits2::eMeshShaderEXT;
+    return stages;
 }
 
-void Application::createFramebuffers()
+void Application::recordDepthPyramid(const vk::raii::CommandBuffer& command_buffer)
 {
-    swapChainFramebuffers.reserve(swapChainImageViews.size());
-    for (auto& image_views : swapChainImageViews)
+    command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, hizPipeline);
+
+    vk::Extent2D source = renderExtent;
+    for (uint32_t level = 0; level < depthPyramidLevels; level++)
     {
-        vk::ImageView attachments[] = {image_views};
+        // Each level reads the one written before it
+        if (level > 0)
+        {
+            constexpr vk::MemoryBarrier2 level_barrier(
+                vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+                vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderSampledRead);
+            command_buffer.pipelineBarrier2(vk::DependencyInfo({}, level_barrier));
+        }
 
-        vk::FramebufferCreateInfo framebuffer_info({}, renderPass, attachments, swapChainExtent.width,
-                                                   swapChainExtent.height, 1);
+        const vk::Extent2D destination = getPyramidExtent(level);
+        command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, hizPipelineLayout, 0,
+                                          *hizDescriptorSets[level], {});
+        command_buffer.pushConstants<HizConstants>(
+            hizPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0,
+            HizConstants{{source.width, source.height}, {destination.width, destination.height}});
+        command_buffer.dispatch((destination.width + hiz_tile_size - 1) / hiz_tile_size,
+                                (destination.height + hiz_tile_size - 1) / hiz_tile_size, 1);
 
-        swapChainFramebuffers.emplace_back(device, framebuffer_info);
+        source = destination;
     }
 }
 
-void Application::createCommandPool()
+vk::Extent2D Application::getPyramidExtent(const uint32_t level) const
 {
-    const vk::CommandPoolCreateInfo pool_info(vk::CommandPoolCreateFlagBits::eResetCommandBuffer,
-                                              queueFamilies.graphicsFamily.value());
-
-    commandPool = device.createCommandPool(pool_info);
+    return {std::max((renderExtent.width / 2) >> level, 1u), std::max((renderExtent.height / 2) >> level, 1u)};
 }
 
-void Application::copyBuffer(const vk::raii::Buffer& src_buffer, const vk::raii::Buffer& dst_buffer,
-                             const vk::DeviceSize size) const
+void Application::recordTonemap(const vk::raii::CommandBuffer& command_buffer, const uint32_t image_index)
 {
-    const vk::CommandBufferAllocateInfo command_buffer_allocate_info(commandPool, vk::CommandBufferLevel::ePrimary, 1);
-    const vk::raii::CommandBuffer command_copy_buffer =
-        std::move(device.allocateCommandBuffers(command_buffer_allocate_info).front());
-
-    command_copy_buffer.begin({vk::CommandBufferUsageFlagBits::eOneTimeSubmit});
+    constexpr vk::ImageSubresourceRange subresource_range(vk::ImageAspectFlagBits::eColor, 0, 1, 0, 1);
 
-    command_copy_buffer.copyBuffer(src_buffer, dst_buffer, vk::BufferCopy(0, 0, size));
+    // The acquire semaphore is waited on at the compute stage, and the image is overwritten entirely
+    const vk::ImageMemoryBarrier2 to_storage(vk::PipelineStageFlagBits2::eComputeShader, {},
+                                             vk::PipelineStageFlagBits2::eComputeShader,
+                                             vk::AccessFlagBits2::eShaderStorageWrite, vk::ImageLayout::eUndefined,
+                                             vk::ImageLayout::eGeneral, vk::QueueFamilyIgnored, vk::QueueFamilyIgnored,
+                                             swapChainImages[image_index], subresource_range);
+    command_buffer.pipelineBarrier2(vk::DependencyInfo({}, {}, {}, to_storage));
 
-    command_copy_buffer.end();
-    graphicsQueue.submit(vk::SubmitInfo({}, {}, *command_copy_buffer));
-    graphicsQueue.waitIdle();
-}
+    gpuProfiler->beginScope(command_buffer, currentFrame, gpu_scope_tonemap);
 
-std::pair<vk::raii::Buffer, vk::raii::DeviceMemory>
-Application::createBuffer(const vk::DeviceSize size, const vk::BufferUsageFlags usage,
-                          const vk::MemoryPropertyFlags properties) const
-{
-    const vk::BufferCreateInfo buffer_create_info({}, size, usage, vk::SharingMode::eExclusive);
-    vk::raii::Buffer buffer(device, buffer_create_info);
-    const vk::MemoryRequirements memory_requirements = buffer.getMemoryRequirements();
-    const vk::MemoryAllocateInfo alloc_info(
-        memory_requirements.size,
-        find_memory_type(physicalDevice.getMemoryProperties(), memory_requirements.memoryTypeBits, properties));
-    vk::raii::DeviceMemory buffer_memory(device, alloc_info);
-    buffer.bindMemory(*buffer_memory, 0);
-    return {std::move(buffer), std::move(buffer_memory)};
-};
+    command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, tonemapPipeline);
+    command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, tonemapPipelineLayout, 0,
+                                      *tonemapDescriptorSets[image_index], {});
 
-void Application::createVertexBuffer()
-{
-    const vk::DeviceSize buffer_size = sizeof(vertices[0]) * vertices.size();
+    const TonemapConstants constants{
+        {swapChainExtent.width, swapChainExtent.height}, {renderExtent.width, renderExtent.height}, settings.exposure,
+        swapChainColorSpace == vk::ColorSpaceKHR::eHdr10St2084EXT ? output_pq : output_srgb,
+        paper_white_nits, hdr_peak_nits
+    };
+    command_buffer.pushConstants<TonemapConstants>(tonemapPipelineLayout, vk::ShaderStageFlagBits::eCompute, 0,
+                                                   constants);
 
-    auto [stage_buffer, stage_buffer_memory] =
-        createBuffer(buffer_size, vk::BufferUsageFlagBits::eTransferSrc,
-                     vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+    command_buffer.dispatch((swapChainExtent.width + tonemap_tile_size - 1) / tonemap_tile_size,
+                            (swapChainExtent.height + tonemap_tile_size - 1) / tonemap_tile_size, 1);
 
-    void* data_location = stage_buffer_memory.mapMemory(0, buffer_size);
-    std::memcpy(data_location, vertices.data(), buffer_size);
-    stage_buffer_memory.unmapMemory();
+    gpuProfiler->endScope(command_buffer, currentFrame, gpu_scope_tonemap);
 
-    std::tie(vertexBuffer, vertexBufferMemory) =
-        createBuffer(buffer_size,
-                     vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eVertexBuffer |
-                     vk::BufferUsageFlagBits::eTransferDst,
-                     vk::MemoryPropertyFlagBits::eDeviceLocal);
+    // Copied in the layout the tonemap pass wrote it in, the transition to present waits for the copy
+    vk::PipelineStageFlags2 written_stages = vk::PipelineStageFlagBits2::eComputeShader;
+    if (frameReadback)
+    {
+        constexpr vk::MemoryBarrier2 copy_barrier(
+            vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+            vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferRead);
+        command_buffer.pipelineBarrier2(vk::DependencyInfo({}, copy_barrier));
+        frameReadback->recordCopy(command_buffer, currentFrame, swapChainImages[image_index],
+                                  vk::ImageLayout::eGeneral, swapChainExtent, swapChainImageFormat, frameCount);
+        written_stages |= vk::PipelineStageFlagBits2::eCopy;
+    }
 
-    copyBuffer(stage_buffer, vertexBuffer, buffer_size);
+    const vk::ImageMemoryBarrier2 to_present(written_stages, vk::AccessFlagBits2::eShaderStorageWrite,
+                                             vk::PipelineStageFlagBits2::eNone, {}, vk::ImageLayout::eGeneral,
+                                             vk::ImageLayout::ePresentSrcKHR, vk::QueueFamilyIgnored,
+                                             vk::QueueFamilyIgnored, swapChainImages[image_index], subresource_range);
+    command_buffer.pipelineBarrier2(vk::DependencyInfo({}, {}, {}, to_present));
 }
 
-void Application::createIndexBuffer()
+void Application::collectGpuTimings(const uint32_t frame_slot)
 {
-    const std::vector<uint16_t> indices = {0, 1, 2, 2, 3, 0};
+    gpuProfiler->collect(frame_slot);
+    computeProfiler->collect(frame_slot);
 
-    const vk::DeviceSize buffer_size = sizeof(indices[0]) * indices.size();
+    if (gpuTrack)
+    {
+        gpuProfiler->calibrate();
+        computeProfiler->calibrate();
+        if (const auto times = gpuProfiler->getScopeTimes(frame_slot, gpu_scope_frame))
+            trace::record(*gpuTrack, "frame", times->first, times->second);
+        if (const auto times = gpuProfiler->getScopeTimes(frame_slot, gpu_scope_tonemap))
+            trace::record(*gpuTrack, "tonemap", times->first, times->second);
+        if (const auto times = computeProfiler->getScopeTimes(frame_slot, compute_scope_particles))
+            trace::record(*gpuTrack, "particles", times->first, times->second);
+    }
 
-    auto [stage_buffer, stage_buffer_memory] =
-        createBuffer(buffer_size, vk::BufferUsageFlagBits::eTransferSrc,
-                     vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent);
+    // Reset for the slot's next frame, the host write is visible to its submit
+    const DrawStats stats = std::exchange(drawStats[frame_slot], DrawStats{});
 
-    void* data_location = stage_buffer_memory.mapMemory(0, buffer_size);
-    std::memcpy(data_location, indices.data(), buffer_size);
-    stage_buffer_memory.unmapMemory();
+    const float render_scale = frameRenderScales[frame_slot];
+    const auto frame_ms = gpuProfiler->getScopeMs(frame_slot, gpu_scope_frame);
+    // Tonemapping runs at the output size, whatever the render scale
+    if (resolutionController && frame_ms)
+        resolutionController->update(*frame_ms, gpuProfiler->getScopeMs(frame_slot, gpu_scope_tonemap).value_or(0.0),
+                                     render_scale);
 
-    std::tie(indexBuffer, indexBufferMemory) =
-        createBuffer(buffer_size, vk::BufferUsageFlagBits::eIndexBuffer | vk::BufferUsageFlagBits::eTransferDst,
-                     vk::MemoryPropertyFlagBits::eDeviceLocal);
+    if (drawPathTuner && frame_ms && frameNumbers[frame_slot] != UINT_MAX &&
+        drawPathTuner->update(frameNumbers[frame_slot], *frame_ms, render_scale))
+    {
+        const bool mesh = drawPathTuner->getChoice() == draw_path_mesh;
+        std::cout << "Draw path: " << (mesh ? "mesh" : "vertex") << " shaders, "
+            << drawPathTuner->getMedianMs(draw_path_mesh) << " ms with mesh and "
+            << drawPathTuner->getMedianMs(draw_path_vertex) << " ms with vertex shaders per full scale frame"
+            << std::endl;
+        // Printing allocates
+        steadyStateFrame = std::max(steadyStateFrame, frameCount + 1);
+    }
 
-    copyBuffer(stage_buffer, indexBuffer, buffer_size);
+    const size_t index = frameTimingIndices[frame_slot];
+    if (index >= frameTimings.size())
+        return;
+
+    if (const auto particle_ms = computeProfiler->getScopeMs(frame_slot, compute_scope_particles))
+    {
+        particleGpuMs += *particle_ms;
+        particleOverlapMs += computeProfiler->getOverlapMs(frame_slot, compute_scope_particles, *gpuProfiler,
+                                                           gpu_scope_scene).value_or(0.0);
+        particleGpuFrames++;
+    }
+
+    frameTimings[index].triangles = stats.triangles;
+    frameTimings[index].drawnClusters = stats.drawnClusters;
+    frameTimings[index].culledClusters = stats.culledClusters;
+    frameTimings[index].renderScale = render_scale;
+    if (frame_ms)
+        frameTimings[index].gpuMs = *frame_ms;
+    if (const auto tonemap_ms = gpuProfiler->getScopeMs(frame_slot, gpu_scope_tonemap))
+        frameTimings[index].tonemapGpuMs = *tonemap_ms;
 }
 
-void Application::createCommandBuffers()
+void Application::createSyncObjects()
 {
-    commandBuffers.reserve(maxFramesInFlight);
+    graphicsTimeline = std::make_unique<renderer::TimelineScheduler>(device);
+    // Separate timelines even when the queues are the same, so waits between them work either way
+    computeTimeline = std::make_unique<renderer::TimelineScheduler>(device);
+    transferTimeline = std::make_unique<renderer::TimelineScheduler>(device);
+    frameTimelineValues.assign(maxFramesInFlight, 0);
+    transferTimelineValues.assign(maxFramesInFlight, 0);
+
+    gpuProfiler = std::make_unique<renderer::GpuProfiler>(device, physicalDevice, queueFamilies.graphicsFamily.value(),
+                                                          maxFramesInFlight, gpu_scope_count,
+                                                          calibratedTimestampsEnabled);
+    computeProfiler = std::make_unique<renderer::GpuProfiler>(device, physicalDevice,
+                                                              queueFamilies.computeFamily.value(), maxFramesInFlight,
+                                                              compute_scope_count, calibratedTimestampsEnabled);
+    frameTimingIndices.assign(maxFramesInFlight, SIZE_MAX);
+    frameRenderScales.assign(maxFramesInFlight, 1.0f);
+    frameNumbers.assign(maxFramesInFlight, UINT_MAX);
+
+    if (settings.targetGpuMs > 0.0)
+    {
+        if (gpuProfiler->isSupported())
+        {
+            resolutionController = std::make_unique<renderer::ResolutionController>(settings.targetGpuMs,
+                                                                                    settings.minRenderScale);
+        }
+        else
+        {
+            std::cerr << "Dynamic resolution needs GPU timestamps, rendering at full resolution" << std::endl;
+        }
+    }
 
-    const vk::CommandBufferAllocateInfo command_buffer_allocate_info(commandPool, vk::CommandBufferLevel::ePrimary,
-                                                                     maxFramesInFlight);
+    // Streamed geometry is only drawn by the mesh path, so there is nothing to choose
+    if (settings.drawPath == DrawPath::Auto && meshShadersEnabled && settings.geometryPath.empty())
+    {
+        if (gpuProfiler->isSupported())
+        {
+            drawPathTuner = std::make_unique<renderer::DrawPathTuner>(draw_path_count, draw_path_warmup_frames,
+                                                                      draw_path_trial_frames);
+        }
+        else
+        {
+            std::cerr << "Choosing a draw path needs GPU timestamps, drawing with mesh shaders" << std::endl;
+        }
+    }
 
-    commandBuffers = device.allocateCommandBuffers(command_buffer_allocate_info);
+    imageAvailableSemaphores.reserve(maxFramesInFlight);
+
+    for (size_t i = 0; i < maxFramesInFlight; i++)
+    {
+        imageAvailableSemaphores.emplace_back(device.createSemaphore({}, hostAllocator.getCallbacks()));
+        frameArenas.emplace_back(frame_arena_capacity);
+    }
 }
 
-void Application::recordCommandBuffer(const vk::raii::CommandBuffer& command_buffer, const uint32_t image_index) const
+uint64_t Application::submitCompute(const std::span<const vk::CommandBufferSubmitInfo> command_buffers,
+                                    const std::span<const vk::SemaphoreSubmitInfo> waits)
 {
-    command_buffer.begin(vk::CommandBufferBeginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit));
-
-    constexpr vk::ClearValue clear_color_value(vk::ClearColorValue(std::array{0.0f, 0.0f, 0.0f, 1.0f}));
-    const vk::RenderPassBeginInfo render_pass_info(renderPass, swapChainFramebuffers[image_index],
-                                                   vk::Rect2D({}, swapChainExtent), clear_color_value);
-
-    command_buffer.beginRenderPass(render_pass_info, vk::SubpassContents::eInline);
+    return computeTimeline->submit(computeQueue, waits, command_buffers);
+}
 
-    command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, graphicsPipeline);
-    /*
-        command_buffer.bindVertexBuffers(0, *vertexBuffer, {0});
-        command_buffer.bindIndexBuffer(*indexBuffer, 0, vk::IndexType::eUint16);
+void Application::waitForCompute(const uint64_t value, const vk::PipelineStageFlags2 stages)
+{
+    frameWaits.push_back(computeTimeline->getWaitInfo(value, stages));
+}
 
-        command_buffer.drawIndexed(6, 1, 0, 0, 0);
-    */
-    command_buffer.pushConstants<unsigned int>(
-        pipelineLayout, vk::ShaderStageFlagBits::eMeshEXT | vk::ShaderStageFlagBits::eTaskEXT, 0,
-        {static_cast<unsigned int>(vertices.size())});
+void Application::createPresentSemaphores()
+{
+    // Only called with the device idle, so none of the old semaphores has a pending present
+    renderFinishedSemaphores.clear();
+    renderFinishedSemaphores.reserve(swapChainImageCount);
 
-    command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 0, *descriptorSets[0], {});
+    for (size_t i = 0; i < swapChainImageCount; i++)
+    {
+        renderFinishedSemaphores.emplace_back(device.createSemaphore({}, hostAllocator.getCallbacks()));
+    }
+}
 
-    command_buffer.drawMeshTasksEXT(1, 1, 1);
+void Application::paceFrame()
+{
+    TRACE_SCOPE("paceFrame");
 
-    command_buffer.endRenderPass();
+    if (presentId > 0)
+    {
+        try
+        {
+            if (swapChain.waitForPresent(presentId, present_wait_timeout_ns) == vk::Result::eSuccess)
+                framePacer.framePresented(renderer::FramePacer::clock::now());
+        }
+        catch (const vk::OutOfDateKHRError&)
+        {
+            // Acquire reports it again and the swapchain gets rebuilt there
+        }
+    }
 
-    command_buffer.end();
+    std::this_thread::sleep_for(framePacer.getStartDelay());
+    framePacer.frameStarted(renderer::FramePacer::clock::now());
 }
 
-// TODO: Make sure that there is the right number of semaphores when recreating the swap chain
-void Application::createSyncObjects()
+void Application::advanceSimulation()
 {
-    imageAvailableSemaphores.reserve(swapChainImageCount);
-    renderFinishedSemaphores.reserve(swapChainImageCount);
+    TRACE_SCOPE("advanceSimulation");
 
-    for (size_t i = 0; i < swapChainImageCount; i++)
+    const unsigned int frame = frameCount;
+    const scene::SceneSnapshot& snapshot = simulation.acquire();
+    sceneSnapshot = &snapshot;
+    if (snapshot.update != lastWorldMatrixUpdate)
     {
-        imageAvailableSemaphores.emplace_back(device.createSemaphore({}));
-        renderFinishedSemaphores.emplace_back(device.createSemaphore({}));
+        // The slot after the identity holds the first matrix. The snapshot's ranges are relative to the update before
+        // it, when the render thread skipped that one everything is copied.
+        if (snapshot.worldMatrices.size() >= world_matrix_capacity)
+            throw std::runtime_error("The scene has more transforms than the world matrix buffer holds");
+        if (snapshot.update == lastWorldMatrixUpdate + 1)
+        {
+            for (const scene::MatrixRange range : snapshot.uploadRanges)
+            {
+                std::copy_n(snapshot.worldMatrices.begin() + range.first, range.count,
+                            worldMatrices.begin() + range.first + 1);
+                worldMatrixDirtyRanges.add(sizeof(glm::mat4) * (range.first + 1), sizeof(glm::mat4) * range.count);
+            }
+        }
+        else
+        {
+            std::ranges::copy(snapshot.worldMatrices, worldMatrices.begin() + 1);
+            worldMatrixDirtyRanges.add(sizeof(glm::mat4), sizeof(glm::mat4) * snapshot.worldMatrices.size());
+        }
+        lastWorldMatrixUpdate = snapshot.update;
     }
 
-    inFlightFences.reserve(maxFramesInFlight);
+    if (snapshot.frame != lastSnapshotFrame)
+    {
+        // Its update was started right before the last drawFrame()
+        lastSnapshotFrame = snapshot.frame;
+        simulationUpdates++;
+        simulationMs += std::chrono::duration<double, std::milli>(snapshot.updateEnd - snapshot.updateStart).count();
+        const auto overlap = std::min(snapshot.updateEnd, lastDrawEnd) - std::max(snapshot.updateStart, lastDrawStart);
+        if (overlap.count() > 0)
+            simulationOverlapMs += std::chrono::duration<double, std::milli>(overlap).count();
+    }
+    if (snapshot.frame < frame)
+        staleSnapshotFrames++;
 
-    for (size_t i = 0; i < maxFramesInFlight; i++)
+    // A replay poses the spins where the recorded run did, however long its frames take
+    if (settings.replayPath.empty())
     {
-        inFlightFences.emplace_back(device.createFence({vk::FenceCreateFlagBits::eSignaled}));
+        const auto scene_time = std::chrono::steady_clock::now() - sceneStartTime;
+        sceneTimeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(scene_time).count();
     }
+    else
+        sceneTimeNs = replaySceneTimeNs;
+    simulation.requestFrame(frame + 1, std::chrono::nanoseconds(sceneTimeNs));
 }
 
 void Application::drawFrame()
 {
-    const auto& current_image_available_semaphore = imageAvailableSemaphores[currentSwapChainImage];
-    const auto& current_render_finished_semaphore = renderFinishedSemaphores[currentSwapChainImage];
+    TRACE_SCOPE("drawFrame");
+
+    if (presentWaitEnabled)
+        paceFrame();
 
+    memoryTracker->update();
+
+    const auto& current_image_available_semaphore = imageAvailableSemaphores[currentFrame];
     const auto& current_command_buffer = commandBuffers[currentFrame];
-    const auto& current_in_flight_fence = inFlightFences[currentFrame];
 
-    while (vk::Result::eTimeout == device.waitForFences(*current_in_flight_fence, true, UINT64_MAX))
+    // The command buffer, staging buffer and acquire semaphore of this slot are free once its last submit is done
     {
+        TRACE_SCOPE("wait for frame slot");
+        graphicsTimeline->wait(frameTimelineValues[currentFrame]);
     }
+    graphicsTimeline->collect();
+    computeTimeline->collect();
+    collectGpuTimings(currentFrame);
+    if (geometryStreamer)
+        geometryStreamer->readFeedback(currentFrame);
+    if (frameReadback)
+        frameReadback->collect(currentFrame);
+    frameArenas[currentFrame].reset();
 
     auto [result, image_index] = swapChain.acquireNextImage(UINT64_MAX, current_image_available_semaphore);
     switch (result)
     {
     case vk::Result::eErrorOutOfDateKHR:
         recreateSwapChain();
+        if (frameRecorder)
+            frameRecorder->recordSwapchainRecreate(static_cast<int32_t>(result), swapChainExtent.width,
+                                                   swapChainExtent.height);
         return;
     case vk::Result::eSuccess:
     case vk::Result::eSuboptimalKHR:
@@ -828,25 +2952,97 @@ void Application::drawFrame()
         throw std::runtime_error("Failed to acquire swap chain image: " + vk::to_string(result));
     }
 
-    device.resetFences(*current_in_flight_fence);
+    const auto& current_render_finished_semaphore = renderFinishedSemaphores[image_index];
+
+    if (textureStreamer || geometryStreamer)
+        streamAssets();
+    if (particleSystem)
+        updateParticles();
+
+    // The render targets are allocated at the swapchain size, a scaled down frame renders into their top left
+    const float render_scale = resolutionController ? resolutionController->getScale() : 1.0f;
+    renderExtent = vk::Extent2D(
+        std::max(static_cast<uint32_t>(static_cast<float>(swapChainExtent.width) * render_scale + 0.5f), 1u),
+        std::max(static_cast<uint32_t>(static_cast<float>(swapChainExtent.height) * render_scale + 0.5f), 1u));
+    frameRenderScales[currentFrame] = render_scale;
+
+    // Pipelines compiled since the last frame replace their fast-linked ones from this one on, compiles allocate
+    if (pipelineManager->update() || pipelineManager->isCompiling())
+        steadyStateFrame = std::max(steadyStateFrame, frameCount + 1);
+
+    if (drawPathTuner)
+        meshPathActive = drawPathTuner->getCandidate(frameCount) == draw_path_mesh;
+    frameNumbers[currentFrame] = frameCount;
 
     current_command_buffer.reset();
     recordCommandBuffer(current_command_buffer, image_index);
+    // renderLoop() adds this frame's timing right after drawFrame()
+    frameTimingIndices[currentFrame] = frameTimingCount % frameTimingCapacity;
+
+    // A semaphore wait holds back its stages for the whole submit, so with particles the frame is three: the scene
+    // never waits for the async update, only the particle draw does, and the next update only waits for that draw
+    const vk::raii::CommandBuffer* output_command_buffer = &current_command_buffer;
+    if (particleSystem)
+    {
+        const vk::CommandBufferSubmitInfo scene_info(*current_command_buffer);
+        graphicsTimeline->submit(graphicsQueue, frameWaits, scene_info);
+        frameWaits.clear();
+
+        const std::array particle_waits{
+            computeTimeline->getWaitInfo(particleUpdateValue,
+                                         vk::PipelineStageFlagBits2::eDrawIndirect |
+                                         vk::PipelineStageFlagBits2::eTaskShaderEXT |
+                                         vk::PipelineStageFlagBits2::eMeshShaderEXT)
+        };
+        const vk::CommandBufferSubmitInfo particle_info(*particleCommandBuffers[currentFrame]);
+        particleDrawValue = graphicsTimeline->submit(graphicsQueue, particle_waits, particle_info);
+
+        output_command_buffer = &tonemapCommandBuffers[currentFrame];
+    }
 
-    constexpr std::array<vk::PipelineStageFlags, 1> wait_stages{vk::PipelineStageFlagBits::eColorAttachmentOutput};
+    // The swapchain image is first touched by the tonemap pass, draws into the HDR image start without it
+    frameWaits.emplace_back(*current_image_available_semaphore, 0, vk::PipelineStageFlagBits2::eComputeShader);
+    const vk::CommandBufferSubmitInfo command_buffer_info(**output_command_buffer);
+    const vk::SemaphoreSubmitInfo signal_info(*current_render_finished_semaphore, 0,
+                                              vk::PipelineStageFlagBits2::eAllCommands);
 
-    const vk::SubmitInfo submit_info(*current_image_available_semaphore, wait_stages, *current_command_buffer,
-                                     *current_render_finished_semaphore);
+    frameTimelineValues[currentFrame] = graphicsTimeline->submit(graphicsQueue, frameWaits, command_buffer_info,
+                                                                 signal_info);
+    gpuProfiler->frameSubmitted(currentFrame);
+    frameWaits.clear();
 
-    graphicsQueue.submit(submit_info, *current_in_flight_fence);
+    window->beforePresent();
+
+    vk::PresentInfoKHR present_info(*current_render_finished_semaphore, *swapChain, image_index);
+    const uint64_t present_id = ++presentId;
+    const vk::PresentIdKHR present_id_info(1, &present_id);
+    if (presentWaitEnabled)
+        present_info.setPNext(&present_id_info);
+
+    {
+        TRACE_SCOPE("present");
+        result = graphicsQueue.presentKHR(present_info);
+    }
+
+    if (presentWaitEnabled)
+        framePacer.frameSubmitted(renderer::FramePacer::clock::now());
+
+    if (!firstFramePresented && result != vk::Result::eErrorOutOfDateKHR)
+    {
+        firstFramePresented = true;
+        std::cout << "First frame presented "
+            << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startupStart).count()
+            << " ms after startup" << std::endl;
+    }
 
-    const vk::PresentInfoKHR present_info(*current_render_finished_semaphore, *swapChain, image_index);
-    result = graphicsQueue.presentKHR(present_info);
     switch (result)
     {
     case vk::Result::eErrorOutOfDateKHR:
     case vk::Result::eSuboptimalKHR:
         recreateSwapChain();
+        if (frameRecorder)
+            frameRecorder->recordSwapchainRecreate(static_cast<int32_t>(result), swapChainExtent.width,
+                                                   swapChainExtent.height);
         break;
     case vk::Result::eSuccess:
         break;
@@ -854,6 +3050,5 @@ void Application::drawFrame()
         throw std::runtime_error("Failed to present swap chain image: " + vk::to_string(result));
     }
 
-    currentSwapChainImage = ++currentSwapChainImage % swapChainImageCount;
     currentFrame = ++frameCount % maxFramesInFlight;
 }
@@ -1,13 +1,42 @@
 #pragma once
 
+#include <atomic>
+#include <deque>
+#include <fstream>
+#include <span>
+#include <stop_token>
+#include <thread>
+#include <unordered_map>
+
 #include <vulkan/vulkan_raii.hpp>
 #include <SFML/System.hpp>
 
 #include "ApplicationQueueFamilies.h"
+#include "ApplicationSettings.h"
 #include "ApplicationSwapChainDetails.h"
+#include "Capture/FrameCapture.h"
+#include "Capture/FrameReadback.h"
+#include "Capture/FrameTimings.h"
+#include "Events/EventQueue.h"
+#include "Geometry/GeometryStreamer.h"
+#include "Jobs/TaskGraph.h"
+#include "Jobs/ThreadPool.h"
+#include "Memory/FrameArena.h"
+#include "Memory/VulkanHostAllocator.h"
+#include "Particles/ParticleSystem.h"
+#include "Renderer/DrawList.h"
+#include "Renderer/DrawPathTuner.h"
+#include "Renderer/FramePacer.h"
+#include "Renderer/GpuProfiler.h"
+#include "Renderer/MemoryTracker.h"
+#include "Renderer/PipelineManager.h"
+#include "Renderer/ResolutionController.h"
+#include "Renderer/TimelineScheduler.h"
+#include "Scene/Simulation.h"
+#include "Textures/TextureStreamer.h"
+#include "Trace/Trace.h"
 #include "Window/Window.h"
 
-// TODO: UBO -> HDR Color-space: conversion
 // TODO: Switch to SDL / SFML no OpenGL patch?
 // TODO: Use SFML multi-monitor fork or use SDL
 // TODO: ~Use designated initializers~ seems to be complicated with ArrayNoProxies
@@ -16,24 +45,120 @@
 class Application
 {
 public:
-    Application();
+    explicit Application(const ApplicationSettings& settings = {});
 
     ~Application();
 
     void run();
 
+    renderer::DrawHandle addDrawable(const Drawable& drawable);
+    void updateDrawable(renderer::DrawHandle handle, const Drawable& drawable);
+    void removeDrawable(renderer::DrawHandle handle);
+
+    // Uploads every pending drawable change at once and waits for it, so a timed run() does not spend its first
+    // frames streaming geometry through the staging buffers. Not during run().
+    void flushUploads();
+
+    // Average over the last run()
+    [[nodiscard]] float getFrameRate() const;
+
+    // Whether particles are drawn, they are not when none were asked for or the device has no mesh shaders
+    [[nodiscard]] bool hasParticles() const;
+
+    // Mean GPU time of the particle update over the last run(), 0 without particles or GPU timestamps
+    [[nodiscard]] double getParticleGpuMs() const;
+
+    // Mean GPU time per frame the particle update ran alongside the scene's passes, measured like getParticleGpuMs()
+    [[nodiscard]] double getParticleOverlapMs() const;
+
 private:
+    // Matches DrawStats in triangle.slang
+    struct DrawStats
+    {
+        uint32_t triangles;
+        uint32_t drawnClusters;
+        uint32_t culledClusters; // Selected by the LOD but off screen or occluded
+    };
+
+    // First member, so it is taken before anything else is set up
+    const std::chrono::steady_clock::time_point startupStart = std::chrono::steady_clock::now();
+    bool firstFramePresented = false;
+
+    ApplicationSettings settings;
+
+    // Owned by the render thread, the main thread only pumps the window while it runs
     bool windowOpen = true;
     bool paused = false;
+    std::atomic<bool> renderThreadDone = false;
+
+    // Filled by the window on the main thread, drained once per frame on the render thread by processEvents()
+    events::EventQueue eventQueue;
 
     unsigned int maxFramesInFlight = 2;
     unsigned int currentFrame = 0;
 
     unsigned int swapChainImageCount = 1;
-    unsigned int currentSwapChainImage = 0;
 
     unsigned int frameCount = 0;
     sf::Clock timer;
+    float frameRate = 0.0f;
+
+    // VK_KHR_present_wait pacing, only when settings.lowLatency is set and the device supports it
+    bool presentWaitEnabled = false;
+    uint64_t presentId = 0; // Last id presented on the current swapchain
+    renderer::FramePacer framePacer;
+
+    jobs::ThreadPool threadPool;
+    // Updates frame N + 1 on its own thread while this one records frame N, the only user of threadPool meanwhile
+    scene::Simulation simulation{threadPool};
+    // Of the snapshots drawn so far, and the drawFrame() their updates overlapped with
+    uint64_t lastSnapshotFrame = UINT64_MAX;
+    std::chrono::steady_clock::time_point lastDrawStart;
+    std::chrono::steady_clock::time_point lastDrawEnd;
+    uint64_t simulationUpdates = 0;
+    double simulationMs = 0.0;
+    double simulationOverlapMs = 0.0; // Of simulationMs, spent while the render thread was in drawFrame()
+    uint64_t staleSnapshotFrames = 0; // Frames that drew an older snapshot since theirs was not done yet
+    // The snapshot this frame draws, valid until the next advanceSimulation()
+    const scene::SceneSnapshot* sceneSnapshot = nullptr;
+    // Update of the last snapshot copied into worldMatrices
+    uint64_t lastWorldMatrixUpdate = 0;
+    // Mirrors worldMatrixBuffer: the identity that draws without a transform use, then the snapshot's world matrices
+    std::vector<glm::mat4> worldMatrices;
+    renderer::DirtyRanges worldMatrixDirtyRanges;
+
+    renderer::DrawList drawList;
+    renderer::DrawHandle triangleDraw;
+    // By draw handle index, invalid for draws that are not transformed
+    std::vector<scene::TransformHandle> drawTransforms;
+
+    std::unique_ptr<capture::FrameRecorder> frameRecorder;
+    std::vector<capture::CapturedFrame> replayFrames;
+    // Captured handle (index << 32 | generation) to the handle it got in this run
+    std::unordered_map<uint64_t, renderer::DrawHandle> replayHandles;
+    // Captured transform id to the transform it got in this run
+    std::unordered_map<uint32_t, scene::TransformHandle> replayTransforms;
+    // Spins are posed at the time since run() started, or at the captured time when replaying
+    std::chrono::steady_clock::time_point sceneStartTime;
+    uint64_t sceneTimeNs = 0; // Of the last requested update
+    uint64_t replaySceneTimeNs = 0;
+    // The newest frameTimingCapacity frames of the run, in order until it wraps around
+    std::vector<capture::FrameTiming> frameTimings;
+    size_t frameTimingCapacity = 1;
+    size_t frameTimingCount = 0; // Frames timed this run
+    uint64_t frameUploadBytes = 0;
+
+    // Steady-state frames must not allocate, checked in debug builds and benchmarks. Frames before steadyStateFrame
+    // are still warming up, anything that legitimately allocates, like a swapchain rebuild, pushes it back.
+    bool checkAllocations = false;
+    bool validationLayersEnabled = false;
+    unsigned int steadyStateFrame = 0;
+    uint64_t steadyFrames = 0;
+    uint64_t allocatingFrames = 0;
+    uint64_t steadyDriverAllocations = 0;
+
+    // Host memory of every Vulkan object the application creates, declared before them so it outlives them all
+    memory::VulkanHostAllocator hostAllocator;
 
     std::unique_ptr<window::Window> window;
     vk::raii::Context context;
@@ -43,38 +168,191 @@ private:
     vk::raii::PhysicalDevice physicalDevice = nullptr;
     vk::raii::Device device = nullptr;
 
+    // Outlives every tracked allocation below
+    std::unique_ptr<renderer::MemoryTracker> memoryTracker;
+
     // Synchronization objects need to be destroyed after the Queue
+    // One per frame in flight, reused once the frame's timeline value has completed
     std::vector<vk::raii::Semaphore> imageAvailableSemaphores;
+    // One per swapchain image, the presentation engine holds it until that image is acquired again
     std::vector<vk::raii::Semaphore> renderFinishedSemaphores;
-    std::vector<vk::raii::Fence> inFlightFences;
 
     vk::raii::DescriptorSetLayout descriptorSetLayout = nullptr;
     vk::raii::DescriptorPool descriptorPool = nullptr;
+    // The second set, only there with a geometryStreamer, binds its buffers in place of the draw list's
     vk::raii::DescriptorSets descriptorSets = nullptr;
 
     vk::raii::Queue graphicsQueue = nullptr;
+    // The same queue as graphicsQueue when the device has no separate family for them
+    vk::raii::Queue computeQueue = nullptr;
+    vk::raii::Queue transferQueue = nullptr;
     vk::raii::SwapchainKHR swapChain = nullptr;
+    // All draw into hdrFramebuffer, the early pass clears it and the late pass after the depth pyramid loads it, as
+    // does the particle pass after both
     vk::raii::RenderPass renderPass = nullptr;
+    vk::raii::RenderPass lateRenderPass = nullptr;
+    vk::raii::RenderPass particleRenderPass = nullptr;
     vk::raii::PipelineLayout pipelineLayout = nullptr;
-    vk::raii::Pipeline graphicsPipeline = nullptr;
+    // Compiles the graphics pipelines, from VK_EXT_graphics_pipeline_library parts if pipelineLibrariesEnabled
+    std::unique_ptr<renderer::PipelineManager> pipelineManager;
+    // Only compiled for the paths frames may draw with
+    renderer::PipelineHandle trianglePipeline;
+    renderer::PipelineHandle triangleVertexPipeline;
+    bool pipelineLibrariesEnabled = false;
+    // VK_EXT_mesh_shader is enabled. Without it the vertex stage stands in for the task and mesh stages in bindings,
+    // push constants and barriers, and only the vertex path draws.
+    bool meshShadersEnabled = false;
+    // Whether the frame being recorded draws with task and mesh shaders, see settings.drawPath
+    bool meshPathActive = false;
+    // Every stage the draw constants are pushed to
+    vk::ShaderStageFlags drawConstantStages;
+
+    // Everything is drawn into this HDR image, the tonemap pass then writes it to the swapchain image
+    vk::raii::Image hdrImage = nullptr;
+    renderer::TrackedDeviceMemory hdrImageMemory = nullptr;
+    vk::raii::ImageView hdrImageView = nullptr;
+    vk::raii::Image depthImage = nullptr;
+    renderer::TrackedDeviceMemory depthImageMemory = nullptr;
+    vk::raii::ImageView depthImageView = nullptr;
+    vk::raii::Framebuffer hdrFramebuffer = nullptr;
+
+    // Farthest depth of the early pass, halved per level, which the late pass culls against
+    vk::raii::Image depthPyramid = nullptr;
+    renderer::TrackedDeviceMemory depthPyramidMemory = nullptr;
+    vk::raii::ImageView depthPyramidView = nullptr; // Every level, sampled by the task shader
+    std::vector<vk::raii::ImageView> depthPyramidLevelViews;
+    uint32_t depthPyramidLevels = 0;
+
+    vk::raii::DescriptorSetLayout hizDescriptorSetLayout = nullptr;
+    vk::raii::PipelineLayout hizPipelineLayout = nullptr;
+    vk::raii::Pipeline hizPipeline = nullptr;
+    // One set per pyramid level, rebuilt with the swapchain
+    vk::raii::DescriptorPool hizDescriptorPool = nullptr;
+    vk::raii::DescriptorSets hizDescriptorSets = nullptr;
+
+    vk::raii::DescriptorSetLayout tonemapDescriptorSetLayout = nullptr;
+    vk::raii::PipelineLayout tonemapPipelineLayout = nullptr;
+    vk::raii::Pipeline tonemapPipeline = nullptr;
+    // One set per swapchain image, rebuilt with the swapchain
+    vk::raii::DescriptorPool tonemapDescriptorPool = nullptr;
+    vk::raii::DescriptorSets tonemapDescriptorSets = nullptr;
+
+    // Only created for settings.texturePaths, its copies run on the transfer queue
+    std::unique_ptr<textures::TextureStreamer> textureStreamer;
+    std::vector<textures::TextureHandle> textureHandles;
+    // Only created for settings.geometryPath, its copies share the transfer submits with the textures'
+    std::unique_ptr<geometry::GeometryStreamer> geometryStreamer;
+    // Only created for settings.particleCount, updated on the async compute queue and drawn in a submit of its own
+    // between the scene and tonemapping
+    std::unique_ptr<particles::ParticleSystem> particleSystem;
+    // Compute timeline value of the last update, which the next particle draw waits for, and graphics timeline value
+    // of the last particle draw, which the next update waits for
+    uint64_t particleUpdateValue = 0;
+    uint64_t particleDrawValue = 0;
+    // Summed over the frames of this run() that have the particle update's GPU time, and how much of it ran
+    // alongside the scene's passes
+    double particleGpuMs = 0.0;
+    double particleOverlapMs = 0.0;
+    uint64_t particleGpuFrames = 0;
+    // Only created for settings.readbackPath, copies every presented image for readbackWriter to append to
+    // readbackFile. Declared before the writer, which stops before they are destroyed.
+    std::unique_ptr<capture::FrameReadback> frameReadback;
+    std::ofstream readbackFile;
+    std::jthread readbackWriter;
+
+    std::unique_ptr<renderer::GpuProfiler> gpuProfiler;
+    // Times the work submitted to the async compute queue
+    std::unique_ptr<renderer::GpuProfiler> computeProfiler;
+    // GPU scopes go on this track when tracing, placed on the host clock with VK_EXT_calibrated_timestamps if enabled
+    trace::Track* gpuTrack = nullptr;
+    bool calibratedTimestampsEnabled = false;
+    // Index in frameTimings of the frame each slot recorded last, its GPU times arrive when the slot is reused
+    std::vector<size_t> frameTimingIndices;
+    // Only created for settings.targetGpuMs, fed the GPU time of every completed frame
+    std::unique_ptr<renderer::ResolutionController> resolutionController;
+    // Render scale each slot's last frame was recorded at
+    std::vector<float> frameRenderScales;
+    // Only created for DrawPath::Auto, switches between the mesh and the vertex path until it has timed both
+    std::unique_ptr<renderer::DrawPathTuner> drawPathTuner;
+    // frameCount of the frame each slot recorded last
+    std::vector<unsigned int> frameNumbers;
     vk::raii::CommandPool commandPool = nullptr;
+    vk::raii::CommandPool computeCommandPool = nullptr;
+    vk::raii::CommandPool transferCommandPool = nullptr;
     vk::raii::Buffer vertexBuffer = nullptr;
-    vk::raii::DeviceMemory vertexBufferMemory = nullptr;
+    renderer::TrackedDeviceMemory vertexBufferMemory = nullptr;
+    vk::raii::Buffer clusterBuffer = nullptr;
+    renderer::TrackedDeviceMemory clusterBufferMemory = nullptr;
+    // One flag per cluster, whether it passed the late pass's occlusion test last frame
+    vk::raii::Buffer clusterVisibilityBuffer = nullptr;
+    renderer::TrackedDeviceMemory clusterVisibilityMemory = nullptr;
+    // One per frame in flight, written by the task shader and read back once the frame's submit completes
+    vk::raii::Buffer drawStatsBuffer = nullptr;
+    renderer::TrackedDeviceMemory drawStatsMemory = nullptr;
+    DrawStats* drawStats = nullptr;
+    vk::raii::Buffer worldMatrixBuffer = nullptr;
+    renderer::TrackedDeviceMemory worldMatrixMemory = nullptr;
     vk::raii::Buffer indexBuffer = nullptr;
-    vk::raii::DeviceMemory indexBufferMemory = nullptr;
+    renderer::TrackedDeviceMemory indexBufferMemory = nullptr;
     std::vector<vk::raii::CommandBuffer> commandBuffers;
+    std::vector<vk::raii::CommandBuffer> transferCommandBuffers;
+    std::vector<vk::raii::CommandBuffer> computeCommandBuffers;
+    std::vector<vk::raii::CommandBuffer> particleCommandBuffers;
+    std::vector<vk::raii::CommandBuffer> tonemapCommandBuffers;
+
+    // Declared after everything it may retire, so it is destroyed, and waits for the GPU, first
+    std::unique_ptr<renderer::TimelineScheduler> graphicsTimeline;
+    std::unique_ptr<renderer::TimelineScheduler> computeTimeline;
+    std::unique_ptr<renderer::TimelineScheduler> transferTimeline;
+    // Timeline value of the last submit that used each frame in flight's resources
+    std::vector<uint64_t> frameTimelineValues;
+    // Transfer timeline value of the last upload each frame in flight recorded
+    std::vector<uint64_t> transferTimelineValues;
+    // Of the latest upload any frame recorded, every frame waits for it since what it draws may have arrived with it
+    uint64_t latestTransferValue = 0;
+
+    // Persistently mapped, one per frame in flight, holding that frame's draw list uploads
+    std::vector<vk::raii::Buffer> stagingBuffers;
+    std::vector<renderer::TrackedDeviceMemory> stagingBufferMemories;
+    std::vector<void*> stagingBufferMappings;
+
+    // Compute waits of the next graphics submit, plus its acquire semaphore, reused every frame
+    std::vector<vk::SemaphoreSubmitInfo> frameWaits;
+
+    // Transient CPU data of each frame in flight, like its upload lists, reset when the slot is reused
+    std::deque<memory::FrameArena> frameArenas;
 
     vk::Format swapChainImageFormat;
+    vk::ColorSpaceKHR swapChainColorSpace;
     vk::Extent2D swapChainExtent;
+    // Size of the current frame's render, the swapchain extent unless the resolution is scaled down
+    vk::Extent2D renderExtent;
     std::vector<vk::Image> swapChainImages;
     std::vector<vk::raii::ImageView> swapChainImageViews;
-    std::vector<vk::raii::Framebuffer> swapChainFramebuffers;
 
     ApplicationQueueFamilies queueFamilies;
     ApplicationSwapChainDetails swapChainDetails;
 
+    // Applies the events queued since the last frame, at most one swapchain rebuild however many resizes came in
+    void processEvents();
+
     void windowCallback(events::event event);
 
+    // Body of the render thread, draws frames until the window closes or the frame limit is reached
+    void renderLoop();
+
+    void replayFrame(const capture::CapturedFrame& frame);
+
+    void createFrameReadback();
+
+    // Body of readbackWriter, writes read back frames until it is stopped and none are left
+    void writeReadbackFrames(const std::stop_token& stop_token);
+
+    void reportFrameTimings() const;
+
+    // Counts a frame that made heap allocations after warming up, throwing when checkAllocations is set
+    void checkFrameAllocations(unsigned int frame_index, uint64_t allocations, uint64_t driver_allocations);
+
     static VKAPI_ATTR vk::Bool32 VKAPI_CALL
     debugCallback(vk::DebugUtilsMessageSeverityFlagBitsEXT message_severity,
                   vk::DebugUtilsMessageTypeFlagsEXT message_type,
@@ -93,12 +371,14 @@ private:
     static bool checkDeviceExtensions(const vk::raii::PhysicalDevice& device,
                                       const std::vector<std::string_view>& requested_extensions);
 
-    [[nodiscard]] static vk::SurfaceFormatKHR
-    chooseSwapSurfaceFormat(const std::vector<vk::SurfaceFormatKHR>& available_formats);
+    // Prefers HDR10 when settings.hdr is set and the window's display supports it. Only formats the tonemap pass can
+    // write as storage images are considered.
+    [[nodiscard]] vk::SurfaceFormatKHR
+    chooseSwapSurfaceFormat(const std::vector<vk::SurfaceFormatKHR>& available_formats) const;
 
     [[nodiscard]] static vk::PresentModeKHR
     choosePresentMode(const std::vector<vk::PresentModeKHR>& available_present_modes,
-                      const std::vector<vk::PresentModeKHR>& present_mode_preferences);
+                      std::span<const vk::PresentModeKHR> present_mode_preferences);
 
     [[nodiscard]] vk::Extent2D
     chooseSwapExtent(const vk::SurfaceCapabilitiesKHR& capabilities) const;
@@ -116,6 +396,9 @@ private:
 
     void selectPhysicalDevice(const std::vector<std::string_view>& requested_extensions);
 
+    // Adds the optional extensions the selected device supports, enabling the features that depend on them
+    void selectDeviceExtensions(std::vector<std::string_view>& device_extensions);
+
     void createSurface();
 
     void createLogicalDevice(const std::vector<std::string_view>& layers,
@@ -140,23 +423,116 @@ private:
 
     void createFramebuffers();
 
+    // Recreated with the swapchain, sized to its extent
+    void createHdrImage();
+    // The depth attachment and its pyramid, recreated with the swapchain
+    void createDepthImages();
+
+    void createHizPipeline();
+    // Also points the draw descriptor set at the current pyramid
+    void createHizDescriptorSets();
+
+    // Every draw of the list, phase is one of the draw_phase constants
+    void recordDraws(const vk::raii::CommandBuffer& command_buffer, uint32_t phase);
+    // The draw list on the vertex path, clusters selected on the CPU as the task shader would
+    void recordVertexDraws(const vk::raii::CommandBuffer& command_buffer, float error_threshold);
+    // The stages draws read and write buffers in, task and mesh shaders only when they are enabled
+    [[nodiscard]] vk::PipelineStageFlags2 getGeometryStages() const;
+    // Reduces the early pass's depth into the pyramid, one dispatch per level
+    void recordDepthPyramid(const vk::raii::CommandBuffer& command_buffer);
+    // Part of the pyramid level the current render extent uses
+    [[nodiscard]] vk::Extent2D getPyramidExtent(uint32_t level) const;
+
+    void createTonemapPipeline();
+    void createTonemapDescriptorSets();
+
+    void recordTonemap(const vk::raii::CommandBuffer& command_buffer, uint32_t image_index);
+
+    // Moves the GPU times and draw statistics of the frame the slot recorded last into frameTimings, once its
+    // submit has completed
+    void collectGpuTimings(uint32_t frame_slot);
+
     void createCommandPool();
 
-    void copyBuffer(const vk::raii::Buffer& src_buffer, const vk::raii::Buffer& dst_buffer, vk::DeviceSize size) const;
+    // Returns the timeline value the copy completes at, src_buffer has to outlive it
+    uint64_t copyBuffer(const vk::raii::Buffer& src_buffer, const vk::raii::Buffer& dst_buffer, vk::DeviceSize size);
+
+    [[nodiscard]] std::pair<vk::raii::Image, renderer::TrackedDeviceMemory> createImage(
+        vk::Extent2D extent, vk::Format format, vk::ImageUsageFlags usage, std::string_view owner,
+        uint32_t mip_levels = 1) const;
 
-    [[nodiscard]] std::pair<vk::raii::Buffer, vk::raii::DeviceMemory> createBuffer(
+    [[nodiscard]] std::pair<vk::raii::Buffer, renderer::TrackedDeviceMemory> createBuffer(
         vk::DeviceSize size, vk::BufferUsageFlags usage,
-        vk::MemoryPropertyFlags properties) const;
+        vk::MemoryPropertyFlags properties, renderer::MemoryCategory category, std::string_view owner) const;
+
+    void createMemoryTracker(bool budget_supported);
+
+    void writeStats() const;
 
     void createVertexBuffer();
+    // The cluster buffer mirroring the draw list's, the cluster visibility flags and the draw statistics
+    void createClusterBuffers();
+    void createWorldMatrixBuffer();
     void createIndexBuffer();
+    void createStagingBuffers();
 
     void createCommandBuffers();
 
+    void recordUploads(const vk::raii::CommandBuffer& command_buffer);
+
+    // Copies as many dirty ranges of source as fit into this frame's staging buffer after staging_offset
+    void stageUploads(renderer::DirtyRanges& dirty_ranges, std::span<const std::byte> source,
+                      std::pmr::vector<vk::BufferCopy>& regions, vk::DeviceSize& staging_offset);
+
+    void createTextureStreamer();
+
+    void createGeometryStreamer();
+
+    void createParticleSystem();
+
+    // Submits this frame's texture and geometry page uploads to the transfer queue, the graphics submit waits for them
+    void streamAssets();
+
+    // Submits this frame's particle update to the async compute queue, only the particle draw waits for it
+    void updateParticles();
+
+    // Records the scene into command_buffer. With particles it ends after the scene, and the particle draw and the
+    // tonemap pass go to the slot's particle and tonemap command buffers.
     void recordCommandBuffer(const vk::raii::CommandBuffer& command_buffer,
-                             uint32_t image_index) const;
+                             uint32_t image_index);
+    void recordParticleDraw(const vk::raii::CommandBuffer& command_buffer);
+
+    // Waits for the previous frame to reach the display, then until this one should start
+    void paceFrame();
+
+    // The default scene, a triangle turning about its centre
+    void createScene();
+
+    // Outside of run(), while the simulation is idle. Recorded into the capture along with the transform's spin.
+    scene::TransformHandle createTransform(scene::TransformHandle parent, glm::vec3 position);
+    void addSpin(scene::TransformHandle handle, float radians_per_second);
+
+    // Draws the draw list entry with the transform's world matrix. Transforms are created outside of run(), while
+    // the simulation is idle.
+    void setDrawTransform(renderer::DrawHandle handle, scene::TransformHandle transform);
+
+    // Index of the draw's world matrix in worldMatrices
+    [[nodiscard]] uint32_t getWorldMatrixSlot(uint32_t draw_index) const;
+
+    // Takes the newest scene snapshot for this frame and starts the update of the next one
+    void advanceSimulation();
 
     void drawFrame();
 
+    // Submits to the async compute queue, which runs alongside graphics. Resources shared with graphics need
+    // concurrent sharing or an ownership transfer when the families differ. Returns the compute timeline value the
+    // work completes at.
+    uint64_t submitCompute(std::span<const vk::CommandBufferSubmitInfo> command_buffers,
+                           std::span<const vk::SemaphoreSubmitInfo> waits = {});
+
+    // Makes the next frame's graphics submit wait at stages until compute work up to value is done
+    void waitForCompute(uint64_t value, vk::PipelineStageFlags2 stages);
+
     void createSyncObjects();
+    void createPresentSemaphores();
 };
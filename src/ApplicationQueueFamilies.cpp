@@ -8,18 +8,30 @@ ApplicationQueueFamilies::ApplicationQueueFamilies(
     const vk::raii::PhysicalDevice &physical_device, const vk::raii::SurfaceKHR &surface) {
     const std::vector<vk::QueueFamilyProperties> properties =
         physical_device.getQueueFamilyProperties();
-    int i = 0;
-    for (auto property : properties) {
-        if (property.queueFlags & vk::QueueFlagBits::eGraphics) {
+    for (uint32_t i = 0; i < properties.size(); i++) {
+        const vk::QueueFlags flags = properties[i].queueFlags;
+        if (!graphicsFamily && (flags & vk::QueueFlagBits::eGraphics)) {
             graphicsFamily = i;
         }
-        if (physical_device.getSurfaceSupportKHR(i, surface)) {
+        if (!presentFamily && physical_device.getSurfaceSupportKHR(i, surface)) {
             presentFamily = i;
         }
-        if (isComplete()) {
-            break;
+        if (!computeFamily && (flags & vk::QueueFlagBits::eCompute) &&
+            !(flags & vk::QueueFlagBits::eGraphics)) {
+            computeFamily = i;
         }
-        i++;
+        if (!transferFamily && (flags & vk::QueueFlagBits::eTransfer) &&
+            !(flags & (vk::QueueFlagBits::eGraphics | vk::QueueFlagBits::eCompute))) {
+            transferFamily = i;
+        }
+    }
+
+    // Graphics families always support compute and transfer, so one queue can do everything
+    if (!computeFamily) {
+        computeFamily = graphicsFamily;
+    }
+    if (!transferFamily) {
+        transferFamily = graphicsFamily;
     }
 }
 
@@ -32,7 +44,17 @@ bool ApplicationQueueFamilies::areUnique() const {
     return graphicsFamily.value() != presentFamily.value();
 }
 
+bool ApplicationQueueFamilies::hasAsyncCompute() const {
+    assert(isComplete());
+    return computeFamily.value() != graphicsFamily.value();
+}
+
+bool ApplicationQueueFamilies::hasDedicatedTransfer() const {
+    assert(isComplete());
+    return transferFamily.value() != graphicsFamily.value();
+}
+
 std::vector<uint32_t> ApplicationQueueFamilies::getQueueFamilyIndices() const {
     assert(isComplete());
     return {graphicsFamily.value(), presentFamily.value()};
-}
\ No newline at end of file
+}
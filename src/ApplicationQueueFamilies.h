@@ -11,6 +11,11 @@ class SurfaceKHR;
 struct ApplicationQueueFamilies {
     std::optional<uint32_t> graphicsFamily;
     std::optional<uint32_t> presentFamily;
+    // A compute family without graphics when the device has one, so compute work overlaps rendering,
+    // otherwise the graphics family
+    std::optional<uint32_t> computeFamily;
+    // A transfer-only family when the device has one, usually backed by a copy engine, otherwise the graphics family
+    std::optional<uint32_t> transferFamily;
 
     ApplicationQueueFamilies();
 
@@ -21,5 +26,9 @@ struct ApplicationQueueFamilies {
 
     [[nodiscard]] bool areUnique() const;
 
+    [[nodiscard]] bool hasAsyncCompute() const;
+
+    [[nodiscard]] bool hasDedicatedTransfer() const;
+
     [[nodiscard]] std::vector<uint32_t> getQueueFamilyIndices() const;
 };
@@ -0,0 +1,157 @@
+#include "ApplicationSettings.h"
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+ApplicationSettings::ApplicationSettings() = default;
+
+ApplicationSettings::ApplicationSettings(const int argc, const char* const* argv) {
+    int i = 1;
+
+    const auto next_value = [&](const std::string_view option) -> std::string_view {
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value for " + std::string(option));
+        }
+        return argv[++i];
+    };
+
+    const auto next_number = [&](const std::string_view option) -> uint32_t {
+        const std::string value(next_value(option));
+        try {
+            return static_cast<uint32_t>(std::stoul(value));
+        } catch (const std::logic_error &) {
+            throw std::invalid_argument("Invalid number for " + std::string(option) + ": " + value);
+        }
+    };
+
+    const auto next_real = [&](const std::string_view option) -> double {
+        const std::string value(next_value(option));
+        try {
+            return std::stod(value);
+        } catch (const std::logic_error &) {
+            throw std::invalid_argument("Invalid number for " + std::string(option) + ": " + value);
+        }
+    };
+
+    for (; i < argc; i++) {
+        const std::string_view option = argv[i];
+
+        if (option == "--headless") {
+            headless = true;
+        } else if (option == "--size") {
+            const std::string value(next_value(option));
+            const size_t separator = value.find('x');
+            if (separator == std::string::npos) {
+                throw std::invalid_argument("Expected --size WIDTHxHEIGHT, got " + value);
+            }
+            windowSize = {std::stoi(value.substr(0, separator)), std::stoi(value.substr(separator + 1))};
+        } else if (option == "--frames") {
+            frameLimit = next_number(option);
+        } else if (option == "--max-vertices") {
+            maxVertices = next_number(option);
+        } else if (option == "--frames-in-flight") {
+            framesInFlight = next_number(option);
+            if (framesInFlight == 0) {
+                throw std::invalid_argument("--frames-in-flight needs at least 1 frame");
+            }
+        } else if (option == "--swapchain-images") {
+            swapchainImages = next_number(option);
+        } else if (option == "--low-latency") {
+            lowLatency = true;
+        } else if (option == "--hdr") {
+            hdr = true;
+        } else if (option == "--exposure") {
+            exposure = static_cast<float>(next_real(option));
+            if (exposure <= 0.0f) {
+                throw std::invalid_argument("--exposure must be positive");
+            }
+        } else if (option == "--lod-error") {
+            lodErrorPixels = static_cast<float>(next_real(option));
+            if (lodErrorPixels < 0.0f) {
+                throw std::invalid_argument("--lod-error must not be negative");
+            }
+        } else if (option == "--no-occlusion-culling") {
+            occlusionCulling = false;
+        } else if (option == "--draw-path") {
+            const std::string value(next_value(option));
+            if (value == "mesh") {
+                drawPath = DrawPath::Mesh;
+            } else if (value == "vertex") {
+                drawPath = DrawPath::Vertex;
+            } else if (value == "auto") {
+                drawPath = DrawPath::Auto;
+            } else {
+                throw std::invalid_argument("Expected --draw-path mesh, vertex or auto, got " + value);
+            }
+        } else if (option == "--dynamic-resolution") {
+            targetGpuMs = next_real(option);
+            if (targetGpuMs <= 0.0) {
+                throw std::invalid_argument("--dynamic-resolution must be positive");
+            }
+        } else if (option == "--min-render-scale") {
+            minRenderScale = static_cast<float>(next_real(option));
+            if (minRenderScale <= 0.0f || minRenderScale > 1.0f) {
+                throw std::invalid_argument("--min-render-scale must be in (0, 1]");
+            }
+        } else if (option == "--no-pipeline-libraries") {
+            pipelineLibraries = false;
+        } else if (option == "--soft") {
+            softwareRenderer = true;
+        } else if (option == "--output") {
+            outputPath = next_value(option);
+        } else if (option == "--benchmark") {
+            benchmark = true;
+        } else if (option == "--benchmark-triangles") {
+            benchmarkTriangles = next_number(option);
+        } else if (option == "--benchmark-particles") {
+            benchmarkParticles = true;
+        } else if (option == "--particles") {
+            particleCount = next_number(option);
+        } else if (option == "--capture") {
+            capturePath = next_value(option);
+        } else if (option == "--replay") {
+            replayPath = next_value(option);
+            headless = true;
+        } else if (option == "--timings") {
+            timingsPath = next_value(option);
+        } else if (option == "--compare") {
+            comparePath = next_value(option);
+        } else if (option == "--readback") {
+            readbackPath = next_value(option);
+        } else if (option == "--readback-depth") {
+            readbackDepth = next_number(option);
+        } else if (option == "--trace") {
+            tracePath = next_value(option);
+        } else if (option == "--stats") {
+            statsPath = next_value(option);
+        } else if (option == "--memory-soft-limit") {
+            memorySoftLimit = next_real(option);
+            if (memorySoftLimit <= 0.0 || memorySoftLimit > 1.0) {
+                throw std::invalid_argument("--memory-soft-limit must be in (0, 1]");
+            }
+        } else if (option == "--texture") {
+            texturePaths.emplace_back(next_value(option));
+        } else if (option == "--texture-budget") {
+            textureBudgetMiB = next_number(option);
+        } else if (option == "--geometry") {
+            geometryPath = next_value(option);
+        } else if (option == "--geometry-budget") {
+            geometryBudgetMiB = next_number(option);
+        } else if (option == "--bake-geometry") {
+            bakeGeometryPath = next_value(option);
+        } else if (option == "--bake-tiles") {
+            bakeTiles = next_number(option);
+        } else {
+            throw std::invalid_argument("Unknown option: " + std::string(option));
+        }
+    }
+
+    if (!capturePath.empty() && !replayPath.empty()) {
+        throw std::invalid_argument("--capture and --replay cannot be combined");
+    }
+    // Streamed pages are only found through the page table the task and mesh shaders read
+    if (!geometryPath.empty() && drawPath == DrawPath::Vertex) {
+        throw std::invalid_argument("--geometry cannot be drawn with --draw-path vertex");
+    }
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include <glm/vec2.hpp>
+
+// How the scene's clusters get to the rasterizer
+enum class DrawPath {
+    // Task shaders select and cull clusters, mesh shaders emit them. Needs VK_EXT_mesh_shader.
+    Mesh,
+    // The CPU selects clusters and draws their vertices with a vertex shader, without occlusion culling
+    Vertex,
+    // Times both over the first frames and keeps the faster one
+    Auto,
+};
+
+struct ApplicationSettings {
+    glm::ivec2 windowSize{1280, 720};
+
+    // Render to a VK_EXT_headless_surface instead of opening a window
+    bool headless = false;
+
+    // Stop after this many frames, 0 runs until the window is closed
+    uint32_t frameLimit = 0;
+
+    uint32_t maxVertices = 100;
+
+    // Frames the CPU may record ahead of the GPU
+    uint32_t framesInFlight = 2;
+    // Swapchain images to request, 0 uses one more than the surface minimum
+    uint32_t swapchainImages = 0;
+    // Pace frames with VK_KHR_present_wait so each one starts just in time for the next refresh
+    bool lowLatency = false;
+
+    // Present to an HDR10 swapchain when the display supports it, SDR otherwise
+    bool hdr = false;
+    // Scale applied to the HDR render before tonemapping
+    float exposure = 1.0f;
+
+    // Screen-space error in pixels the task shader allows when picking cluster levels of detail, 0 draws full detail
+    float lodErrorPixels = 1.0f;
+    // Cull clusters hidden behind the depth pyramid of last frame's visible clusters, in an early and a late pass
+    bool occlusionCulling = true;
+    // Falls back on DrawPath::Vertex when the device has no mesh shaders
+    DrawPath drawPath = DrawPath::Mesh;
+
+    // GPU frame time in milliseconds the render scale is adjusted to hold, 0 renders at the window size
+    double targetGpuMs = 0.0;
+    // Smallest render scale per axis dynamic resolution may pick
+    float minRenderScale = 0.5f;
+
+    // Build graphics pipelines from VK_EXT_graphics_pipeline_library parts when the device supports it
+    bool pipelineLibraries = true;
+
+    // Draw on the CPU with the SoftRenderer, writing the last frame to outputPath
+    bool softwareRenderer = false;
+    std::filesystem::path outputPath = "frame.ppm";
+
+    // Compare SoftRenderer and Vulkan throughput on benchmarkTriangles triangles, then exit
+    bool benchmark = false;
+    uint32_t benchmarkTriangles = 100000;
+    // Time the particle update and draw at 10 thousand to 10 million particles, then exit
+    bool benchmarkParticles = false;
+
+    // Particles of the GPU fountain drawn over the scene, 0 draws none. Needs VK_EXT_mesh_shader.
+    uint32_t particleCount = 0;
+
+    // Record every frame's events, draw list edits, uploads and swapchain rebuilds
+    std::filesystem::path capturePath;
+    // Re-run a capture headlessly, as fast as possible
+    std::filesystem::path replayPath;
+    // Per-frame CPU timings of the run, as CSV
+    std::filesystem::path timingsPath;
+    // Timings CSV of a previous run to compare this one against
+    std::filesystem::path comparePath;
+
+    // Append every presented frame to this file as raw pixels, read back without stalling the GPU
+    std::filesystem::path readbackPath;
+    // Completed frames that may wait for the writer before new ones are dropped
+    uint32_t readbackDepth = 3;
+
+    // Chrome trace of every thread and of the GPU queue, written when the run ends
+    std::filesystem::path tracePath;
+
+    // Frame rate and GPU memory usage by heap, category and owner, as JSON
+    std::filesystem::path statsPath;
+    // Warn when a heap's usage goes above this fraction of its budget
+    double memorySoftLimit = 0.9;
+
+    // KTX2 textures to stream, each treated as covering the window
+    std::vector<std::filesystem::path> texturePaths;
+    // Device memory all resident texture mips together may use
+    uint32_t textureBudgetMiB = 256;
+
+    // Cluster page file to stream, drawn over the default scene
+    std::filesystem::path geometryPath;
+    // Device memory the pool of resident geometry pages may use
+    uint32_t geometryBudgetMiB = 256;
+    // Write a procedural world of bakeTiles x bakeTiles tiles to this cluster page file, then exit
+    std::filesystem::path bakeGeometryPath;
+    uint32_t bakeTiles = 8;
+
+    ApplicationSettings();
+
+    // Throws std::invalid_argument on unknown or malformed options
+    ApplicationSettings(int argc, const char* const* argv);
+};
@@ -0,0 +1,154 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+
+#include <SFML/System.hpp>
+
+#include "Application.h"
+#include "StaticMesh.h"
+#include "Jobs/ThreadPool.h"
+#include "Renderer/SoftRenderer.h"
+
+constexpr uint32_t default_benchmark_frames = 100;
+// A decade apart, from a handful of workgroups to more than a storage buffer holds on some devices
+constexpr std::array<uint32_t, 4> benchmark_particle_counts{10'000, 100'000, 1'000'000, 10'000'000};
+
+// Small clockwise triangles scattered over the screen, seeded so every run and both renderers see the same scene
+static StaticMesh create_benchmark_mesh(const uint32_t triangle_count)
+{
+    std::mt19937 random(42);
+    std::uniform_real_distribution position(-1.0f, 1.0f);
+    std::uniform_real_distribution unit(0.0f, 1.0f);
+
+    std::vector<Vertex> vertices;
+    vertices.reserve(static_cast<size_t>(triangle_count) * 3);
+
+    for (uint32_t i = 0; i < triangle_count; i++)
+    {
+        const glm::vec2 center(position(random), position(random));
+        const float radius = 0.01f + 0.04f * unit(random);
+        const glm::vec3 color(unit(random), unit(random), unit(random));
+
+        vertices.push_back({center + glm::vec2(0.0f, -radius), color});
+        vertices.push_back({center + glm::vec2(radius, radius), color});
+        vertices.push_back({center + glm::vec2(-radius, radius), color});
+    }
+
+    return StaticMesh(std::move(vertices));
+}
+
+int run_renderer_benchmark(const ApplicationSettings& settings)
+{
+    const uint32_t frames = settings.frameLimit > 0 ? settings.frameLimit : default_benchmark_frames;
+    const uint32_t triangles = settings.benchmarkTriangles;
+    const StaticMesh mesh = create_benchmark_mesh(triangles);
+
+    jobs::ThreadPool thread_pool;
+    renderer::DrawList draw_list(triangles * 3);
+    draw_list.add(mesh);
+
+    renderer::SoftRenderer soft_renderer(settings.windowSize, thread_pool);
+    soft_renderer.render(draw_list); // Warm up the bins
+
+    sf::Clock clock;
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        soft_renderer.render(draw_list);
+    }
+    const float soft_frame_rate = static_cast<float>(frames) / clock.getElapsedTime().asSeconds();
+
+    ApplicationSettings vulkan_settings = settings;
+    vulkan_settings.headless = true;
+    vulkan_settings.frameLimit = frames;
+    vulkan_settings.maxVertices = triangles * 3;
+    // The soft renderer draws every triangle, so no coarser levels of detail either
+    vulkan_settings.lodErrorPixels = 0.0f;
+
+    float vulkan_frame_rate;
+    {
+        Application application(vulkan_settings);
+        application.addDrawable(mesh);
+        // Otherwise the first timed frames stream the mesh through the staging buffers, a megabyte at a time
+        application.flushUploads();
+        application.run();
+        vulkan_frame_rate = application.getFrameRate();
+    }
+
+    std::printf("%u triangles, %dx%d, %u frames, %u threads\n", triangles, settings.windowSize.x,
+                settings.windowSize.y, frames, thread_pool.getConcurrency());
+    std::printf("%-8s %12s %16s\n", "Renderer", "Frames/s", "Triangles/s");
+    std::printf("%-8s %12.1f %16.0f\n", "Soft", soft_frame_rate, soft_frame_rate * static_cast<float>(triangles));
+    std::printf("%-8s %12.1f %16.0f\n", "Vulkan", vulkan_frame_rate,
+                vulkan_frame_rate * static_cast<float>(triangles));
+
+    return 0;
+}
+
+int run_particle_benchmark(const ApplicationSettings& settings)
+{
+    const uint32_t frames = settings.frameLimit > 0 ? settings.frameLimit : default_benchmark_frames;
+
+    std::printf("%dx%d, %u frames per count\n", settings.windowSize.x, settings.windowSize.y, frames);
+    std::printf("%-10s %12s %16s %12s %12s\n", "Particles", "Frames/s", "Particles/s", "Update ms", "Overlap ms");
+    for (const uint32_t count : benchmark_particle_counts)
+    {
+        ApplicationSettings particle_settings = settings;
+        particle_settings.headless = true;
+        particle_settings.frameLimit = frames;
+        particle_settings.particleCount = count;
+
+        // The first update fills the whole capacity with particles of every age, so every frame draws all of them
+        float frame_rate;
+        double update_ms;
+        double overlap_ms;
+        try
+        {
+            Application application(particle_settings);
+            if (!application.hasParticles())
+            {
+                std::printf("%-10u skipped: particles need mesh shaders\n", count);
+                continue;
+            }
+            application.run();
+            frame_rate = application.getFrameRate();
+            update_ms = application.getParticleGpuMs();
+            overlap_ms = application.getParticleOverlapMs();
+        }
+        catch (const std::runtime_error& error)
+        {
+            std::printf("%-10u skipped: %s\n", count, error.what());
+            continue;
+        }
+
+        std::printf("%-10u %12.1f %16.0f %12.3f %12.3f\n", count, frame_rate, frame_rate * static_cast<float>(count),
+                    update_ms, overlap_ms);
+    }
+
+    return 0;
+}
+
+int run_software_renderer(const ApplicationSettings& settings)
+{
+    jobs::ThreadPool thread_pool;
+    renderer::DrawList draw_list(settings.maxVertices);
+    draw_list.add(StaticMesh::triangle());
+
+    renderer::SoftRenderer soft_renderer(settings.windowSize, thread_pool);
+
+    const uint32_t frames = std::max(settings.frameLimit, 1u);
+    sf::Clock clock;
+    for (uint32_t i = 0; i < frames; i++)
+    {
+        soft_renderer.render(draw_list);
+    }
+    std::printf("Framerate: %.1f FPS\n", static_cast<float>(frames) / clock.getElapsedTime().asSeconds());
+
+    soft_renderer.writeImage(settings.outputPath);
+    std::printf("Wrote %s\n", settings.outputPath.string().c_str());
+
+    return 0;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "ApplicationSettings.h"
+
+// Draws the same triangle soup with the SoftRenderer and the headless Vulkan renderer and prints the throughput of
+// each. Point VK_ICD_FILENAMES at lavapipe to compare both on the CPU.
+int run_renderer_benchmark(const ApplicationSettings& settings);
+
+// Runs the headless Vulkan renderer with 10 thousand to 10 million GPU particles and prints the frame rate and the GPU
+// time of the particle update at each count
+int run_particle_benchmark(const ApplicationSettings& settings);
+
+// Draws the default scene with the SoftRenderer and writes the last frame to settings.outputPath
+int run_software_renderer(const ApplicationSettings& settings);
@@ -0,0 +1,386 @@
+#include "FrameCapture.h"
+
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+constexpr char capture_magic[8] = {'V', 'K', 'T', 'C', 'A', 'P', 'T', '\0'};
+// 2 added the scene time to frame ends, and the transform records
+constexpr uint64_t capture_version = 2;
+
+enum class Tag : uint8_t
+{
+    FrameBegin = 1,
+    FrameEnd,
+    Resize,
+    VisibilityChange,
+    Close,
+    DrawAdd,
+    DrawUpdate,
+    DrawRemove,
+    Upload,
+    SwapchainRecreate,
+    TransformCreate,
+    TransformSpin,
+    DrawTransform,
+};
+
+template <class... Ts>
+struct Overloaded : Ts...
+{
+    using Ts::operator()...;
+};
+
+// Signed values are zigzag encoded so small negatives stay short
+static uint64_t zigzag_encode(const int64_t value)
+{
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+static int64_t zigzag_decode(const uint64_t value)
+{
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+class CaptureReader
+{
+public:
+    explicit CaptureReader(std::span<const char> data) : data(data)
+    {
+    }
+
+    [[nodiscard]] bool atEnd() const
+    {
+        return position == data.size();
+    }
+
+    uint8_t readByte()
+    {
+        require(1);
+        return static_cast<uint8_t>(data[position++]);
+    }
+
+    uint64_t readVarint()
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            const uint8_t byte = readByte();
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return value;
+        }
+        throw std::runtime_error("Malformed capture: integer too long");
+    }
+
+    renderer::DrawHandle readHandle()
+    {
+        renderer::DrawHandle handle;
+        handle.index = static_cast<uint32_t>(readVarint());
+        handle.generation = static_cast<uint32_t>(readVarint());
+        return handle;
+    }
+
+    scene::TransformHandle readTransform()
+    {
+        return {static_cast<uint32_t>(readVarint())};
+    }
+
+    template <class T>
+    T readFloats()
+    {
+        T value;
+        readBytes(&value, sizeof(value));
+        return value;
+    }
+
+    std::vector<Vertex> readVertices()
+    {
+        const uint64_t count = readVarint();
+        require(count * sizeof(Vertex));
+
+        std::vector<Vertex> vertices(count);
+        std::memcpy(vertices.data(), data.data() + position, count * sizeof(Vertex));
+        position += count * sizeof(Vertex);
+        return vertices;
+    }
+
+    void readBytes(void* destination, const size_t size)
+    {
+        require(size);
+        std::memcpy(destination, data.data() + position, size);
+        position += size;
+    }
+
+private:
+    std::span<const char> data;
+    size_t position = 0;
+
+    void require(const uint64_t size) const
+    {
+        if (size > data.size() - position)
+            throw std::runtime_error("Malformed capture: unexpected end of file");
+    }
+};
+
+namespace capture
+{
+    FrameRecorder::FrameRecorder(const std::filesystem::path& path) : file(path, std::ios::binary)
+    {
+        if (!file)
+            throw std::runtime_error("Failed to open capture file " + path.string());
+
+        file.write(capture_magic, sizeof(capture_magic));
+        writeVarint(capture_version);
+    }
+
+    void FrameRecorder::beginFrame(const uint64_t index)
+    {
+        writeByte(static_cast<uint8_t>(Tag::FrameBegin));
+        writeVarint(index);
+    }
+
+    void FrameRecorder::endFrame(const uint64_t cpu_time_ns, const uint64_t scene_time_ns)
+    {
+        writeByte(static_cast<uint8_t>(Tag::FrameEnd));
+        writeVarint(cpu_time_ns);
+        writeVarint(scene_time_ns);
+    }
+
+    void FrameRecorder::record(const events::event& event)
+    {
+        std::visit(Overloaded{
+                       [this](const events::Resize& resize)
+                       {
+                           writeByte(static_cast<uint8_t>(Tag::Resize));
+                           writeVarint(zigzag_encode(resize.size.x));
+                           writeVarint(zigzag_encode(resize.size.y));
+                       },
+                       [this](const events::VisibilityChange& visibility)
+                       {
+                           writeByte(static_cast<uint8_t>(Tag::VisibilityChange));
+                           writeByte(visibility.isVisible);
+                       },
+                       [this](const events::Close&) { writeByte(static_cast<uint8_t>(Tag::Close)); }
+                   },
+                   event);
+    }
+
+    void FrameRecorder::recordDrawAdd(const renderer::DrawHandle handle, const std::span<const Vertex> vertices)
+    {
+        writeByte(static_cast<uint8_t>(Tag::DrawAdd));
+        writeHandle(handle);
+        writeVertices(vertices);
+    }
+
+    void FrameRecorder::recordDrawUpdate(const renderer::DrawHandle handle, const std::span<const Vertex> vertices)
+    {
+        writeByte(static_cast<uint8_t>(Tag::DrawUpdate));
+        writeHandle(handle);
+        writeVertices(vertices);
+    }
+
+    void FrameRecorder::recordDrawRemove(const renderer::DrawHandle handle)
+    {
+        writeByte(static_cast<uint8_t>(Tag::DrawRemove));
+        writeHandle(handle);
+    }
+
+    void FrameRecorder::recordTransformCreate(const scene::TransformHandle handle, const scene::TransformHandle parent,
+                                              const glm::vec3 position, const glm::quat rotation,
+                                              const glm::vec3 scale)
+    {
+        writeByte(static_cast<uint8_t>(Tag::TransformCreate));
+        writeVarint(handle.id);
+        writeVarint(parent.id);
+        writeFloats({&position.x, 3});
+        writeFloats({&rotation.x, 4});
+        writeFloats({&scale.x, 3});
+    }
+
+    void FrameRecorder::recordTransformSpin(const scene::TransformHandle handle, const float rate)
+    {
+        writeByte(static_cast<uint8_t>(Tag::TransformSpin));
+        writeVarint(handle.id);
+        writeFloats({&rate, 1});
+    }
+
+    void FrameRecorder::recordDrawTransform(const renderer::DrawHandle draw, const scene::TransformHandle transform)
+    {
+        writeByte(static_cast<uint8_t>(Tag::DrawTransform));
+        writeHandle(draw);
+        writeVarint(transform.id);
+    }
+
+    void FrameRecorder::recordUpload(const uint64_t bytes, const uint32_t regions)
+    {
+        writeByte(static_cast<uint8_t>(Tag::Upload));
+        writeVarint(bytes);
+        writeVarint(regions);
+    }
+
+    void FrameRecorder::recordSwapchainRecreate(const int32_t result, const uint32_t width, const uint32_t height)
+    {
+        writeByte(static_cast<uint8_t>(Tag::SwapchainRecreate));
+        writeVarint(zigzag_encode(result));
+        writeVarint(width);
+        writeVarint(height);
+    }
+
+    void FrameRecorder::writeByte(const uint8_t value)
+    {
+        file.put(static_cast<char>(value));
+    }
+
+    void FrameRecorder::writeVarint(uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            writeByte(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        writeByte(static_cast<uint8_t>(value));
+    }
+
+    void FrameRecorder::writeHandle(const renderer::DrawHandle handle)
+    {
+        writeVarint(handle.index);
+        writeVarint(handle.generation);
+    }
+
+    void FrameRecorder::writeVertices(const std::span<const Vertex> vertices)
+    {
+        writeVarint(vertices.size());
+        file.write(reinterpret_cast<const char*>(vertices.data()), static_cast<std::streamsize>(vertices.size_bytes()));
+    }
+
+    void FrameRecorder::writeFloats(const std::span<const float> values)
+    {
+        file.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size_bytes()));
+    }
+
+    std::vector<CapturedFrame> load_capture(const std::filesystem::path& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            throw std::runtime_error("Failed to open capture file " + path.string());
+
+        const std::vector<char> data{std::istreambuf_iterator(file), std::istreambuf_iterator<char>()};
+        CaptureReader reader(data);
+
+        char magic[sizeof(capture_magic)];
+        reader.readBytes(magic, sizeof(magic));
+        if (std::memcmp(magic, capture_magic, sizeof(magic)) != 0)
+            throw std::runtime_error(path.string() + " is not a capture file");
+        if (const uint64_t version = reader.readVarint(); version != capture_version)
+            throw std::runtime_error("Unsupported capture version " + std::to_string(version));
+
+        std::vector<CapturedFrame> frames;
+        // Records made between two frames, e.g. drawables added before run(), belong to the frame that follows
+        CapturedFrame pending;
+        CapturedFrame* frame = &pending;
+
+        while (!reader.atEnd())
+        {
+            const auto tag = static_cast<Tag>(reader.readByte());
+
+            if (tag == Tag::FrameBegin)
+            {
+                if (frame != &pending)
+                    throw std::runtime_error("Malformed capture: frame begins inside another frame");
+
+                frame = &frames.emplace_back();
+                frame->index = reader.readVarint();
+                frame->commands = std::move(pending.commands);
+                pending.commands.clear();
+                continue;
+            }
+
+            switch (tag)
+            {
+            case Tag::FrameEnd:
+                if (frame == &pending)
+                    throw std::runtime_error("Malformed capture: frame ends outside of a frame");
+
+                frame->cpuTimeNs = reader.readVarint();
+                frame->sceneTimeNs = reader.readVarint();
+                frame = &pending;
+                break;
+            case Tag::Resize:
+                {
+                    const auto width = static_cast<int>(zigzag_decode(reader.readVarint()));
+                    const auto height = static_cast<int>(zigzag_decode(reader.readVarint()));
+                    frame->commands.emplace_back(events::event(events::Resize{{width, height}}));
+                    break;
+                }
+            case Tag::VisibilityChange:
+                frame->commands.emplace_back(events::event(events::VisibilityChange{reader.readByte() != 0}));
+                break;
+            case Tag::Close:
+                frame->commands.emplace_back(events::event(events::Close{}));
+                break;
+            case Tag::DrawAdd:
+                {
+                    const renderer::DrawHandle handle = reader.readHandle();
+                    frame->commands.emplace_back(commands::DrawAdd{handle, reader.readVertices()});
+                    break;
+                }
+            case Tag::DrawUpdate:
+                {
+                    const renderer::DrawHandle handle = reader.readHandle();
+                    frame->commands.emplace_back(commands::DrawUpdate{handle, reader.readVertices()});
+                    break;
+                }
+            case Tag::DrawRemove:
+                frame->commands.emplace_back(commands::DrawRemove{reader.readHandle()});
+                break;
+            case Tag::TransformCreate:
+                {
+                    const scene::TransformHandle handle = reader.readTransform();
+                    const scene::TransformHandle parent = reader.readTransform();
+                    const auto position = reader.readFloats<glm::vec3>();
+                    const auto rotation = reader.readFloats<glm::quat>();
+                    const auto scale = reader.readFloats<glm::vec3>();
+                    frame->commands.emplace_back(commands::TransformCreate{handle, parent, position, rotation, scale});
+                    break;
+                }
+            case Tag::TransformSpin:
+                {
+                    const scene::TransformHandle handle = reader.readTransform();
+                    frame->commands.emplace_back(commands::TransformSpin{handle, reader.readFloats<float>()});
+                    break;
+                }
+            case Tag::DrawTransform:
+                {
+                    const renderer::DrawHandle draw = reader.readHandle();
+                    frame->commands.emplace_back(commands::DrawTransform{draw, reader.readTransform()});
+                    break;
+                }
+            case Tag::Upload:
+                {
+                    const uint64_t bytes = reader.readVarint();
+                    frame->commands.emplace_back(commands::Upload{bytes, static_cast<uint32_t>(reader.readVarint())});
+                    break;
+                }
+            case Tag::SwapchainRecreate:
+                {
+                    const auto result = static_cast<int32_t>(zigzag_decode(reader.readVarint()));
+                    const auto width = static_cast<uint32_t>(reader.readVarint());
+                    const auto height = static_cast<uint32_t>(reader.readVarint());
+                    frame->commands.emplace_back(commands::SwapchainRecreate{result, width, height});
+                    break;
+                }
+            default:
+                throw std::runtime_error("Malformed capture: unknown record " +
+                    std::to_string(static_cast<int>(tag)));
+            }
+        }
+
+        // A capture cut short by a crash still replays up to its last complete frame
+        if (frame != &pending)
+            frames.pop_back();
+
+        return frames;
+    }
+} // capture
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <variant>
+#include <vector>
+
+#include "../Events/Event.h"
+#include "../Renderer/DrawList.h"
+#include "../Scene/TransformSystem.h"
+
+namespace capture
+{
+    // Everything that can change the work done by a frame, in the order it happened
+    namespace commands
+    {
+        struct DrawAdd
+        {
+            renderer::DrawHandle handle;
+            std::vector<Vertex> vertices;
+        };
+
+        struct DrawUpdate
+        {
+            renderer::DrawHandle handle;
+            std::vector<Vertex> vertices;
+        };
+
+        struct DrawRemove
+        {
+            renderer::DrawHandle handle;
+        };
+
+        // Parent is invalid for a root
+        struct TransformCreate
+        {
+            scene::TransformHandle handle;
+            scene::TransformHandle parent;
+            glm::vec3 position;
+            glm::quat rotation;
+            glm::vec3 scale;
+        };
+
+        struct TransformSpin
+        {
+            scene::TransformHandle handle;
+            float rate; // Radians per second of scene time
+        };
+
+        // The drawable is drawn with the transform's world matrix
+        struct DrawTransform
+        {
+            renderer::DrawHandle draw;
+            scene::TransformHandle transform;
+        };
+
+        // Bytes copied to the GPU by the frame, kept to compare against the replay
+        struct Upload
+        {
+            uint64_t bytes;
+            uint32_t regions;
+        };
+
+        // The swapchain was rebuilt because acquire or present reported it out of date or suboptimal
+        struct SwapchainRecreate
+        {
+            int32_t result;
+            uint32_t width;
+            uint32_t height;
+        };
+    }
+
+    using command = std::variant<
+        events::event,
+        commands::DrawAdd,
+        commands::DrawUpdate,
+        commands::DrawRemove,
+        commands::TransformCreate,
+        commands::TransformSpin,
+        commands::DrawTransform,
+        commands::Upload,
+        commands::SwapchainRecreate
+    >;
+
+    struct CapturedFrame
+    {
+        uint64_t index = 0;
+        uint64_t cpuTimeNs = 0;
+        uint64_t sceneTimeNs = 0; // What the scene update the frame requested was posed at
+        std::vector<command> commands;
+    };
+
+    // Streams frames to a compact binary file: a tag byte per record, LEB128 integers and raw vertex data.
+    // Records made outside beginFrame()/endFrame() are replayed at the start of the next frame.
+    // Vertices and transforms are stored in memory layout, so captures are only portable between builds with the same
+    // Vertex and glm.
+    class FrameRecorder
+    {
+    public:
+        explicit FrameRecorder(const std::filesystem::path& path);
+
+        void beginFrame(uint64_t index);
+        void endFrame(uint64_t cpu_time_ns, uint64_t scene_time_ns);
+
+        void record(const events::event& event);
+        void recordDrawAdd(renderer::DrawHandle handle, std::span<const Vertex> vertices);
+        void recordDrawUpdate(renderer::DrawHandle handle, std::span<const Vertex> vertices);
+        void recordDrawRemove(renderer::DrawHandle handle);
+        void recordTransformCreate(scene::TransformHandle handle, scene::TransformHandle parent, glm::vec3 position,
+                                   glm::quat rotation, glm::vec3 scale);
+        void recordTransformSpin(scene::TransformHandle handle, float rate);
+        void recordDrawTransform(renderer::DrawHandle draw, scene::TransformHandle transform);
+        void recordUpload(uint64_t bytes, uint32_t regions);
+        void recordSwapchainRecreate(int32_t result, uint32_t width, uint32_t height);
+
+    private:
+        std::ofstream file;
+
+        void writeByte(uint8_t value);
+        void writeVarint(uint64_t value);
+        void writeHandle(renderer::DrawHandle handle);
+        void writeVertices(std::span<const Vertex> vertices);
+        void writeFloats(std::span<const float> values);
+    };
+
+    // Reads a whole capture written by FrameRecorder, throws std::runtime_error if it is malformed
+    std::vector<CapturedFrame> load_capture(const std::filesystem::path& path);
+} // capture
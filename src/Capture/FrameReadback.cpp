@@ -0,0 +1,186 @@
+#include "FrameReadback.h"
+
+#include <cassert>
+#include <utility>
+
+// Host-cached memory makes the consumer's reads fast, coherent memory saves invalidating it. Returns the memory type
+// and whether it is coherent.
+static std::pair<uint32_t, bool> find_readback_memory_type(const vk::PhysicalDeviceMemoryProperties& memory_properties,
+                                                           const uint32_t type_filter)
+{
+    constexpr vk::MemoryPropertyFlags cached =
+        vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCached;
+    for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++)
+    {
+        const vk::MemoryPropertyFlags flags = memory_properties.memoryTypes[i].propertyFlags;
+        if ((type_filter & (1u << i)) && (flags & cached) == cached)
+            return {i, static_cast<bool>(flags & vk::MemoryPropertyFlagBits::eHostCoherent)};
+    }
+
+    return {
+        renderer::find_memory_type(memory_properties, type_filter,
+                                   vk::MemoryPropertyFlagBits::eHostVisible |
+                                   vk::MemoryPropertyFlagBits::eHostCoherent),
+        true
+    };
+}
+
+namespace capture
+{
+    FrameReadback::FrameReadback(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physical_device,
+                                 renderer::MemoryTracker& memory_tracker, const uint32_t frames_in_flight,
+                                 const uint32_t queue_depth, Callback callback,
+                                 const vk::Optional<const vk::AllocationCallbacks> allocator) :
+        device(device), physicalDevice(physical_device), memoryTracker(memory_tracker),
+        callback(std::move(callback)), allocator(allocator), buffers(frames_in_flight + queue_depth),
+        pendingBuffers(frames_in_flight, UINT32_MAX), queue(frames_in_flight + queue_depth)
+    {
+    }
+
+    uint32_t FrameReadback::getTexelSize(const vk::Format format)
+    {
+        switch (format)
+        {
+        case vk::Format::eB8G8R8A8Unorm:
+        case vk::Format::eB8G8R8A8Srgb:
+        case vk::Format::eR8G8B8A8Unorm:
+        case vk::Format::eR8G8B8A8Srgb:
+        case vk::Format::eA2B10G10R10UnormPack32:
+        case vk::Format::eA2R10G10B10UnormPack32:
+            return 4;
+        case vk::Format::eR16G16B16A16Sfloat:
+            return 8;
+        default:
+            return 0;
+        }
+    }
+
+    bool FrameReadback::recordCopy(const vk::raii::CommandBuffer& command_buffer, const uint32_t frame_slot,
+                                   const vk::Image image, const vk::ImageLayout layout, const vk::Extent2D extent,
+                                   const vk::Format format, const uint64_t frame_number)
+    {
+        assert(pendingBuffers[frame_slot] == UINT32_MAX);
+        const uint32_t texel_size = getTexelSize(format);
+        assert(texel_size > 0);
+
+        uint32_t index = UINT32_MAX;
+        {
+            std::lock_guard lock(mutex);
+            const auto count = static_cast<uint32_t>(buffers.size());
+            for (uint32_t i = 0; i < count; i++)
+            {
+                const uint32_t candidate = (nextBuffer + i) % count;
+                if (buffers[candidate].state == State::Free)
+                {
+                    index = candidate;
+                    break;
+                }
+            }
+
+            if (index == UINT32_MAX)
+            {
+                stats.dropped++;
+                return false;
+            }
+            buffers[index].state = State::Copying;
+            nextBuffer = (index + 1) % count;
+            stats.copied++;
+        }
+
+        // Copying keeps the consumer away from it, so it can be reallocated without the lock
+        Buffer& buffer = buffers[index];
+        const uint32_t row_pitch = extent.width * texel_size;
+        const vk::DeviceSize size = static_cast<vk::DeviceSize>(row_pitch) * extent.height;
+        if (buffer.size < size)
+            allocate(buffer, size);
+        buffer.frame = Frame{frame_number, extent, format, row_pitch, {buffer.mapping, size}, index};
+        pendingBuffers[frame_slot] = index;
+
+        const vk::BufferImageCopy region(0, 0, 0, vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, 0, 0, 1),
+                                         {}, vk::Extent3D(extent, 1));
+        command_buffer.copyImageToBuffer(image, layout, buffer.buffer, region);
+
+        // The host reads it once the submit has completed
+        constexpr vk::MemoryBarrier2 host_barrier(vk::PipelineStageFlagBits2::eCopy,
+                                                  vk::AccessFlagBits2::eTransferWrite,
+                                                  vk::PipelineStageFlagBits2::eHost, vk::AccessFlagBits2::eHostRead);
+        command_buffer.pipelineBarrier2(vk::DependencyInfo({}, host_barrier));
+        return true;
+    }
+
+    void FrameReadback::collect(const uint32_t frame_slot)
+    {
+        const uint32_t index = std::exchange(pendingBuffers[frame_slot], UINT32_MAX);
+        if (index == UINT32_MAX)
+            return;
+
+        Buffer& buffer = buffers[index];
+        if (!buffer.coherent)
+            device.invalidateMappedMemoryRanges(vk::MappedMemoryRange(*buffer.memory, 0, vk::WholeSize));
+
+        if (callback)
+        {
+            callback(buffer.frame);
+
+            std::lock_guard lock(mutex);
+            buffer.state = State::Free;
+            stats.delivered++;
+            return;
+        }
+
+        {
+            std::lock_guard lock(mutex);
+            buffer.state = State::Queued;
+            queue[(queueHead + queueCount) % queue.size()] = index;
+            queueCount++;
+        }
+        queueCondition.notify_one();
+    }
+
+    std::optional<FrameReadback::Frame> FrameReadback::acquire(const std::chrono::milliseconds timeout)
+    {
+        std::unique_lock lock(mutex);
+        if (!queueCondition.wait_for(lock, timeout, [this] { return queueCount > 0; }))
+            return std::nullopt;
+
+        const uint32_t index = queue[queueHead];
+        queueHead = (queueHead + 1) % static_cast<uint32_t>(queue.size());
+        queueCount--;
+        buffers[index].state = State::Held;
+        return buffers[index].frame;
+    }
+
+    void FrameReadback::release(const Frame& frame)
+    {
+        std::lock_guard lock(mutex);
+        assert(buffers[frame.buffer].state == State::Held);
+        buffers[frame.buffer].state = State::Free;
+        stats.delivered++;
+    }
+
+    FrameReadback::Stats FrameReadback::getStats() const
+    {
+        std::lock_guard lock(mutex);
+        return stats;
+    }
+
+    void FrameReadback::allocate(Buffer& buffer, const vk::DeviceSize size) const
+    {
+        // Unmapped when the old memory is freed
+        buffer.buffer = nullptr;
+        buffer.memory = nullptr;
+
+        buffer.buffer = vk::raii::Buffer(device, vk::BufferCreateInfo({}, size, vk::BufferUsageFlagBits::eTransferDst),
+                                         allocator);
+        const vk::MemoryRequirements requirements = buffer.buffer.getMemoryRequirements();
+        const auto [memory_type, coherent] = find_readback_memory_type(physicalDevice.getMemoryProperties(),
+                                                                       requirements.memoryTypeBits);
+        buffer.memory = renderer::TrackedDeviceMemory(device, vk::MemoryAllocateInfo(requirements.size, memory_type),
+                                                      memoryTracker, renderer::MemoryCategory::Staging,
+                                                      "frame readback", allocator);
+        buffer.buffer.bindMemory(*buffer.memory, 0);
+        buffer.mapping = static_cast<const std::byte*>(buffer.memory.mapMemory(0, vk::WholeSize));
+        buffer.size = size;
+        buffer.coherent = coherent;
+    }
+} // capture
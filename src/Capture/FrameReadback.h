@@ -0,0 +1,119 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "../Renderer/MemoryTracker.h"
+
+namespace capture
+{
+    // Copies finished frames into a ring of persistently mapped host buffers and hands them to a consumer once their
+    // submit has completed, which the renderer learns when the frame's slot comes around again, so reading back never
+    // waits on the GPU. Host-cached memory is preferred, the consumer reads every byte on the CPU.
+    // With a callback, frames are delivered from collect() and their pixels only stay valid during the call. Without
+    // one they queue up for acquire(), which may be called from any thread, and stay valid until release(). Either
+    // way the consumer reads the mapped buffer itself, nothing is copied on the CPU. While every buffer is in flight,
+    // queued or held, new frames are dropped instead of stalling the renderer.
+    class FrameReadback
+    {
+    public:
+        struct Frame
+        {
+            uint64_t number; // As passed to recordCopy()
+            vk::Extent2D extent;
+            vk::Format format;
+            uint32_t rowPitch; // Rows are tightly packed
+            std::span<const std::byte> pixels;
+            uint32_t buffer; // Identifies the frame to release()
+        };
+
+        struct Stats
+        {
+            uint64_t copied = 0;
+            uint64_t delivered = 0; // Passed to the callback or released
+            uint64_t dropped = 0; // Not copied, no buffer was free
+        };
+
+        using Callback = std::function<void(const Frame& frame)>;
+
+        // queue_depth is how many completed frames may wait for or be held by the consumer, on top of the frames in
+        // flight. Buffers are allocated by the first copy that needs them, and again when the frame size grows.
+        FrameReadback(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physical_device,
+                      renderer::MemoryTracker& memory_tracker, uint32_t frames_in_flight, uint32_t queue_depth,
+                      Callback callback = {}, vk::Optional<const vk::AllocationCallbacks> allocator = nullptr);
+
+        FrameReadback(const FrameReadback&) = delete;
+        FrameReadback& operator=(const FrameReadback&) = delete;
+
+        // Bytes per texel of the formats that can be read back, 0 for the others
+        [[nodiscard]] static uint32_t getTexelSize(vk::Format format);
+
+        // Copies image, which must have been created with eTransferSrc and be in layout with its writes made visible
+        // to copies. Returns false when the frame is dropped. Expects collect() to have run for the slot since its last
+        // copy.
+        bool recordCopy(const vk::raii::CommandBuffer& command_buffer, uint32_t frame_slot, vk::Image image,
+                        vk::ImageLayout layout, vk::Extent2D extent, vk::Format format, uint64_t frame_number);
+
+        // Delivers the slot's copy, only once the GPU has finished its submit
+        void collect(uint32_t frame_slot);
+
+        // The oldest completed frame, waiting up to timeout for one. Only without a callback.
+        [[nodiscard]] std::optional<Frame> acquire(std::chrono::milliseconds timeout);
+
+        // Hands the frame's buffer back for a later copy
+        void release(const Frame& frame);
+
+        [[nodiscard]] Stats getStats() const;
+
+    private:
+        enum class State : uint8_t
+        {
+            Free,
+            Copying,
+            Queued,
+            Held,
+        };
+
+        struct Buffer
+        {
+            vk::raii::Buffer buffer = nullptr;
+            renderer::TrackedDeviceMemory memory = nullptr;
+            const std::byte* mapping = nullptr;
+            vk::DeviceSize size = 0;
+            bool coherent = false; // Otherwise collect() invalidates the mapping before delivering it
+            State state = State::Free;
+            Frame frame{};
+        };
+
+        const vk::raii::Device& device;
+        const vk::raii::PhysicalDevice& physicalDevice;
+        renderer::MemoryTracker& memoryTracker;
+        Callback callback;
+        vk::Optional<const vk::AllocationCallbacks> allocator;
+
+        std::vector<Buffer> buffers;
+        // Buffer each slot's last recordCopy() wrote to, UINT32_MAX when it dropped the frame or was collected
+        std::vector<uint32_t> pendingBuffers;
+        uint32_t nextBuffer = 0; // Where the search for a free buffer starts, so they are used in turn
+
+        mutable std::mutex mutex; // Guards the buffer states, the queue and the stats
+        std::condition_variable queueCondition;
+        // Ring of queued buffers, as long as buffers so pushing never allocates
+        std::vector<uint32_t> queue;
+        uint32_t queueHead = 0;
+        uint32_t queueCount = 0;
+        Stats stats;
+
+        // Replaces the buffer's allocation with one of at least size bytes, the buffer must not be in use
+        void allocate(Buffer& buffer, vk::DeviceSize size) const;
+    };
+} // capture
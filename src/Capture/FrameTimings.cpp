@@ -0,0 +1,157 @@
+#include "FrameTimings.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+// Frames this much slower than the baseline count as regressions
+constexpr double regression_threshold = 1.10;
+constexpr size_t worst_frame_count = 5;
+
+struct TimingSummary
+{
+    double mean = 0.0;
+    double median = 0.0;
+    double p95 = 0.0;
+    double max = 0.0;
+};
+
+static TimingSummary summarize(std::vector<double> values)
+{
+    TimingSummary summary;
+    if (values.empty())
+        return summary;
+
+    std::sort(values.begin(), values.end());
+
+    for (const double value : values)
+    {
+        summary.mean += value;
+    }
+    summary.mean /= static_cast<double>(values.size());
+    summary.median = values[values.size() / 2];
+    summary.p95 = values[std::min(values.size() - 1, values.size() * 95 / 100)];
+    summary.max = values.back();
+
+    return summary;
+}
+
+namespace capture
+{
+    void write_timings(const std::filesystem::path& path, const std::span<const FrameTiming> timings)
+    {
+        std::ofstream file(path);
+        if (!file)
+            throw std::runtime_error("Failed to open " + path.string());
+
+        file << "frame,cpu_ms,captured_cpu_ms,upload_bytes,gpu_ms,tonemap_gpu_ms,triangles,drawn_clusters,"
+            "culled_clusters,render_scale\n";
+        file << std::fixed << std::setprecision(4);
+        for (const auto& timing : timings)
+        {
+            file << timing.frame << "," << timing.cpuMs << "," << timing.capturedCpuMs << "," << timing.uploadBytes
+                << "," << timing.gpuMs << "," << timing.tonemapGpuMs << "," << timing.triangles
+                << "," << timing.drawnClusters << "," << timing.culledClusters << ","
+                << timing.renderScale << "\n";
+        }
+    }
+
+    std::vector<FrameTiming> load_timings(const std::filesystem::path& path)
+    {
+        std::ifstream file(path);
+        if (!file)
+            throw std::runtime_error("Failed to open " + path.string());
+
+        std::vector<FrameTiming> timings;
+        std::string line;
+        std::getline(file, line); // Header
+
+        while (std::getline(file, line))
+        {
+            if (line.empty())
+                continue;
+
+            std::istringstream row(line);
+            FrameTiming timing;
+            char separator;
+            if (!(row >> timing.frame >> separator >> timing.cpuMs >> separator >> timing.capturedCpuMs >> separator
+                >> timing.uploadBytes))
+            {
+                throw std::runtime_error("Malformed timing row in " + path.string() + ": " + line);
+            }
+            // Older files stop after upload_bytes, tonemap_gpu_ms, triangles or culled_clusters, whatever was
+            // measured when they were written
+            if (row >> separator >> timing.gpuMs && row >> separator >> timing.tonemapGpuMs &&
+                row >> separator >> timing.triangles && row >> separator >> timing.drawnClusters &&
+                row >> separator >> timing.culledClusters)
+            {
+                row >> separator >> timing.renderScale;
+            }
+            timings.push_back(timing);
+        }
+
+        return timings;
+    }
+
+    void print_timing_comparison(const std::span<const FrameTiming> baseline, const std::span<const FrameTiming> current,
+                                 std::ostream& output)
+    {
+        const size_t count = std::min(baseline.size(), current.size());
+        if (baseline.size() != current.size())
+        {
+            output << "Warning: baseline has " << baseline.size() << " frames, this run " << current.size()
+                << ", comparing the first " << count << std::endl;
+        }
+
+        std::vector<double> baseline_ms, current_ms, baseline_gpu_ms, current_gpu_ms;
+        std::vector<std::pair<double, size_t>> deltas;
+        size_t regressions = 0;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            baseline_ms.push_back(baseline[i].cpuMs);
+            current_ms.push_back(current[i].cpuMs);
+            deltas.emplace_back(current[i].cpuMs - baseline[i].cpuMs, i);
+
+            if (baseline[i].gpuMs > 0.0 && current[i].gpuMs > 0.0)
+            {
+                baseline_gpu_ms.push_back(baseline[i].gpuMs);
+                current_gpu_ms.push_back(current[i].gpuMs);
+            }
+
+            if (current[i].cpuMs > baseline[i].cpuMs * regression_threshold)
+                regressions++;
+        }
+
+        const TimingSummary before = summarize(baseline_ms);
+        const TimingSummary after = summarize(current_ms);
+
+        output << std::fixed << std::setprecision(3);
+        output << std::setw(10) << "" << std::setw(10) << "mean" << std::setw(10) << "median" << std::setw(10)
+            << "p95" << std::setw(10) << "max" << std::endl;
+        output << std::setw(10) << "baseline" << std::setw(10) << before.mean << std::setw(10) << before.median
+            << std::setw(10) << before.p95 << std::setw(10) << before.max << std::endl;
+        output << std::setw(10) << "current" << std::setw(10) << after.mean << std::setw(10) << after.median
+            << std::setw(10) << after.p95 << std::setw(10) << after.max << std::endl;
+
+        if (!current_gpu_ms.empty())
+        {
+            output << std::setw(10) << "gpu" << std::setw(10) << summarize(baseline_gpu_ms).mean << " -> "
+                << summarize(current_gpu_ms).mean << " ms mean" << std::endl;
+        }
+
+        output << regressions << " of " << count << " frames over "
+            << static_cast<int>((regression_threshold - 1.0) * 100) << "% slower" << std::endl;
+
+        std::sort(deltas.begin(), deltas.end(), std::greater());
+        for (size_t i = 0; i < std::min(worst_frame_count, deltas.size()) && deltas[i].first > 0.0; i++)
+        {
+            const size_t frame = deltas[i].second;
+            output << "  frame " << current[frame].frame << ": " << baseline[frame].cpuMs << " ms -> "
+                << current[frame].cpuMs << " ms" << std::endl;
+        }
+    }
+} // capture
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <span>
+#include <vector>
+
+namespace capture
+{
+    struct FrameTiming
+    {
+        uint64_t frame = 0;
+        double cpuMs = 0.0;
+        // Time the same frame took while it was being captured
+        double capturedCpuMs = 0.0;
+        uint64_t uploadBytes = 0;
+        // GPU time of the whole command buffer and of its tonemap pass, 0 without timestamp support
+        double gpuMs = 0.0;
+        double tonemapGpuMs = 0.0;
+        // Triangles the task shaders selected at the configured LOD error
+        uint64_t triangles = 0;
+        // Clusters the LOD selected that were drawn, and those culled off screen or occluded
+        uint64_t drawnClusters = 0;
+        uint64_t culledClusters = 0;
+        // Render size relative to the output per axis
+        double renderScale = 1.0;
+    };
+
+    // CSV, one frame per row, so runs can also be compared in a spreadsheet
+    void write_timings(const std::filesystem::path& path, std::span<const FrameTiming> timings);
+
+    std::vector<FrameTiming> load_timings(const std::filesystem::path& path);
+
+    // Summary of both runs plus the frames that regressed the most, matched by frame index
+    void print_timing_comparison(std::span<const FrameTiming> baseline, std::span<const FrameTiming> current,
+                                 std::ostream& output);
+} // capture
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <vector>
+
+#include "Vertex.h"
+
+class Drawable
+{
+public:
+    virtual ~Drawable() = default;
+
+    [[nodiscard]] virtual std::vector<Vertex> pack() const = 0;
+};
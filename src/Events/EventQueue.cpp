@@ -0,0 +1,37 @@
+#include "EventQueue.h"
+
+#include <bit>
+
+namespace events
+{
+    EventQueue::EventQueue(const size_t capacity) : slots(std::bit_ceil(capacity < 2 ? 2 : capacity)),
+                                                    mask(slots.size() - 1)
+    {
+    }
+
+    bool EventQueue::push(const event& value)
+    {
+        const size_t tail = producerIndex.load(std::memory_order_relaxed);
+
+        if (tail - consumerIndex.load(std::memory_order_acquire) == slots.size())
+        {
+            if (std::holds_alternative<Close>(value))
+            {
+                closeLatched.store(true, std::memory_order_release);
+                return true;
+            }
+
+            droppedCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        slots[tail & mask] = value;
+        producerIndex.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    uint64_t EventQueue::getDroppedCount() const
+    {
+        return droppedCount.load(std::memory_order_relaxed);
+    }
+} // events
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Event.h"
+
+namespace events
+{
+    // Wait-free single-producer/single-consumer ring of window events.
+    // The window pushes from its message handler, the renderer drains once per frame. A full queue drops the event
+    // and counts it, except Close which is latched so it can never be lost.
+    class EventQueue
+    {
+    public:
+        // Rounded up to a power of two
+        explicit EventQueue(size_t capacity);
+
+        EventQueue(const EventQueue&) = delete;
+        EventQueue& operator=(const EventQueue&) = delete;
+
+        // Producer only, returns false if the event was dropped
+        bool push(const event& value);
+
+        // Consumer only, calls function(event) for everything pushed so far, in order
+        template <class F>
+        void drain(F&& function)
+        {
+            const size_t tail = producerIndex.load(std::memory_order_acquire);
+            size_t head = consumerIndex.load(std::memory_order_relaxed);
+
+            for (; head != tail; head++)
+            {
+                function(slots[head & mask]);
+            }
+            consumerIndex.store(head, std::memory_order_release);
+
+            if (closeLatched.exchange(false, std::memory_order_acquire))
+                function(event(Close{}));
+        }
+
+        // Events dropped because the consumer fell behind
+        [[nodiscard]] uint64_t getDroppedCount() const;
+
+    private:
+        static constexpr size_t cache_line_size = 64;
+
+        std::vector<event> slots;
+        size_t mask;
+
+        // Each index is written by one side only, kept on separate cache lines so they do not bounce between cores
+        alignas(cache_line_size) std::atomic<size_t> producerIndex = 0;
+        alignas(cache_line_size) std::atomic<size_t> consumerIndex = 0;
+
+        alignas(cache_line_size) std::atomic<bool> closeLatched = false;
+        std::atomic<uint64_t> droppedCount = 0;
+    };
+} // events
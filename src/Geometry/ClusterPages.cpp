@@ -0,0 +1,213 @@
+#include "ClusterPages.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+constexpr char cluster_page_magic[8] = {'V', 'K', 'T', 'P', 'A', 'G', 'E', '\0'};
+constexpr uint32_t cluster_page_version = 1;
+
+// Tables and pages are written as they are in memory, little endian like every platform this runs on
+struct ClusterPageHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t pageVertices;
+    uint32_t meshCount;
+    uint32_t clusterCount;
+    uint32_t pageCount;
+    uint32_t reserved;
+    uint64_t tableOffset;
+};
+
+// Pages start here, right after the header
+constexpr uint64_t page_data_offset = 64;
+static_assert(sizeof(ClusterPageHeader) <= page_data_offset);
+
+static void read_exactly(std::ifstream& file, const std::filesystem::path& path, const uint64_t offset, void* data,
+                         const size_t size)
+{
+    file.seekg(static_cast<std::streamoff>(offset));
+    file.read(static_cast<char*>(data), static_cast<std::streamsize>(size));
+    if (!file)
+        throw std::runtime_error("Truncated cluster page file " + path.string());
+}
+
+namespace geometry
+{
+    ClusterPageWriter::ClusterPageWriter(const std::filesystem::path& path) :
+        path(path), file(path, std::ios::binary | std::ios::trunc)
+    {
+        if (!file)
+            throw std::runtime_error("Failed to open cluster page file " + path.string());
+
+        // Rewritten by finish(), a file that was never finished has no tables
+        const ClusterPageHeader header{};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        page.reserve(cluster_page_vertices);
+    }
+
+    void ClusterPageWriter::add(const renderer::ClusterLod& lod)
+    {
+        if (finished)
+            throw std::logic_error("Cluster page file " + path.string() + " is already finished");
+
+        ClusterPageFile::Mesh mesh{
+            static_cast<uint32_t>(tables.clusters.size()), static_cast<uint32_t>(lod.clusters.size()),
+            tables.pageCount, 0, lod.boundsMin, lod.boundsMax
+        };
+
+        // The coarsest cut is what the largest error selects. Simplifying can end with nothing left, so the clusters
+        // at the top are replaced too, by nothing at a larger error.
+        float largest_error = 0.0f;
+        for (const auto& cluster : lod.clusters)
+        {
+            largest_error = std::max(largest_error, cluster.error);
+        }
+        const auto is_coarsest = [largest_error](const renderer::Cluster& cluster)
+        {
+            return cluster.parentError > largest_error;
+        };
+
+        // The coarsest cut first, those pages stay resident
+        std::vector<uint32_t> order(lod.clusters.size());
+        for (uint32_t i = 0; i < order.size(); i++)
+        {
+            order[i] = i;
+        }
+        std::ranges::stable_partition(order, [&](const uint32_t index) { return is_coarsest(lod.clusters[index]); });
+
+        for (const uint32_t index : order)
+        {
+            renderer::Cluster cluster = lod.clusters[index];
+            const bool coarsest = is_coarsest(cluster);
+
+            // The coarsest cut gets pages of its own, they are the only ones that never leave
+            const uint32_t vertex_count = cluster.triangleCount * 3;
+            if (page.size() + vertex_count > cluster_page_vertices || (pagePinned && !coarsest))
+                flushPage();
+            pagePinned |= coarsest;
+
+            const auto first = lod.vertices.begin() + cluster.firstVertex;
+            cluster.firstVertex = tables.pageCount * cluster_page_vertices + static_cast<uint32_t>(page.size());
+            page.insert(page.end(), first, first + vertex_count);
+            tables.clusters.push_back(cluster);
+        }
+        // Pages are not shared between meshes
+        if (!page.empty())
+            flushPage();
+
+        // Clusters keep the hierarchy's order, which is what the renderer indexes them by
+        std::vector<renderer::Cluster> ordered(order.size());
+        for (uint32_t i = 0; i < order.size(); i++)
+        {
+            ordered[order[i]] = tables.clusters[mesh.firstCluster + i];
+        }
+        std::ranges::copy(ordered, tables.clusters.begin() + mesh.firstCluster);
+
+        mesh.pageCount = tables.pageCount - mesh.firstPage;
+        tables.meshes.push_back(mesh);
+    }
+
+    void ClusterPageWriter::finish()
+    {
+        if (finished)
+            return;
+        finished = true;
+
+        const uint64_t table_offset = page_data_offset + static_cast<uint64_t>(tables.pageCount) * cluster_page_bytes;
+        file.seekp(static_cast<std::streamoff>(table_offset));
+        file.write(reinterpret_cast<const char*>(tables.meshes.data()),
+                   static_cast<std::streamsize>(sizeof(ClusterPageFile::Mesh) * tables.meshes.size()));
+        file.write(reinterpret_cast<const char*>(tables.clusters.data()),
+                   static_cast<std::streamsize>(sizeof(renderer::Cluster) * tables.clusters.size()));
+        file.write(reinterpret_cast<const char*>(tables.pinned.data()),
+                   static_cast<std::streamsize>(tables.pinned.size()));
+
+        ClusterPageHeader header{};
+        std::memcpy(header.magic, cluster_page_magic, sizeof(header.magic));
+        header.version = cluster_page_version;
+        header.pageVertices = cluster_page_vertices;
+        header.meshCount = static_cast<uint32_t>(tables.meshes.size());
+        header.clusterCount = static_cast<uint32_t>(tables.clusters.size());
+        header.pageCount = tables.pageCount;
+        header.tableOffset = table_offset;
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        file.close();
+        if (!file)
+            throw std::runtime_error("Failed to write cluster page file " + path.string());
+    }
+
+    uint32_t ClusterPageWriter::getPageCount() const
+    {
+        return tables.pageCount;
+    }
+
+    void ClusterPageWriter::flushPage()
+    {
+        // Padded to the full page, so every page is at a fixed offset
+        page.resize(cluster_page_vertices, Vertex{});
+        file.seekp(static_cast<std::streamoff>(page_data_offset + tables.pageCount * cluster_page_bytes));
+        file.write(reinterpret_cast<const char*>(page.data()), static_cast<std::streamsize>(cluster_page_bytes));
+
+        tables.pinned.push_back(pagePinned ? 1 : 0);
+        tables.pageCount++;
+        page.clear();
+        pagePinned = false;
+    }
+
+    ClusterPageFile read_cluster_page_file(const std::filesystem::path& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            throw std::runtime_error("Failed to open cluster page file " + path.string());
+
+        ClusterPageHeader header;
+        read_exactly(file, path, 0, &header, sizeof(header));
+        if (std::memcmp(header.magic, cluster_page_magic, sizeof(header.magic)) != 0)
+            throw std::runtime_error(path.string() + " is not a finished cluster page file");
+        if (header.version != cluster_page_version || header.pageVertices != cluster_page_vertices)
+            throw std::runtime_error("Unsupported cluster page file version in " + path.string());
+
+        ClusterPageFile pages;
+        pages.pageCount = header.pageCount;
+        pages.meshes.resize(header.meshCount);
+        pages.clusters.resize(header.clusterCount);
+        pages.pinned.resize(header.pageCount);
+
+        uint64_t offset = header.tableOffset;
+        read_exactly(file, path, offset, pages.meshes.data(), sizeof(ClusterPageFile::Mesh) * pages.meshes.size());
+        offset += sizeof(ClusterPageFile::Mesh) * pages.meshes.size();
+        read_exactly(file, path, offset, pages.clusters.data(), sizeof(renderer::Cluster) * pages.clusters.size());
+        offset += sizeof(renderer::Cluster) * pages.clusters.size();
+        read_exactly(file, path, offset, pages.pinned.data(), pages.pinned.size());
+
+        for (const auto& mesh : pages.meshes)
+        {
+            if (static_cast<uint64_t>(mesh.firstCluster) + mesh.clusterCount > pages.clusters.size() ||
+                static_cast<uint64_t>(mesh.firstPage) + mesh.pageCount > pages.pageCount)
+                throw std::runtime_error("Malformed cluster page file " + path.string());
+        }
+        for (const auto& cluster : pages.clusters)
+        {
+            const uint32_t offset_in_page = cluster.firstVertex % cluster_page_vertices;
+            if (cluster.firstVertex / cluster_page_vertices >= pages.pageCount ||
+                offset_in_page + cluster.triangleCount * 3 > cluster_page_vertices ||
+                cluster.triangleCount > renderer::cluster_triangle_limit)
+                throw std::runtime_error("Malformed cluster page file " + path.string());
+        }
+
+        return pages;
+    }
+
+    void read_cluster_page(std::ifstream& file, const std::filesystem::path& path, const uint32_t page,
+                           const std::span<Vertex> vertices)
+    {
+        if (vertices.size() < cluster_page_vertices)
+            throw std::invalid_argument("A cluster page needs room for cluster_page_vertices vertices");
+
+        read_exactly(file, path, page_data_offset + page * cluster_page_bytes, vertices.data(), cluster_page_bytes);
+    }
+} // geometry
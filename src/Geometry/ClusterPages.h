@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <vector>
+
+#include "../Vertex.h"
+#include "../Renderer/ClusterLod.h"
+
+namespace geometry
+{
+    // Matches pageVertices in triangle.slang. A page holds whole clusters, at least 32 of the largest.
+    constexpr uint32_t cluster_page_vertices = 3072;
+    constexpr uint64_t cluster_page_bytes = sizeof(Vertex) * cluster_page_vertices;
+
+    // Cluster hierarchies of a world whose vertices are split into fixed-size pages, read on demand.
+    // Everything needed to select clusters stays in memory, it is a few percent of the vertices. Every
+    // Cluster::firstVertex is page * cluster_page_vertices plus the cluster's offset in its page. Pages never hold
+    // clusters of two meshes, and the clusters of each mesh's coarsest cut, the one its largest error selects, come
+    // first in pages of their own, so only a few pages are needed to draw every mesh at all.
+    struct ClusterPageFile
+    {
+        struct Mesh
+        {
+            uint32_t firstCluster;
+            uint32_t clusterCount;
+            uint32_t firstPage;
+            uint32_t pageCount;
+            glm::vec2 boundsMin;
+            glm::vec2 boundsMax;
+        };
+
+        std::vector<Mesh> meshes;
+        std::vector<renderer::Cluster> clusters;
+        // Per page, whether it holds clusters of a coarsest cut
+        std::vector<uint8_t> pinned;
+        uint32_t pageCount = 0;
+    };
+
+    // Writes pages as meshes are added, the tables follow them once the world is finished
+    class ClusterPageWriter
+    {
+    public:
+        explicit ClusterPageWriter(const std::filesystem::path& path);
+
+        ClusterPageWriter(const ClusterPageWriter&) = delete;
+        ClusterPageWriter& operator=(const ClusterPageWriter&) = delete;
+
+        void add(const renderer::ClusterLod& lod);
+
+        // The file cannot be read before
+        void finish();
+
+        [[nodiscard]] uint32_t getPageCount() const;
+
+    private:
+        std::filesystem::path path;
+        std::ofstream file;
+        ClusterPageFile tables;
+        std::vector<Vertex> page; // Being filled, written once the next cluster does not fit
+        bool pagePinned = false;
+        bool finished = false;
+
+        void flushPage();
+    };
+
+    // Throws std::runtime_error unless path is a complete cluster page file
+    [[nodiscard]] ClusterPageFile read_cluster_page_file(const std::filesystem::path& path);
+
+    // Reads cluster_page_vertices vertices, file being an open stream of path
+    void read_cluster_page(std::ifstream& file, const std::filesystem::path& path, uint32_t page,
+                           std::span<Vertex> vertices);
+} // geometry
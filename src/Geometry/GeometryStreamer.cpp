@@ -0,0 +1,557 @@
+#include "GeometryStreamer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+
+#include "../Trace/Trace.h"
+
+// Per frame in flight, bounds the pages copied in one frame
+constexpr vk::DeviceSize geometry_staging_size = 4 << 20;
+// Reads in flight at once, enough to keep the disk busy without committing to pages newer feedback no longer wants
+constexpr uint32_t max_loading_pages = 64;
+// Frames a page has to go undrawn before its slot may be given up, well past the frames feedback takes to arrive
+constexpr uint64_t eviction_age_frames = 16;
+// Page table entries this close together are written in one go
+constexpr size_t table_merge_gap = 64;
+
+namespace geometry
+{
+    GeometryStreamer::GeometryStreamer(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physical_device,
+                                       renderer::MemoryTracker& memory_tracker,
+                                       renderer::TimelineScheduler& graphics_timeline,
+                                       renderer::TimelineScheduler& transfer_timeline,
+                                       const std::span<const uint32_t> queue_families,
+                                       const uint32_t frames_in_flight, const std::filesystem::path& path,
+                                       const vk::DeviceSize budget,
+                                       const vk::Optional<const vk::AllocationCallbacks> allocator) :
+        device(device), physicalDevice(physical_device), memoryTracker(memory_tracker),
+        graphicsTimeline(graphics_timeline), transferTimeline(transfer_timeline),
+        queueFamilies(queue_families.begin(), queue_families.end()), framesInFlight(frames_in_flight), path(path),
+        allocator(allocator), file(read_cluster_page_file(path))
+    {
+        std::ranges::sort(queueFamilies);
+        queueFamilies.erase(std::unique(queueFamilies.begin(), queueFamilies.end()), queueFamilies.end());
+
+        pages.resize(file.pageCount);
+        for (uint32_t mesh = 0; mesh < file.meshes.size(); mesh++)
+        {
+            const ClusterPageFile::Mesh& info = file.meshes[mesh];
+            for (uint32_t page = info.firstPage; page < info.firstPage + info.pageCount; page++)
+            {
+                pages[page].mesh = mesh;
+            }
+        }
+        uint32_t pinned_pages = 0;
+        for (uint32_t page = 0; page < file.pageCount; page++)
+        {
+            pages[page].pinned = file.pinned[page] != 0;
+            pinned_pages += pages[page].pinned ? 1 : 0;
+        }
+
+        poolPages = static_cast<uint32_t>(std::min<vk::DeviceSize>(budget / cluster_page_bytes, file.pageCount));
+        if (poolPages < pinned_pages)
+            throw std::runtime_error("A geometry budget of " + std::to_string(budget >> 20) + " MiB cannot hold the " +
+                                     std::to_string(pinned_pages) + " pages every mesh of " + path.string() +
+                                     " needs to be drawn at all");
+        poolPages = std::max(poolPages, 1u);
+
+        stats.meshes = static_cast<uint32_t>(file.meshes.size());
+        stats.pages = file.pageCount;
+        stats.poolPages = poolPages;
+        stats.pinnedPages = pinned_pages;
+
+        // Every cut of a mesh starts at one of its cluster errors
+        uint32_t largest_count = 0;
+        meshCuts.resize(file.meshes.size());
+        for (uint32_t mesh = 0; mesh < file.meshes.size(); mesh++)
+        {
+            const ClusterPageFile::Mesh& info = file.meshes[mesh];
+            MeshCuts& cuts = meshCuts[mesh];
+            cuts.firstThreshold = static_cast<uint32_t>(thresholds.size());
+            for (uint32_t i = info.firstCluster; i < info.firstCluster + info.clusterCount; i++)
+            {
+                thresholds.push_back(file.clusters[i].error);
+            }
+            const auto first = thresholds.begin() + cuts.firstThreshold;
+            std::sort(first, thresholds.end());
+            thresholds.erase(std::unique(first, thresholds.end()), thresholds.end());
+            cuts.thresholdCount = static_cast<uint32_t>(thresholds.size()) - cuts.firstThreshold;
+            cuts.dirty = true;
+            largest_count = std::max(largest_count, cuts.thresholdCount);
+        }
+        cutResident.resize(thresholds.size());
+        cutChanges.reserve(largest_count + 1);
+        for (uint32_t mesh = 0; mesh < meshCuts.size(); mesh++)
+        {
+            updateCuts(mesh);
+        }
+
+        pageTable.assign(file.pageCount, no_page_slot);
+        tableRanges.resize(frames_in_flight);
+        for (uint32_t slot = poolPages; slot > 0; slot--)
+        {
+            freeSlots.push_back(slot - 1);
+        }
+        requestOrder.reserve(file.pageCount);
+        evictionOrder.reserve(file.pageCount);
+        pageCopies.reserve(geometry_staging_size / cluster_page_bytes);
+
+        const uint32_t table_pages = std::max(file.pageCount, 1u);
+        const auto cluster_count = std::max<vk::DeviceSize>(file.clusters.size(), 1);
+        std::tie(pagePool, pagePoolMemory) = createBuffer(
+            poolPages * cluster_page_bytes,
+            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+            vk::MemoryPropertyFlagBits::eDeviceLocal, renderer::MemoryCategory::Geometry, "geometry page pool", true);
+        std::tie(clusterBuffer, clusterMemory) = createBuffer(
+            sizeof(renderer::Cluster) * cluster_count,
+            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eTransferDst,
+            vk::MemoryPropertyFlagBits::eDeviceLocal, renderer::MemoryCategory::Geometry, "streamed clusters", true);
+        // Starts out undefined, like the resident meshes' visibility, the first early pass draws whatever it says
+        std::tie(visibilityBuffer, visibilityMemory) = createBuffer(
+            sizeof(uint32_t) * cluster_count, vk::BufferUsageFlagBits::eStorageBuffer,
+            vk::MemoryPropertyFlagBits::eDeviceLocal, renderer::MemoryCategory::Geometry,
+            "streamed cluster visibility", false);
+
+        const vk::MemoryPropertyFlags host_visible =
+            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent;
+        const vk::DeviceSize table_size = sizeof(uint32_t) * table_pages * frames_in_flight;
+        std::tie(pageTableBuffer, pageTableMemory) = createBuffer(
+            table_size, vk::BufferUsageFlagBits::eStorageBuffer, host_visible, renderer::MemoryCategory::Geometry,
+            "geometry page table", false);
+        pageTableMapping = static_cast<uint32_t*>(pageTableMemory.mapMemory(0, table_size));
+        std::fill_n(pageTableMapping, table_pages * frames_in_flight, no_page_slot);
+
+        const vk::DeviceSize feedback_size = table_size * 2;
+        std::tie(feedbackBuffer, feedbackMemory) = createBuffer(
+            feedback_size, vk::BufferUsageFlagBits::eStorageBuffer, host_visible, renderer::MemoryCategory::Geometry,
+            "geometry feedback", false);
+        feedback = static_cast<uint32_t*>(feedbackMemory.mapMemory(0, feedback_size));
+        std::memset(feedback, 0, feedback_size);
+
+        for (uint32_t i = 0; i < frames_in_flight; i++)
+        {
+            auto [buffer, memory] = createBuffer(geometry_staging_size, vk::BufferUsageFlagBits::eTransferSrc,
+                                                 host_visible, renderer::MemoryCategory::Staging, "geometry staging",
+                                                 false);
+            stagingMappings.push_back(memory.mapMemory(0, geometry_staging_size));
+            stagingBuffers.push_back(std::move(buffer));
+            stagingMemories.push_back(std::move(memory));
+        }
+
+        // Nothing can be drawn before the coarsest cuts are in
+        for (uint32_t page = 0; page < file.pageCount; page++)
+        {
+            if (pages[page].pinned)
+                queueRead(page);
+        }
+
+        reader = std::thread([this]
+        {
+            trace::set_thread_name("geometry reader");
+            readLoop();
+        });
+    }
+
+    GeometryStreamer::~GeometryStreamer()
+    {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        readCondition.notify_all();
+        reader.join();
+    }
+
+    void GeometryStreamer::readFeedback(const uint32_t frame_slot)
+    {
+        TRACE_SCOPE("readGeometryFeedback");
+
+        frame++;
+        stats.frames++;
+
+        uint32_t* slot_feedback = feedback + static_cast<size_t>(frame_slot) * std::max(file.pageCount, 1u) * 2;
+        uint32_t idle_pages = 0;
+        requestOrder.clear();
+        for (uint32_t index = 0; index < file.pageCount; index++)
+        {
+            Page& page = pages[index];
+            const uint32_t used = slot_feedback[index * 2];
+            const uint32_t wanted = slot_feedback[index * 2 + 1];
+            if (page.slot != no_page_slot)
+            {
+                if (used != 0 || wanted != 0)
+                    page.lastUsedFrame = frame;
+                else if (!page.pinned && frame - page.lastUsedFrame > eviction_age_frames)
+                    idle_pages++;
+            }
+            else if (wanted != 0)
+            {
+                stats.missingPages++;
+                if (!page.loading && !page.failed)
+                {
+                    page.wanted = wanted;
+                    requestOrder.push_back(index);
+                }
+            }
+        }
+        std::memset(slot_feedback, 0, sizeof(uint32_t) * file.pageCount * 2);
+
+        // Reads past what free and idle slots can take would only wait for room, by then newer feedback may want
+        // other pages
+        const size_t room = std::min<size_t>(freeSlots.size() + retiringSlots.size() + idle_pages, max_loading_pages);
+        if (loadingCount >= room || requestOrder.empty())
+            return;
+
+        const size_t count = std::min(requestOrder.size(), room - loadingCount);
+        std::partial_sort(requestOrder.begin(), requestOrder.begin() + static_cast<ptrdiff_t>(count),
+                          requestOrder.end(), [this](const uint32_t a, const uint32_t b)
+                          {
+                              return pages[a].wanted != pages[b].wanted ? pages[a].wanted > pages[b].wanted : a < b;
+                          });
+        for (size_t i = 0; i < count; i++)
+        {
+            queueRead(requestOrder[i]);
+        }
+    }
+
+    bool GeometryStreamer::recordUploads(const vk::raii::CommandBuffer& command_buffer, const uint32_t frame_slot)
+    {
+        TRACE_SCOPE("recordGeometryUploads");
+
+        // Last frame's submit has been made by now, so retiring covers it
+        for (auto& staging : oversizedStaging)
+        {
+            transferTimeline.retire(std::move(staging));
+        }
+        oversizedStaging.clear();
+
+        bool recorded = false;
+        if (!clustersUploaded)
+        {
+            const vk::DeviceSize size = sizeof(renderer::Cluster) * file.clusters.size();
+            if (size > 0)
+            {
+                auto staging = createBuffer(size, vk::BufferUsageFlagBits::eTransferSrc,
+                                            vk::MemoryPropertyFlagBits::eHostVisible |
+                                            vk::MemoryPropertyFlagBits::eHostCoherent,
+                                            renderer::MemoryCategory::Staging, "geometry staging (clusters)", false);
+                void* mapping = staging.second.mapMemory(0, size);
+                std::memcpy(mapping, file.clusters.data(), size);
+                staging.second.unmapMemory();
+                command_buffer.copyBuffer(*staging.first, *clusterBuffer, vk::BufferCopy(0, 0, size));
+                oversizedStaging.push_back(std::move(staging));
+                recorded = true;
+            }
+            clustersUploaded = true;
+        }
+
+        const uint64_t completed = graphicsTimeline.getCompletedValue();
+        while (!retiringSlots.empty() && retiringSlots.front().graphicsValue <= completed)
+        {
+            freeSlots.push_back(retiringSlots.front().slot);
+            retiringSlots.pop_front();
+        }
+
+        // Pages that were read and have no slot to go to make idle ones give theirs up
+        size_t ready;
+        {
+            std::lock_guard lock(mutex);
+            ready = results.size();
+        }
+        if (ready > freeSlots.size() + retiringSlots.size())
+            evict(static_cast<uint32_t>(ready - freeSlots.size() - retiringSlots.size()));
+
+        pageCopies.clear();
+        vk::DeviceSize staging_offset = 0;
+        std::unique_lock lock(mutex);
+        while (!results.empty() && staging_offset + cluster_page_bytes <= geometry_staging_size)
+        {
+            ReadResult result = std::move(results.front());
+            results.pop_front();
+            Page& page = pages[result.page];
+            if (result.failed)
+            {
+                page.loading = false;
+                page.failed = true;
+                loadingCount--;
+                continue;
+            }
+            if (freeSlots.empty())
+            {
+                // Waits for a slot the GPU is still reading from
+                results.push_front(std::move(result));
+                break;
+            }
+            lock.unlock();
+
+            const uint32_t slot = freeSlots.back();
+            freeSlots.pop_back();
+            std::memcpy(static_cast<std::byte*>(stagingMappings[frame_slot]) + staging_offset, result.vertices.data(),
+                        cluster_page_bytes);
+            pageCopies.emplace_back(staging_offset, slot * cluster_page_bytes, cluster_page_bytes);
+            staging_offset += cluster_page_bytes;
+
+            setSlot(result.page, slot);
+            page.loading = false;
+            page.lastUsedFrame = frame;
+            loadingCount--;
+            stats.streamedPages++;
+
+            lock.lock();
+        }
+        lock.unlock();
+
+        if (!pageCopies.empty())
+        {
+            command_buffer.copyBuffer(*stagingBuffers[frame_slot], *pagePool, pageCopies);
+            recorded = true;
+        }
+
+        // The frame that used this table last has completed, and the copies it points at are waited for by the frame
+        // about to be recorded
+        renderer::DirtyRanges& ranges = tableRanges[frame_slot];
+        if (!ranges.empty())
+        {
+            ranges.coalesce(table_merge_gap);
+            takenRanges.clear();
+            ranges.take(std::numeric_limits<size_t>::max(), takenRanges);
+            auto* table = reinterpret_cast<std::byte*>(pageTableMapping + static_cast<size_t>(frame_slot) *
+                                                       std::max(file.pageCount, 1u));
+            for (const auto& range : takenRanges)
+            {
+                std::memcpy(table + range.offset, reinterpret_cast<const std::byte*>(pageTable.data()) + range.offset,
+                            range.size);
+            }
+        }
+
+        for (uint32_t mesh = 0; mesh < meshCuts.size(); mesh++)
+        {
+            if (meshCuts[mesh].dirty)
+                updateCuts(mesh);
+        }
+
+        return recorded;
+    }
+
+    float GeometryStreamer::getDrawThreshold(const uint32_t mesh, const float wanted_error) const
+    {
+        const MeshCuts& cuts = meshCuts[mesh];
+        const auto first = thresholds.begin() + cuts.firstThreshold;
+        const auto last = first + cuts.thresholdCount;
+
+        // The cut wanted_error selects is the one of the largest error not above it, below every error it is empty
+        const auto above = std::upper_bound(first, last, wanted_error);
+        if (above == first)
+            return wanted_error;
+
+        auto threshold = static_cast<uint32_t>(above - thresholds.begin()) - 1;
+        if (cutResident[threshold])
+            return wanted_error;
+        for (threshold++; threshold < cuts.firstThreshold + cuts.thresholdCount; threshold++)
+        {
+            if (cutResident[threshold])
+                return thresholds[threshold];
+        }
+        return std::numeric_limits<float>::infinity();
+    }
+
+    std::span<const ClusterPageFile::Mesh> GeometryStreamer::getMeshes() const
+    {
+        return file.meshes;
+    }
+
+    uint32_t GeometryStreamer::getPageCount() const
+    {
+        return file.pageCount;
+    }
+
+    vk::Buffer GeometryStreamer::getPagePool() const
+    {
+        return *pagePool;
+    }
+
+    vk::Buffer GeometryStreamer::getClusterBuffer() const
+    {
+        return *clusterBuffer;
+    }
+
+    vk::Buffer GeometryStreamer::getVisibilityBuffer() const
+    {
+        return *visibilityBuffer;
+    }
+
+    vk::Buffer GeometryStreamer::getPageTable() const
+    {
+        return *pageTableBuffer;
+    }
+
+    vk::Buffer GeometryStreamer::getFeedbackBuffer() const
+    {
+        return *feedbackBuffer;
+    }
+
+    bool GeometryStreamer::isStreaming() const
+    {
+        return loadingCount > 0;
+    }
+
+    GeometryStreamer::Stats GeometryStreamer::getStats() const
+    {
+        return stats;
+    }
+
+    std::pair<vk::raii::Buffer, renderer::TrackedDeviceMemory> GeometryStreamer::createBuffer(
+        const vk::DeviceSize size, const vk::BufferUsageFlags usage, const vk::MemoryPropertyFlags properties,
+        const renderer::MemoryCategory category, const std::string_view owner, const bool shared) const
+    {
+        vk::BufferCreateInfo buffer_info({}, size, usage);
+        // Read by graphics, written by the transfer queue, concurrent sharing spares the ownership transfers
+        if (shared && queueFamilies.size() > 1)
+        {
+            buffer_info.sharingMode = vk::SharingMode::eConcurrent;
+            buffer_info.setQueueFamilyIndices(queueFamilies);
+        }
+        vk::raii::Buffer buffer(device, buffer_info, allocator);
+
+        const vk::MemoryRequirements requirements = buffer.getMemoryRequirements();
+        const vk::MemoryAllocateInfo allocate_info(
+            requirements.size, renderer::find_memory_type(physicalDevice.getMemoryProperties(),
+                                                          requirements.memoryTypeBits, properties));
+        renderer::TrackedDeviceMemory memory(device, allocate_info, memoryTracker, category, owner, allocator);
+        buffer.bindMemory(*memory, 0);
+        return {std::move(buffer), std::move(memory)};
+    }
+
+    void GeometryStreamer::queueRead(const uint32_t page)
+    {
+        pages[page].loading = true;
+        loadingCount++;
+
+        {
+            std::lock_guard lock(mutex);
+            requests.push_back(page);
+        }
+        readCondition.notify_one();
+    }
+
+    void GeometryStreamer::setSlot(const uint32_t page, const uint32_t slot)
+    {
+        if (pages[page].slot == no_page_slot)
+            stats.residentPages++;
+        if (slot == no_page_slot)
+            stats.residentPages--;
+
+        pages[page].slot = slot;
+        pageTable[page] = slot;
+        for (auto& ranges : tableRanges)
+        {
+            ranges.add(sizeof(uint32_t) * page, sizeof(uint32_t));
+        }
+        meshCuts[pages[page].mesh].dirty = true;
+    }
+
+    void GeometryStreamer::evict(const uint32_t count)
+    {
+        evictionOrder.clear();
+        for (uint32_t index = 0; index < file.pageCount; index++)
+        {
+            const Page& page = pages[index];
+            if (page.slot != no_page_slot && !page.pinned && frame - page.lastUsedFrame > eviction_age_frames)
+                evictionOrder.push_back(index);
+        }
+
+        // Least recently used first, ties in page order so the same pages give way every time
+        const size_t evicted = std::min<size_t>(count, evictionOrder.size());
+        std::partial_sort(evictionOrder.begin(), evictionOrder.begin() + static_cast<ptrdiff_t>(evicted),
+                          evictionOrder.end(), [this](const uint32_t a, const uint32_t b)
+                          {
+                              return pages[a].lastUsedFrame != pages[b].lastUsedFrame
+                                         ? pages[a].lastUsedFrame < pages[b].lastUsedFrame
+                                         : a < b;
+                          });
+
+        // Frames already submitted may still read the slot, the ones recorded from now on see it missing
+        const uint64_t submitted = graphicsTimeline.getSubmittedValue();
+        for (size_t i = 0; i < evicted; i++)
+        {
+            const uint32_t page = evictionOrder[i];
+            retiringSlots.push_back({submitted, pages[page].slot});
+            setSlot(page, no_page_slot);
+            stats.evictedPages++;
+        }
+    }
+
+    void GeometryStreamer::updateCuts(const uint32_t mesh)
+    {
+        MeshCuts& cuts = meshCuts[mesh];
+        cuts.dirty = false;
+
+        const auto first = thresholds.begin() + cuts.firstThreshold;
+        const auto last = first + cuts.thresholdCount;
+
+        // A cluster is in every cut from its own error up to its parent's, a missing one breaks all of them
+        cutChanges.assign(cuts.thresholdCount + 1, 0);
+        const ClusterPageFile::Mesh& info = file.meshes[mesh];
+        for (uint32_t i = info.firstCluster; i < info.firstCluster + info.clusterCount; i++)
+        {
+            const renderer::Cluster& cluster = file.clusters[i];
+            if (pages[cluster.firstVertex / cluster_page_vertices].slot != no_page_slot)
+                continue;
+
+            const auto lowest = std::lower_bound(first, last, cluster.error) - first;
+            const auto highest = std::lower_bound(first, last, cluster.parentError) - first;
+            if (lowest < highest)
+            {
+                cutChanges[lowest]++;
+                cutChanges[highest]--;
+            }
+        }
+
+        int32_t missing = 0;
+        for (uint32_t i = 0; i < cuts.thresholdCount; i++)
+        {
+            missing += cutChanges[i];
+            cutResident[cuts.firstThreshold + i] = missing == 0 ? 1 : 0;
+        }
+    }
+
+    void GeometryStreamer::readLoop()
+    {
+        std::ifstream stream(path, std::ios::binary);
+        while (true)
+        {
+            uint32_t page;
+            {
+                std::unique_lock lock(mutex);
+                readCondition.wait(lock, [this] { return stopping || !requests.empty(); });
+                if (stopping)
+                    return;
+
+                page = requests.front();
+                requests.pop_front();
+            }
+
+            ReadResult result{page, false, {}};
+            try
+            {
+                TRACE_SCOPE("read geometry page");
+                result.vertices.resize(cluster_page_vertices);
+                read_cluster_page(stream, path, page, result.vertices);
+            }
+            catch (const std::runtime_error& error)
+            {
+                std::cerr << error.what() << std::endl;
+                result.failed = true;
+                stream.clear();
+            }
+
+            std::lock_guard lock(mutex);
+            results.push_back(std::move(result));
+        }
+    }
+} // geometry
@@ -0,0 +1,208 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory_resource>
+#include <mutex>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "ClusterPages.h"
+#include "../Renderer/DirtyRanges.h"
+#include "../Renderer/MemoryTracker.h"
+#include "../Renderer/TimelineScheduler.h"
+
+namespace geometry
+{
+    // Matches noSlot in triangle.slang, the page table entry of a page that is not resident
+    constexpr uint32_t no_page_slot = UINT32_MAX;
+
+    // Draws a world from a cluster page file with a fixed pool of resident pages, however large the world is.
+    // Every frame the task shader reports, per page, whether it drew from it and how many triangles it wanted from it
+    // while it was missing. Missing pages are read on a background thread, most wanted first, and copied into free pool
+    // slots on the transfer queue. Pages nothing drew from for a while give their slots up, least recently used first.
+    // Each mesh draws the cut its wanted error selects once all of that cut's pages are resident, the next coarser
+    // resident one until then. Coarsest cuts never leave, so a mesh is only ever coarser than wanted, never cracked.
+    // Every frame in flight has its own host-visible copy of the page table, written when the frame is recorded, so a
+    // slot that was given up is only reused once the frames that could still see it are done.
+    class GeometryStreamer
+    {
+    public:
+        struct Stats
+        {
+            uint32_t meshes = 0;
+            uint32_t pages = 0;
+            uint32_t poolPages = 0;
+            uint32_t residentPages = 0;
+            uint32_t pinnedPages = 0;
+            uint64_t streamedPages = 0;
+            uint64_t evictedPages = 0;
+            // Summed over frames, pages the task shader wanted that were not resident
+            uint64_t missingPages = 0;
+            uint64_t frames = 0;
+        };
+
+        // The page pool and cluster buffer are shared between the graphics family and the transfer family recording
+        // the uploads. Slots given up wait for graphics_timeline, oversized staging buffers for transfer_timeline.
+        // Throws std::runtime_error if budget cannot hold every mesh's coarsest cut.
+        GeometryStreamer(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physical_device,
+                         renderer::MemoryTracker& memory_tracker, renderer::TimelineScheduler& graphics_timeline,
+                         renderer::TimelineScheduler& transfer_timeline, std::span<const uint32_t> queue_families,
+                         uint32_t frames_in_flight, const std::filesystem::path& path, vk::DeviceSize budget,
+                         vk::Optional<const vk::AllocationCallbacks> allocator = nullptr);
+        // Waits for the reads still in progress
+        ~GeometryStreamer();
+
+        GeometryStreamer(const GeometryStreamer&) = delete;
+        GeometryStreamer& operator=(const GeometryStreamer&) = delete;
+
+        // Takes in what frame_slot's last frame reported, which has to have completed, and clears it for the next one
+        void readFeedback(uint32_t frame_slot);
+
+        // Queues the reads of the most wanted missing pages, records the copies of finished ones and writes
+        // frame_slot's page table. Returns whether anything was recorded.
+        bool recordUploads(const vk::raii::CommandBuffer& command_buffer, uint32_t frame_slot);
+
+        // The error threshold mesh is drawn with, wanted_error when the cut it selects is resident, the smallest larger
+        // one whose cut is otherwise. Infinite until the mesh's coarsest cut is resident.
+        [[nodiscard]] float getDrawThreshold(uint32_t mesh, float wanted_error) const;
+
+        [[nodiscard]] std::span<const ClusterPageFile::Mesh> getMeshes() const;
+
+        [[nodiscard]] uint32_t getPageCount() const;
+
+        // Bound in place of the vertex and cluster buffers for streamed draws
+        [[nodiscard]] vk::Buffer getPagePool() const;
+        [[nodiscard]] vk::Buffer getClusterBuffer() const;
+        [[nodiscard]] vk::Buffer getVisibilityBuffer() const;
+        // A table per frame in flight, frame_slot * getPageCount() + page holds the pool slot of page
+        [[nodiscard]] vk::Buffer getPageTable() const;
+        // Two counters per frame in flight and page, at (frame_slot * getPageCount() + page) * 2: whether the frame
+        // drew from the page and how many triangles it wanted from it
+        [[nodiscard]] vk::Buffer getFeedbackBuffer() const;
+
+        // Whether reads are queued, in flight or waiting for a slot, frames keep allocating while they are
+        [[nodiscard]] bool isStreaming() const;
+
+        [[nodiscard]] Stats getStats() const;
+
+    private:
+        struct Page
+        {
+            uint32_t mesh = 0;
+            uint32_t slot = no_page_slot;
+            uint32_t wanted = 0; // Triangles asked for in the latest feedback
+            uint64_t lastUsedFrame = 0;
+            bool pinned = false;
+            bool loading = false;
+            bool failed = false; // The read failed, the page is not asked for again
+        };
+
+        // Sorted distinct errors of a mesh's clusters, every cut the mesh has starts at one of them
+        struct MeshCuts
+        {
+            uint32_t firstThreshold = 0;
+            uint32_t thresholdCount = 0;
+            bool dirty = false; // Residency changed since the cuts were last checked
+        };
+
+        struct ReadResult
+        {
+            uint32_t page;
+            bool failed;
+            std::vector<Vertex> vertices;
+        };
+
+        struct RetiringSlot
+        {
+            uint64_t graphicsValue; // Frames that may still read the slot complete at this value
+            uint32_t slot;
+        };
+
+        const vk::raii::Device& device;
+        const vk::raii::PhysicalDevice& physicalDevice;
+        renderer::MemoryTracker& memoryTracker;
+        renderer::TimelineScheduler& graphicsTimeline;
+        renderer::TimelineScheduler& transferTimeline;
+        std::vector<uint32_t> queueFamilies;
+        uint32_t framesInFlight;
+        std::filesystem::path path;
+        vk::Optional<const vk::AllocationCallbacks> allocator;
+
+        ClusterPageFile file;
+        uint32_t poolPages = 0;
+
+        std::vector<Page> pages;
+        std::vector<uint32_t> pageTable; // Slot of every page, frames copy it into their own table
+        std::vector<renderer::DirtyRanges> tableRanges; // Per frame in flight, bytes of pageTable it has not seen yet
+        std::pmr::vector<renderer::DirtyRanges::Range> takenRanges;
+
+        std::vector<MeshCuts> meshCuts;
+        std::vector<float> thresholds;
+        std::vector<uint8_t> cutResident; // Per threshold, whether every page of the cut it selects is resident
+        std::vector<int32_t> cutChanges;
+
+        std::vector<uint32_t> freeSlots;
+        std::deque<RetiringSlot> retiringSlots;
+        // Reused every frame, so deciding costs no allocations while nothing changes
+        std::vector<uint32_t> requestOrder;
+        std::vector<uint32_t> evictionOrder;
+        std::vector<vk::BufferCopy> pageCopies;
+
+        uint64_t frame = 0;
+        uint32_t loadingCount = 0;
+        bool clustersUploaded = false;
+        Stats stats;
+
+        vk::raii::Buffer pagePool = nullptr;
+        renderer::TrackedDeviceMemory pagePoolMemory = nullptr;
+        vk::raii::Buffer clusterBuffer = nullptr;
+        renderer::TrackedDeviceMemory clusterMemory = nullptr;
+        vk::raii::Buffer visibilityBuffer = nullptr;
+        renderer::TrackedDeviceMemory visibilityMemory = nullptr;
+        // Host visible and persistently mapped, like the feedback
+        vk::raii::Buffer pageTableBuffer = nullptr;
+        renderer::TrackedDeviceMemory pageTableMemory = nullptr;
+        uint32_t* pageTableMapping = nullptr;
+        vk::raii::Buffer feedbackBuffer = nullptr;
+        renderer::TrackedDeviceMemory feedbackMemory = nullptr;
+        uint32_t* feedback = nullptr;
+
+        // Persistently mapped, one per frame in flight
+        std::vector<vk::raii::Buffer> stagingBuffers;
+        std::vector<renderer::TrackedDeviceMemory> stagingMemories;
+        std::vector<void*> stagingMappings;
+        // The cluster upload's staging, retired to the transfer timeline once submitted
+        std::vector<std::pair<vk::raii::Buffer, renderer::TrackedDeviceMemory>> oversizedStaging;
+
+        std::mutex mutex; // Guards the queues and stopping
+        std::condition_variable readCondition;
+        std::deque<uint32_t> requests;
+        std::deque<ReadResult> results;
+        bool stopping = false;
+        // Declared last, so it starts after everything it uses
+        std::thread reader;
+
+        [[nodiscard]] std::pair<vk::raii::Buffer, renderer::TrackedDeviceMemory> createBuffer(
+            vk::DeviceSize size, vk::BufferUsageFlags usage, vk::MemoryPropertyFlags properties,
+            renderer::MemoryCategory category, std::string_view owner, bool shared) const;
+
+        void queueRead(uint32_t page);
+
+        void setSlot(uint32_t page, uint32_t slot);
+
+        // Gives up the slots of the least recently used pages nothing drew from lately, at most count of them
+        void evict(uint32_t count);
+
+        void updateCuts(uint32_t mesh);
+
+        void readLoop();
+    };
+} // geometry
@@ -0,0 +1,91 @@
+#include "GeometryBake.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <vector>
+
+#include "Geometry/ClusterPages.h"
+#include "Jobs/ThreadPool.h"
+#include "Renderer/ClusterLod.h"
+
+// Quads per tile side, each tile is a mesh of its own with 2 * 64 * 64 triangles at full detail
+constexpr uint32_t bake_tile_quads = 64;
+// Tiles whose hierarchies are built at once, bounds the memory held before they are written
+constexpr uint32_t bake_batch_tiles = 64;
+
+// Clockwise quads, shaded across the tile so its levels of detail are visible
+static std::vector<Vertex> create_tile(const uint32_t tile, const uint32_t tiles_per_side)
+{
+    const float size = 2.0f / static_cast<float>(tiles_per_side);
+    const glm::vec2 origin(-1.0f + size * static_cast<float>(tile % tiles_per_side),
+                           -1.0f + size * static_cast<float>(tile / tiles_per_side));
+    // Neighbouring tiles differ in hue
+    const uint32_t hash = (tile + 1) * 2654435761u;
+    const glm::vec3 base(static_cast<float>(hash & 0xff) / 255.0f, static_cast<float>((hash >> 8) & 0xff) / 255.0f,
+                         static_cast<float>((hash >> 16) & 0xff) / 255.0f);
+
+    std::vector<Vertex> vertices;
+    vertices.reserve(static_cast<size_t>(bake_tile_quads) * bake_tile_quads * 6);
+    const auto corner = [&](const uint32_t x, const uint32_t y) -> Vertex
+    {
+        const glm::vec2 t(static_cast<float>(x) / bake_tile_quads, static_cast<float>(y) / bake_tile_quads);
+        return {origin + t * size, base * (0.5f + 0.5f * t.x * t.y)};
+    };
+    for (uint32_t y = 0; y < bake_tile_quads; y++)
+    {
+        for (uint32_t x = 0; x < bake_tile_quads; x++)
+        {
+            vertices.push_back(corner(x, y));
+            vertices.push_back(corner(x + 1, y));
+            vertices.push_back(corner(x, y + 1));
+            vertices.push_back(corner(x + 1, y));
+            vertices.push_back(corner(x + 1, y + 1));
+            vertices.push_back(corner(x, y + 1));
+        }
+    }
+    return vertices;
+}
+
+int run_geometry_bake(const ApplicationSettings& settings)
+{
+    const uint32_t tiles_per_side = std::max(settings.bakeTiles, 1u);
+    const uint32_t tile_count = tiles_per_side * tiles_per_side;
+
+    try
+    {
+        jobs::ThreadPool thread_pool;
+        geometry::ClusterPageWriter writer(settings.bakeGeometryPath);
+
+        std::vector<renderer::ClusterLod> batch;
+        for (uint32_t first = 0; first < tile_count; first += bake_batch_tiles)
+        {
+            batch.clear();
+            batch.resize(std::min(bake_batch_tiles, tile_count - first));
+            thread_pool.parallelFor(batch.size(), 1, [&](const size_t begin, const size_t end)
+            {
+                for (size_t i = begin; i < end; i++)
+                {
+                    batch[i] = renderer::build_cluster_lod(
+                        create_tile(first + static_cast<uint32_t>(i), tiles_per_side));
+                }
+            });
+
+            // In tile order, so the same settings always write the same file
+            for (const auto& lod : batch)
+            {
+                writer.add(lod);
+            }
+        }
+        writer.finish();
+
+        std::printf("Baked %u tiles into %u pages of %s\n", tile_count, writer.getPageCount(),
+                    settings.bakeGeometryPath.string().c_str());
+    }
+    catch (const std::exception& error)
+    {
+        std::fprintf(stderr, "%s\n", error.what());
+        return 1;
+    }
+    return 0;
+}
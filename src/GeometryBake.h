@@ -0,0 +1,7 @@
+#pragma once
+
+#include "ApplicationSettings.h"
+
+// Writes a world of settings.bakeTiles x settings.bakeTiles finely tessellated tiles covering the screen to
+// settings.bakeGeometryPath as a cluster page file, for --geometry to stream
+int run_geometry_bake(const ApplicationSettings& settings);
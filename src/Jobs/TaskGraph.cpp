@@ -0,0 +1,188 @@
+#include "TaskGraph.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <iomanip>
+#include <mutex>
+#include <stdexcept>
+
+#include "../Trace/Trace.h"
+
+using clock_type = std::chrono::steady_clock;
+
+[[nodiscard]] static double milliseconds_between(const clock_type::time_point from, const clock_type::time_point to)
+{
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+namespace jobs
+{
+    TaskGraph::TaskId TaskGraph::add(std::string name, std::function<void()> function,
+                                     const std::initializer_list<TaskId> dependencies)
+    {
+        const auto id = static_cast<TaskId>(tasks.size());
+        for (const TaskId dependency : dependencies)
+        {
+            if (dependency >= id)
+                throw std::invalid_argument("Task " + name + " depends on a task added after it");
+        }
+
+        tasks.push_back({std::move(name), std::move(function), dependencies, {}});
+        return id;
+    }
+
+    void TaskGraph::run(ThreadPool& pool)
+    {
+        if (tasks.empty())
+            return;
+
+        std::vector<std::vector<TaskId>> dependents(tasks.size());
+        std::vector<uint32_t> pending(tasks.size());
+        std::vector<TaskId> ready;
+        for (TaskId id = 0; id < tasks.size(); id++)
+        {
+            pending[id] = static_cast<uint32_t>(tasks[id].dependencies.size());
+            for (const TaskId dependency : tasks[id].dependencies)
+            {
+                dependents[dependency].push_back(id);
+            }
+            if (pending[id] == 0)
+                ready.push_back(id);
+        }
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        size_t finished = 0;
+        std::exception_ptr error;
+
+        laneCount = pool.getConcurrency();
+        const clock_type::time_point start = clock_type::now();
+
+        // One long running chunk per thread, each picking up steps as they become ready
+        pool.parallelFor(laneCount, 1, [&](const size_t lane, size_t)
+        {
+            std::unique_lock lock(mutex);
+            while (true)
+            {
+                condition.wait(lock, [&] { return !ready.empty() || finished == tasks.size() || error; });
+                if (error || ready.empty())
+                    return;
+
+                const TaskId id = ready.back();
+                ready.pop_back();
+                Task& task = tasks[id];
+
+                lock.unlock();
+                const clock_type::time_point task_start = clock_type::now();
+                std::exception_ptr task_error;
+                try
+                {
+                    task.function();
+                }
+                catch (...)
+                {
+                    task_error = std::current_exception();
+                }
+                const clock_type::time_point task_end = clock_type::now();
+                if (trace::is_enabled())
+                    trace::record(trace::intern(task.name), task_start, task_end);
+                lock.lock();
+
+                task.timing = {milliseconds_between(start, task_start), milliseconds_between(task_start, task_end),
+                               static_cast<unsigned int>(lane)};
+                finished++;
+
+                if (task_error && !error)
+                    error = task_error;
+
+                for (const TaskId dependent : dependents[id])
+                {
+                    if (--pending[dependent] == 0)
+                        ready.push_back(dependent);
+                }
+                condition.notify_all();
+            }
+        });
+
+        totalMs = milliseconds_between(start, clock_type::now());
+
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    double TaskGraph::getTotalMs() const
+    {
+        return totalMs;
+    }
+
+    std::vector<TaskGraph::TaskId> TaskGraph::getCriticalPath() const
+    {
+        if (tasks.empty())
+            return {};
+
+        // Tasks only depend on earlier ones, so one pass in order sees every dependency's chain before its own
+        std::vector<double> chain_ms(tasks.size());
+        std::vector<TaskId> previous(tasks.size(), UINT32_MAX);
+        for (TaskId id = 0; id < tasks.size(); id++)
+        {
+            for (const TaskId dependency : tasks[id].dependencies)
+            {
+                if (previous[id] == UINT32_MAX || chain_ms[dependency] > chain_ms[previous[id]])
+                    previous[id] = dependency;
+            }
+            chain_ms[id] = tasks[id].timing.durationMs + (previous[id] == UINT32_MAX ? 0.0 : chain_ms[previous[id]]);
+        }
+
+        std::vector<TaskId> path;
+        for (auto id = static_cast<TaskId>(std::max_element(chain_ms.begin(), chain_ms.end()) - chain_ms.begin());
+             id != UINT32_MAX; id = previous[id])
+        {
+            path.push_back(id);
+        }
+        std::reverse(path.begin(), path.end());
+        return path;
+    }
+
+    const std::string& TaskGraph::getName(const TaskId task) const
+    {
+        return tasks[task].name;
+    }
+
+    const TaskGraph::TaskTiming& TaskGraph::getTiming(const TaskId task) const
+    {
+        return tasks[task].timing;
+    }
+
+    void TaskGraph::printReport(std::ostream& output) const
+    {
+        const std::vector<TaskId> critical_path = getCriticalPath();
+
+        const auto flags = output.flags();
+        const auto precision = output.precision();
+        output << std::fixed << std::setprecision(2);
+        output << tasks.size() << " steps took " << totalMs << " ms on " << laneCount << " threads" << std::endl;
+        output << std::left << std::setw(24) << "  step" << std::right << std::setw(10) << "start" << std::setw(10)
+            << "ms" << std::setw(8) << "thread" << std::endl;
+
+        for (TaskId id = 0; id < tasks.size(); id++)
+        {
+            const bool critical = std::find(critical_path.begin(), critical_path.end(), id) != critical_path.end();
+            output << (critical ? "* " : "  ") << std::left << std::setw(22) << tasks[id].name << std::right
+                << std::setw(10) << tasks[id].timing.startMs << std::setw(10) << tasks[id].timing.durationMs
+                << std::setw(8) << tasks[id].timing.lane << std::endl;
+        }
+
+        double critical_ms = 0.0;
+        output << "Critical path:";
+        for (const TaskId id : critical_path)
+        {
+            output << (id == critical_path.front() ? " " : " -> ") << tasks[id].name;
+            critical_ms += tasks[id].timing.durationMs;
+        }
+        output << " (" << critical_ms << " ms)" << std::endl;
+
+        output.flags(flags);
+        output.precision(precision);
+    }
+} // jobs
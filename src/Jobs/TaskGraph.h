@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "ThreadPool.h"
+
+namespace jobs
+{
+    // Steps with dependencies on earlier steps, run on a thread pool as soon as everything they depend on is done.
+    // Each step is timed, so after run() the report shows which thread ran what and the critical path, the chain of
+    // dependencies that bounded the total time. Steps must not use the pool themselves.
+    class TaskGraph
+    {
+    public:
+        using TaskId = uint32_t;
+
+        struct TaskTiming
+        {
+            double startMs = 0.0; // Since run() started
+            double durationMs = 0.0;
+            unsigned int lane = 0; // Which of the pool's threads ran it
+        };
+
+        // Dependencies have to be added first, which also keeps the graph free of cycles
+        TaskId add(std::string name, std::function<void()> function, std::initializer_list<TaskId> dependencies = {});
+
+        // Blocks until every step has run. If one throws, no further steps start and the first exception is
+        // rethrown once the ones already running have finished.
+        void run(ThreadPool& pool);
+
+        [[nodiscard]] double getTotalMs() const;
+
+        // Longest chain of dependent steps by measured duration, in order
+        [[nodiscard]] std::vector<TaskId> getCriticalPath() const;
+
+        [[nodiscard]] const std::string& getName(TaskId task) const;
+        [[nodiscard]] const TaskTiming& getTiming(TaskId task) const;
+
+        void printReport(std::ostream& output) const;
+
+    private:
+        struct Task
+        {
+            std::string name;
+            std::function<void()> function;
+            std::vector<TaskId> dependencies;
+            TaskTiming timing;
+        };
+
+        std::vector<Task> tasks;
+        double totalMs = 0.0;
+        unsigned int laneCount = 1;
+    };
+} // jobs
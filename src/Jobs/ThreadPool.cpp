@@ -0,0 +1,120 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <string>
+
+#include "../Trace/Trace.h"
+
+namespace jobs
+{
+    ThreadPool::ThreadPool(const unsigned int thread_count)
+    {
+        // The dispatching thread works too, so one fewer dedicated worker is needed
+        const unsigned int worker_count = std::max(thread_count, 1u) - 1;
+
+        workers.reserve(worker_count);
+        for (unsigned int i = 0; i < worker_count; i++)
+        {
+            workers.emplace_back([this, i]
+            {
+                trace::set_thread_name("worker " + std::to_string(i + 1));
+                workerLoop();
+            });
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wakeCondition.notify_all();
+
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    unsigned int ThreadPool::getConcurrency() const
+    {
+        return static_cast<unsigned int>(workers.size()) + 1;
+    }
+
+    void ThreadPool::dispatch(const size_t count, size_t grain_size, const RangeFunction function, void* context)
+    {
+        if (count == 0)
+            return;
+
+        grain_size = std::max<size_t>(grain_size, 1);
+
+        // Not worth waking anybody up for a single chunk
+        if (workers.empty() || count <= grain_size)
+        {
+            function(context, 0, count);
+            return;
+        }
+
+        std::lock_guard dispatch_lock(dispatchMutex);
+
+        Job current_job{function, context, count, grain_size};
+        {
+            std::unique_lock lock(mutex);
+            // A worker that woke late for the previous job may still be reading nextChunk
+            idleCondition.wait(lock, [this] { return busyWorkers == 0; });
+
+            job = current_job;
+            nextChunk.store(0, std::memory_order_relaxed);
+            generation++;
+        }
+        wakeCondition.notify_all();
+
+        runChunks(current_job);
+
+        // Every chunk has been claimed, wait for the ones still running on workers
+        std::unique_lock lock(mutex);
+        idleCondition.wait(lock, [this] { return busyWorkers == 0; });
+    }
+
+    void ThreadPool::runChunks(const Job& current_job)
+    {
+        const size_t chunk_count = (current_job.count + current_job.grainSize - 1) / current_job.grainSize;
+
+        for (size_t chunk = nextChunk.fetch_add(1, std::memory_order_relaxed); chunk < chunk_count;
+             chunk = nextChunk.fetch_add(1, std::memory_order_relaxed))
+        {
+            const size_t begin = chunk * current_job.grainSize;
+            const size_t end = std::min(begin + current_job.grainSize, current_job.count);
+            current_job.function(current_job.context, begin, end);
+        }
+    }
+
+    void ThreadPool::workerLoop()
+    {
+        uint64_t seen_generation = 0;
+
+        while (true)
+        {
+            Job current_job;
+            {
+                std::unique_lock lock(mutex);
+                wakeCondition.wait(lock, [&] { return stopping || generation != seen_generation; });
+                if (stopping)
+                    return;
+
+                seen_generation = generation;
+                current_job = job;
+                busyWorkers++;
+            }
+
+            runChunks(current_job);
+
+            {
+                std::lock_guard lock(mutex);
+                busyWorkers--;
+            }
+            idleCondition.notify_all();
+        }
+    }
+} // jobs
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace jobs
+{
+    // Fixed set of worker threads for data-parallel loops.
+    // parallelFor() blocks until every chunk has run and the calling thread takes part in the work, so the loop body
+    // can safely capture locals by reference and a dispatch does not allocate. Loop bodies must not call back into
+    // parallelFor.
+    class ThreadPool
+    {
+    public:
+        explicit ThreadPool(unsigned int thread_count = std::thread::hardware_concurrency());
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        // Number of threads taking part in a parallelFor, including the caller
+        [[nodiscard]] unsigned int getConcurrency() const;
+
+        // Calls function(begin, end) over [0, count) in chunks of at most grain_size elements
+        template <class F>
+        void parallelFor(const size_t count, const size_t grain_size, F&& function)
+        {
+            using Function = std::remove_reference_t<F>;
+            dispatch(count, grain_size, [](void* context, const size_t begin, const size_t end)
+            {
+                (*static_cast<Function*>(context))(begin, end);
+            }, const_cast<void*>(static_cast<const void*>(&function)));
+        }
+
+    private:
+        using RangeFunction = void (*)(void* context, size_t begin, size_t end);
+
+        struct Job
+        {
+            RangeFunction function = nullptr;
+            void* context = nullptr;
+            size_t count = 0;
+            size_t grainSize = 1;
+        };
+
+        std::vector<std::thread> workers;
+
+        std::mutex dispatchMutex; // Serialises callers, only one job is in flight at a time
+        std::mutex mutex;
+        std::condition_variable wakeCondition;
+        std::condition_variable idleCondition;
+
+        Job job;
+        uint64_t generation = 0;
+        unsigned int busyWorkers = 0;
+        bool stopping = false;
+
+        std::atomic<size_t> nextChunk = 0;
+
+        void dispatch(size_t count, size_t grain_size, RangeFunction function, void* context);
+
+        void runChunks(const Job& current_job);
+
+        void workerLoop();
+    };
+} // jobs
@@ -0,0 +1,92 @@
+#include "AllocationCounter.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+// Replaceable global allocation functions. The standard array and nothrow forms call these, the sized deletes are
+// replaced too since compilers warn when they are not.
+
+namespace
+{
+    // Plain thread_local with a constant initializer, reading it needs no guard and allocating threads never touch a
+    // shared cache line
+    thread_local uint64_t allocation_count = 0;
+
+    void* allocate(const std::size_t size)
+    {
+        allocation_count++;
+
+        while (true)
+        {
+            if (void* pointer = std::malloc(size > 0 ? size : 1))
+                return pointer;
+
+            const std::new_handler handler = std::get_new_handler();
+            if (!handler)
+                throw std::bad_alloc();
+            handler();
+        }
+    }
+
+    // Over-allocates by the alignment and keeps malloc's pointer just before the aligned one, which avoids the
+    // different aligned allocation functions of each platform
+    void* allocate_aligned(const std::size_t size, const std::size_t alignment)
+    {
+        void* base = allocate(size + alignment + sizeof(void*));
+        const auto address = reinterpret_cast<std::uintptr_t>(base) + sizeof(void*);
+        void* aligned = reinterpret_cast<void*>((address + alignment - 1) & ~(alignment - 1));
+        std::memcpy(static_cast<std::byte*>(aligned) - sizeof(void*), &base, sizeof(void*));
+        return aligned;
+    }
+
+    void free_aligned(void* pointer)
+    {
+        if (!pointer)
+            return;
+
+        void* base;
+        std::memcpy(&base, static_cast<std::byte*>(pointer) - sizeof(void*), sizeof(void*));
+        std::free(base);
+    }
+}
+
+void* operator new(const std::size_t size)
+{
+    return allocate(size);
+}
+
+void* operator new(const std::size_t size, const std::align_val_t alignment)
+{
+    return allocate_aligned(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+    free_aligned(pointer);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t) noexcept
+{
+    free_aligned(pointer);
+}
+
+namespace memory
+{
+    uint64_t thread_allocation_count()
+    {
+        return allocation_count;
+    }
+} // memory
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+
+namespace memory
+{
+    // Heap allocations made through operator new by the calling thread since it started. The counting replacements of
+    // the global operator new and delete live in AllocationCounter.cpp, so this covers every container and
+    // make_unique of the program, but not memory a library gets from malloc directly.
+    [[nodiscard]] uint64_t thread_allocation_count();
+
+    // Counts the calling thread's allocations from construction to getCount()
+    class AllocationScope
+    {
+    public:
+        AllocationScope() : start(thread_allocation_count())
+        {
+        }
+
+        [[nodiscard]] uint64_t getCount() const
+        {
+            return thread_allocation_count() - start;
+        }
+
+    private:
+        uint64_t start;
+    };
+} // memory
@@ -0,0 +1,88 @@
+#include "FrameArena.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <new>
+
+namespace memory
+{
+    FrameArena::FrameArena(const size_t capacity) : buffer(std::make_unique<std::byte[]>(capacity)),
+                                                    capacity(capacity)
+    {
+    }
+
+    FrameArena::~FrameArena()
+    {
+        releaseSpills();
+    }
+
+    void FrameArena::reset()
+    {
+        const size_t used = getUsed();
+        peak = std::max(peak, used);
+
+        if (!spills.empty())
+        {
+            releaseSpills();
+            // Spilled allocations were not packed, so this leaves room for their alignment padding as well
+            capacity = std::bit_ceil(used);
+            buffer = std::make_unique<std::byte[]>(capacity);
+        }
+
+        offset = 0;
+    }
+
+    size_t FrameArena::getCapacity() const
+    {
+        return capacity;
+    }
+
+    size_t FrameArena::getUsed() const
+    {
+        return offset + spilledBytes;
+    }
+
+    size_t FrameArena::getPeak() const
+    {
+        return std::max(peak, getUsed());
+    }
+
+    void* FrameArena::do_allocate(const size_t bytes, const size_t alignment)
+    {
+        const auto base = reinterpret_cast<std::uintptr_t>(buffer.get());
+        const std::uintptr_t address = (base + offset + alignment - 1) & ~(alignment - 1);
+
+        if (address + bytes <= base + capacity)
+        {
+            offset = address + bytes - base;
+            return reinterpret_cast<void*>(address);
+        }
+
+        spills.reserve(spills.size() + 1);
+        void* pointer = ::operator new(bytes, std::align_val_t(alignment));
+        spills.push_back({pointer, bytes, alignment});
+        spilledBytes += bytes + alignment;
+        return pointer;
+    }
+
+    void FrameArena::do_deallocate(void*, size_t, size_t)
+    {
+        // Everything is released together by reset()
+    }
+
+    bool FrameArena::do_is_equal(const memory_resource& other) const noexcept
+    {
+        return this == &other;
+    }
+
+    void FrameArena::releaseSpills()
+    {
+        for (const auto& spill : spills)
+        {
+            ::operator delete(spill.pointer, spill.size, std::align_val_t(spill.alignment));
+        }
+        spills.clear();
+        spilledBytes = 0;
+    }
+} // memory
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+namespace memory
+{
+    // Linear allocator for CPU data that only lives for one frame, as a memory resource so std::pmr containers can use
+    // it. Allocating bumps an offset and nothing is freed before reset(), so the frame's transient lists cost no heap
+    // allocations. A frame that needs more than the capacity spills onto the heap, and the next reset() grows the
+    // arena to fit it, so allocations stop once the largest frame has been seen.
+    class FrameArena final : public std::pmr::memory_resource
+    {
+    public:
+        explicit FrameArena(size_t capacity);
+        ~FrameArena() override;
+
+        FrameArena(const FrameArena&) = delete;
+        FrameArena& operator=(const FrameArena&) = delete;
+
+        // Invalidates everything allocated since the last reset
+        void reset();
+
+        [[nodiscard]] size_t getCapacity() const;
+
+        // Bytes handed out since the last reset, including what spilled onto the heap
+        [[nodiscard]] size_t getUsed() const;
+
+        // Largest getUsed() of any frame so far
+        [[nodiscard]] size_t getPeak() const;
+
+    private:
+        struct Spill
+        {
+            void* pointer;
+            size_t size;
+            size_t alignment;
+        };
+
+        std::unique_ptr<std::byte[]> buffer;
+        size_t capacity;
+        size_t offset = 0;
+
+        std::vector<Spill> spills;
+        size_t spilledBytes = 0;
+        size_t peak = 0;
+
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* pointer, size_t bytes, size_t alignment) override;
+        [[nodiscard]] bool do_is_equal(const memory_resource& other) const noexcept override;
+
+        void releaseSpills();
+    };
+} // memory
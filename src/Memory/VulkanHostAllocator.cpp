@@ -0,0 +1,125 @@
+#include "VulkanHostAllocator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace
+{
+    // Stored just before every allocation, the free callback gets neither size nor alignment
+    struct Header
+    {
+        void* base;
+        size_t size;
+    };
+
+    Header& header_of(void* pointer)
+    {
+        return *reinterpret_cast<Header*>(static_cast<std::byte*>(pointer) - sizeof(Header));
+    }
+}
+
+namespace memory
+{
+    VulkanHostAllocator::VulkanHostAllocator()
+    {
+        // Filled in through the C struct, whose function pointer types are the same in every vulkan-hpp version
+        VkAllocationCallbacks& c_callbacks = callbacks;
+        c_callbacks.pUserData = this;
+        c_callbacks.pfnAllocation = &allocateCallback;
+        c_callbacks.pfnReallocation = &reallocateCallback;
+        c_callbacks.pfnFree = &freeCallback;
+    }
+
+    const vk::AllocationCallbacks& VulkanHostAllocator::getCallbacks() const
+    {
+        return callbacks;
+    }
+
+    uint64_t VulkanHostAllocator::getAllocationCount() const
+    {
+        return allocationCount.load(std::memory_order_relaxed);
+    }
+
+    size_t VulkanHostAllocator::getLiveBytes() const
+    {
+        return liveBytes.load(std::memory_order_relaxed);
+    }
+
+    size_t VulkanHostAllocator::getPeakBytes() const
+    {
+        return peakBytes.load(std::memory_order_relaxed);
+    }
+
+    void* VulkanHostAllocator::allocate(const size_t size, size_t alignment)
+    {
+        if (size == 0)
+            return nullptr;
+
+        alignment = std::max(alignment, alignof(Header));
+        void* base = std::malloc(size + sizeof(Header) + alignment - 1);
+        if (!base)
+            return nullptr;
+
+        const auto address = reinterpret_cast<std::uintptr_t>(base) + sizeof(Header);
+        void* pointer = reinterpret_cast<void*>((address + alignment - 1) & ~(alignment - 1));
+        header_of(pointer) = {base, size};
+
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        const size_t live = liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+        size_t peak = peakBytes.load(std::memory_order_relaxed);
+        while (live > peak && !peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+        {
+        }
+
+        return pointer;
+    }
+
+    void* VulkanHostAllocator::reallocate(void* original, const size_t size, const size_t alignment)
+    {
+        if (!original)
+            return allocate(size, alignment);
+        if (size == 0)
+        {
+            free(original);
+            return nullptr;
+        }
+
+        // On failure the original has to stay valid
+        void* pointer = allocate(size, alignment);
+        if (!pointer)
+            return nullptr;
+
+        std::memcpy(pointer, original, std::min(size, header_of(original).size));
+        free(original);
+        return pointer;
+    }
+
+    void VulkanHostAllocator::free(void* pointer)
+    {
+        if (!pointer)
+            return;
+
+        const Header header = header_of(pointer);
+        liveBytes.fetch_sub(header.size, std::memory_order_relaxed);
+        std::free(header.base);
+    }
+
+    void* VulkanHostAllocator::allocateCallback(void* user_data, const size_t size, const size_t alignment,
+                                                VkSystemAllocationScope)
+    {
+        return static_cast<VulkanHostAllocator*>(user_data)->allocate(size, alignment);
+    }
+
+    void* VulkanHostAllocator::reallocateCallback(void* user_data, void* original, const size_t size,
+                                                  const size_t alignment, VkSystemAllocationScope)
+    {
+        return static_cast<VulkanHostAllocator*>(user_data)->reallocate(original, size, alignment);
+    }
+
+    void VulkanHostAllocator::freeCallback(void* user_data, void* memory)
+    {
+        static_cast<VulkanHostAllocator*>(user_data)->free(memory);
+    }
+} // memory
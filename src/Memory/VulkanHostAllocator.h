@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include <vulkan/vulkan_raii.hpp>
+
+namespace memory
+{
+    // Host memory the Vulkan implementation allocates for its objects, through vk::AllocationCallbacks so it can be
+    // counted. Drivers call these from any thread. Their allocations are kept apart from the application's own
+    // operator new count, since a driver allocating inside vkQueueSubmit is not something the renderer can fix.
+    class VulkanHostAllocator
+    {
+    public:
+        VulkanHostAllocator();
+
+        VulkanHostAllocator(const VulkanHostAllocator&) = delete;
+        VulkanHostAllocator& operator=(const VulkanHostAllocator&) = delete;
+
+        // Refers to this object, which has to outlive everything created with them
+        [[nodiscard]] const vk::AllocationCallbacks& getCallbacks() const;
+
+        [[nodiscard]] uint64_t getAllocationCount() const;
+        [[nodiscard]] size_t getLiveBytes() const;
+        [[nodiscard]] size_t getPeakBytes() const;
+
+    private:
+        vk::AllocationCallbacks callbacks;
+
+        std::atomic<uint64_t> allocationCount = 0;
+        std::atomic<size_t> liveBytes = 0;
+        std::atomic<size_t> peakBytes = 0;
+
+        void* allocate(size_t size, size_t alignment);
+        void* reallocate(void* original, size_t size, size_t alignment);
+        void free(void* pointer);
+
+        static VKAPI_ATTR void* VKAPI_CALL allocateCallback(void* user_data, size_t size, size_t alignment,
+                                                            VkSystemAllocationScope scope);
+        static VKAPI_ATTR void* VKAPI_CALL reallocateCallback(void* user_data, void* original, size_t size,
+                                                              size_t alignment, VkSystemAllocationScope scope);
+        static VKAPI_ATTR void VKAPI_CALL freeCallback(void* user_data, void* memory);
+    };
+} // memory
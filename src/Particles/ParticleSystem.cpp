@@ -0,0 +1,268 @@
+#include "ParticleSystem.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+
+#include "particle.h"
+
+// Matches Particle in particle.slang
+struct Particle
+{
+    float position[2];
+    float velocity[2];
+    float age;
+    uint32_t color;
+};
+static_assert(sizeof(Particle) == 24);
+
+// Matches ParticleCounters in particle.slang
+struct ParticleCounters
+{
+    uint32_t sourceCount;
+    uint32_t appended;
+    uint32_t simulateGroups[3];
+    uint32_t drawGroups[3];
+};
+static_assert(sizeof(ParticleCounters) == 32);
+
+// Matches ParticleConstants in particle.slang
+struct ParticleConstants
+{
+    float deltaTime;
+    float lifetime;
+    uint32_t capacity;
+    uint32_t emitCount;
+    uint32_t seed;
+    float size;
+    float emitterPosition[2];
+    float emitAge;
+};
+static_assert(sizeof(ParticleConstants) == 36);
+
+// Matches groupSize and maxGroupsX in particle.slang
+constexpr uint32_t particle_group_size = 64;
+constexpr uint32_t max_groups_x = 65535;
+
+constexpr float particle_lifetime = 2.0f;
+constexpr float particle_size = 0.004f;
+// Bottom center of the screen, particles rise from it and fall back
+constexpr float emitter_position[2] = {0.0f, 0.9f};
+// A hitch emits and moves no more than this, so the fountain does not jump after one
+constexpr float max_delta_time = 1.0f / 20.0f;
+
+constexpr vk::ShaderStageFlags particle_stages =
+    vk::ShaderStageFlagBits::eCompute | vk::ShaderStageFlagBits::eTaskEXT | vk::ShaderStageFlagBits::eMeshEXT;
+
+namespace particles
+{
+    ParticleSystem::ParticleSystem(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physical_device,
+                                   renderer::MemoryTracker& memory_tracker,
+                                   renderer::PipelineManager& pipeline_manager, const vk::RenderPass render_pass,
+                                   const uint32_t capacity, const std::span<const uint32_t> queue_families,
+                                   const vk::Optional<const vk::AllocationCallbacks> allocator) :
+        device(device), physicalDevice(physical_device), memoryTracker(memory_tracker),
+        pipelineManager(pipeline_manager), capacity(capacity),
+        queueFamilies(queue_families.begin(), queue_families.end()), allocator(allocator)
+    {
+        std::ranges::sort(queueFamilies);
+        queueFamilies.erase(std::unique(queueFamilies.begin(), queueFamilies.end()), queueFamilies.end());
+
+        const vk::DeviceSize particle_bytes = sizeof(Particle) * static_cast<vk::DeviceSize>(std::max(capacity, 1u));
+        const uint32_t max_range = physical_device.getProperties().limits.maxStorageBufferRange;
+        if (particle_bytes > max_range)
+            throw std::runtime_error(std::to_string(capacity) + " particles do not fit the " +
+                                     std::to_string(max_range >> 20) + " MiB a storage buffer may bind");
+
+        for (uint32_t i = 0; i < 2; i++)
+        {
+            std::tie(particleBuffers[i], particleMemories[i]) =
+                createBuffer(particle_bytes, vk::BufferUsageFlagBits::eStorageBuffer, "particles");
+        }
+        std::tie(counterBuffer, counterMemory) = createBuffer(
+            sizeof(ParticleCounters),
+            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer |
+            vk::BufferUsageFlagBits::eTransferDst, "particle counters");
+
+        constexpr std::array layout_bindings{
+            vk::DescriptorSetLayoutBinding(0, vk::DescriptorType::eStorageBuffer, 1, particle_stages, nullptr),
+            vk::DescriptorSetLayoutBinding(1, vk::DescriptorType::eStorageBuffer, 1, particle_stages, nullptr),
+            vk::DescriptorSetLayoutBinding(2, vk::DescriptorType::eStorageBuffer, 1, particle_stages, nullptr),
+        };
+        descriptorSetLayout = device.createDescriptorSetLayout(vk::DescriptorSetLayoutCreateInfo({}, layout_bindings),
+                                                               allocator);
+
+        const vk::PushConstantRange push_constant_range(particle_stages, 0, sizeof(ParticleConstants));
+        pipelineLayout = device.createPipelineLayout(
+            vk::PipelineLayoutCreateInfo({}, *descriptorSetLayout, push_constant_range), allocator);
+
+        const vk::DescriptorPoolSize pool_size(vk::DescriptorType::eStorageBuffer, 3 * 2);
+        descriptorPool = device.createDescriptorPool(
+            vk::DescriptorPoolCreateInfo(vk::DescriptorPoolCreateFlagBits::eFreeDescriptorSet, 2, pool_size),
+            allocator);
+        const std::array layouts{*descriptorSetLayout, *descriptorSetLayout};
+        descriptorSets = device.allocateDescriptorSets(vk::DescriptorSetAllocateInfo(descriptorPool, layouts));
+
+        // Set p is used by the update that writes to buffer p, which reads the other one
+        const std::array particle_infos{
+            vk::DescriptorBufferInfo(particleBuffers[0], 0, vk::WholeSize),
+            vk::DescriptorBufferInfo(particleBuffers[1], 0, vk::WholeSize),
+        };
+        const vk::DescriptorBufferInfo counter_info(counterBuffer, 0, vk::WholeSize);
+        std::array<vk::WriteDescriptorSet, 6> descriptor_writes;
+        for (uint32_t set = 0; set < 2; set++)
+        {
+            descriptor_writes[set * 3] = vk::WriteDescriptorSet(*descriptorSets[set], 0, 0,
+                                                                vk::DescriptorType::eStorageBuffer, {},
+                                                                particle_infos[1 - set]);
+            descriptor_writes[set * 3 + 1] = vk::WriteDescriptorSet(*descriptorSets[set], 1, 0,
+                                                                    vk::DescriptorType::eStorageBuffer, {},
+                                                                    particle_infos[set]);
+            descriptor_writes[set * 3 + 2] = vk::WriteDescriptorSet(*descriptorSets[set], 2, 0,
+                                                                    vk::DescriptorType::eStorageBuffer, {},
+                                                                    counter_info);
+        }
+        device.updateDescriptorSets(descriptor_writes, {});
+
+        assert((void("Invalid SPIR-V magic number"), particle[0] == 0x07230203));
+
+        const std::span<const uint32_t> code(particle, particle_sizeInBytes / sizeof(uint32_t));
+        const auto shader_module = device.createShaderModule(
+            vk::ShaderModuleCreateInfo({}, particle_sizeInBytes, particle), allocator);
+        simulatePipeline = createComputePipeline(shader_module, "simulateMain");
+        emitPipeline = createComputePipeline(shader_module, "emitMain");
+        preparePipeline = createComputePipeline(shader_module, "prepareMain");
+
+        // Additive, and drawn over everything without touching depth
+        renderer::GraphicsPipelineDesc desc;
+        desc.code = code;
+        desc.taskEntry = "particleTaskMain";
+        desc.meshEntry = "particleMeshMain";
+        desc.fragmentEntry = "particleFragmentMain";
+        desc.layout = pipelineLayout;
+        desc.renderPass = render_pass;
+        desc.cullMode = vk::CullModeFlagBits::eNone;
+        desc.depthTest = false;
+        desc.depthWrite = false;
+        desc.blend = true;
+        drawPipeline = pipelineManager.request(desc);
+        pipelineManager.wait(drawPipeline);
+    }
+
+    void ParticleSystem::recordUpdate(const vk::raii::CommandBuffer& command_buffer)
+    {
+        const Clock::time_point now = Clock::now();
+        const float delta_time =
+            cleared ? std::min(std::chrono::duration<float>(now - lastUpdate).count(), max_delta_time) : 0.0f;
+        lastUpdate = now;
+
+        // The first update fills the capacity with particles of every age, after it just enough replace what dies
+        uint32_t emit_count = capacity;
+        float emit_age = particle_lifetime;
+        if (cleared)
+        {
+            emitCarry += static_cast<double>(capacity) / particle_lifetime * delta_time;
+            emit_count = static_cast<uint32_t>(std::min(std::floor(emitCarry), static_cast<double>(capacity)));
+            emitCarry -= std::floor(emitCarry);
+            emit_age = delta_time;
+        }
+        else
+        {
+            command_buffer.fillBuffer(counterBuffer, 0, vk::WholeSize, 0);
+            cleared = true;
+        }
+
+        // Last frame's prepare pass wrote the counters. Its draw read the buffer this update writes to, the caller
+        // made this update wait for it.
+        constexpr vk::MemoryBarrier2 start_barrier(
+            vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eClear,
+            vk::AccessFlagBits2::eShaderStorageWrite | vk::AccessFlagBits2::eTransferWrite,
+            vk::PipelineStageFlagBits2::eComputeShader | vk::PipelineStageFlagBits2::eDrawIndirect,
+            vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite |
+            vk::AccessFlagBits2::eIndirectCommandRead);
+        command_buffer.pipelineBarrier2(vk::DependencyInfo({}, start_barrier));
+
+        parity = 1 - parity;
+        const ParticleConstants constants{
+            delta_time, particle_lifetime, capacity, emit_count, seed++, particle_size,
+            {emitter_position[0], emitter_position[1]}, emit_age
+        };
+        command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout, 0,
+                                          *descriptorSets[parity], {});
+        command_buffer.pushConstants<ParticleConstants>(pipelineLayout, particle_stages, 0, constants);
+
+        // Survivors and new particles only meet at the counter, both append with atomics and can run together
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, simulatePipeline);
+        command_buffer.dispatchIndirect(counterBuffer, offsetof(ParticleCounters, simulateGroups));
+        if (emit_count > 0)
+        {
+            const uint32_t groups = (emit_count + particle_group_size - 1) / particle_group_size;
+            command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, emitPipeline);
+            command_buffer.dispatch(std::min(groups, max_groups_x), (groups + max_groups_x - 1) / max_groups_x, 1);
+        }
+
+        constexpr vk::MemoryBarrier2 append_barrier(
+            vk::PipelineStageFlagBits2::eComputeShader, vk::AccessFlagBits2::eShaderStorageWrite,
+            vk::PipelineStageFlagBits2::eComputeShader,
+            vk::AccessFlagBits2::eShaderStorageRead | vk::AccessFlagBits2::eShaderStorageWrite);
+        command_buffer.pipelineBarrier2(vk::DependencyInfo({}, append_barrier));
+
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eCompute, preparePipeline);
+        command_buffer.dispatch(1, 1, 1);
+    }
+
+    void ParticleSystem::recordDraw(const vk::raii::CommandBuffer& command_buffer)
+    {
+        command_buffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipelineManager.get(drawPipeline));
+        command_buffer.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout, 0,
+                                          *descriptorSets[parity], {});
+        command_buffer.pushConstants<ParticleConstants>(
+            pipelineLayout, particle_stages, 0,
+            ParticleConstants{
+                0.0f, particle_lifetime, capacity, 0, 0, particle_size, {emitter_position[0], emitter_position[1]}, 0.0f
+            });
+        command_buffer.drawMeshTasksIndirectEXT(counterBuffer, offsetof(ParticleCounters, drawGroups), 1,
+                                                sizeof(uint32_t) * 3);
+    }
+
+    uint32_t ParticleSystem::getCapacity() const
+    {
+        return capacity;
+    }
+
+    std::pair<vk::raii::Buffer, renderer::TrackedDeviceMemory> ParticleSystem::createBuffer(
+        const vk::DeviceSize size, const vk::BufferUsageFlags usage, const std::string_view owner) const
+    {
+        vk::BufferCreateInfo buffer_info({}, size, usage);
+        if (queueFamilies.size() > 1)
+        {
+            buffer_info.sharingMode = vk::SharingMode::eConcurrent;
+            buffer_info.setQueueFamilyIndices(queueFamilies);
+        }
+        vk::raii::Buffer buffer(device, buffer_info, allocator);
+
+        const vk::MemoryRequirements requirements = buffer.getMemoryRequirements();
+        const vk::MemoryAllocateInfo allocate_info(
+            requirements.size, renderer::find_memory_type(physicalDevice.getMemoryProperties(),
+                                                          requirements.memoryTypeBits,
+                                                          vk::MemoryPropertyFlagBits::eDeviceLocal));
+        renderer::TrackedDeviceMemory memory(device, allocate_info, memoryTracker, renderer::MemoryCategory::Geometry,
+                                             owner, allocator);
+        buffer.bindMemory(*memory, 0);
+        return {std::move(buffer), std::move(memory)};
+    }
+
+    vk::raii::Pipeline ParticleSystem::createComputePipeline(const vk::ShaderModule shader_module,
+                                                             const char* entry) const
+    {
+        const vk::PipelineShaderStageCreateInfo stage_info({}, vk::ShaderStageFlagBits::eCompute, shader_module,
+                                                           entry);
+        return device.createComputePipeline(nullptr, vk::ComputePipelineCreateInfo({}, stage_info, pipelineLayout),
+                                            allocator);
+    }
+} // particles
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "../Renderer/MemoryTracker.h"
+#include "../Renderer/PipelineManager.h"
+
+namespace particles
+{
+    // A fountain of up to capacity particles that lives entirely on the GPU. Compute shaders integrate the particles,
+    // compact the survivors into the other of two buffers and emit new ones behind them, then write the indirect
+    // arguments of the draw and of the next frame's integration, so the CPU never learns how many are alive. The task
+    // and mesh stages draw them as additive quads, one workgroup per 32. The first update fills the whole capacity with
+    // particles of every age, after it new ones replace the ones that die at capacity / lifetime per second.
+    class ParticleSystem
+    {
+    public:
+        // Needs VK_EXT_mesh_shader. Draws into subpass 0 of render_pass and of the render passes compatible with it.
+        // The buffers are shared between queue_families, those of the update's queue and of the draw's.
+        // Throws std::runtime_error if the device cannot bind capacity particles in one storage buffer.
+        ParticleSystem(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physical_device,
+                       renderer::MemoryTracker& memory_tracker, renderer::PipelineManager& pipeline_manager,
+                       vk::RenderPass render_pass, uint32_t capacity, std::span<const uint32_t> queue_families,
+                       vk::Optional<const vk::AllocationCallbacks> allocator = nullptr);
+
+        ParticleSystem(const ParticleSystem&) = delete;
+        ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+        // Advances the particles by the time since the last update, on a queue with compute support. Updates are
+        // expected to execute in the order they are recorded, on one queue. The caller orders them against the draws:
+        // an update waits for the last draw, and the draw for its update at eDrawIndirect and the task and mesh
+        // stages, through semaphores when the queues differ.
+        void recordUpdate(const vk::raii::CommandBuffer& command_buffer);
+
+        // Draws what the last recordUpdate left, inside a render pass. Viewport and scissor are set by the caller.
+        void recordDraw(const vk::raii::CommandBuffer& command_buffer);
+
+        [[nodiscard]] uint32_t getCapacity() const;
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        const vk::raii::Device& device;
+        const vk::raii::PhysicalDevice& physicalDevice;
+        renderer::MemoryTracker& memoryTracker;
+        renderer::PipelineManager& pipelineManager;
+        uint32_t capacity;
+        std::vector<uint32_t> queueFamilies; // Sorted and unique
+        vk::Optional<const vk::AllocationCallbacks> allocator;
+
+        // The two sides of the ping-pong, each holding capacity particles
+        std::array<vk::raii::Buffer, 2> particleBuffers{nullptr, nullptr};
+        std::array<renderer::TrackedDeviceMemory, 2> particleMemories{nullptr, nullptr};
+        vk::raii::Buffer counterBuffer = nullptr;
+        renderer::TrackedDeviceMemory counterMemory = nullptr;
+
+        vk::raii::DescriptorSetLayout descriptorSetLayout = nullptr;
+        vk::raii::PipelineLayout pipelineLayout = nullptr;
+        vk::raii::DescriptorPool descriptorPool = nullptr;
+        // One per parity, the second binds the buffers the other way round
+        vk::raii::DescriptorSets descriptorSets = nullptr;
+        vk::raii::Pipeline simulatePipeline = nullptr;
+        vk::raii::Pipeline emitPipeline = nullptr;
+        vk::raii::Pipeline preparePipeline = nullptr;
+        renderer::PipelineHandle drawPipeline;
+
+        uint32_t parity = 0; // Which buffer the last update wrote to
+        bool cleared = false; // The counters start out undefined, the first update clears them and fills the buffer
+        Clock::time_point lastUpdate;
+        double emitCarry = 0.0; // Fraction of a particle left over from the last update's emission
+        uint32_t seed = 0;
+
+        [[nodiscard]] std::pair<vk::raii::Buffer, renderer::TrackedDeviceMemory> createBuffer(
+            vk::DeviceSize size, vk::BufferUsageFlags usage, std::string_view owner) const;
+
+        [[nodiscard]] vk::raii::Pipeline createComputePipeline(vk::ShaderModule shader_module,
+                                                               const char* entry) const;
+    };
+} // particles
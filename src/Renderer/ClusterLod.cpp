@@ -0,0 +1,396 @@
+#include "ClusterLod.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+// Clusters merged into one group, simplified to about half. Larger groups lock a smaller share of their vertices.
+constexpr size_t cluster_group_size = 8;
+// A group whose triangle count shrinks by less than this is not worth another level, its clusters stay the coarsest
+constexpr float min_group_reduction = 0.15f;
+
+constexpr uint32_t unowned = UINT32_MAX;
+constexpr uint32_t shared = UINT32_MAX - 1;
+
+namespace
+{
+    struct Triangle
+    {
+        std::array<uint32_t, 3> vertices; // Welded positions
+        // Per corner, a collapse moves the corner's position but keeps its color
+        std::array<glm::vec3, 3> colors;
+
+        [[nodiscard]] bool contains(const uint32_t vertex) const
+        {
+            return vertices[0] == vertex || vertices[1] == vertex || vertices[2] == vertex;
+        }
+    };
+
+    // Triangles of an emitted cluster, kept while the levels above it are built
+    struct BuildCluster
+    {
+        std::vector<Triangle> triangles;
+        glm::vec2 center;
+    };
+
+    struct Collapse
+    {
+        uint32_t from;
+        uint32_t to;
+        float cost;
+    };
+}
+
+static uint32_t spread_bits(uint32_t value)
+{
+    value &= 0xFFFF;
+    value = (value | value << 8) & 0x00FF00FF;
+    value = (value | value << 4) & 0x0F0F0F0F;
+    value = (value | value << 2) & 0x33333333;
+    value = (value | value << 1) & 0x55555555;
+    return value;
+}
+
+// Orders the points along a Z-order curve, so consecutive ones are close together
+static std::vector<uint32_t> morton_order(const std::vector<glm::vec2>& points)
+{
+    glm::vec2 low(std::numeric_limits<float>::max());
+    glm::vec2 high(std::numeric_limits<float>::lowest());
+    for (const auto& point : points)
+    {
+        low = glm::min(low, point);
+        high = glm::max(high, point);
+    }
+    const glm::vec2 scale = glm::vec2(65535.0f) / glm::max(high - low, glm::vec2(1e-20f));
+
+    std::vector<std::pair<uint32_t, uint32_t>> keys(points.size());
+    for (uint32_t i = 0; i < points.size(); i++)
+    {
+        const glm::vec2 cell = (points[i] - low) * scale;
+        keys[i] = {spread_bits(static_cast<uint32_t>(cell.x)) | spread_bits(static_cast<uint32_t>(cell.y)) << 1, i};
+    }
+    std::ranges::sort(keys);
+
+    std::vector<uint32_t> order(points.size());
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        order[i] = keys[i].second;
+    }
+    return order;
+}
+
+static glm::vec2 triangle_center(const Triangle& triangle, const std::vector<glm::vec2>& positions)
+{
+    return (positions[triangle.vertices[0]] + positions[triangle.vertices[1]] + positions[triangle.vertices[2]]) /
+        3.0f;
+}
+
+static float signed_area(const glm::vec2 a, const glm::vec2 b, const glm::vec2 c)
+{
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+// Collapses the shortest edges until at most target_count triangles are left. Locked vertices never move, vertices on
+// the open border only slide along it and no collapse may flip or flatten a triangle. Every point moves at most as far
+// as the longest collapsed edge, which is returned.
+static float simplify(std::vector<Triangle>& triangles, const std::vector<glm::vec2>& positions,
+                      const std::vector<bool>& locked, const size_t target_count)
+{
+    float error = 0.0f;
+    std::vector<bool> removed(triangles.size());
+    size_t live = triangles.size();
+
+    // Each pass collapses edges whose neighbourhoods do not overlap, then the adjacency is rebuilt
+    while (live > target_count)
+    {
+        std::unordered_map<uint32_t, std::vector<uint32_t>> adjacency;
+        std::unordered_map<uint64_t, uint32_t> edge_uses;
+        for (uint32_t t = 0; t < triangles.size(); t++)
+        {
+            if (removed[t])
+                continue;
+
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                const uint32_t a = triangles[t].vertices[corner];
+                const uint32_t b = triangles[t].vertices[(corner + 1) % 3];
+                adjacency[a].push_back(t);
+                edge_uses[static_cast<uint64_t>(std::min(a, b)) << 32 | std::max(a, b)]++;
+            }
+        }
+
+        std::unordered_set<uint32_t> border;
+        for (const auto& [edge, uses] : edge_uses)
+        {
+            if (uses == 1)
+            {
+                border.insert(static_cast<uint32_t>(edge >> 32));
+                border.insert(static_cast<uint32_t>(edge));
+            }
+        }
+
+        std::vector<Collapse> collapses;
+        for (const auto& [edge, uses] : edge_uses)
+        {
+            const auto a = static_cast<uint32_t>(edge >> 32);
+            const auto b = static_cast<uint32_t>(edge);
+            if (a == b)
+                continue;
+
+            const float cost = glm::distance(positions[a], positions[b]);
+            if (!locked[a] && (uses == 1 || !border.contains(a)))
+                collapses.push_back({a, b, cost});
+            if (!locked[b] && (uses == 1 || !border.contains(b)))
+                collapses.push_back({b, a, cost});
+        }
+        std::ranges::sort(collapses, {}, &Collapse::cost);
+
+        std::unordered_set<uint32_t> touched;
+        bool progress = false;
+        for (const auto& collapse : collapses)
+        {
+            if (live <= target_count)
+                break;
+            if (touched.contains(collapse.from) || touched.contains(collapse.to))
+                continue;
+
+            const auto& around = adjacency[collapse.from];
+            const bool flips = std::ranges::any_of(around, [&](const uint32_t t)
+            {
+                const Triangle& triangle = triangles[t];
+                if (triangle.contains(collapse.to))
+                    return false;
+
+                std::array<glm::vec2, 3> corners;
+                for (uint32_t corner = 0; corner < 3; corner++)
+                {
+                    corners[corner] = positions[triangle.vertices[corner]];
+                }
+                const float before = signed_area(corners[0], corners[1], corners[2]);
+                for (uint32_t corner = 0; corner < 3; corner++)
+                {
+                    if (triangle.vertices[corner] == collapse.from)
+                        corners[corner] = positions[collapse.to];
+                }
+                return before * signed_area(corners[0], corners[1], corners[2]) <= 0.0f;
+            });
+            if (flips)
+                continue;
+
+            for (const uint32_t t : around)
+            {
+                Triangle& triangle = triangles[t];
+                for (const uint32_t vertex : triangle.vertices)
+                {
+                    touched.insert(vertex);
+                }
+
+                if (triangle.contains(collapse.to))
+                {
+                    removed[t] = true;
+                    live--;
+                }
+                else
+                {
+                    std::ranges::replace(triangle.vertices, collapse.from, collapse.to);
+                }
+            }
+
+            error = std::max(error, collapse.cost);
+            progress = true;
+        }
+
+        if (!progress)
+            break;
+    }
+
+    size_t kept = 0;
+    for (size_t t = 0; t < triangles.size(); t++)
+    {
+        if (!removed[t])
+            triangles[kept++] = triangles[t];
+    }
+    triangles.resize(kept);
+
+    return error;
+}
+
+namespace renderer
+{
+    ClusterLod build_cluster_lod(const std::span<const Vertex> triangles)
+    {
+        ClusterLod lod;
+        const size_t triangle_count = triangles.size() / 3;
+        if (triangle_count == 0)
+            return lod;
+
+        // Corners at the same position share a vertex, whatever their colors, so collapses keep the mesh connected
+        std::vector<glm::vec2> positions;
+        std::unordered_map<uint64_t, uint32_t> position_indices;
+        std::vector<Triangle> input(triangle_count);
+        for (size_t t = 0; t < triangle_count; t++)
+        {
+            for (uint32_t corner = 0; corner < 3; corner++)
+            {
+                const Vertex& vertex = triangles[t * 3 + corner];
+                // Adding zero turns -0 into 0, so both weld
+                const uint64_t key = static_cast<uint64_t>(std::bit_cast<uint32_t>(vertex.position.x + 0.0f)) << 32 |
+                    std::bit_cast<uint32_t>(vertex.position.y + 0.0f);
+
+                const auto [entry, inserted] =
+                    position_indices.try_emplace(key, static_cast<uint32_t>(positions.size()));
+                if (inserted)
+                    positions.push_back(vertex.position);
+
+                input[t].vertices[corner] = entry->second;
+                input[t].colors[corner] = vertex.color;
+            }
+        }
+
+        std::vector<BuildCluster> built;
+        std::vector<uint32_t> emitted;
+
+        // Appends the triangles as clusters of nearby ones, their indices in lod.clusters go to emitted
+        const auto emit_clusters = [&](const std::vector<Triangle>& cluster_triangles, const float error)
+        {
+            std::vector<glm::vec2> centers(cluster_triangles.size());
+            for (size_t t = 0; t < cluster_triangles.size(); t++)
+            {
+                centers[t] = triangle_center(cluster_triangles[t], positions);
+            }
+            const std::vector<uint32_t> order = morton_order(centers);
+
+            for (size_t first = 0; first < order.size(); first += cluster_triangle_limit)
+            {
+                const size_t count = std::min<size_t>(cluster_triangle_limit, order.size() - first);
+
+                BuildCluster cluster{{}, glm::vec2(0.0f)};
+                Cluster& emitted_cluster = lod.clusters.emplace_back(Cluster{
+                    static_cast<uint32_t>(lod.vertices.size()), static_cast<uint32_t>(count), error,
+                    std::numeric_limits<float>::infinity(), glm::vec2(std::numeric_limits<float>::max()),
+                    glm::vec2(std::numeric_limits<float>::lowest())
+                });
+                for (size_t i = first; i < first + count; i++)
+                {
+                    const Triangle& triangle = cluster_triangles[order[i]];
+                    for (uint32_t corner = 0; corner < 3; corner++)
+                    {
+                        const glm::vec2 position = positions[triangle.vertices[corner]];
+                        emitted_cluster.boundsMin = glm::min(emitted_cluster.boundsMin, position);
+                        emitted_cluster.boundsMax = glm::max(emitted_cluster.boundsMax, position);
+                        lod.vertices.push_back({position, triangle.colors[corner]});
+                    }
+                    cluster.triangles.push_back(triangle);
+                    cluster.center = cluster.center + centers[order[i]];
+                }
+                cluster.center = cluster.center / static_cast<float>(count);
+
+                emitted.push_back(static_cast<uint32_t>(built.size()));
+                built.push_back(std::move(cluster));
+            }
+        };
+
+        emit_clusters(input, 0.0f);
+        lod.baseVertexCount = static_cast<uint32_t>(lod.vertices.size());
+        lod.levelCount = 1;
+        // Collapses only ever move vertices onto others, so the full resolution bounds hold for every level
+        lod.boundsMin = lod.boundsMax = positions.front();
+        for (const glm::vec2 position : positions)
+        {
+            lod.boundsMin = glm::min(lod.boundsMin, position);
+            lod.boundsMax = glm::max(lod.boundsMax, position);
+        }
+        const size_t vertex_limit = lod.vertices.size() * cluster_lod_vertex_factor;
+
+        // Clusters of the current level, covering the whole mesh, which is what tells a group which of its vertices
+        // others use too. Those in groups that could not be simplified join the next level, whose groups differ.
+        std::vector<uint32_t> active = std::exchange(emitted, {});
+        std::vector<uint32_t> owners;
+        std::vector<bool> locked;
+
+        while (!active.empty())
+        {
+            std::vector<glm::vec2> centers(active.size());
+            for (size_t i = 0; i < active.size(); i++)
+            {
+                centers[i] = built[active[i]].center;
+            }
+            const std::vector<uint32_t> order = morton_order(centers);
+            const size_t group_count = (order.size() + cluster_group_size - 1) / cluster_group_size;
+
+            owners.assign(positions.size(), unowned);
+            for (size_t i = 0; i < order.size(); i++)
+            {
+                const auto group = static_cast<uint32_t>(i / cluster_group_size);
+                for (const auto& triangle : built[active[order[i]]].triangles)
+                {
+                    for (const uint32_t vertex : triangle.vertices)
+                    {
+                        if (owners[vertex] == unowned)
+                            owners[vertex] = group;
+                        else if (owners[vertex] != group)
+                            owners[vertex] = shared;
+                    }
+                }
+            }
+            locked.assign(positions.size(), false);
+            for (size_t vertex = 0; vertex < positions.size(); vertex++)
+            {
+                locked[vertex] = owners[vertex] == shared;
+            }
+
+            std::vector<uint32_t> carried;
+            bool simplified = false;
+            for (size_t group = 0; group < group_count; group++)
+            {
+                const size_t first = group * cluster_group_size;
+                const size_t last = std::min(first + cluster_group_size, order.size());
+
+                std::vector<Triangle> merged;
+                float child_error = 0.0f;
+                for (size_t i = first; i < last; i++)
+                {
+                    const uint32_t cluster = active[order[i]];
+                    merged.insert(merged.end(), built[cluster].triangles.begin(), built[cluster].triangles.end());
+                    child_error = std::max(child_error, lod.clusters[cluster].error);
+                }
+
+                const size_t original_count = merged.size();
+                const float simplify_error = simplify(merged, positions, locked, original_count / 2);
+
+                const bool reduced = static_cast<float>(merged.size()) <=
+                    static_cast<float>(original_count) * (1.0f - min_group_reduction);
+                if (!reduced || lod.vertices.size() + merged.size() * 3 > vertex_limit)
+                {
+                    for (size_t i = first; i < last; i++)
+                    {
+                        carried.push_back(active[order[i]]);
+                    }
+                    continue;
+                }
+
+                // Errors add up, the new clusters are only as close to full resolution as the ones they replace
+                const float error = child_error + simplify_error;
+                for (size_t i = first; i < last; i++)
+                {
+                    lod.clusters[active[order[i]]].parentError = error;
+                }
+                emit_clusters(merged, error);
+                simplified = true;
+            }
+
+            if (!simplified)
+                break;
+
+            lod.levelCount++;
+            active = std::exchange(emitted, {});
+            active.insert(active.end(), carried.begin(), carried.end());
+        }
+
+        return lod;
+    }
+} // renderer
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "../Vertex.h"
+
+namespace renderer
+{
+    // Matches trianglesPerGroup in triangle.slang, one mesh workgroup draws one cluster
+    constexpr uint32_t cluster_triangle_limit = 32;
+    // A hierarchy holds at most this many times the vertices of the triangle list it was built from
+    constexpr uint32_t cluster_lod_vertex_factor = 3;
+
+    // Matches Cluster in triangle.slang
+    struct Cluster
+    {
+        uint32_t firstVertex; // Relative to the draw's first vertex
+        uint32_t triangleCount;
+        // Largest distance, in the units of the vertex positions, any point moved while simplifying down to this
+        // cluster. 0 for full resolution clusters.
+        float error;
+        // Error of the coarser clusters that replace this one's group, infinite when nothing does
+        float parentError;
+        // Of the cluster's vertex positions, for culling
+        glm::vec2 boundsMin;
+        glm::vec2 boundsMax;
+    };
+
+    // Clusters of every level of detail of a triangle list, their triangles stored back to back.
+    // Drawing every cluster with error <= threshold < parentError gives a crack-free mesh whose geometry is off by at
+    // most threshold, since a group's clusters all share the parentError their replacements have as error.
+    struct ClusterLod
+    {
+        std::vector<Vertex> vertices; // Full resolution clusters first
+        std::vector<Cluster> clusters;
+        uint32_t baseVertexCount = 0; // Vertices of the full resolution clusters
+        uint32_t levelCount = 0;
+        // Of every vertex, the coarser levels stay within the full resolution ones
+        glm::vec2 boundsMin{0.0f};
+        glm::vec2 boundsMax{0.0f};
+    };
+
+    // Splits the triangle list into clusters of nearby triangles, then repeatedly merges neighbouring clusters into
+    // groups, simplifies each group to about half its triangles by collapsing its shortest edges and splits the result
+    // into coarser clusters. Vertices a group shares with others stay in place, so neighbouring groups fit together at
+    // any combination of levels. Stops when no group simplifies any further or the hierarchy would outgrow
+    // cluster_lod_vertex_factor.
+    [[nodiscard]] ClusterLod build_cluster_lod(std::span<const Vertex> triangles);
+} // renderer
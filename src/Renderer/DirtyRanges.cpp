@@ -0,0 +1,100 @@
+#include "DirtyRanges.h"
+
+#include <algorithm>
+
+namespace renderer
+{
+    void DirtyRanges::add(const size_t offset, const size_t size)
+    {
+        if (size == 0)
+            return;
+
+        // Consecutive writes usually extend the previous range
+        if (!ranges.empty() && ranges.back().offset + ranges.back().size == offset)
+        {
+            ranges.back().size += size;
+            return;
+        }
+
+        if (!ranges.empty() && offset < ranges.back().offset)
+            sorted = false;
+
+        ranges.push_back({offset, size});
+    }
+
+    void DirtyRanges::coalesce(const size_t merge_gap)
+    {
+        if (ranges.size() < 2)
+            return;
+
+        if (!sorted)
+        {
+            std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) { return a.offset < b.offset; });
+            sorted = true;
+        }
+
+        size_t merged = 0;
+        for (size_t i = 1; i < ranges.size(); i++)
+        {
+            Range& last = ranges[merged];
+            const size_t last_end = last.offset + last.size;
+
+            if (ranges[i].offset <= last_end + merge_gap)
+            {
+                last.size = std::max(last_end, ranges[i].offset + ranges[i].size) - last.offset;
+            }
+            else
+            {
+                ranges[++merged] = ranges[i];
+            }
+        }
+        ranges.resize(merged + 1);
+    }
+
+    size_t DirtyRanges::take(const size_t max_bytes, std::pmr::vector<Range>& taken)
+    {
+        size_t total = 0;
+        size_t consumed = 0;
+
+        for (; consumed < ranges.size() && total < max_bytes; consumed++)
+        {
+            Range& range = ranges[consumed];
+            const size_t size = std::min(range.size, max_bytes - total);
+
+            taken.push_back({range.offset, size});
+            total += size;
+
+            if (size < range.size)
+            {
+                // Keep the remainder for the next upload
+                range.offset += size;
+                range.size -= size;
+                break;
+            }
+        }
+
+        ranges.erase(ranges.begin(), ranges.begin() + static_cast<std::ptrdiff_t>(consumed));
+        return total;
+    }
+
+    bool DirtyRanges::empty() const
+    {
+        return ranges.empty();
+    }
+
+    size_t DirtyRanges::getPendingBytes() const
+    {
+        size_t total = 0;
+        for (const auto& range : ranges)
+        {
+            total += range.size;
+        }
+        return total;
+    }
+
+    void DirtyRanges::clear()
+    {
+        ranges.clear();
+        sorted = true;
+    }
+} // renderer
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <vector>
+
+namespace renderer
+{
+    // Byte ranges of a GPU buffer whose CPU copy changed since they were last uploaded
+    class DirtyRanges
+    {
+    public:
+        struct Range
+        {
+            size_t offset;
+            size_t size;
+        };
+
+        void add(size_t offset, size_t size);
+
+        // Sorts the pending ranges and merges the ones that overlap or are at most merge_gap bytes apart. Re-copying a
+        // small clean gap is cheaper than an extra copy region.
+        void coalesce(size_t merge_gap = 0);
+
+        // Moves up to max_bytes worth of pending ranges into taken, splitting the last range if it does not fit.
+        // Returns the number of bytes taken. taken is usually a per-frame list on a FrameArena.
+        size_t take(size_t max_bytes, std::pmr::vector<Range>& taken);
+
+        [[nodiscard]] bool empty() const;
+
+        [[nodiscard]] size_t getPendingBytes() const;
+
+        void clear();
+
+    private:
+        std::vector<Range> ranges;
+        bool sorted = true;
+    };
+} // renderer
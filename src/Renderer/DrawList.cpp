@@ -0,0 +1,232 @@
+#include "DrawList.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace renderer
+{
+    // Every cluster holds at least one triangle
+    DrawList::DrawList(const uint32_t vertex_capacity) : vertices(vertex_capacity * cluster_lod_vertex_factor),
+                                                         clusters(vertex_capacity * cluster_lod_vertex_factor / 3)
+    {
+        freeBlocks.push_back({0, static_cast<uint32_t>(vertices.size())});
+        if (!clusters.empty())
+            freeClusterBlocks.push_back({0, static_cast<uint32_t>(clusters.size())});
+    }
+
+    DrawHandle DrawList::add(const Drawable& drawable)
+    {
+        return add(drawable.pack());
+    }
+
+    DrawHandle DrawList::add(const std::span<const Vertex> packed)
+    {
+        const ClusterLod lod = build_cluster_lod(packed);
+
+        // Placed before it takes an entry, so a drawable that does not fit leaves the list as it was
+        Entry placed;
+        place(placed, lod);
+
+        uint32_t index;
+        if (freeEntries.empty())
+        {
+            index = static_cast<uint32_t>(entries.size());
+            entries.emplace_back();
+        }
+        else
+        {
+            index = freeEntries.back();
+            freeEntries.pop_back();
+        }
+
+        Entry& entry = entries[index];
+        placed.generation = entry.generation;
+        placed.live = true;
+        entry = placed;
+        write(entry, lod);
+
+        return {index, entry.generation};
+    }
+
+    void DrawList::update(const DrawHandle handle, const Drawable& drawable)
+    {
+        update(handle, drawable.pack());
+    }
+
+    void DrawList::update(const DrawHandle handle, const std::span<const Vertex> packed)
+    {
+        Entry& entry = getEntry(handle);
+        const ClusterLod lod = build_cluster_lod(packed);
+
+        // Placed in a copy, so a drawable that no longer fits keeps its old geometry and ranges
+        Entry placed = entry;
+        place(placed, lod);
+        entry = placed;
+        write(entry, lod);
+    }
+
+    void DrawList::remove(const DrawHandle handle)
+    {
+        Entry& entry = getEntry(handle);
+
+        // The stale vertices and clusters are no longer drawn, so there is nothing to upload
+        release(freeBlocks, entry.draw.firstVertex, entry.capacity);
+        release(freeClusterBlocks, entry.draw.firstCluster, entry.clusterCapacity);
+
+        entry = {.generation = entry.generation + 1};
+        freeEntries.push_back(handle.index);
+    }
+
+    bool DrawList::contains(const DrawHandle handle) const
+    {
+        return handle.index < entries.size() && entries[handle.index].live &&
+            entries[handle.index].generation == handle.generation;
+    }
+
+    DrawList::Draw DrawList::getDraw(const DrawHandle handle) const
+    {
+        if (!contains(handle))
+            throw std::invalid_argument("Invalid draw handle");
+
+        return entries[handle.index].draw;
+    }
+
+    std::span<const Vertex> DrawList::getVertices() const
+    {
+        return vertices;
+    }
+
+    uint32_t DrawList::getVertexCapacity() const
+    {
+        return static_cast<uint32_t>(vertices.size());
+    }
+
+    std::span<const Cluster> DrawList::getClusters() const
+    {
+        return clusters;
+    }
+
+    uint32_t DrawList::getClusterCapacity() const
+    {
+        return static_cast<uint32_t>(clusters.size());
+    }
+
+    DirtyRanges& DrawList::getDirtyRanges()
+    {
+        return dirtyRanges;
+    }
+
+    DirtyRanges& DrawList::getClusterDirtyRanges()
+    {
+        return clusterDirtyRanges;
+    }
+
+    DrawList::Entry& DrawList::getEntry(const DrawHandle handle)
+    {
+        if (!contains(handle))
+            throw std::invalid_argument("Invalid draw handle");
+
+        return entries[handle.index];
+    }
+
+    void DrawList::place(Entry& entry, const ClusterLod& lod)
+    {
+        // Both new ranges are allocated before either old one is released, so a throw leaves the entry and the free
+        // lists as they were
+        const auto vertex_count = static_cast<uint32_t>(lod.vertices.size());
+        const bool grow_vertices = vertex_count > entry.capacity;
+        const uint32_t first_vertex = grow_vertices ? allocate(freeBlocks, vertex_count) : entry.draw.firstVertex;
+
+        const auto cluster_count = static_cast<uint32_t>(lod.clusters.size());
+        const bool grow_clusters = cluster_count > entry.clusterCapacity;
+        uint32_t first_cluster = entry.draw.firstCluster;
+        if (grow_clusters)
+        {
+            try
+            {
+                first_cluster = allocate(freeClusterBlocks, cluster_count);
+            }
+            catch (...)
+            {
+                if (grow_vertices)
+                    release(freeBlocks, first_vertex, vertex_count);
+                throw;
+            }
+        }
+
+        if (grow_vertices)
+        {
+            release(freeBlocks, entry.draw.firstVertex, entry.capacity);
+            entry.draw.firstVertex = first_vertex;
+            entry.capacity = vertex_count;
+        }
+        if (grow_clusters)
+        {
+            release(freeClusterBlocks, entry.draw.firstCluster, entry.clusterCapacity);
+            entry.draw.firstCluster = first_cluster;
+            entry.clusterCapacity = cluster_count;
+        }
+
+        entry.draw.vertexCount = lod.baseVertexCount;
+        entry.draw.clusterCount = cluster_count;
+        entry.draw.boundsMin = lod.boundsMin;
+        entry.draw.boundsMax = lod.boundsMax;
+    }
+
+    uint32_t DrawList::allocate(std::vector<FreeBlock>& blocks, const uint32_t count)
+    {
+        if (count == 0)
+            return 0;
+
+        for (auto block = blocks.begin(); block != blocks.end(); ++block)
+        {
+            if (block->count < count)
+                continue;
+
+            const uint32_t first = block->first;
+            block->first += count;
+            block->count -= count;
+            if (block->count == 0)
+                blocks.erase(block);
+
+            return first;
+        }
+
+        throw std::runtime_error("Draw list is out of space");
+    }
+
+    void DrawList::release(std::vector<FreeBlock>& blocks, const uint32_t first, const uint32_t count)
+    {
+        if (count == 0)
+            return;
+
+        auto next = std::lower_bound(blocks.begin(), blocks.end(), first,
+                                     [](const FreeBlock& block, const uint32_t value) { return block.first < value; });
+        next = blocks.insert(next, {first, count});
+
+        // Merge with the following block, then with the preceding one
+        if (const auto following = next + 1;
+            following != blocks.end() && next->first + next->count == following->first)
+        {
+            next->count += following->count;
+            blocks.erase(following);
+        }
+        if (next != blocks.begin())
+        {
+            if (const auto preceding = next - 1; preceding->first + preceding->count == next->first)
+            {
+                preceding->count += next->count;
+                blocks.erase(next);
+            }
+        }
+    }
+
+    void DrawList::write(const Entry& entry, const ClusterLod& lod)
+    {
+        std::ranges::copy(lod.vertices, vertices.begin() + entry.draw.firstVertex);
+        dirtyRanges.add(entry.draw.firstVertex * sizeof(Vertex), lod.vertices.size() * sizeof(Vertex));
+
+        std::ranges::copy(lod.clusters, clusters.begin() + entry.draw.firstCluster);
+        clusterDirtyRanges.add(entry.draw.firstCluster * sizeof(Cluster), lod.clusters.size() * sizeof(Cluster));
+    }
+} // renderer
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "ClusterLod.h"
+#include "DirtyRanges.h"
+#include "../Drawable.h"
+
+namespace renderer
+{
+    struct DrawHandle
+    {
+        static constexpr uint32_t invalid = UINT32_MAX;
+
+        uint32_t index = invalid;
+        uint32_t generation = 0;
+
+        [[nodiscard]] bool isValid() const { return index != invalid; }
+    };
+
+    // Keeps the packed geometry of every drawable in one vertex arena mirroring the GPU vertex buffer, along with the
+    // clusters of its level of detail hierarchy in a cluster arena mirroring the GPU cluster buffer.
+    // Handles stay valid until remove(), whatever happens to other entries, and every change only marks the bytes it
+    // touched so the renderer can upload just those.
+    class DrawList
+    {
+    public:
+        struct Draw
+        {
+            uint32_t firstVertex;
+            uint32_t vertexCount; // Of the full resolution triangles, the coarser levels follow them
+            uint32_t firstCluster;
+            uint32_t clusterCount;
+            // Of every level, for culling the whole draw
+            glm::vec2 boundsMin;
+            glm::vec2 boundsMax;
+        };
+
+        // vertex_capacity counts full resolution vertices, the arena makes room for the coarser levels on top
+        explicit DrawList(uint32_t vertex_capacity);
+
+        DrawHandle add(const Drawable& drawable);
+        DrawHandle add(std::span<const Vertex> packed);
+
+        // Re-packs the drawable and rebuilds its hierarchy, in place when both still fit their allocations
+        void update(DrawHandle handle, const Drawable& drawable);
+        void update(DrawHandle handle, std::span<const Vertex> packed);
+
+        void remove(DrawHandle handle);
+
+        [[nodiscard]] bool contains(DrawHandle handle) const;
+
+        [[nodiscard]] Draw getDraw(DrawHandle handle) const;
+
+        [[nodiscard]] std::span<const Vertex> getVertices() const;
+
+        [[nodiscard]] uint32_t getVertexCapacity() const;
+
+        [[nodiscard]] std::span<const Cluster> getClusters() const;
+
+        [[nodiscard]] uint32_t getClusterCapacity() const;
+
+        // Calls function(draw) for every live entry
+        template <class F>
+        void forEachDraw(F&& function) const
+        {
+            for (const auto& entry : entries)
+            {
+                if (entry.live && entry.draw.vertexCount > 0)
+                    function(entry.draw);
+            }
+        }
+
+        // Calls function(handle, draw) for every live entry, including empty ones
+        template <class F>
+        void forEachHandle(F&& function) const
+        {
+            for (uint32_t i = 0; i < entries.size(); i++)
+            {
+                if (entries[i].live)
+                    function(DrawHandle{i, entries[i].generation}, entries[i].draw);
+            }
+        }
+
+        DirtyRanges& getDirtyRanges();
+        DirtyRanges& getClusterDirtyRanges();
+
+    private:
+        struct Entry
+        {
+            Draw draw{};
+            uint32_t capacity = 0;
+            uint32_t clusterCapacity = 0;
+            uint32_t generation = 0;
+            bool live = false;
+        };
+
+        struct FreeBlock
+        {
+            uint32_t first;
+            uint32_t count;
+        };
+
+        std::vector<Vertex> vertices;
+        std::vector<Entry> entries;
+        std::vector<uint32_t> freeEntries;
+        std::vector<FreeBlock> freeBlocks; // Sorted by first vertex
+        std::vector<Cluster> clusters;
+        std::vector<FreeBlock> freeClusterBlocks; // Sorted by first cluster
+
+        DirtyRanges dirtyRanges;
+        DirtyRanges clusterDirtyRanges;
+
+        [[nodiscard]] Entry& getEntry(DrawHandle handle);
+
+        // Places the hierarchy, reallocating the entry's ranges where it no longer fits. Throws before changing the
+        // entry or the free lists when it does not fit at all.
+        void place(Entry& entry, const ClusterLod& lod);
+
+        static uint32_t allocate(std::vector<FreeBlock>& blocks, uint32_t count);
+
+        static void release(std::vector<FreeBlock>& blocks, uint32_t first, uint32_t count);
+
+        void write(const Entry& entry, const ClusterLod& lod);
+    };
+} // renderer
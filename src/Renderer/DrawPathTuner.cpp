@@ -0,0 +1,77 @@
+#include "DrawPathTuner.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace renderer
+{
+    DrawPathTuner::DrawPathTuner(const uint32_t candidates, const uint32_t warmup_frames,
+                                 const uint32_t trial_frames)
+        : candidates(candidates), warmupFrames(warmup_frames), trialFrames(trial_frames),
+          samples(static_cast<size_t>(candidates) * trial_frames), sampleCounts(candidates, 0), medians(candidates, 0.0)
+    {
+        if (candidates == 0 || trial_frames == 0)
+            throw std::invalid_argument("Tuning needs at least one candidate and one trial frame");
+    }
+
+    uint32_t DrawPathTuner::getCandidate(const uint64_t frame) const
+    {
+        if (decided)
+            return choice;
+
+        const uint64_t turn = frame / (warmupFrames + trialFrames);
+        return static_cast<uint32_t>(std::min<uint64_t>(turn, candidates - 1));
+    }
+
+    bool DrawPathTuner::update(const uint64_t frame, const double gpu_ms, const float frame_scale)
+    {
+        if (decided)
+            return false;
+
+        const uint64_t turn = frame / (warmupFrames + trialFrames);
+        const bool measured = turn < candidates && frame % (warmupFrames + trialFrames) >= warmupFrames;
+        if (measured && gpu_ms > 0.0 && frame_scale > 0.0f && sampleCounts[turn] < trialFrames)
+        {
+            samples[turn * trialFrames + sampleCounts[turn]++] =
+                gpu_ms / (static_cast<double>(frame_scale) * frame_scale);
+        }
+
+        // Frames without timestamps leave gaps, so a trial is also over once frames after all of them complete
+        const bool complete = std::ranges::all_of(sampleCounts, [this](const uint32_t count)
+        {
+            return count == trialFrames;
+        });
+        const bool past_trials = turn >= candidates && std::ranges::none_of(sampleCounts, [](const uint32_t count)
+        {
+            return count == 0;
+        });
+        if (!complete && !past_trials)
+            return false;
+
+        for (uint32_t i = 0; i < candidates; i++)
+        {
+            const auto first = samples.begin() + static_cast<ptrdiff_t>(i) * trialFrames;
+            const auto middle = first + sampleCounts[i] / 2;
+            std::nth_element(first, middle, first + sampleCounts[i]);
+            medians[i] = *middle;
+        }
+        choice = static_cast<uint32_t>(std::ranges::min_element(medians) - medians.begin());
+        decided = true;
+        return true;
+    }
+
+    bool DrawPathTuner::isDecided() const
+    {
+        return decided;
+    }
+
+    uint32_t DrawPathTuner::getChoice() const
+    {
+        return choice;
+    }
+
+    double DrawPathTuner::getMedianMs(const uint32_t candidate) const
+    {
+        return medians[candidate];
+    }
+} // renderer
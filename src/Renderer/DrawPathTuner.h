@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace renderer
+{
+    // Picks the fastest of several ways to draw the same frames from their measured GPU times. Candidates take turns
+    // for warmup_frames + trial_frames frames each, the warmup lets caches and clocks settle after a switch and is not
+    // measured. Like ResolutionController, every time is divided by the square of its frame's render scale, so a scale
+    // change during the trials does not favour one candidate. The one with the lowest median wins.
+    class DrawPathTuner
+    {
+    public:
+        DrawPathTuner(uint32_t candidates, uint32_t warmup_frames, uint32_t trial_frames);
+
+        // The candidate frame draws with, frames counting from 0. The winner once it is decided, the last candidate
+        // while the final trials are still in flight.
+        [[nodiscard]] uint32_t getCandidate(uint64_t frame) const;
+
+        // Feeds the GPU time of a completed frame rendered at frame_scale, returns whether it decided the winner
+        bool update(uint64_t frame, double gpu_ms, float frame_scale);
+
+        [[nodiscard]] bool isDecided() const;
+
+        [[nodiscard]] uint32_t getChoice() const;
+
+        // Median full scale GPU frame time of candidate's trial, 0 until it is decided
+        [[nodiscard]] double getMedianMs(uint32_t candidate) const;
+
+    private:
+        uint32_t candidates;
+        uint32_t warmupFrames;
+        uint32_t trialFrames;
+
+        // trialFrames per candidate, allocated up front
+        std::vector<double> samples;
+        std::vector<uint32_t> sampleCounts;
+        std::vector<double> medians;
+        uint32_t choice = 0;
+        bool decided = false;
+    };
+} // renderer
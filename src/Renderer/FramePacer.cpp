@@ -0,0 +1,76 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+
+// Weight of the newest sample in the moving averages
+constexpr double estimate_weight = 0.1;
+// Head room for GPU work, which the CPU side of the frame does not see
+constexpr double work_safety_factor = 1.5;
+constexpr double start_margin_ms = 1.0;
+
+[[nodiscard]] static double to_milliseconds(const renderer::FramePacer::clock::duration duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+[[nodiscard]] static double update_estimate(const double estimate, const double sample)
+{
+    return estimate == 0.0 ? sample : estimate + (sample - estimate) * estimate_weight;
+}
+
+namespace renderer
+{
+    void FramePacer::framePresented(const clock::time_point time)
+    {
+        if (hasPresented)
+        {
+            const double interval_ms = to_milliseconds(time - previousPresented);
+            intervalEstimateMs = update_estimate(intervalEstimateMs, interval_ms);
+            totalIntervalMs += interval_ms;
+            intervals++;
+            stats.meanPresentIntervalMs = totalIntervalMs / static_cast<double>(intervals);
+        }
+        previousPresented = time;
+        hasPresented = true;
+
+        // The displayed frame is the one started before the current one
+        if (hasPreviousStart)
+        {
+            const double latency_ms = to_milliseconds(time - previousStart);
+            stats.frames++;
+            totalLatencyMs += latency_ms;
+            stats.meanLatencyMs = totalLatencyMs / static_cast<double>(stats.frames);
+            stats.maxLatencyMs = std::max(stats.maxLatencyMs, latency_ms);
+            hasPreviousStart = false;
+        }
+    }
+
+    FramePacer::clock::duration FramePacer::getStartDelay() const
+    {
+        if (intervalEstimateMs == 0.0 || workEstimateMs == 0.0)
+            return clock::duration::zero();
+
+        const double delay_ms = intervalEstimateMs - workEstimateMs * work_safety_factor - start_margin_ms;
+        if (delay_ms <= 0.0)
+            return clock::duration::zero();
+
+        return std::chrono::duration_cast<clock::duration>(std::chrono::duration<double, std::milli>(delay_ms));
+    }
+
+    void FramePacer::frameStarted(const clock::time_point time)
+    {
+        currentStart = time;
+    }
+
+    void FramePacer::frameSubmitted(const clock::time_point time)
+    {
+        workEstimateMs = update_estimate(workEstimateMs, to_milliseconds(time - currentStart));
+        previousStart = currentStart;
+        hasPreviousStart = true;
+    }
+
+    FramePacer::Stats FramePacer::getStats() const
+    {
+        return stats;
+    }
+} // renderer
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace renderer
+{
+    // Decides when to start CPU work so a frame is ready just before the refresh that shows it.
+    // The caller waits for the previous frame to be displayed, reports it with framePresented(), then sleeps for
+    // getStartDelay() before starting the next one. Only one frame is ever queued for display this way.
+    class FramePacer
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        struct Stats
+        {
+            uint64_t frames = 0;
+            double meanPresentIntervalMs = 0.0;
+            // From the start of a frame's CPU work until it was displayed
+            double meanLatencyMs = 0.0;
+            double maxLatencyMs = 0.0;
+        };
+
+        void framePresented(clock::time_point time);
+
+        // Refresh interval minus the expected frame time, zero until both have been measured
+        [[nodiscard]] clock::duration getStartDelay() const;
+
+        void frameStarted(clock::time_point time);
+
+        // The frame has been handed to the presentation engine
+        void frameSubmitted(clock::time_point time);
+
+        [[nodiscard]] Stats getStats() const;
+
+    private:
+        clock::time_point previousPresented;
+        clock::time_point currentStart;
+        clock::time_point previousStart;
+        bool hasPresented = false;
+        bool hasPreviousStart = false;
+
+        // Exponential moving averages, in milliseconds
+        double intervalEstimateMs = 0.0;
+        double workEstimateMs = 0.0;
+
+        Stats stats;
+        double totalIntervalMs = 0.0;
+        double totalLatencyMs = 0.0;
+        uint64_t intervals = 0;
+    };
+} // renderer
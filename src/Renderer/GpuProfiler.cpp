@@ -0,0 +1,201 @@
+#include "GpuProfiler.h"
+
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// Converts a value of getHostTimeDomain() to steady_clock, which reads the same clock
+[[nodiscard]] static std::chrono::steady_clock::time_point to_host_time(const uint64_t value)
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    const auto ticks_per_second = static_cast<uint64_t>(frequency.QuadPart);
+    // Split so the multiplication cannot overflow
+    const uint64_t nanoseconds = value / ticks_per_second * 1'000'000'000 +
+        value % ticks_per_second * 1'000'000'000 / ticks_per_second;
+    return std::chrono::steady_clock::time_point(std::chrono::nanoseconds(nanoseconds));
+#else
+    return std::chrono::steady_clock::time_point(std::chrono::nanoseconds(value));
+#endif
+}
+
+namespace renderer
+{
+    GpuProfiler::GpuProfiler(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physical_device,
+                             const uint32_t queue_family, const uint32_t frames_in_flight,
+                             const uint32_t scope_count, const bool calibrated_timestamps) :
+        device(device), scopeCount(scope_count), calibrated(calibrated_timestamps),
+        written(static_cast<size_t>(frames_in_flight) * scope_count), durationsMs(written.size()),
+        ticks(written.size()), submitTimes(frames_in_flight)
+    {
+        const uint32_t valid_bits = physical_device.getQueueFamilyProperties()[queue_family].timestampValidBits;
+        if (valid_bits == 0)
+            return;
+
+        timestampPeriodNs = physical_device.getProperties().limits.timestampPeriod;
+        timestampMask = valid_bits >= 64 ? UINT64_MAX : (uint64_t{1} << valid_bits) - 1;
+
+        // A begin and an end timestamp per scope
+        const vk::QueryPoolCreateInfo pool_info({}, vk::QueryType::eTimestamp,
+                                                static_cast<uint32_t>(written.size()) * 2);
+        queryPool = device.createQueryPool(pool_info);
+    }
+
+    std::optional<vk::TimeDomainEXT> GpuProfiler::getHostTimeDomain()
+    {
+#ifdef _WIN32
+        return vk::TimeDomainEXT::eQueryPerformanceCounter;
+#elif defined(__linux__)
+        // steady_clock is CLOCK_MONOTONIC in both libstdc++ and libc++
+        return vk::TimeDomainEXT::eClockMonotonic;
+#else
+        return std::nullopt;
+#endif
+    }
+
+    bool GpuProfiler::isSupported() const
+    {
+        return *queryPool != nullptr;
+    }
+
+    void GpuProfiler::beginFrame(const vk::raii::CommandBuffer& command_buffer, const uint32_t frame_slot)
+    {
+        if (!isSupported())
+            return;
+
+        command_buffer.resetQueryPool(queryPool, queryIndex(frame_slot, 0), scopeCount * 2);
+        std::fill_n(written.begin() + frame_slot * scopeCount, scopeCount, uint8_t{0});
+    }
+
+    void GpuProfiler::beginScope(const vk::raii::CommandBuffer& command_buffer, const uint32_t frame_slot,
+                                 const uint32_t scope)
+    {
+        if (!isSupported())
+            return;
+
+        // Written once everything recorded before has finished, so the scope excludes earlier work
+        command_buffer.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, queryPool,
+                                       queryIndex(frame_slot, scope));
+    }
+
+    void GpuProfiler::endScope(const vk::raii::CommandBuffer& command_buffer, const uint32_t frame_slot,
+                               const uint32_t scope)
+    {
+        if (!isSupported())
+            return;
+
+        command_buffer.writeTimestamp2(vk::PipelineStageFlagBits2::eAllCommands, queryPool,
+                                       queryIndex(frame_slot, scope) + 1);
+        written[frame_slot * scopeCount + scope] = 1;
+    }
+
+    void GpuProfiler::frameSubmitted(const uint32_t frame_slot)
+    {
+        submitTimes[frame_slot] = clock::now();
+    }
+
+    void GpuProfiler::calibrate()
+    {
+        if (!calibrated || !isSupported())
+            return;
+
+        const std::array infos{
+            vk::CalibratedTimestampInfoEXT(vk::TimeDomainEXT::eDevice),
+            vk::CalibratedTimestampInfoEXT(*getHostTimeDomain()),
+        };
+        // The C entry point again, the wrapper returns its timestamps in a new vector
+        std::array<uint64_t, 2> timestamps{};
+        uint64_t max_deviation = 0;
+        const VkResult result = device.getDispatcher()->vkGetCalibratedTimestampsEXT(
+            static_cast<VkDevice>(*device), static_cast<uint32_t>(infos.size()),
+            reinterpret_cast<const VkCalibratedTimestampInfoEXT*>(infos.data()), timestamps.data(), &max_deviation);
+        if (result != VK_SUCCESS)
+            return;
+
+        calibrationTicks = timestamps[0];
+        calibrationTime = to_host_time(timestamps[1]);
+    }
+
+    void GpuProfiler::collect(const uint32_t frame_slot)
+    {
+        for (uint32_t scope = 0; scope < scopeCount; scope++)
+        {
+            const size_t slot_scope = frame_slot * scopeCount + scope;
+            durationsMs[slot_scope].reset();
+            if (!written[slot_scope])
+                continue;
+            written[slot_scope] = 0;
+
+            // Only called after the submit completed, so the results are available without waiting. Goes through
+            // the C entry point since the wrapper returns a freshly allocated vector every call.
+            std::array<uint64_t, 2> values{};
+            const VkResult result = queryPool.getDispatcher()->vkGetQueryPoolResults(
+                static_cast<VkDevice>(queryPool.getDevice()), static_cast<VkQueryPool>(*queryPool),
+                queryIndex(frame_slot, scope), 2, sizeof(values), values.data(), sizeof(uint64_t),
+                VK_QUERY_RESULT_64_BIT);
+            if (result != VK_SUCCESS)
+                continue;
+
+            const uint64_t elapsed = (values[1] - values[0]) & timestampMask;
+            durationsMs[slot_scope] = static_cast<double>(elapsed) * timestampPeriodNs / 1e6;
+            ticks[slot_scope] = values;
+        }
+    }
+
+    std::optional<double> GpuProfiler::getScopeMs(const uint32_t frame_slot, const uint32_t scope) const
+    {
+        return durationsMs[frame_slot * scopeCount + scope];
+    }
+
+    std::optional<double> GpuProfiler::getOverlapMs(const uint32_t frame_slot, const uint32_t scope,
+                                                    const GpuProfiler& other, const uint32_t other_scope) const
+    {
+        const size_t slot_scope = frame_slot * scopeCount + scope;
+        const size_t other_slot_scope = frame_slot * other.scopeCount + other_scope;
+        if (!durationsMs[slot_scope] || !other.durationsMs[other_slot_scope])
+            return std::nullopt;
+
+        // Relative to the start of this scope, the counter may have wrapped in between
+        const auto offset = [&](const uint64_t value)
+        {
+            return static_cast<int64_t>(value - ticks[slot_scope][0]);
+        };
+        const int64_t start = std::max<int64_t>(0, offset(other.ticks[other_slot_scope][0]));
+        const int64_t end = std::min(offset(ticks[slot_scope][1]), offset(other.ticks[other_slot_scope][1]));
+        return end > start ? static_cast<double>(end - start) * timestampPeriodNs / 1e6 : 0.0;
+    }
+
+    std::optional<std::pair<GpuProfiler::clock::time_point, GpuProfiler::clock::time_point>>
+    GpuProfiler::getScopeTimes(const uint32_t frame_slot, const uint32_t scope) const
+    {
+        const size_t slot_scope = frame_slot * scopeCount + scope;
+        if (!durationsMs[slot_scope])
+            return std::nullopt;
+
+        // Uncalibrated, the slot's first recorded timestamp stands for its submit
+        uint64_t anchor_ticks = calibrationTicks;
+        clock::time_point anchor_time = calibrationTime;
+        if (!calibrated)
+        {
+            const size_t first_scope = frame_slot * scopeCount;
+            anchor_ticks = durationsMs[first_scope] ? ticks[first_scope][0] : ticks[slot_scope][0];
+            anchor_time = submitTimes[frame_slot];
+        }
+
+        const auto to_time = [&](const uint64_t value)
+        {
+            const auto delta = static_cast<double>(static_cast<int64_t>(value - anchor_ticks)) * timestampPeriodNs;
+            return anchor_time + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double, std::nano>(
+                delta));
+        };
+        return std::pair{to_time(ticks[slot_scope][0]), to_time(ticks[slot_scope][1])};
+    }
+
+    uint32_t GpuProfiler::queryIndex(const uint32_t frame_slot, const uint32_t scope) const
+    {
+        return (frame_slot * scopeCount + scope) * 2;
+    }
+} // renderer
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+namespace renderer
+{
+    // Timestamps around scopes of each frame's command buffer, one query range per frame in flight.
+    // A frame's results are read once its submit has completed, when its slot comes around again, so reading never
+    // stalls. Queues without timestamp support make every call a no-op and every result empty.
+    class GpuProfiler
+    {
+    public:
+        using clock = std::chrono::steady_clock;
+
+        // calibrated_timestamps tells whether VK_EXT_calibrated_timestamps is enabled with getHostTimeDomain()
+        GpuProfiler(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physical_device,
+                    uint32_t queue_family, uint32_t frames_in_flight, uint32_t scope_count,
+                    bool calibrated_timestamps = false);
+
+        // The calibrateable time domain steady_clock reads on this platform, if there is one
+        [[nodiscard]] static std::optional<vk::TimeDomainEXT> getHostTimeDomain();
+
+        [[nodiscard]] bool isSupported() const;
+
+        // Resets the slot's queries, recorded before any scope of the frame
+        void beginFrame(const vk::raii::CommandBuffer& command_buffer, uint32_t frame_slot);
+
+        void beginScope(const vk::raii::CommandBuffer& command_buffer, uint32_t frame_slot, uint32_t scope);
+        void endScope(const vk::raii::CommandBuffer& command_buffer, uint32_t frame_slot, uint32_t scope);
+
+        // Anchors the slot's timestamps on the host clock when there is no calibration
+        void frameSubmitted(uint32_t frame_slot);
+
+        // Samples the GPU and host clocks together, again every frame so drift between them does not add up
+        void calibrate();
+
+        // Reads the scopes the slot recorded, only once the GPU has finished its submit
+        void collect(uint32_t frame_slot);
+
+        // Duration of the scope in the slot's last collected frame, empty if it was not recorded
+        [[nodiscard]] std::optional<double> getScopeMs(uint32_t frame_slot, uint32_t scope) const;
+
+        // How long the scope ran at the same time as other_scope of other, a profiler of another queue of the same
+        // device, in their slots' last collected frames. Queues of one device share the timestamp counter.
+        [[nodiscard]] std::optional<double> getOverlapMs(uint32_t frame_slot, uint32_t scope, const GpuProfiler& other,
+                                                         uint32_t other_scope) const;
+
+        // When the scope ran, on the host clock. Without calibration the frame is placed at its submit, which is
+        // only an approximation since the GPU may start it later.
+        [[nodiscard]] std::optional<std::pair<clock::time_point, clock::time_point>> getScopeTimes(
+            uint32_t frame_slot, uint32_t scope) const;
+
+    private:
+        const vk::raii::Device& device;
+        vk::raii::QueryPool queryPool = nullptr;
+        uint32_t scopeCount;
+        double timestampPeriodNs = 0.0;
+        uint64_t timestampMask = 0;
+
+        bool calibrated;
+        uint64_t calibrationTicks = 0;
+        clock::time_point calibrationTime;
+
+        // Per slot, whether each scope was written since beginFrame(), then the collected durations and timestamps
+        std::vector<uint8_t> written;
+        std::vector<std::optional<double>> durationsMs;
+        std::vector<std::array<uint64_t, 2>> ticks;
+        std::vector<clock::time_point> submitTimes; // Per slot
+
+        [[nodiscard]] uint32_t queryIndex(uint32_t frame_slot, uint32_t scope) const;
+    };
+} // renderer
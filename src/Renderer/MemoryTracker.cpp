@@ -0,0 +1,244 @@
+#include "MemoryTracker.h"
+
+#include <stdexcept>
+#include <utility>
+
+// Share of a heap assumed to be available to us when the driver does not report a budget
+constexpr double estimated_budget_fraction = 0.8;
+
+// Owners are internal identifiers, only quotes and backslashes need escaping
+static void write_json_string(std::ostream& output, const std::string_view value)
+{
+    output << '"';
+    for (const char character : value)
+    {
+        if (character == '"' || character == '\\')
+            output << '\\';
+        output << character;
+    }
+    output << '"';
+}
+
+namespace renderer
+{
+    std::string_view to_string(const MemoryCategory category)
+    {
+        switch (category)
+        {
+        case MemoryCategory::Geometry:
+            return "geometry";
+        case MemoryCategory::Staging:
+            return "staging";
+        case MemoryCategory::Images:
+            return "images";
+        case MemoryCategory::Textures:
+            return "textures";
+        case MemoryCategory::Other:
+            break;
+        }
+        return "other";
+    }
+
+    uint32_t find_memory_type(const vk::PhysicalDeviceMemoryProperties& memory_properties, const uint32_t type_filter,
+                              const vk::MemoryPropertyFlags property_flags)
+    {
+        for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++)
+        {
+            if (type_filter & (1 << i) &&
+                (memory_properties.memoryTypes[i].propertyFlags & property_flags) == property_flags)
+            {
+                return i;
+            }
+        }
+
+        throw std::runtime_error("Failed to find suitable memory type");
+    }
+
+    MemoryTracker::Allocation::Allocation(MemoryTracker& tracker, const uint32_t id) : tracker(&tracker), id(id)
+    {
+    }
+
+    MemoryTracker::Allocation::~Allocation()
+    {
+        if (tracker)
+            tracker->release(id);
+    }
+
+    MemoryTracker::Allocation::Allocation(Allocation&& other) noexcept : tracker(std::exchange(other.tracker, nullptr)),
+                                                                         id(other.id)
+    {
+    }
+
+    MemoryTracker::Allocation& MemoryTracker::Allocation::operator=(Allocation&& other) noexcept
+    {
+        if (this != &other)
+        {
+            if (tracker)
+                tracker->release(id);
+            tracker = std::exchange(other.tracker, nullptr);
+            id = other.id;
+        }
+        return *this;
+    }
+
+    MemoryTracker::MemoryTracker(const vk::raii::PhysicalDevice& physical_device, const bool budget_supported) :
+        physicalDevice(physical_device), budgetSupported(budget_supported)
+    {
+        const vk::PhysicalDeviceMemoryProperties properties = physicalDevice.getMemoryProperties();
+
+        for (uint32_t i = 0; i < properties.memoryTypeCount; i++)
+        {
+            typeHeaps[i] = properties.memoryTypes[i].heapIndex;
+        }
+
+        heaps.resize(properties.memoryHeapCount);
+        for (uint32_t i = 0; i < properties.memoryHeapCount; i++)
+        {
+            heaps[i].heap = i;
+            heaps[i].deviceLocal = static_cast<bool>(properties.memoryHeaps[i].flags &
+                vk::MemoryHeapFlagBits::eDeviceLocal);
+            heaps[i].size = properties.memoryHeaps[i].size;
+        }
+
+        update();
+    }
+
+    MemoryTracker::Allocation MemoryTracker::track(const uint32_t memory_type, const vk::DeviceSize size,
+                                                   const MemoryCategory category, const std::string_view owner)
+    {
+        std::lock_guard lock(mutex);
+
+        uint32_t id;
+        if (freeRecords.empty())
+        {
+            id = static_cast<uint32_t>(records.size());
+            records.emplace_back();
+        }
+        else
+        {
+            id = freeRecords.back();
+            freeRecords.pop_back();
+        }
+
+        records[id] = {typeHeaps[memory_type], category, size, std::string(owner), true};
+        heaps[records[id].heap].tracked += size;
+        categoryUsage[static_cast<size_t>(category)] += size;
+
+        return {*this, id};
+    }
+
+    void MemoryTracker::release(const uint32_t id)
+    {
+        std::lock_guard lock(mutex);
+
+        Record& record = records[id];
+        heaps[record.heap].tracked -= record.size;
+        categoryUsage[static_cast<size_t>(record.category)] -= record.size;
+
+        record = {};
+        freeRecords.push_back(id);
+    }
+
+    void MemoryTracker::update()
+    {
+        std::lock_guard lock(mutex);
+
+        if (budgetSupported)
+        {
+            const auto properties = physicalDevice.getMemoryProperties2<
+                vk::PhysicalDeviceMemoryProperties2, vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+            const auto& budget = properties.get<vk::PhysicalDeviceMemoryBudgetPropertiesEXT>();
+
+            for (auto& heap : heaps)
+            {
+                heap.budget = budget.heapBudget[heap.heap];
+                heap.usage = budget.heapUsage[heap.heap];
+            }
+        }
+        else
+        {
+            for (auto& heap : heaps)
+            {
+                heap.budget = static_cast<vk::DeviceSize>(static_cast<double>(heap.size) * estimated_budget_fraction);
+                heap.usage = heap.tracked;
+            }
+        }
+
+        for (auto& limit : softLimits)
+        {
+            for (const auto& heap : heaps)
+            {
+                const bool exceeded = heap.budget > 0 &&
+                    static_cast<double>(heap.usage) > static_cast<double>(heap.budget) * limit.fraction;
+
+                if (exceeded && !limit.exceeded[heap.heap])
+                    limit.callback(heap);
+                limit.exceeded[heap.heap] = exceeded;
+            }
+        }
+    }
+
+    void MemoryTracker::addSoftLimit(const double fraction, SoftLimitCallback callback)
+    {
+        std::lock_guard lock(mutex);
+        softLimits.push_back({fraction, std::move(callback), std::vector<bool>(heaps.size(), false)});
+    }
+
+    std::span<const MemoryTracker::HeapStats> MemoryTracker::getHeaps() const
+    {
+        return heaps;
+    }
+
+    vk::DeviceSize MemoryTracker::getCategoryUsage(const MemoryCategory category) const
+    {
+        std::lock_guard lock(mutex);
+        return categoryUsage[static_cast<size_t>(category)];
+    }
+
+    void MemoryTracker::writeJson(std::ostream& output) const
+    {
+        std::lock_guard lock(mutex);
+
+        output << "{\"budgetExtension\":" << (budgetSupported ? "true" : "false") << ",\"heaps\":[";
+        for (size_t i = 0; i < heaps.size(); i++)
+        {
+            const HeapStats& heap = heaps[i];
+            output << (i > 0 ? "," : "") << "{\"heap\":" << heap.heap << ",\"deviceLocal\":"
+                << (heap.deviceLocal ? "true" : "false") << ",\"size\":" << heap.size << ",\"budget\":"
+                << heap.budget << ",\"usage\":" << heap.usage << ",\"tracked\":" << heap.tracked << "}";
+        }
+
+        output << "],\"categories\":{";
+        for (size_t i = 0; i < memory_category_count; i++)
+        {
+            output << (i > 0 ? "," : "");
+            write_json_string(output, to_string(static_cast<MemoryCategory>(i)));
+            output << ":" << categoryUsage[i];
+        }
+
+        output << "},\"allocations\":[";
+        bool first = true;
+        for (const auto& record : records)
+        {
+            if (!record.live)
+                continue;
+
+            output << (first ? "" : ",") << "{\"owner\":";
+            write_json_string(output, record.owner);
+            output << ",\"category\":";
+            write_json_string(output, to_string(record.category));
+            output << ",\"heap\":" << record.heap << ",\"size\":" << record.size << "}";
+            first = false;
+        }
+        output << "]}";
+    }
+
+    TrackedDeviceMemory::TrackedDeviceMemory(const vk::raii::Device& device,
+                                             const vk::MemoryAllocateInfo& allocate_info, MemoryTracker& tracker,
+                                             const MemoryCategory category, const std::string_view owner,
+                                             const vk::Optional<const vk::AllocationCallbacks> allocator) :
+        vk::raii::DeviceMemory(device, allocate_info, allocator),
+        allocation(tracker.track(allocate_info.memoryTypeIndex, allocate_info.allocationSize, category, owner))
+    {
+    }
+} // renderer
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+namespace renderer
+{
+    enum class MemoryCategory : uint8_t
+    {
+        Geometry,
+        Staging,
+        Images,
+        Textures,
+        Other,
+    };
+
+    constexpr size_t memory_category_count = 5;
+
+    [[nodiscard]] std::string_view to_string(MemoryCategory category);
+
+    // First memory type allowed by type_filter that has all of property_flags, throws if there is none
+    [[nodiscard]] uint32_t find_memory_type(const vk::PhysicalDeviceMemoryProperties& memory_properties,
+                                            uint32_t type_filter, vk::MemoryPropertyFlags property_flags);
+
+    // Accounts every device memory allocation by heap, category and owner, and compares heap usage against the
+    // budget VK_EXT_memory_budget reports. Without the extension the budget is estimated from the heap size.
+    // Soft limits call back when a heap's usage crosses a fraction of its budget, so streaming systems can evict
+    // before allocations start failing. Allocations may be tracked and released from any thread, soft limit callbacks
+    // run with the tracker locked and must not call back into it.
+    class MemoryTracker
+    {
+    public:
+        struct HeapStats
+        {
+            uint32_t heap = 0;
+            bool deviceLocal = false;
+            vk::DeviceSize size = 0;
+            vk::DeviceSize budget = 0;
+            // Process-wide usage reported by the driver, our own tracked usage without the extension
+            vk::DeviceSize usage = 0;
+            vk::DeviceSize tracked = 0;
+        };
+
+        using SoftLimitCallback = std::function<void(const HeapStats& heap)>;
+
+        // Releases its allocation from the tracker when destroyed
+        class Allocation
+        {
+        public:
+            Allocation() = default;
+            Allocation(MemoryTracker& tracker, uint32_t id);
+            ~Allocation();
+
+            Allocation(Allocation&& other) noexcept;
+            Allocation& operator=(Allocation&& other) noexcept;
+
+        private:
+            MemoryTracker* tracker = nullptr;
+            uint32_t id = 0;
+        };
+
+        MemoryTracker(const vk::raii::PhysicalDevice& physical_device, bool budget_supported);
+
+        MemoryTracker(const MemoryTracker&) = delete;
+        MemoryTracker& operator=(const MemoryTracker&) = delete;
+
+        [[nodiscard]] Allocation track(uint32_t memory_type, vk::DeviceSize size, MemoryCategory category,
+                                       std::string_view owner);
+
+        // Refreshes the driver's budget and usage figures and fires the soft limits that were crossed
+        void update();
+
+        // Calls callback once each time a heap's usage rises above fraction of its budget
+        void addSoftLimit(double fraction, SoftLimitCallback callback);
+
+        // Not synchronized, only read it while no other thread allocates
+        [[nodiscard]] std::span<const HeapStats> getHeaps() const;
+
+        [[nodiscard]] vk::DeviceSize getCategoryUsage(MemoryCategory category) const;
+
+        void writeJson(std::ostream& output) const;
+
+    private:
+        struct Record
+        {
+            uint32_t heap = 0;
+            MemoryCategory category = MemoryCategory::Other;
+            vk::DeviceSize size = 0;
+            std::string owner;
+            bool live = false;
+        };
+
+        struct SoftLimit
+        {
+            double fraction;
+            SoftLimitCallback callback;
+            std::vector<bool> exceeded; // Per heap, re-armed once usage falls back below the limit
+        };
+
+        const vk::raii::PhysicalDevice& physicalDevice;
+        bool budgetSupported;
+
+        mutable std::mutex mutex; // Guards everything below
+
+        std::array<uint32_t, VK_MAX_MEMORY_TYPES> typeHeaps{};
+        std::vector<HeapStats> heaps;
+        std::array<vk::DeviceSize, memory_category_count> categoryUsage{};
+
+        std::vector<Record> records;
+        std::vector<uint32_t> freeRecords;
+
+        std::vector<SoftLimit> softLimits;
+
+        void release(uint32_t id);
+    };
+
+    // Device memory that reports itself to a MemoryTracker for as long as it lives
+    class TrackedDeviceMemory : public vk::raii::DeviceMemory
+    {
+    public:
+        TrackedDeviceMemory(std::nullptr_t) : vk::raii::DeviceMemory(nullptr)
+        {
+        }
+
+        TrackedDeviceMemory(const vk::raii::Device& device, const vk::MemoryAllocateInfo& allocate_info,
+                            MemoryTracker& tracker, MemoryCategory category, std::string_view owner,
+                            vk::Optional<const vk::AllocationCallbacks> allocator = nullptr);
+
+    private:
+        MemoryTracker::Allocation allocation;
+    };
+} // renderer
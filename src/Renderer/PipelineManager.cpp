@@ -0,0 +1,429 @@
+#include "PipelineManager.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include "../Vertex.h"
+#include "../Trace/Trace.h"
+
+// The parts a mesh shading pipeline is made of, it has no vertex input
+constexpr vk::GraphicsPipelineLibraryFlagsEXT mesh_parts =
+    vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders |
+    vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader |
+    vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentOutputInterface;
+constexpr vk::GraphicsPipelineLibraryFlagsEXT vertex_parts =
+    mesh_parts | vk::GraphicsPipelineLibraryFlagBitsEXT::eVertexInputInterface;
+
+constexpr uint64_t fnv_offset_basis = 14695981039346656037ull;
+constexpr uint64_t fnv_prime = 1099511628211ull;
+
+// FNV-1a
+static uint64_t hash_bytes(const void* data, const size_t size, uint64_t hash = fnv_offset_basis)
+{
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * fnv_prime;
+    }
+    return hash;
+}
+
+template <class T>
+static uint64_t hash_value(const uint64_t hash, const T& value)
+{
+    return hash_bytes(&value, sizeof(value), hash);
+}
+
+static uint64_t hash_string(const uint64_t hash, const char* string)
+{
+    return hash_bytes(string, std::strlen(string) + 1, hash);
+}
+
+// Create info of a description's fixed function state, pointing into this object
+struct PipelineState
+{
+    // The pre-rasterization stages come first, then the fragment stage
+    std::array<vk::PipelineShaderStageCreateInfo, 3> stages;
+    uint32_t preRasterizationStages;
+    vk::VertexInputBindingDescription vertexBinding = Vertex::getBindingDescriptions();
+    std::array<vk::VertexInputAttributeDescription, 2> vertexAttributes = Vertex::getAttributeDescriptions();
+    vk::PipelineVertexInputStateCreateInfo vertexInput{{}, vertexBinding, vertexAttributes};
+    vk::PipelineInputAssemblyStateCreateInfo inputAssembly{{}, vk::PrimitiveTopology::eTriangleList};
+    vk::PipelineViewportStateCreateInfo viewport{{}, 1, nullptr, 1, nullptr};
+    std::array<vk::DynamicState, 2> dynamicStates{vk::DynamicState::eViewport, vk::DynamicState::eScissor};
+    vk::PipelineDynamicStateCreateInfo dynamic{{}, dynamicStates};
+    vk::PipelineRasterizationStateCreateInfo rasterization;
+    vk::PipelineMultisampleStateCreateInfo multisample{{}, vk::SampleCountFlagBits::e1, false, 1.0f};
+    vk::PipelineDepthStencilStateCreateInfo depthStencil;
+    vk::PipelineColorBlendAttachmentState blendAttachment;
+    vk::PipelineColorBlendStateCreateInfo colorBlend;
+    vk::PipelineLayout layout;
+    vk::RenderPass renderPass;
+    uint32_t subpass;
+
+    PipelineState(const renderer::GraphicsPipelineDesc& desc, const vk::ShaderModule shader_module) :
+        stages{
+            vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eTaskEXT, shader_module, desc.taskEntry),
+            vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eMeshEXT, shader_module, desc.meshEntry),
+            vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eFragment, shader_module,
+                                              desc.fragmentEntry)
+        },
+        preRasterizationStages(2),
+        rasterization({}, false, false, desc.polygonMode, desc.cullMode, desc.frontFace, false, 0.0f, 0.0f, 0.0f,
+                      1.0f),
+        depthStencil({}, desc.depthTest, desc.depthWrite, desc.depthCompare),
+        blendAttachment(desc.blend, vk::BlendFactor::eOne, vk::BlendFactor::eOneMinusSrcAlpha, vk::BlendOp::eAdd,
+                        vk::BlendFactor::eOne, vk::BlendFactor::eOneMinusSrcAlpha, vk::BlendOp::eAdd,
+                        desc.colorWriteMask),
+        colorBlend({}, false, vk::LogicOp::eCopy, blendAttachment, {0.0f, 0.0f, 0.0f, 0.0f}),
+        layout(desc.layout), renderPass(desc.renderPass), subpass(desc.subpass)
+    {
+        if (desc.vertexEntry)
+        {
+            stages[0] = vk::PipelineShaderStageCreateInfo({}, vk::ShaderStageFlagBits::eVertex, shader_module,
+                                                          desc.vertexEntry);
+            stages[1] = stages[2];
+            preRasterizationStages = 1;
+        }
+    }
+
+    PipelineState(const PipelineState&) = delete;
+    PipelineState& operator=(const PipelineState&) = delete;
+
+    // Only holds the state of the given parts
+    [[nodiscard]] vk::GraphicsPipelineCreateInfo getCreateInfo(const vk::GraphicsPipelineLibraryFlagsEXT parts) const
+    {
+        vk::GraphicsPipelineCreateInfo info;
+        info.layout = layout;
+        info.renderPass = renderPass;
+        info.subpass = subpass;
+
+        const bool pre_rasterization =
+            static_cast<bool>(parts & vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders);
+        const bool fragment = static_cast<bool>(parts & vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader);
+        const uint32_t first_stage = pre_rasterization ? 0 : preRasterizationStages;
+        const uint32_t end_stage = fragment ? preRasterizationStages + 1 : preRasterizationStages;
+        info.stageCount = end_stage - first_stage;
+        info.pStages = info.stageCount > 0 ? &stages[first_stage] : nullptr;
+
+        if (parts & vk::GraphicsPipelineLibraryFlagBitsEXT::eVertexInputInterface)
+        {
+            info.pVertexInputState = &vertexInput;
+            info.pInputAssemblyState = &inputAssembly;
+        }
+
+        if (pre_rasterization)
+        {
+            info.pViewportState = &viewport;
+            info.pRasterizationState = &rasterization;
+            info.pDynamicState = &dynamic;
+        }
+        if (fragment)
+        {
+            info.pDepthStencilState = &depthStencil;
+            info.pMultisampleState = &multisample;
+        }
+        if (parts & vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentOutputInterface)
+        {
+            info.pColorBlendState = &colorBlend;
+            info.pMultisampleState = &multisample;
+        }
+        return info;
+    }
+};
+
+namespace renderer
+{
+    PipelineManager::PipelineManager(const vk::raii::Device& device, const bool use_libraries,
+                                     const unsigned int thread_count,
+                                     const vk::Optional<const vk::AllocationCallbacks> allocator) :
+        device(device), useLibraries(use_libraries), allocator(allocator)
+    {
+        pipelineCache = device.createPipelineCache(vk::PipelineCacheCreateInfo(), allocator);
+
+        for (unsigned int i = 0; i < std::max(thread_count, 1u); i++)
+        {
+            compilers.emplace_back([this]
+            {
+                trace::set_thread_name("pipeline compiler");
+                compileLoop();
+            });
+        }
+    }
+
+    PipelineManager::~PipelineManager()
+    {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        compileCondition.notify_all();
+        for (auto& compiler : compilers)
+        {
+            compiler.join();
+        }
+    }
+
+    PipelineHandle PipelineManager::request(const GraphicsPipelineDesc& desc)
+    {
+        TRACE_SCOPE("requestPipeline");
+
+        // Every part covers the render pass and the parts with shaders the layout, so a part's hash alone tells
+        // whether its library can be shared
+        const uint64_t code_hash = hash_bytes(desc.code.data(), desc.code.size_bytes());
+        uint64_t shared_hash = hash_value(code_hash, static_cast<VkPipelineLayout>(desc.layout));
+        shared_hash = hash_value(shared_hash, static_cast<VkRenderPass>(desc.renderPass));
+        shared_hash = hash_value(shared_hash, desc.subpass);
+
+        uint64_t pre_rasterization_hash =
+            hash_value(shared_hash, vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders);
+        if (desc.vertexEntry)
+        {
+            pre_rasterization_hash = hash_string(pre_rasterization_hash, desc.vertexEntry);
+        }
+        else
+        {
+            pre_rasterization_hash = hash_string(pre_rasterization_hash, desc.taskEntry);
+            pre_rasterization_hash = hash_string(pre_rasterization_hash, desc.meshEntry);
+        }
+        pre_rasterization_hash = hash_value(pre_rasterization_hash, desc.polygonMode);
+        pre_rasterization_hash = hash_value(pre_rasterization_hash, desc.cullMode);
+        pre_rasterization_hash = hash_value(pre_rasterization_hash, desc.frontFace);
+
+        uint64_t fragment_hash = hash_value(shared_hash, vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader);
+        fragment_hash = hash_string(fragment_hash, desc.fragmentEntry);
+        fragment_hash = hash_value(fragment_hash, desc.depthTest);
+        fragment_hash = hash_value(fragment_hash, desc.depthWrite);
+        fragment_hash = hash_value(fragment_hash, desc.depthCompare);
+
+        uint64_t output_hash = hash_value(fnv_offset_basis, static_cast<VkRenderPass>(desc.renderPass));
+        output_hash = hash_value(output_hash, desc.subpass);
+        output_hash = hash_value(output_hash, vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentOutputInterface);
+        output_hash = hash_value(output_hash, desc.blend);
+        output_hash = hash_value(output_hash, desc.colorWriteMask);
+
+        // Vertex input is always Vertex, the part only differs between vertex and mesh shading pipelines
+        const uint64_t input_hash =
+            hash_value(fnv_offset_basis, vk::GraphicsPipelineLibraryFlagBitsEXT::eVertexInputInterface);
+
+        uint64_t hash = hash_value(pre_rasterization_hash, fragment_hash);
+        hash = hash_value(hash, output_hash);
+        if (desc.vertexEntry)
+            hash = hash_value(hash, input_hash);
+
+        if (const auto found = pipelineIndices.find(hash); found != pipelineIndices.end())
+            return {found->second};
+
+        const auto index = static_cast<uint32_t>(pipelines.size());
+        Pipeline pipeline{hash};
+        pipeline.requested = Clock::now();
+
+        CompileRequest compile{index, desc, getShaderModule(desc.code, code_hash), {}};
+        if (useLibraries)
+        {
+            compile.libraries = {
+                getLibrary(vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders, pre_rasterization_hash,
+                           desc, compile.shaderModule),
+                getLibrary(vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader, fragment_hash, desc,
+                           compile.shaderModule),
+                getLibrary(vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentOutputInterface, output_hash, desc,
+                           compile.shaderModule)
+            };
+            if (desc.vertexEntry)
+                compile.libraries.push_back(getLibrary(vk::GraphicsPipelineLibraryFlagBitsEXT::eVertexInputInterface,
+                                                       input_hash, desc, compile.shaderModule));
+
+            TRACE_SCOPE("fastLinkPipeline");
+            vk::PipelineLibraryCreateInfoKHR library_info(compile.libraries);
+            vk::GraphicsPipelineCreateInfo link_info;
+            link_info.pNext = &library_info;
+            link_info.layout = desc.layout;
+            pipeline.fastLinked = device.createGraphicsPipeline(pipelineCache, link_info, allocator);
+        }
+
+        pipelines.push_back(std::move(pipeline));
+        pipelineIndices.emplace(hash, index);
+        stats.pipelines++;
+
+        {
+            std::lock_guard lock(mutex);
+            requests.push_back(std::move(compile));
+            queueDepth++;
+            stats.maxQueueDepth = std::max(stats.maxQueueDepth, queueDepth);
+        }
+        compileCondition.notify_one();
+
+        return {index};
+    }
+
+    bool PipelineManager::update()
+    {
+        std::lock_guard lock(mutex);
+        return takeResults();
+    }
+
+    vk::Pipeline PipelineManager::get(const PipelineHandle handle)
+    {
+        const Pipeline& pipeline = pipelines[handle.index];
+        if (*pipeline.optimized)
+            return *pipeline.optimized;
+
+        if (*pipeline.fastLinked)
+            stats.fallbackBinds++;
+        return *pipeline.fastLinked;
+    }
+
+    void PipelineManager::wait(const PipelineHandle handle)
+    {
+        const Pipeline& pipeline = pipelines[handle.index];
+
+        std::unique_lock lock(mutex);
+        takeResults();
+        while (!*pipeline.fastLinked && !*pipeline.optimized)
+        {
+            resultCondition.wait(lock, [this] { return !results.empty(); });
+            takeResults();
+        }
+    }
+
+    bool PipelineManager::isCompiling() const
+    {
+        std::lock_guard lock(mutex);
+        return queueDepth > 0 || !results.empty();
+    }
+
+    bool PipelineManager::isUsingLibraries() const
+    {
+        return useLibraries;
+    }
+
+    PipelineManager::Stats PipelineManager::getStats() const
+    {
+        std::lock_guard lock(mutex);
+        Stats current = stats;
+        current.libraries = static_cast<uint32_t>(libraries.size());
+        current.queueDepth = queueDepth;
+        return current;
+    }
+
+    vk::ShaderModule PipelineManager::getShaderModule(const std::span<const uint32_t> code, const uint64_t code_hash)
+    {
+        auto found = shaderModules.find(code_hash);
+        if (found == shaderModules.end())
+        {
+            if (code.empty() || code[0] != 0x07230203)
+                throw std::invalid_argument("Invalid SPIR-V magic number");
+
+            found = shaderModules.emplace(code_hash, device.createShaderModule(
+                                              vk::ShaderModuleCreateInfo({}, code.size_bytes(), code.data()),
+                                              allocator)).first;
+        }
+        return *found->second;
+    }
+
+    vk::Pipeline PipelineManager::getLibrary(const vk::GraphicsPipelineLibraryFlagsEXT part, const uint64_t hash,
+                                             const GraphicsPipelineDesc& desc, const vk::ShaderModule shader_module)
+    {
+        auto found = libraries.find(hash);
+        if (found == libraries.end())
+        {
+            TRACE_SCOPE("compilePipelineLibrary");
+
+            const PipelineState state(desc, shader_module);
+            vk::StructureChain info_chain{state.getCreateInfo(part), vk::GraphicsPipelineLibraryCreateInfoEXT(part)};
+            // Retains what the optimized link needs to redo the work the libraries skipped
+            info_chain.get<vk::GraphicsPipelineCreateInfo>().flags = vk::PipelineCreateFlagBits::eLibraryKHR |
+                vk::PipelineCreateFlagBits::eRetainLinkTimeOptimizationInfoEXT;
+
+            found = libraries.emplace(hash, device.createGraphicsPipeline(
+                                          pipelineCache, info_chain.get<vk::GraphicsPipelineCreateInfo>(),
+                                          allocator)).first;
+        }
+        return *found->second;
+    }
+
+    bool PipelineManager::takeResults()
+    {
+        if (results.empty())
+            return false;
+
+        const auto now = Clock::now();
+        for (auto& result : results)
+        {
+            Pipeline& pipeline = pipelines[result.pipeline];
+            if (!result.error.empty())
+            {
+                if (!*pipeline.fastLinked)
+                    throw std::runtime_error("Compiling a graphics pipeline failed: " + result.error);
+
+                std::cerr << "Optimizing a graphics pipeline failed, keeping the fast-linked one: " << result.error
+                    << std::endl;
+                continue;
+            }
+
+            pipeline.optimized = std::move(result.compiled);
+
+            const double compile_ms = std::chrono::duration<double, std::milli>(now - pipeline.requested).count();
+            stats.optimized++;
+            totalCompileMs += compile_ms;
+            stats.meanCompileMs = totalCompileMs / stats.optimized;
+            stats.maxCompileMs = std::max(stats.maxCompileMs, compile_ms);
+        }
+        results.clear();
+        return true;
+    }
+
+    void PipelineManager::compileLoop()
+    {
+        while (true)
+        {
+            CompileRequest compile;
+            {
+                std::unique_lock lock(mutex);
+                compileCondition.wait(lock, [this] { return stopping || !requests.empty(); });
+                if (stopping)
+                    return;
+
+                compile = std::move(requests.front());
+                requests.pop_front();
+            }
+
+            CompileResult result{compile.pipeline};
+            try
+            {
+                TRACE_SCOPE("compilePipeline");
+
+                if (compile.libraries.empty())
+                {
+                    const PipelineState state(compile.desc, compile.shaderModule);
+                    const auto parts = compile.desc.vertexEntry ? vertex_parts : mesh_parts;
+                    result.compiled = device.createGraphicsPipeline(pipelineCache, state.getCreateInfo(parts),
+                                                                    allocator);
+                }
+                else
+                {
+                    vk::PipelineLibraryCreateInfoKHR library_info(compile.libraries);
+                    vk::GraphicsPipelineCreateInfo link_info;
+                    link_info.pNext = &library_info;
+                    link_info.flags = vk::PipelineCreateFlagBits::eLinkTimeOptimizationEXT;
+                    link_info.layout = compile.desc.layout;
+                    result.compiled = device.createGraphicsPipeline(pipelineCache, link_info, allocator);
+                }
+            }
+            catch (const std::exception& error)
+            {
+                result.error = error.what();
+            }
+
+            {
+                std::lock_guard lock(mutex);
+                results.push_back(std::move(result));
+                queueDepth--;
+            }
+            resultCondition.notify_all();
+        }
+    }
+} // renderer
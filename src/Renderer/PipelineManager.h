@@ -0,0 +1,174 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+namespace renderer
+{
+    struct PipelineHandle
+    {
+        uint32_t index = UINT32_MAX;
+
+        [[nodiscard]] bool isValid() const
+        {
+            return index != UINT32_MAX;
+        }
+    };
+
+    // Everything a graphics pipeline of this renderer can differ in. Viewport and scissor are always dynamic.
+    // The entry point names are not copied, they have to outlive the compile.
+    struct GraphicsPipelineDesc
+    {
+        std::span<const uint32_t> code; // SPIR-V holding all the stages
+        const char* taskEntry = "taskMain";
+        const char* meshEntry = "meshMain";
+        // Set for a vertex shading pipeline, which draws triangle lists of Vertex from binding 0 instead of running
+        // the task and mesh stages
+        const char* vertexEntry = nullptr;
+        const char* fragmentEntry = "fragmentMain";
+        vk::PipelineLayout layout;
+        vk::RenderPass renderPass;
+        uint32_t subpass = 0;
+
+        vk::PolygonMode polygonMode = vk::PolygonMode::eFill;
+        vk::CullModeFlags cullMode = vk::CullModeFlagBits::eBack;
+        vk::FrontFace frontFace = vk::FrontFace::eClockwise;
+
+        bool depthTest = true;
+        bool depthWrite = true;
+        vk::CompareOp depthCompare = vk::CompareOp::eLessOrEqual;
+
+        bool blend = false; // Premultiplied alpha over what is there
+        vk::ColorComponentFlags colorWriteMask =
+            vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG | vk::ColorComponentFlagBits::eB;
+    };
+
+    // Graphics pipelines keyed by a hash of their whole state, compiled off the render thread.
+    // With VK_EXT_graphics_pipeline_library a description is split into its pre-rasterization, fragment shader and
+    // fragment output parts. Each part is compiled once as a library and shared by every description it appears in,
+    // and the libraries are linked without optimization right away, which is fast enough to do while recording. The
+    // optimized link runs on a compile thread and replaces the fast-linked pipeline once it is done.
+    // Without the extension the whole pipeline is compiled on a compile thread and nothing can draw with it until it
+    // is done.
+    class PipelineManager
+    {
+    public:
+        struct Stats
+        {
+            uint32_t pipelines = 0;
+            uint32_t optimized = 0; // Compiled pipelines in use, monolithic ones without libraries
+            uint32_t libraries = 0;
+            uint32_t queueDepth = 0; // Compiles queued or running
+            uint32_t maxQueueDepth = 0;
+            uint64_t fallbackBinds = 0; // get() calls answered with a fast-linked pipeline
+            double meanCompileMs = 0.0; // From request to the compiled pipeline being in use
+            double maxCompileMs = 0.0;
+        };
+
+        // use_libraries needs VK_KHR_pipeline_library and VK_EXT_graphics_pipeline_library with its feature enabled
+        PipelineManager(const vk::raii::Device& device, bool use_libraries, unsigned int thread_count,
+                        vk::Optional<const vk::AllocationCallbacks> allocator = nullptr);
+        // Waits for the compiles in progress, the ones still queued are dropped
+        ~PipelineManager();
+
+        PipelineManager(const PipelineManager&) = delete;
+        PipelineManager& operator=(const PipelineManager&) = delete;
+
+        // Returns the pipeline of an equal description when there is one. Otherwise queues the compile, after building
+        // the missing libraries and fast linking them when libraries are in use.
+        PipelineHandle request(const GraphicsPipelineDesc& desc);
+
+        // Swaps in the pipelines compiled since the last call, returns whether there were any. Rethrows the error of a
+        // failed compile that has nothing to fall back on.
+        bool update();
+
+        // The optimized pipeline when it is in use, the fast-linked one before that. Null while a monolithic compile
+        // is still running.
+        [[nodiscard]] vk::Pipeline get(PipelineHandle handle);
+
+        // Blocks until get() returns a pipeline for handle
+        void wait(PipelineHandle handle);
+
+        // Whether compiles are queued or running, they allocate while they are
+        [[nodiscard]] bool isCompiling() const;
+
+        [[nodiscard]] bool isUsingLibraries() const;
+
+        [[nodiscard]] Stats getStats() const;
+
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        // The fast-linked pipeline is kept once the optimized one replaces it, frames in flight may still use it
+        struct Pipeline
+        {
+            uint64_t hash;
+            vk::raii::Pipeline fastLinked = nullptr;
+            vk::raii::Pipeline optimized = nullptr;
+            Clock::time_point requested;
+        };
+
+        // Carries copies of what the compile needs, pipelines and libraries may reallocate while it runs
+        struct CompileRequest
+        {
+            uint32_t pipeline;
+            GraphicsPipelineDesc desc;
+            vk::ShaderModule shaderModule;
+            std::vector<vk::Pipeline> libraries; // Empty for a monolithic compile
+        };
+
+        struct CompileResult
+        {
+            uint32_t pipeline;
+            vk::raii::Pipeline compiled = nullptr;
+            std::string error; // Empty on success
+        };
+
+        const vk::raii::Device& device;
+        bool useLibraries;
+        vk::Optional<const vk::AllocationCallbacks> allocator;
+
+        // Shared by every compile, vkCreateGraphicsPipelines synchronises access to it
+        vk::raii::PipelineCache pipelineCache = nullptr;
+
+        // Keyed by the hash of the code
+        std::unordered_map<uint64_t, vk::raii::ShaderModule> shaderModules;
+        // Keyed by the hash of the state each part covers
+        std::unordered_map<uint64_t, vk::raii::Pipeline> libraries;
+        std::unordered_map<uint64_t, uint32_t> pipelineIndices;
+        std::vector<Pipeline> pipelines;
+
+        Stats stats;
+        double totalCompileMs = 0.0;
+
+        mutable std::mutex mutex; // Guards the queues, queueDepth and stopping
+        std::condition_variable compileCondition;
+        std::condition_variable resultCondition;
+        std::deque<CompileRequest> requests;
+        std::deque<CompileResult> results;
+        uint32_t queueDepth = 0;
+        bool stopping = false;
+        // Declared last, so they start after everything they use
+        std::vector<std::thread> compilers;
+
+        vk::ShaderModule getShaderModule(std::span<const uint32_t> code, uint64_t code_hash);
+
+        vk::Pipeline getLibrary(vk::GraphicsPipelineLibraryFlagsEXT part, uint64_t hash,
+                                const GraphicsPipelineDesc& desc, vk::ShaderModule shader_module);
+
+        // Moves the finished results into their pipelines, expects mutex to be held
+        bool takeResults();
+
+        void compileLoop();
+    };
+} // renderer
@@ -0,0 +1,76 @@
+#include "ResolutionController.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// Weight of the newest sample in the moving average
+constexpr double estimate_weight = 0.2;
+// Scales this close to the ideal one are kept, so noise does not keep resizing the render
+constexpr double scale_tolerance = 0.03;
+// Largest relative change of the scale in one frame
+constexpr double max_step = 0.05;
+// Scales are rounded to this, away from the current one so a step never rounds to no change. Render sizes then only
+// change when the scale really moves.
+constexpr float scale_granularity = 1.0f / 64.0f;
+
+namespace renderer
+{
+    ResolutionController::ResolutionController(const double target_ms, const float min_scale, const float max_scale)
+        : targetMs(target_ms), minScale(min_scale), maxScale(max_scale), scale(max_scale)
+    {
+        if (target_ms <= 0.0)
+            throw std::invalid_argument("The target frame time must be positive");
+        if (min_scale <= 0.0f || min_scale > max_scale)
+            throw std::invalid_argument("The render scale range is empty");
+    }
+
+    float ResolutionController::update(const double gpu_ms, const double output_ms, const float frame_scale)
+    {
+        stats.frames++;
+        totalScale += scale;
+        stats.meanScale = totalScale / static_cast<double>(stats.frames);
+        stats.minScale = std::min(stats.minScale, scale);
+
+        if (gpu_ms <= 0.0 || frame_scale <= 0.0f)
+            return scale;
+
+        // What the scaled passes would have taken at full scale, which stays put while the scale moves
+        const double fixed_ms = std::clamp(output_ms, 0.0, gpu_ms);
+        const double full_ms = (gpu_ms - fixed_ms) / (static_cast<double>(frame_scale) * frame_scale);
+        const bool first = estimateMs == 0.0 && outputEstimateMs == 0.0;
+        estimateMs = first ? full_ms : estimateMs + (full_ms - estimateMs) * estimate_weight;
+        outputEstimateMs = first ? fixed_ms : outputEstimateMs + (fixed_ms - outputEstimateMs) * estimate_weight;
+        if (estimateMs <= 0.0)
+            return scale;
+
+        // When the output passes alone miss the target the smallest scale is the best there is
+        // At small scales one granularity step is a larger relative change than the tolerance, without the half step
+        // a scale between two steps would flip between them every frame
+        const double ideal = std::sqrt(std::max(targetMs - outputEstimateMs, 0.0) / estimateMs);
+        const double tolerance = std::max(scale_tolerance, 0.5 * scale_granularity / scale);
+        if (std::abs(ideal / scale - 1.0) <= tolerance)
+            return scale;
+
+        const double limited = std::clamp(ideal, scale * (1.0 - max_step), scale * (1.0 + max_step));
+        const float steps = static_cast<float>(limited) / scale_granularity;
+        const float rounded = (ideal > scale ? std::ceil(steps) : std::floor(steps)) * scale_granularity;
+        const float next = std::clamp(rounded, minScale, maxScale);
+        if (next != scale)
+        {
+            scale = next;
+            stats.changes++;
+        }
+        return scale;
+    }
+
+    float ResolutionController::getScale() const
+    {
+        return scale;
+    }
+
+    ResolutionController::Stats ResolutionController::getStats() const
+    {
+        return stats;
+    }
+} // renderer
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+
+namespace renderer
+{
+    // Picks the render scale, relative to the output size per axis, that keeps the measured GPU frame time at a target.
+    // GPU time is taken to grow with the pixel count, so every measurement is divided by the square of the scale its
+    // frame was rendered at. Passes running at the output size cost the same at any scale and are taken out first. The
+    // smoothed result says what a full scale frame would cost, and the scale that fits the target follows from it
+    // directly. Measurements arrive frames late, so correcting from the latest one alone would
+    // oscillate; the changes are also limited per frame, so a single slow frame does not drop the resolution.
+    class ResolutionController
+    {
+    public:
+        struct Stats
+        {
+            uint64_t frames = 0;
+            double meanScale = 0.0;
+            float minScale = 1.0f;
+            uint64_t changes = 0;
+        };
+
+        ResolutionController(double target_ms, float min_scale, float max_scale = 1.0f);
+
+        // Feeds the GPU time of a completed frame rendered at frame_scale, output_ms of which went to passes at the
+        // output size. Returns the scale for the next frame to record.
+        float update(double gpu_ms, double output_ms, float frame_scale);
+
+        [[nodiscard]] float getScale() const;
+
+        [[nodiscard]] Stats getStats() const;
+
+    private:
+        double targetMs;
+        float minScale;
+        float maxScale;
+        float scale;
+
+        // Exponential moving averages
+        double estimateMs = 0.0;
+        double outputEstimateMs = 0.0;
+
+        Stats stats;
+        double totalScale = 0.0;
+    };
+} // renderer
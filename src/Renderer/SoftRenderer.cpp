@@ -0,0 +1,316 @@
+#include "SoftRenderer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+#include "../Jobs/ThreadPool.h"
+#include "../simd.h"
+
+// Triangles set up and binned by one task, also the granularity that keeps submission order within a tile
+constexpr size_t bin_chunk_size = 2048;
+
+// Opaque black, the same clear colour as the Vulkan render pass
+constexpr uint32_t clear_color = 0xFF000000;
+
+namespace renderer
+{
+    SoftRenderer::SoftRenderer(const glm::ivec2 size, jobs::ThreadPool& thread_pool) : threadPool(thread_pool)
+    {
+        resize(size);
+    }
+
+    void SoftRenderer::resize(const glm::ivec2 new_size)
+    {
+        size = glm::max(new_size, glm::ivec2(1));
+        // Rows are padded so the four-pixel steps never straddle two rows
+        stride = (size.x + 3) & ~3;
+        tileCount = (size + tile_size - 1) / tile_size;
+        pixels.assign(static_cast<size_t>(stride) * size.y, clear_color);
+    }
+
+    void SoftRenderer::render(const DrawList& draw_list)
+    {
+        triangleFirstVertices.clear();
+        draw_list.forEachDraw([this](const DrawList::Draw& draw)
+        {
+            for (uint32_t i = 0; i + 3 <= draw.vertexCount; i += 3)
+            {
+                triangleFirstVertices.push_back(draw.firstVertex + i);
+            }
+        });
+
+        triangles.resize(triangleFirstVertices.size());
+
+        const size_t chunk_count = (triangles.size() + bin_chunk_size - 1) / bin_chunk_size;
+        const auto tiles = static_cast<size_t>(tileCount.x) * tileCount.y;
+        bins.resize(chunk_count);
+        for (auto& chunk_bins : bins)
+        {
+            chunk_bins.resize(tiles);
+        }
+
+        const auto vertices = draw_list.getVertices();
+        threadPool.parallelFor(chunk_count, 1, [this, vertices](const size_t begin, const size_t end)
+        {
+            for (size_t chunk = begin; chunk < end; chunk++)
+            {
+                binChunk(vertices, chunk);
+            }
+        });
+
+        threadPool.parallelFor(tiles, 1, [this](const size_t begin, const size_t end)
+        {
+            for (size_t tile = begin; tile < end; tile++)
+            {
+                rasterizeTile(static_cast<int>(tile % tileCount.x), static_cast<int>(tile / tileCount.x));
+            }
+        });
+    }
+
+    glm::ivec2 SoftRenderer::getSize() const
+    {
+        return size;
+    }
+
+    std::span<const uint32_t> SoftRenderer::getPixels() const
+    {
+        return pixels;
+    }
+
+    int SoftRenderer::getStride() const
+    {
+        return stride;
+    }
+
+    size_t SoftRenderer::getTriangleCount() const
+    {
+        return triangles.size();
+    }
+
+    void SoftRenderer::writeImage(const std::filesystem::path& path) const
+    {
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+            throw std::runtime_error("Failed to open " + path.string());
+
+        file << "P6\n" << size.x << " " << size.y << "\n255\n";
+
+        std::vector<char> row(static_cast<size_t>(size.x) * 3);
+        for (int y = 0; y < size.y; y++)
+        {
+            for (int x = 0; x < size.x; x++)
+            {
+                const uint32_t pixel = pixels[static_cast<size_t>(y) * stride + x];
+                row[x * 3 + 0] = static_cast<char>(pixel & 0xFF);
+                row[x * 3 + 1] = static_cast<char>(pixel >> 8 & 0xFF);
+                row[x * 3 + 2] = static_cast<char>(pixel >> 16 & 0xFF);
+            }
+            file.write(row.data(), static_cast<std::streamsize>(row.size()));
+        }
+    }
+
+    bool SoftRenderer::setupTriangle(const std::span<const Vertex> vertices, const uint32_t first_vertex,
+                                     Triangle& triangle) const
+    {
+        const glm::vec2 half_size = glm::vec2(size) * 0.5f;
+
+        glm::vec2 positions[3];
+        for (int i = 0; i < 3; i++)
+        {
+            positions[i] = (vertices[first_vertex + i].position + 1.0f) * half_size;
+        }
+
+        // Positive for clockwise triangles in framebuffer space, the front faces of the Vulkan pipeline
+        const float area = (positions[1].x - positions[0].x) * (positions[2].y - positions[0].y) -
+            (positions[2].x - positions[0].x) * (positions[1].y - positions[0].y);
+        if (area <= 0.0f)
+            return false;
+
+        const glm::vec2 low = glm::min(glm::min(positions[0], positions[1]), positions[2]);
+        const glm::vec2 high = glm::max(glm::max(positions[0], positions[1]), positions[2]);
+
+        triangle.min = glm::max(glm::ivec2(glm::floor(low)), glm::ivec2(0));
+        triangle.max = glm::min(glm::ivec2(glm::ceil(high)), size - 1);
+        if (triangle.min.x > triangle.max.x || triangle.min.y > triangle.max.y)
+            return false;
+
+        // Edge i is opposite vertex i, so its value divided by the area is the barycentric weight of that vertex
+        for (int i = 0; i < 3; i++)
+        {
+            const glm::vec2 a = positions[(i + 1) % 3];
+            const glm::vec2 b = positions[(i + 2) % 3];
+            triangle.edges[i] = {a.y - b.y, b.x - a.x, (b.y - a.y) * a.x - (b.x - a.x) * a.y};
+            // The edge function grows inwards, so the inside lies right of a left edge and below a top edge
+            triangle.topLeft[i] = triangle.edges[i].a > 0.0f ||
+                (triangle.edges[i].a == 0.0f && triangle.edges[i].b > 0.0f);
+        }
+
+        // Colours are interpolated in 0-255 so the raster loop only needs to round
+        const float color_scale = 255.0f / area;
+        for (int channel = 0; channel < 3; channel++)
+        {
+            Plane& plane = triangle.colors[channel];
+            plane = {0.0f, 0.0f, 0.0f};
+            for (int i = 0; i < 3; i++)
+            {
+                const float value = vertices[first_vertex + i].color[channel] * color_scale;
+                plane.a += triangle.edges[i].a * value;
+                plane.b += triangle.edges[i].b * value;
+                plane.c += triangle.edges[i].c * value;
+            }
+        }
+
+        return true;
+    }
+
+    void SoftRenderer::binChunk(const std::span<const Vertex> vertices, const size_t chunk)
+    {
+        auto& chunk_bins = bins[chunk];
+        for (auto& bin : chunk_bins)
+        {
+            bin.clear();
+        }
+
+        const size_t begin = chunk * bin_chunk_size;
+        const size_t end = std::min(begin + bin_chunk_size, triangles.size());
+
+        for (size_t i = begin; i < end; i++)
+        {
+            Triangle& triangle = triangles[i];
+            if (!setupTriangle(vertices, triangleFirstVertices[i], triangle))
+                continue;
+
+            const glm::ivec2 first_tile = triangle.min / tile_size;
+            const glm::ivec2 last_tile = triangle.max / tile_size;
+            for (int y = first_tile.y; y <= last_tile.y; y++)
+            {
+                for (int x = first_tile.x; x <= last_tile.x; x++)
+                {
+                    chunk_bins[static_cast<size_t>(y) * tileCount.x + x].push_back(static_cast<uint32_t>(i));
+                }
+            }
+        }
+    }
+
+    void SoftRenderer::rasterizeTile(const int tile_x, const int tile_y)
+    {
+        const glm::ivec2 tile_min(tile_x * tile_size, tile_y * tile_size);
+        // Inclusive, covers the row padding horizontally so every step is a full four pixels
+        const glm::ivec2 tile_max(std::min(tile_min.x + tile_size, stride) - 1,
+                                  std::min(tile_min.y + tile_size, size.y) - 1);
+
+        for (int y = tile_min.y; y <= tile_max.y; y++)
+        {
+            std::fill_n(pixels.begin() + static_cast<std::ptrdiff_t>(y) * stride + tile_min.x,
+                        tile_max.x - tile_min.x + 1, clear_color);
+        }
+
+        const size_t tile = static_cast<size_t>(tile_y) * tileCount.x + tile_x;
+        for (const auto& chunk_bins : bins)
+        {
+            for (const uint32_t index : chunk_bins[tile])
+            {
+                rasterizeTriangle(triangles[index], tile_min, tile_max);
+            }
+        }
+    }
+
+    void SoftRenderer::rasterizeTriangle(const Triangle& triangle, const glm::ivec2 tile_min,
+                                         const glm::ivec2 tile_max)
+    {
+        const int x_begin = std::max(tile_min.x, triangle.min.x) & ~3;
+        const int x_end = std::min(tile_max.x, triangle.max.x);
+        const int y_begin = std::max(tile_min.y, triangle.min.y);
+        const int y_end = std::min(tile_max.y, triangle.max.y);
+
+        const Plane(&e)[3] = triangle.edges;
+        const Plane(&c)[3] = triangle.colors;
+
+#ifdef VKT_SIMD_SSE2
+        const __m128 pixel_offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 max_channel = _mm_set1_ps(255.0f);
+        const __m128i alpha = _mm_set1_epi32(static_cast<int>(clear_color));
+
+        const __m128 edge_a[3] = {_mm_set1_ps(e[0].a), _mm_set1_ps(e[1].a), _mm_set1_ps(e[2].a)};
+        __m128 edge_inclusive[3];
+        for (int i = 0; i < 3; i++)
+        {
+            edge_inclusive[i] = _mm_castsi128_ps(_mm_set1_epi32(triangle.topLeft[i] ? -1 : 0));
+        }
+        const __m128 color_a[3] = {_mm_set1_ps(c[0].a), _mm_set1_ps(c[1].a), _mm_set1_ps(c[2].a)};
+
+        for (int y = y_begin; y <= y_end; y++)
+        {
+            const float py = static_cast<float>(y) + 0.5f;
+            const __m128 edge_row[3] = {
+                _mm_set1_ps(e[0].b * py + e[0].c), _mm_set1_ps(e[1].b * py + e[1].c), _mm_set1_ps(e[2].b * py + e[2].c)
+            };
+            const __m128 color_row[3] = {
+                _mm_set1_ps(c[0].b * py + c[0].c), _mm_set1_ps(c[1].b * py + c[1].c), _mm_set1_ps(c[2].b * py + c[2].c)
+            };
+
+            uint32_t* row = pixels.data() + static_cast<size_t>(y) * stride;
+
+            for (int x = x_begin; x <= x_end; x += 4)
+            {
+                const __m128 px = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), pixel_offsets);
+
+                __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                for (int i = 0; i < 3; i++)
+                {
+                    const __m128 value = _mm_add_ps(_mm_mul_ps(edge_a[i], px), edge_row[i]);
+                    inside = _mm_and_ps(inside, _mm_or_ps(_mm_cmpgt_ps(value, zero),
+                                                          _mm_and_ps(_mm_cmpeq_ps(value, zero), edge_inclusive[i])));
+                }
+
+                if (_mm_movemask_ps(inside) == 0)
+                    continue;
+
+                __m128i packed = alpha;
+                for (int channel = 0; channel < 3; channel++)
+                {
+                    __m128 value = _mm_add_ps(_mm_mul_ps(color_a[channel], px), color_row[channel]);
+                    value = _mm_min_ps(_mm_max_ps(value, zero), max_channel);
+                    packed = _mm_or_si128(packed, _mm_slli_epi32(_mm_cvtps_epi32(value), channel * 8));
+                }
+
+                const __m128i mask = _mm_castps_si128(inside);
+                auto* destination = reinterpret_cast<__m128i*>(row + x);
+                const __m128i previous = _mm_loadu_si128(destination);
+                _mm_storeu_si128(destination, _mm_or_si128(_mm_and_si128(mask, packed),
+                                                           _mm_andnot_si128(mask, previous)));
+            }
+        }
+#else
+        for (int y = y_begin; y <= y_end; y++)
+        {
+            const float py = static_cast<float>(y) + 0.5f;
+            uint32_t* row = pixels.data() + static_cast<size_t>(y) * stride;
+
+            for (int x = x_begin; x <= x_end; x++)
+            {
+                const float px = static_cast<float>(x) + 0.5f;
+                bool inside = true;
+                for (int i = 0; i < 3; i++)
+                {
+                    const float value = e[i].a * px + e[i].b * py + e[i].c;
+                    inside = inside && (value > 0.0f || (value == 0.0f && triangle.topLeft[i]));
+                }
+                if (!inside)
+                    continue;
+
+                uint32_t packed = clear_color;
+                for (int channel = 0; channel < 3; channel++)
+                {
+                    const float value = std::clamp(c[channel].a * px + c[channel].b * py + c[channel].c, 0.0f,
+                                                   255.0f);
+                    packed |= static_cast<uint32_t>(value + 0.5f) << channel * 8;
+                }
+                row[x] = packed;
+            }
+        }
+#endif
+    }
+} // renderer
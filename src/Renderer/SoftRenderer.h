@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "DrawList.h"
+
+namespace jobs
+{
+    class ThreadPool;
+}
+
+namespace renderer
+{
+    // CPU rasterizer drawing the same draw list as the Vulkan renderer, for machines without a GPU.
+    // Triangles are set up and binned into screen tiles in parallel, then every tile is rasterized independently,
+    // four pixels at a time, by whichever thread picks it up. Like the Vulkan pipeline it culls counter-clockwise
+    // triangles and has no depth test, later draws simply cover earlier ones.
+    class SoftRenderer
+    {
+    public:
+        static constexpr int tile_size = 64;
+
+        SoftRenderer(glm::ivec2 size, jobs::ThreadPool& thread_pool);
+
+        void resize(glm::ivec2 size);
+
+        void render(const DrawList& draw_list);
+
+        [[nodiscard]] glm::ivec2 getSize() const;
+
+        // RGBA8 rows of getStride() pixels
+        [[nodiscard]] std::span<const uint32_t> getPixels() const;
+
+        [[nodiscard]] int getStride() const;
+
+        [[nodiscard]] size_t getTriangleCount() const;
+
+        // Binary PPM, readable by nearly every image tool without pulling in an image library
+        void writeImage(const std::filesystem::path& path) const;
+
+    private:
+        // Edge functions and colour planes are all of the form a * x + b * y + c in pixel coordinates
+        struct Plane
+        {
+            float a, b, c;
+        };
+
+        struct Triangle
+        {
+            Plane edges[3];
+            // Top-left fill rule: pixel centres exactly on an edge are only inside for top and left edges, so a
+            // centre on an edge two triangles share is shaded once
+            bool topLeft[3];
+            Plane colors[3];
+            glm::ivec2 min;
+            glm::ivec2 max;
+        };
+
+        jobs::ThreadPool& threadPool;
+
+        glm::ivec2 size;
+        int stride = 0;
+        glm::ivec2 tileCount;
+        std::vector<uint32_t> pixels;
+
+        std::vector<Triangle> triangles;
+        std::vector<uint32_t> triangleFirstVertices;
+
+        // bins[chunk][tile] lists the triangles of a setup chunk touching the tile, keeping each chunk's bins apart
+        // lets setup run in parallel while tiles still draw triangles in submission order
+        std::vector<std::vector<std::vector<uint32_t>>> bins;
+
+        // Returns false when the triangle is culled or entirely off screen
+        bool setupTriangle(std::span<const Vertex> vertices, uint32_t first_vertex, Triangle& triangle) const;
+
+        void binChunk(std::span<const Vertex> vertices, size_t chunk);
+
+        void rasterizeTile(int tile_x, int tile_y);
+
+        void rasterizeTriangle(const Triangle& triangle, glm::ivec2 tile_min, glm::ivec2 tile_max);
+    };
+} // renderer
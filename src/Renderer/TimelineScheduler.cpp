@@ -0,0 +1,92 @@
+#include "TimelineScheduler.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+[[nodiscard]] static vk::raii::Semaphore create_timeline(const vk::raii::Device& device)
+{
+    vk::StructureChain create_info(vk::SemaphoreCreateInfo(),
+                                   vk::SemaphoreTypeCreateInfo(vk::SemaphoreType::eTimeline, 0));
+    return device.createSemaphore(create_info.get<vk::SemaphoreCreateInfo>());
+}
+
+namespace renderer
+{
+    TimelineScheduler::TimelineScheduler(const vk::raii::Device& device) : device(device),
+                                                                         timeline(create_timeline(device))
+    {
+    }
+
+    TimelineScheduler::~TimelineScheduler()
+    {
+        try
+        {
+            wait(submittedValue);
+        }
+        catch (const vk::SystemError&)
+        {
+            // A lost device has nothing left in flight
+        }
+    }
+
+    uint64_t TimelineScheduler::submit(const vk::raii::Queue& queue, const std::span<const vk::SemaphoreSubmitInfo> waits,
+                                       const std::span<const vk::CommandBufferSubmitInfo> command_buffers,
+                                       const std::span<const vk::SemaphoreSubmitInfo> signals)
+    {
+        const uint64_t value = submittedValue + 1;
+
+        signalInfos.assign(signals.begin(), signals.end());
+        signalInfos.emplace_back(*timeline, value, vk::PipelineStageFlagBits2::eAllCommands);
+
+        queue.submit2(vk::SubmitInfo2({}, waits, command_buffers, signalInfos));
+
+        submittedValue = value;
+        return value;
+    }
+
+    void TimelineScheduler::wait(const uint64_t value)
+    {
+        if (value <= completedValue)
+            return;
+
+        const vk::SemaphoreWaitInfo wait_info({}, *timeline, value);
+        if (device.waitSemaphores(wait_info, UINT64_MAX) != vk::Result::eSuccess)
+            throw std::runtime_error("Timed out waiting for the GPU");
+
+        completedValue = std::max(completedValue, value);
+    }
+
+    uint64_t TimelineScheduler::getCompletedValue()
+    {
+        completedValue = std::max(completedValue, timeline.getCounterValue());
+        return completedValue;
+    }
+
+    vk::SemaphoreSubmitInfo TimelineScheduler::getWaitInfo(const uint64_t value,
+                                                           const vk::PipelineStageFlags2 stages) const
+    {
+        return {*timeline, value, stages};
+    }
+
+    uint64_t TimelineScheduler::getSubmittedValue() const
+    {
+        return submittedValue;
+    }
+
+    void TimelineScheduler::collect()
+    {
+        if (retired.empty())
+            return;
+
+        const uint64_t completed = getCompletedValue();
+        while (!retired.empty() && retired.front().value <= completed)
+        {
+            retired.pop_front();
+        }
+    }
+
+    size_t TimelineScheduler::getRetiredCount() const
+    {
+        return retired.size();
+    }
+} // renderer
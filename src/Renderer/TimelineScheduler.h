@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+namespace renderer
+{
+    // Orders all work submitted to one queue on a single timeline semaphore.
+    // Every submit signals the next value, so "is this done" is a comparison against the GPU's completed value and
+    // the CPU blocks in vkWaitSemaphores instead of polling fences. Objects the GPU may still be reading are retired
+    // with the value of the last submit and destroyed once the GPU has passed it.
+    class TimelineScheduler
+    {
+    public:
+        explicit TimelineScheduler(const vk::raii::Device& device);
+        // Waits for everything submitted so retired objects are no longer in use
+        ~TimelineScheduler();
+
+        TimelineScheduler(const TimelineScheduler&) = delete;
+        TimelineScheduler& operator=(const TimelineScheduler&) = delete;
+
+        // Submits with synchronization2, adding the timeline signal to signals. Returns the value it signals.
+        uint64_t submit(const vk::raii::Queue& queue, std::span<const vk::SemaphoreSubmitInfo> waits,
+                        std::span<const vk::CommandBufferSubmitInfo> command_buffers,
+                        std::span<const vk::SemaphoreSubmitInfo> signals = {});
+
+        // Blocks until the GPU has reached value
+        void wait(uint64_t value);
+
+        [[nodiscard]] uint64_t getCompletedValue();
+
+        // Makes a submit, on this queue or another one, wait at stages until this timeline reaches value
+        [[nodiscard]] vk::SemaphoreSubmitInfo getWaitInfo(uint64_t value, vk::PipelineStageFlags2 stages) const;
+
+        // Value of the most recent submit, what work recorded so far completes at
+        [[nodiscard]] uint64_t getSubmittedValue() const;
+
+        // Keeps objects alive until the GPU has passed the last submitted value
+        template <class... Ts>
+        void retire(Ts&&... objects)
+        {
+            retired.push_back({
+                submittedValue, std::make_unique<Retired<std::tuple<std::decay_t<Ts>...>>>(
+                    std::tuple<std::decay_t<Ts>...>(std::forward<Ts>(objects)...))
+            });
+        }
+
+        // Destroys everything retired at or before the completed value
+        void collect();
+
+        [[nodiscard]] size_t getRetiredCount() const;
+
+    private:
+        struct RetiredBase
+        {
+            virtual ~RetiredBase() = default;
+        };
+
+        template <class T>
+        struct Retired : RetiredBase
+        {
+            explicit Retired(T&& object) : object(std::move(object))
+            {
+            }
+
+            T object;
+        };
+
+        struct RetiredEntry
+        {
+            uint64_t value;
+            std::unique_ptr<RetiredBase> object;
+        };
+
+        const vk::raii::Device& device;
+        vk::raii::Semaphore timeline;
+
+        uint64_t submittedValue = 0;
+        uint64_t completedValue = 0;
+
+        std::deque<RetiredEntry> retired; // Ordered by value
+        std::vector<vk::SemaphoreSubmitInfo> signalInfos; // Reused by submit() to avoid allocating every frame
+    };
+} // renderer
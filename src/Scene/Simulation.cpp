@@ -0,0 +1,119 @@
+#include "Simulation.h"
+
+#include "../Jobs/ThreadPool.h"
+#include "../Trace/Trace.h"
+
+namespace scene
+{
+    Simulation::Simulation(jobs::ThreadPool& thread_pool) :
+        threadPool(thread_pool), updater([this]
+        {
+            trace::set_thread_name("simulation");
+            updateLoop();
+        })
+    {
+    }
+
+    Simulation::~Simulation()
+    {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        requestCondition.notify_all();
+        updater.join();
+    }
+
+    void Simulation::requestFrame(const uint64_t frame, const std::chrono::nanoseconds scene_time)
+    {
+        {
+            std::lock_guard lock(mutex);
+            requestedFrame = frame;
+            requestedTime = scene_time;
+            requested = true;
+        }
+        requestCondition.notify_one();
+    }
+
+    void Simulation::waitIdle()
+    {
+        std::unique_lock lock(mutex);
+        idleCondition.wait(lock, [this] { return !requested && !updating; });
+    }
+
+    const SceneSnapshot& Simulation::acquire()
+    {
+        return snapshots.acquire();
+    }
+
+    TransformSystem& Simulation::getTransforms()
+    {
+        return transforms;
+    }
+
+    void Simulation::addSpin(const TransformHandle handle, const float radians_per_second)
+    {
+        spins.push_back({handle, transforms.getRotation(handle), radians_per_second});
+    }
+
+    void Simulation::update(const uint64_t frame, const std::chrono::nanoseconds scene_time)
+    {
+        TRACE_SCOPE("simulate");
+
+        SceneSnapshot& snapshot = snapshots.getBack();
+        snapshot.updateStart = std::chrono::steady_clock::now();
+
+        const float seconds = std::chrono::duration<float>(scene_time).count();
+        for (const Spin& spin : spins)
+        {
+            transforms.setRotation(spin.handle,
+                                   spin.rotation * glm::angleAxis(spin.rate * seconds, glm::vec3(0.0f, 0.0f, 1.0f)));
+        }
+
+        transforms.update(threadPool);
+
+        // The back slot is two publishes old, so the whole state is copied rather than what changed since the last
+        // update. Its capacity is kept, only a growing scene allocates.
+        const auto world_matrices = transforms.getWorldMatrices();
+        snapshot.worldMatrices.assign(world_matrices.begin(), world_matrices.end());
+        const auto world_indices = transforms.getWorldIndices();
+        snapshot.worldIndices.assign(world_indices.begin(), world_indices.end());
+
+        // Only the ranges are relative to the last update, the renderer uploads just those
+        snapshot.uploadRanges.clear();
+        transforms.forEachUploadRange([&snapshot](const uint32_t first, const uint32_t count)
+        {
+            snapshot.uploadRanges.push_back({first, count});
+        });
+        transforms.clearUploadRanges();
+        snapshot.frame = frame;
+        snapshot.update = ++updateCount;
+        snapshot.updateEnd = std::chrono::steady_clock::now();
+
+        snapshots.publish();
+    }
+
+    void Simulation::updateLoop()
+    {
+        std::unique_lock lock(mutex);
+        while (true)
+        {
+            requestCondition.wait(lock, [this] { return stopping || requested; });
+            if (stopping)
+                return;
+
+            const uint64_t frame = requestedFrame;
+            const std::chrono::nanoseconds scene_time = requestedTime;
+            requested = false;
+            updating = true;
+            lock.unlock();
+
+            update(frame, scene_time);
+
+            lock.lock();
+            updating = false;
+            if (!requested)
+                idleCondition.notify_all();
+        }
+    }
+} // scene
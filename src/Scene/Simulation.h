@@ -0,0 +1,104 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "TransformSystem.h"
+#include "TripleBuffer.h"
+
+namespace jobs
+{
+    class ThreadPool;
+}
+
+namespace scene
+{
+    struct MatrixRange
+    {
+        uint32_t first;
+        uint32_t count;
+    };
+
+    // Everything recording a frame reads of the scene, copied out once the frame's update is done
+    struct SceneSnapshot
+    {
+        uint64_t frame = 0;
+        // Counts the updates, a reader that skipped one lost its uploadRanges
+        uint64_t update = 0;
+        std::vector<glm::mat4> worldMatrices;
+        // By transform id, the transform's index in worldMatrices
+        std::vector<uint32_t> worldIndices;
+        // Runs of worldMatrices this update changed, relative to the update before it
+        std::vector<MatrixRange> uploadRanges;
+        // When the update that produced it ran
+        std::chrono::steady_clock::time_point updateStart;
+        std::chrono::steady_clock::time_point updateEnd;
+    };
+
+    // Updates the scene on a thread of its own, so the update of the next frame runs while the render thread records
+    // and submits the current one. Snapshots pass through a TripleBuffer, the render thread always draws the newest
+    // complete one and neither side waits for the other. A frame requested while an update is running starts as soon
+    // as it ends, frames requested in between are folded into it.
+    class Simulation
+    {
+    public:
+        // Updates spread over thread_pool, nothing else may run a parallelFor on it while they do
+        explicit Simulation(jobs::ThreadPool& thread_pool);
+        // Waits for the update in progress
+        ~Simulation();
+
+        Simulation(const Simulation&) = delete;
+        Simulation& operator=(const Simulation&) = delete;
+
+        // Never blocks. Spins are posed at scene_time, which the caller keeps so replays can pose them the same way.
+        void requestFrame(uint64_t frame, std::chrono::nanoseconds scene_time);
+
+        // Blocks until every requested frame is published
+        void waitIdle();
+
+        // Render thread only, never blocks
+        [[nodiscard]] const SceneSnapshot& acquire();
+
+        // Only while idle, between waitIdle() and the next requestFrame()
+        [[nodiscard]] TransformSystem& getTransforms();
+
+        // Only while idle. Turns the transform about its z axis at a constant rate with the scene time, from its
+        // current rotation at scene time 0.
+        void addSpin(TransformHandle handle, float radians_per_second);
+
+    private:
+        struct Spin
+        {
+            TransformHandle handle;
+            glm::quat rotation;
+            float rate;
+        };
+
+        jobs::ThreadPool& threadPool;
+        TransformSystem transforms;
+        std::vector<Spin> spins;
+        uint64_t updateCount = 0;
+        TripleBuffer<SceneSnapshot> snapshots;
+
+        std::mutex mutex; // Guards the request state and stopping
+        std::condition_variable requestCondition;
+        std::condition_variable idleCondition;
+        uint64_t requestedFrame = 0;
+        std::chrono::nanoseconds requestedTime{0};
+        bool requested = false;
+        bool updating = false;
+        bool stopping = false;
+        // Declared last, so it starts after everything it uses
+        std::thread updater;
+
+        void update(uint64_t frame, std::chrono::nanoseconds scene_time);
+
+        void updateLoop();
+    };
+} // scene
@@ -0,0 +1,417 @@
+#include "TransformSystem.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <numeric>
+
+#include "../Jobs/ThreadPool.h"
+#include "../simd.h"
+
+// Nodes per parallelFor chunk, small enough to split the wide levels of big scenes without drowning tiny ones in
+// scheduling overhead
+constexpr size_t update_grain_size = 1024;
+
+template <class T>
+static void permute(std::vector<T>& values, const std::vector<uint32_t>& order)
+{
+    std::vector<T> sorted;
+    sorted.reserve(values.size());
+    for (const uint32_t index : order)
+    {
+        sorted.push_back(values[index]);
+    }
+    values = std::move(sorted);
+}
+
+namespace scene
+{
+    TransformHandle TransformSystem::create(const TransformHandle parent, const glm::vec3 position,
+                                            const glm::quat rotation, const glm::vec3 scale)
+    {
+        const auto dense = static_cast<uint32_t>(parents.size());
+        const uint32_t parent_dense = parent.isValid() ? toDense(parent) : no_parent;
+        const uint32_t depth = parent_dense == no_parent ? 0 : depths[parent_dense] + 1;
+
+        if (!depths.empty() && depth < depths.back())
+        {
+            // Appending would break the depth ordering, re-sort on the next update
+            orderDirty = true;
+        }
+        else if (!orderDirty)
+        {
+            if (depth == levels.size())
+                levels.emplace_back(dense, dense + 1);
+            else
+                levels.back().second++;
+        }
+
+        positionX.push_back(position.x);
+        positionY.push_back(position.y);
+        positionZ.push_back(position.z);
+        rotationX.push_back(rotation.x);
+        rotationY.push_back(rotation.y);
+        rotationZ.push_back(rotation.z);
+        rotationW.push_back(rotation.w);
+        scaleX.push_back(scale.x);
+        scaleY.push_back(scale.y);
+        scaleZ.push_back(scale.z);
+
+        parents.push_back(parent_dense);
+        depths.push_back(depth);
+
+        localDirty.push_back(0);
+        worldStamps.push_back(0);
+        uploadDirty.push_back(0);
+        worldMatrices.emplace_back(1.0f);
+
+        const auto id = static_cast<uint32_t>(idToDense.size());
+        idToDense.push_back(dense);
+        denseToId.push_back(id);
+
+        markDirty(dense);
+
+        return {id};
+    }
+
+    void TransformSystem::setPosition(const TransformHandle handle, const glm::vec3 position)
+    {
+        const uint32_t index = toDense(handle);
+        positionX[index] = position.x;
+        positionY[index] = position.y;
+        positionZ[index] = position.z;
+        markDirty(index);
+    }
+
+    void TransformSystem::translate(const TransformHandle handle, const glm::vec3 translation)
+    {
+        setPosition(handle, getPosition(handle) + translation);
+    }
+
+    void TransformSystem::setRotation(const TransformHandle handle, const glm::quat rotation)
+    {
+        const uint32_t index = toDense(handle);
+        rotationX[index] = rotation.x;
+        rotationY[index] = rotation.y;
+        rotationZ[index] = rotation.z;
+        rotationW[index] = rotation.w;
+        markDirty(index);
+    }
+
+    void TransformSystem::rotate(const TransformHandle handle, const glm::quat rotation)
+    {
+        setRotation(handle, glm::normalize(rotation * getRotation(handle)));
+    }
+
+    void TransformSystem::setScale(const TransformHandle handle, const glm::vec3 scale)
+    {
+        const uint32_t index = toDense(handle);
+        scaleX[index] = scale.x;
+        scaleY[index] = scale.y;
+        scaleZ[index] = scale.z;
+        markDirty(index);
+    }
+
+    glm::vec3 TransformSystem::getPosition(const TransformHandle handle) const
+    {
+        const uint32_t index = toDense(handle);
+        return {positionX[index], positionY[index], positionZ[index]};
+    }
+
+    glm::quat TransformSystem::getRotation(const TransformHandle handle) const
+    {
+        const uint32_t index = toDense(handle);
+        return {rotationW[index], rotationX[index], rotationY[index], rotationZ[index]};
+    }
+
+    glm::vec3 TransformSystem::getScale(const TransformHandle handle) const
+    {
+        const uint32_t index = toDense(handle);
+        return {scaleX[index], scaleY[index], scaleZ[index]};
+    }
+
+    const glm::mat4& TransformSystem::getWorldMatrix(const TransformHandle handle) const
+    {
+        return worldMatrices[toDense(handle)];
+    }
+
+    uint32_t TransformSystem::getWorldIndex(const TransformHandle handle) const
+    {
+        return toDense(handle);
+    }
+
+    std::span<const glm::mat4> TransformSystem::getWorldMatrices() const
+    {
+        return worldMatrices;
+    }
+
+    std::span<const uint32_t> TransformSystem::getWorldIndices() const
+    {
+        return idToDense;
+    }
+
+    size_t TransformSystem::size() const
+    {
+        return parents.size();
+    }
+
+    void TransformSystem::update(jobs::ThreadPool& thread_pool)
+    {
+        if (orderDirty)
+            sortByDepth();
+
+        if (minDirtyDepth >= levels.size())
+            return;
+
+        updateStamp++;
+        firstUploadDirty = std::min(firstUploadDirty, levels[minDirtyDepth].first);
+
+        // Levels run one after the other so parents are always final before their children read them
+        for (size_t depth = minDirtyDepth; depth < levels.size(); depth++)
+        {
+            const auto [begin, end] = levels[depth];
+            thread_pool.parallelFor(end - begin, update_grain_size, [this, begin](const size_t first, const size_t last)
+            {
+                updateRange(begin + static_cast<uint32_t>(first), begin + static_cast<uint32_t>(last));
+            });
+        }
+
+        minDirtyDepth = UINT32_MAX;
+    }
+
+    void TransformSystem::clearUploadRanges()
+    {
+        if (firstUploadDirty >= uploadDirty.size())
+            return;
+
+        std::fill(uploadDirty.begin() + firstUploadDirty, uploadDirty.end(), 0);
+        firstUploadDirty = UINT32_MAX;
+    }
+
+    uint32_t TransformSystem::toDense(const TransformHandle handle) const
+    {
+        assert(handle.isValid() && handle.id < idToDense.size());
+        return idToDense[handle.id];
+    }
+
+    void TransformSystem::markDirty(const uint32_t index)
+    {
+        localDirty[index] = 1;
+        minDirtyDepth = std::min(minDirtyDepth, depths[index]);
+    }
+
+    void TransformSystem::sortByDepth()
+    {
+        std::vector<uint32_t> order(parents.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [this](const uint32_t a, const uint32_t b)
+        {
+            return depths[a] < depths[b];
+        });
+
+        std::vector<uint32_t> old_to_new(order.size());
+        for (uint32_t i = 0; i < order.size(); i++)
+        {
+            old_to_new[order[i]] = i;
+        }
+
+        for (auto* values : {
+                 &positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ, &rotationW, &scaleX, &scaleY,
+                 &scaleZ
+             })
+        {
+            permute(*values, order);
+        }
+        permute(parents, order);
+        permute(depths, order);
+        permute(denseToId, order);
+
+        for (auto& parent : parents)
+        {
+            if (parent != no_parent)
+                parent = old_to_new[parent];
+        }
+        for (uint32_t i = 0; i < denseToId.size(); i++)
+        {
+            idToDense[denseToId[i]] = i;
+        }
+
+        // Every world matrix moved, so all of them are recomputed and uploaded again
+        std::fill(localDirty.begin(), localDirty.end(), 1);
+        std::fill(uploadDirty.begin(), uploadDirty.end(), 1);
+        std::fill(worldStamps.begin(), worldStamps.end(), 0);
+        minDirtyDepth = 0;
+        firstUploadDirty = 0;
+
+        rebuildLevels();
+        orderDirty = false;
+    }
+
+    void TransformSystem::rebuildLevels()
+    {
+        levels.clear();
+        for (uint32_t i = 0; i < depths.size(); i++)
+        {
+            if (depths[i] == levels.size())
+                levels.emplace_back(i, i + 1);
+            else
+                levels.back().second++;
+        }
+    }
+
+    void TransformSystem::updateRange(const uint32_t begin, const uint32_t end)
+    {
+        std::array<uint32_t, simd::lane_count> batch{};
+        uint32_t batch_size = 0;
+
+        for (uint32_t i = begin; i < end; i++)
+        {
+            const uint32_t parent = parents[i];
+            if (!localDirty[i] && (parent == no_parent || worldStamps[parent] != updateStamp))
+                continue;
+
+            batch[batch_size++] = i;
+            if (batch_size == simd::lane_count)
+            {
+                computeBatch(batch.data(), batch_size);
+                batch_size = 0;
+            }
+        }
+
+        if (batch_size > 0)
+            computeBatch(batch.data(), batch_size);
+    }
+
+    void TransformSystem::computeBatch(const uint32_t* indices, const uint32_t count)
+    {
+        // Gather the batch into lanes, unused lanes hold an identity transform
+        alignas(16) float position[3][simd::lane_count] = {};
+        alignas(16) float rotation[4][simd::lane_count] = {{}, {}, {}, {1.0f, 1.0f, 1.0f, 1.0f}};
+        alignas(16) float scale[3][simd::lane_count] = {
+            {1.0f, 1.0f, 1.0f, 1.0f}, {1.0f, 1.0f, 1.0f, 1.0f}, {1.0f, 1.0f, 1.0f, 1.0f}
+        };
+
+        for (uint32_t lane = 0; lane < count; lane++)
+        {
+            const uint32_t index = indices[lane];
+            position[0][lane] = positionX[index];
+            position[1][lane] = positionY[index];
+            position[2][lane] = positionZ[index];
+            rotation[0][lane] = rotationX[index];
+            rotation[1][lane] = rotationY[index];
+            rotation[2][lane] = rotationZ[index];
+            rotation[3][lane] = rotationW[index];
+            scale[0][lane] = scaleX[index];
+            scale[1][lane] = scaleY[index];
+            scale[2][lane] = scaleZ[index];
+        }
+
+        // Upper 3x3 of each local matrix (rotation * scale), column major
+        alignas(16) float basis[3][3][simd::lane_count];
+
+#ifdef VKT_SIMD_SSE2
+        {
+            const __m128 x = _mm_load_ps(rotation[0]);
+            const __m128 y = _mm_load_ps(rotation[1]);
+            const __m128 z = _mm_load_ps(rotation[2]);
+            const __m128 w = _mm_load_ps(rotation[3]);
+
+            const __m128 x2 = _mm_add_ps(x, x);
+            const __m128 y2 = _mm_add_ps(y, y);
+            const __m128 z2 = _mm_add_ps(z, z);
+
+            const __m128 xx = _mm_mul_ps(x, x2);
+            const __m128 yy = _mm_mul_ps(y, y2);
+            const __m128 zz = _mm_mul_ps(z, z2);
+            const __m128 xy = _mm_mul_ps(x, y2);
+            const __m128 xz = _mm_mul_ps(x, z2);
+            const __m128 yz = _mm_mul_ps(y, z2);
+            const __m128 wx = _mm_mul_ps(w, x2);
+            const __m128 wy = _mm_mul_ps(w, y2);
+            const __m128 wz = _mm_mul_ps(w, z2);
+
+            const __m128 one = _mm_set1_ps(1.0f);
+            const __m128 sx = _mm_load_ps(scale[0]);
+            const __m128 sy = _mm_load_ps(scale[1]);
+            const __m128 sz = _mm_load_ps(scale[2]);
+
+            _mm_store_ps(basis[0][0], _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx));
+            _mm_store_ps(basis[0][1], _mm_mul_ps(_mm_add_ps(xy, wz), sx));
+            _mm_store_ps(basis[0][2], _mm_mul_ps(_mm_sub_ps(xz, wy), sx));
+
+            _mm_store_ps(basis[1][0], _mm_mul_ps(_mm_sub_ps(xy, wz), sy));
+            _mm_store_ps(basis[1][1], _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy));
+            _mm_store_ps(basis[1][2], _mm_mul_ps(_mm_add_ps(yz, wx), sy));
+
+            _mm_store_ps(basis[2][0], _mm_mul_ps(_mm_add_ps(xz, wy), sz));
+            _mm_store_ps(basis[2][1], _mm_mul_ps(_mm_sub_ps(yz, wx), sz));
+            _mm_store_ps(basis[2][2], _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz));
+        }
+#else
+        for (uint32_t lane = 0; lane < simd::lane_count; lane++)
+        {
+            const glm::quat q(rotation[3][lane], rotation[0][lane], rotation[1][lane], rotation[2][lane]);
+            const glm::mat3 r = glm::mat3_cast(q);
+            for (int column = 0; column < 3; column++)
+            {
+                for (int row = 0; row < 3; row++)
+                {
+                    basis[column][row][lane] = r[column][row] * scale[column][lane];
+                }
+            }
+        }
+#endif
+
+        for (uint32_t lane = 0; lane < count; lane++)
+        {
+            const uint32_t index = indices[lane];
+            const uint32_t parent = parents[index];
+            float* world = &worldMatrices[index][0][0];
+
+            const float local[4][4] = {
+                {basis[0][0][lane], basis[0][1][lane], basis[0][2][lane], 0.0f},
+                {basis[1][0][lane], basis[1][1][lane], basis[1][2][lane], 0.0f},
+                {basis[2][0][lane], basis[2][1][lane], basis[2][2][lane], 0.0f},
+                {position[0][lane], position[1][lane], position[2][lane], 1.0f},
+            };
+
+            if (parent == no_parent)
+            {
+                std::copy_n(&local[0][0], 16, world);
+            }
+            else
+            {
+                const float* parent_world = &worldMatrices[parent][0][0];
+#ifdef VKT_SIMD_SSE2
+                const __m128 p0 = _mm_loadu_ps(parent_world);
+                const __m128 p1 = _mm_loadu_ps(parent_world + 4);
+                const __m128 p2 = _mm_loadu_ps(parent_world + 8);
+                const __m128 p3 = _mm_loadu_ps(parent_world + 12);
+
+                for (int column = 0; column < 4; column++)
+                {
+                    __m128 result = _mm_mul_ps(p0, _mm_set1_ps(local[column][0]));
+                    result = _mm_add_ps(result, _mm_mul_ps(p1, _mm_set1_ps(local[column][1])));
+                    result = _mm_add_ps(result, _mm_mul_ps(p2, _mm_set1_ps(local[column][2])));
+                    result = _mm_add_ps(result, _mm_mul_ps(p3, _mm_set1_ps(local[column][3])));
+                    _mm_storeu_ps(world + column * 4, result);
+                }
+#else
+                for (int column = 0; column < 4; column++)
+                {
+                    for (int row = 0; row < 4; row++)
+                    {
+                        world[column * 4 + row] = parent_world[row] * local[column][0] +
+                            parent_world[4 + row] * local[column][1] + parent_world[8 + row] * local[column][2] +
+                            parent_world[12 + row] * local[column][3];
+                    }
+                }
+#endif
+            }
+
+            localDirty[index] = 0;
+            worldStamps[index] = updateStamp;
+            uploadDirty[index] = 1;
+        }
+    }
+} // scene
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace jobs
+{
+    class ThreadPool;
+}
+
+namespace scene
+{
+    struct TransformHandle
+    {
+        static constexpr uint32_t invalid = UINT32_MAX;
+
+        uint32_t id = invalid;
+
+        [[nodiscard]] bool isValid() const { return id != invalid; }
+
+        bool operator==(const TransformHandle&) const = default;
+    };
+
+    // Owns the local and world transforms of every object in the scene.
+    // Local transforms are kept as structure-of-arrays sorted by hierarchy depth, so update() can walk one depth level
+    // at a time knowing all parents are already final, and compute a level's world matrices in SIMD batches spread
+    // over the thread pool. Only transforms that changed, or whose ancestors changed, are recomputed and reported as
+    // needing an upload.
+    class TransformSystem
+    {
+    public:
+        TransformHandle create(TransformHandle parent = {}, glm::vec3 position = glm::vec3(0.0f),
+                               glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f),
+                               glm::vec3 scale = glm::vec3(1.0f));
+
+        void setPosition(TransformHandle handle, glm::vec3 position);
+        void translate(TransformHandle handle, glm::vec3 translation);
+        void setRotation(TransformHandle handle, glm::quat rotation);
+        void rotate(TransformHandle handle, glm::quat rotation);
+        void setScale(TransformHandle handle, glm::vec3 scale);
+
+        [[nodiscard]] glm::vec3 getPosition(TransformHandle handle) const;
+        [[nodiscard]] glm::quat getRotation(TransformHandle handle) const;
+        [[nodiscard]] glm::vec3 getScale(TransformHandle handle) const;
+
+        // Valid after the update() following the last change
+        [[nodiscard]] const glm::mat4& getWorldMatrix(TransformHandle handle) const;
+
+        // Position of the transform in getWorldMatrices(), changes whenever the hierarchy is re-sorted
+        [[nodiscard]] uint32_t getWorldIndex(TransformHandle handle) const;
+
+        [[nodiscard]] std::span<const glm::mat4> getWorldMatrices() const;
+
+        // getWorldIndex() of every transform, by handle id
+        [[nodiscard]] std::span<const uint32_t> getWorldIndices() const;
+
+        [[nodiscard]] size_t size() const;
+
+        void update(jobs::ThreadPool& thread_pool);
+
+        // Calls function(first, count) for each run of world matrices recomputed since the last clearUploadRanges()
+        template <class F>
+        void forEachUploadRange(F&& function) const
+        {
+            const auto count = static_cast<uint32_t>(uploadDirty.size());
+            for (uint32_t i = firstUploadDirty; i < count; i++)
+            {
+                if (!uploadDirty[i])
+                    continue;
+
+                const uint32_t first = i;
+                while (i < count && uploadDirty[i])
+                    i++;
+                function(first, i - first);
+            }
+        }
+
+        void clearUploadRanges();
+
+    private:
+        static constexpr uint32_t no_parent = UINT32_MAX;
+
+        // Local transforms, indexed by dense (depth sorted) index
+        std::vector<float> positionX, positionY, positionZ;
+        std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+        std::vector<float> scaleX, scaleY, scaleZ;
+
+        std::vector<uint32_t> parents;
+        std::vector<uint32_t> depths;
+
+        std::vector<uint8_t> localDirty;
+        // Update in which the world matrix was last recomputed, children compare against it instead of a flag that
+        // would need clearing every update
+        std::vector<uint32_t> worldStamps;
+        std::vector<uint8_t> uploadDirty;
+        std::vector<glm::mat4> worldMatrices;
+
+        std::vector<uint32_t> denseToId;
+        std::vector<uint32_t> idToDense;
+
+        // [begin, end) dense range of each depth level
+        std::vector<std::pair<uint32_t, uint32_t>> levels;
+
+        uint32_t updateStamp = 0;
+        uint32_t minDirtyDepth = UINT32_MAX;
+        uint32_t firstUploadDirty = UINT32_MAX;
+        bool orderDirty = false;
+
+        [[nodiscard]] uint32_t toDense(TransformHandle handle) const;
+
+        void markDirty(uint32_t index);
+
+        void sortByDepth();
+
+        void rebuildLevels();
+
+        void updateRange(uint32_t begin, uint32_t end);
+
+        void computeBatch(const uint32_t* indices, uint32_t count);
+    };
+} // scene
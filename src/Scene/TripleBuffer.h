@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace scene
+{
+    // Hands values from one producer thread to one consumer thread without either ever waiting for the other.
+    // The producer fills the back slot and publishes it, swapping it with the middle one. The consumer swaps the
+    // middle slot with its front one whenever something new was published since, so it always reads the newest
+    // complete value and the producer never overwrites the one being read.
+    template <class T>
+    class TripleBuffer
+    {
+    public:
+        // Producer only
+        [[nodiscard]] T& getBack()
+        {
+            return slots[back];
+        }
+
+        // Producer only, getBack() is a different slot afterwards
+        void publish()
+        {
+            back = middle.exchange(back | fresh_bit, std::memory_order_acq_rel) & index_mask;
+        }
+
+        // Consumer only, the newest published value, which stays put until the next acquire()
+        [[nodiscard]] const T& acquire()
+        {
+            if (middle.load(std::memory_order_relaxed) & fresh_bit)
+                front = middle.exchange(front, std::memory_order_acq_rel) & index_mask;
+            return slots[front];
+        }
+
+    private:
+        static constexpr uint32_t index_mask = 3;
+        // Set on the middle slot when it was published after the consumer's last acquire()
+        static constexpr uint32_t fresh_bit = 4;
+
+        std::array<T, 3> slots{};
+        uint32_t back = 0;
+        std::atomic<uint32_t> middle = 1;
+        uint32_t front = 2;
+    };
+} // scene
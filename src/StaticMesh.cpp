@@ -0,0 +1,24 @@
+#include "StaticMesh.h"
+
+StaticMesh::StaticMesh(std::vector<Vertex> vertices) : vertices(std::move(vertices))
+{
+}
+
+StaticMesh StaticMesh::triangle()
+{
+    return StaticMesh({
+        {{0.0f, -0.5f}, {1.0f, 0.0f, 0.0f}},
+        {{0.5f, 0.5f}, {0.0f, 1.0f, 0.0f}},
+        {{-0.5f, 0.5f}, {0.0f, 0.0f, 1.0f}},
+    });
+}
+
+std::vector<Vertex> StaticMesh::pack() const
+{
+    return vertices;
+}
+
+void StaticMesh::setVertices(std::vector<Vertex> new_vertices)
+{
+    vertices = std::move(new_vertices);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <vector>
+
+#include "Drawable.h"
+
+// Geometry that is already packed, like the built-in test shapes
+class StaticMesh : public Drawable
+{
+public:
+    explicit StaticMesh(std::vector<Vertex> vertices);
+
+    // The RGB triangle shown by default
+    static StaticMesh triangle();
+
+    [[nodiscard]] std::vector<Vertex> pack() const override;
+
+    void setVertices(std::vector<Vertex> new_vertices);
+
+private:
+    std::vector<Vertex> vertices;
+};
@@ -0,0 +1,117 @@
+#include "Ktx2.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+
+constexpr unsigned char ktx2_identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+// Identifier, header and index, after which the level index starts
+constexpr size_t ktx2_level_index_offset = 80;
+constexpr size_t ktx2_level_entry_size = 24;
+
+// Covers the texel block size of every block-compressed format and the 4 byte alignment of buffer copy offsets
+constexpr size_t level_alignment = 16;
+
+// Fields are little endian, like every platform this runs on
+template <class T>
+static T read_field(const unsigned char* data)
+{
+    T value;
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+
+static void read_exactly(std::ifstream& file, const std::filesystem::path& path, const uint64_t offset, void* data,
+                         const size_t size)
+{
+    file.seekg(static_cast<std::streamoff>(offset));
+    file.read(static_cast<char*>(data), static_cast<std::streamsize>(size));
+    if (!file)
+        throw std::runtime_error("Truncated KTX2 file " + path.string());
+}
+
+namespace textures
+{
+    uint32_t Ktx2File::getLevelCount() const
+    {
+        return static_cast<uint32_t>(levels.size());
+    }
+
+    vk::Extent2D Ktx2File::getLevelExtent(const uint32_t level) const
+    {
+        return {std::max(width >> level, 1u), std::max(height >> level, 1u)};
+    }
+
+    Ktx2File read_ktx2_header(const std::filesystem::path& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            throw std::runtime_error("Failed to open texture " + path.string());
+
+        unsigned char header[ktx2_level_index_offset];
+        read_exactly(file, path, 0, header, sizeof(header));
+        if (std::memcmp(header, ktx2_identifier, sizeof(ktx2_identifier)) != 0)
+            throw std::runtime_error(path.string() + " is not a KTX2 file");
+
+        Ktx2File result;
+        result.format = static_cast<vk::Format>(read_field<uint32_t>(header + 12));
+        result.width = read_field<uint32_t>(header + 20);
+        result.height = read_field<uint32_t>(header + 24);
+        const auto depth = read_field<uint32_t>(header + 28);
+        const auto layer_count = read_field<uint32_t>(header + 32);
+        const auto face_count = read_field<uint32_t>(header + 36);
+        // Zero asks the loader to generate the mips, only the base level is stored then
+        const uint32_t level_count = std::max(read_field<uint32_t>(header + 40), 1u);
+        const auto supercompression = read_field<uint32_t>(header + 44);
+
+        // Basis Universal payloads have no Vulkan format and would need a transcoder
+        if (result.format == vk::Format::eUndefined || supercompression != 0)
+            throw std::runtime_error(path.string() + " is supercompressed, only plain KTX2 is supported");
+        if (result.width == 0 || result.height == 0 || depth > 0 || layer_count > 0 || face_count != 1)
+            throw std::runtime_error(path.string() + " is not a single 2D texture");
+        if (level_count > 32 || (std::max(result.width, result.height) >> (level_count - 1)) == 0)
+            throw std::runtime_error(path.string() + " has more mip levels than its size allows");
+
+        std::vector<unsigned char> level_index(static_cast<size_t>(level_count) * ktx2_level_entry_size);
+        read_exactly(file, path, ktx2_level_index_offset, level_index.data(), level_index.size());
+
+        result.levels.resize(level_count);
+        for (uint32_t level = 0; level < level_count; level++)
+        {
+            const unsigned char* entry = level_index.data() + static_cast<size_t>(level) * ktx2_level_entry_size;
+            result.levels[level] = {read_field<uint64_t>(entry), read_field<uint64_t>(entry + 8)};
+        }
+
+        return result;
+    }
+
+    Ktx2Levels read_ktx2_levels(const std::filesystem::path& path, const Ktx2File& file, const uint32_t first_level,
+                                const uint32_t end_level)
+    {
+        std::ifstream stream(path, std::ios::binary);
+        if (!stream)
+            throw std::runtime_error("Failed to open texture " + path.string());
+
+        Ktx2Levels result;
+        result.firstLevel = first_level;
+
+        size_t size = 0;
+        for (uint32_t level = first_level; level < end_level; level++)
+        {
+            result.offsets.push_back(size);
+            size += (file.levels[level].size + level_alignment - 1) & ~(level_alignment - 1);
+        }
+
+        result.data.resize(size);
+        for (uint32_t level = first_level; level < end_level; level++)
+        {
+            std::byte* destination = result.data.data() + result.offsets[level - first_level];
+            read_exactly(stream, path, file.levels[level].offset, destination, file.levels[level].size);
+        }
+
+        return result;
+    }
+} // textures
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include <vulkan/vulkan.hpp>
+
+namespace textures
+{
+    // Header and level index of a KTX 2.0 container holding a single 2D texture. Level data stays in the file and is
+    // read on demand, so opening a texture costs one small read however large it is.
+    struct Ktx2File
+    {
+        struct Level
+        {
+            uint64_t offset;
+            uint64_t size;
+        };
+
+        vk::Format format = vk::Format::eUndefined;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        // Level 0 is the full resolution one
+        std::vector<Level> levels;
+
+        [[nodiscard]] uint32_t getLevelCount() const;
+        [[nodiscard]] vk::Extent2D getLevelExtent(uint32_t level) const;
+    };
+
+    // Throws std::runtime_error unless the file holds one 2D texture in a Vulkan format without supercompression
+    [[nodiscard]] Ktx2File read_ktx2_header(const std::filesystem::path& path);
+
+    // Levels [first_level, end_level) back to back, each aligned for buffer to image copies
+    struct Ktx2Levels
+    {
+        uint32_t firstLevel = 0;
+        std::vector<size_t> offsets; // Per level, from firstLevel on
+        std::vector<std::byte> data;
+    };
+
+    [[nodiscard]] Ktx2Levels read_ktx2_levels(const std::filesystem::path& path, const Ktx2File& file,
+                                              uint32_t first_level, uint32_t end_level);
+} // textures
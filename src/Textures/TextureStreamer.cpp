@@ -0,0 +1,487 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include "../Trace/Trace.h"
+
+// Per frame in flight, reads larger than this get a staging buffer of their own
+constexpr vk::DeviceSize texture_staging_size = 16 << 20;
+// Levels at or below this size make up the mip tail every texture starts with and never gives up
+constexpr uint32_t mip_tail_size = 64;
+// Matches the level alignment of Ktx2Levels
+constexpr vk::DeviceSize staging_alignment = 16;
+
+namespace textures
+{
+    TextureStreamer::TextureStreamer(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physical_device,
+                                     renderer::MemoryTracker& memory_tracker,
+                                     renderer::TimelineScheduler& graphics_timeline,
+                                     renderer::TimelineScheduler& transfer_timeline,
+                                     const std::span<const uint32_t> queue_families, const uint32_t frames_in_flight,
+                                     const vk::DeviceSize budget,
+                                     const vk::Optional<const vk::AllocationCallbacks> allocator) :
+        device(device), physicalDevice(physical_device), memoryTracker(memory_tracker),
+        graphicsTimeline(graphics_timeline), transferTimeline(transfer_timeline),
+        queueFamilies(queue_families.begin(), queue_families.end()), budget(budget),
+        allocator(allocator)
+    {
+        std::ranges::sort(queueFamilies);
+        queueFamilies.erase(std::unique(queueFamilies.begin(), queueFamilies.end()), queueFamilies.end());
+
+        // BC7 is what desktop GPUs sample, ASTC and then ETC2 cover mobile ones
+        const vk::PhysicalDeviceFeatures features = getCompressionFeatures(physical_device);
+        if (features.textureCompressionBC)
+            supportedVariants.emplace_back("bc7");
+        if (features.textureCompressionASTC_LDR)
+            supportedVariants.emplace_back("astc");
+        if (features.textureCompressionETC2)
+            supportedVariants.emplace_back("etc2");
+
+        for (uint32_t i = 0; i < frames_in_flight; i++)
+        {
+            auto [buffer, memory] = createStagingBuffer(texture_staging_size, "texture staging");
+            stagingMappings.push_back(memory.mapMemory(0, texture_staging_size));
+            stagingBuffers.push_back(std::move(buffer));
+            stagingMemories.push_back(std::move(memory));
+        }
+
+        reader = std::thread([this]
+        {
+            trace::set_thread_name("texture reader");
+            readLoop();
+        });
+    }
+
+    TextureStreamer::~TextureStreamer()
+    {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        readCondition.notify_all();
+        reader.join();
+    }
+
+    vk::PhysicalDeviceFeatures TextureStreamer::getCompressionFeatures(const vk::raii::PhysicalDevice& physical_device)
+    {
+        const vk::PhysicalDeviceFeatures supported = physical_device.getFeatures();
+
+        vk::PhysicalDeviceFeatures features;
+        features.textureCompressionBC = supported.textureCompressionBC;
+        features.textureCompressionASTC_LDR = supported.textureCompressionASTC_LDR;
+        features.textureCompressionETC2 = supported.textureCompressionETC2;
+        return features;
+    }
+
+    TextureHandle TextureStreamer::load(const std::filesystem::path& path)
+    {
+        std::filesystem::path chosen = path;
+        for (const auto& variant : supportedVariants)
+        {
+            std::filesystem::path candidate = path;
+            candidate.replace_extension("." + variant + path.extension().string());
+            if (std::filesystem::exists(candidate))
+            {
+                chosen = std::move(candidate);
+                break;
+            }
+        }
+
+        Texture texture;
+        texture.file = read_ktx2_header(chosen);
+        texture.path = std::move(chosen);
+
+        const vk::FormatProperties properties = physicalDevice.getFormatProperties(texture.file.format);
+        if (!(properties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eSampledImage))
+            throw std::runtime_error("This device cannot sample the " + vk::to_string(texture.file.format) + " of " +
+                                     texture.path.string());
+
+        const uint32_t level_count = texture.file.getLevelCount();
+        texture.tailLevel = level_count - 1;
+        while (texture.tailLevel > 0)
+        {
+            const vk::Extent2D extent = texture.file.getLevelExtent(texture.tailLevel - 1);
+            if (std::max(extent.width, extent.height) > mip_tail_size)
+                break;
+            texture.tailLevel--;
+        }
+        texture.rangeBytes.resize(level_count);
+        for (uint32_t level = 0; level < level_count; level++)
+        {
+            const vk::ImageCreateInfo image_info = getImageInfo(texture, level);
+            texture.rangeBytes[level] = device.getImageMemoryRequirements(
+                vk::DeviceImageMemoryRequirements(&image_info)).memoryRequirements.size;
+        }
+        texture.residentLevel = level_count;
+        texture.wantedLevel = texture.tailLevel;
+        texture.lastSeenFrame = frame;
+
+        const auto index = static_cast<uint32_t>(textures.size());
+        textures.push_back(std::move(texture));
+        queueRead(index, textures[index].tailLevel);
+
+        return {index};
+    }
+
+    void TextureStreamer::requestSize(const TextureHandle handle, const float pixels)
+    {
+        Texture& texture = textures[handle.index];
+        texture.requestedPixels = std::max(texture.requestedPixels, pixels);
+        texture.lastSeenFrame = frame;
+    }
+
+    bool TextureStreamer::recordUploads(const vk::raii::CommandBuffer& command_buffer, const uint32_t frame_slot)
+    {
+        TRACE_SCOPE("recordTextureUploads");
+
+        // Last frame's submit has been made by now, so retiring covers it
+        for (auto& staging : oversizedStaging)
+        {
+            transferTimeline.retire(std::move(staging));
+        }
+        oversizedStaging.clear();
+
+        // Likewise the frames sampling and the copies reading the images replaced last frame
+        for (auto& image : replacedImages)
+        {
+            image.graphicsValue = graphicsTimeline.getSubmittedValue();
+            image.transferValue = transferTimeline.getSubmittedValue();
+            retiredImages.push_back(std::move(image));
+        }
+        replacedImages.clear();
+        while (!retiredImages.empty() && retiredImages.front().graphicsValue <= graphicsTimeline.getCompletedValue() &&
+               retiredImages.front().transferValue <= transferTimeline.getCompletedValue())
+        {
+            residentBytes -= retiredImages.front().bytes;
+            retiredImages.pop_front();
+        }
+
+        bool recorded = false;
+
+        chooseLevels();
+        for (uint32_t i = 0; i < textures.size(); i++)
+        {
+            Texture& texture = textures[i];
+            if (texture.loading)
+                continue;
+
+            // Giving levels up only copies what stays on the GPU, so it happens right away
+            if (texture.wantedLevel > texture.residentLevel)
+            {
+                replaceImage(command_buffer, texture, texture.wantedLevel, nullptr, 0, nullptr);
+                recorded = true;
+            }
+            else if (!texture.failed && texture.wantedLevel < texture.residentLevel)
+                queueRead(i, texture.wantedLevel);
+        }
+
+        vk::DeviceSize staging_offset = 0;
+
+        std::unique_lock lock(mutex);
+        while (!results.empty())
+        {
+            ReadResult result = std::move(results.front());
+            results.pop_front();
+            lock.unlock();
+
+            if (!upload(command_buffer, frame_slot, staging_offset, result))
+            {
+                // Out of staging space or budget, the rest waits for the next frame
+                lock.lock();
+                results.push_front(std::move(result));
+                break;
+            }
+            recorded |= !result.failed;
+
+            lock.lock();
+        }
+        lock.unlock();
+
+        frame++;
+        return recorded;
+    }
+
+    vk::ImageView TextureStreamer::getView(const TextureHandle handle) const
+    {
+        return *textures[handle.index].view;
+    }
+
+    uint32_t TextureStreamer::getResidentLevel(const TextureHandle handle) const
+    {
+        return textures[handle.index].residentLevel;
+    }
+
+    bool TextureStreamer::isStreaming() const
+    {
+        return loadingCount > 0;
+    }
+
+    TextureStreamer::Stats TextureStreamer::getStats() const
+    {
+        return {static_cast<uint32_t>(textures.size()), residentBytes, budget, streamedLevels, evictedLevels};
+    }
+
+    vk::ImageCreateInfo TextureStreamer::getImageInfo(const Texture& texture, const uint32_t first_level) const
+    {
+        vk::ImageCreateInfo image_info({}, vk::ImageType::e2D, texture.file.format,
+                                       vk::Extent3D(texture.file.getLevelExtent(first_level), 1),
+                                       texture.file.getLevelCount() - first_level, 1, vk::SampleCountFlagBits::e1,
+                                       vk::ImageTiling::eOptimal,
+                                       vk::ImageUsageFlagBits::eSampled | vk::ImageUsageFlagBits::eTransferSrc |
+                                       vk::ImageUsageFlagBits::eTransferDst);
+        // Sampled by graphics, written by the transfer queue, concurrent sharing spares the ownership transfers
+        if (queueFamilies.size() > 1)
+        {
+            image_info.sharingMode = vk::SharingMode::eConcurrent;
+            image_info.setQueueFamilyIndices(queueFamilies);
+        }
+        return image_info;
+    }
+
+    void TextureStreamer::chooseLevels()
+    {
+        vk::DeviceSize total = 0;
+        for (auto& texture : textures)
+        {
+            // Levels that are already resident stay until the budget needs them, so a texture shrinking on screen
+            // for a moment does not have to stream them in again
+            uint32_t level = std::min(texture.residentLevel, texture.tailLevel);
+            if (texture.requestedPixels > 0.0f)
+            {
+                const auto largest = static_cast<float>(std::max(texture.file.width, texture.file.height));
+                const float wanted = std::floor(std::log2(largest / texture.requestedPixels));
+                level = std::min(level, static_cast<uint32_t>(std::clamp(wanted, 0.0f,
+                                                                         static_cast<float>(texture.tailLevel))));
+            }
+
+            texture.wantedLevel = level;
+            texture.requestedPixels = 0.0f;
+            total += texture.rangeBytes[level];
+        }
+
+        if (total <= budget)
+            return;
+
+        // Least recently seen first, ties in load order so the same textures give way every frame
+        evictionOrder.resize(textures.size());
+        for (uint32_t i = 0; i < evictionOrder.size(); i++)
+        {
+            evictionOrder[i] = i;
+        }
+        std::ranges::stable_sort(evictionOrder, [this](const uint32_t a, const uint32_t b)
+        {
+            return textures[a].lastSeenFrame < textures[b].lastSeenFrame;
+        });
+
+        for (const uint32_t index : evictionOrder)
+        {
+            Texture& texture = textures[index];
+            while (total > budget && texture.wantedLevel < texture.tailLevel)
+            {
+                total -= texture.rangeBytes[texture.wantedLevel] - texture.rangeBytes[texture.wantedLevel + 1];
+                texture.wantedLevel++;
+            }
+            if (total <= budget)
+                break;
+        }
+    }
+
+    void TextureStreamer::queueRead(const uint32_t index, const uint32_t first_level)
+    {
+        Texture& texture = textures[index];
+        texture.loading = true;
+        loadingCount++;
+
+        {
+            std::lock_guard lock(mutex);
+            requests.push_back({index, first_level, texture.residentLevel, texture.path, texture.file});
+        }
+        readCondition.notify_one();
+    }
+
+    bool TextureStreamer::upload(const vk::raii::CommandBuffer& command_buffer, const uint32_t frame_slot,
+                                 vk::DeviceSize& staging_offset, const ReadResult& result)
+    {
+        Texture& texture = textures[result.texture];
+        if (result.failed)
+        {
+            texture.loading = false;
+            texture.failed = true;
+            loadingCount--;
+            return true;
+        }
+
+        // The old image stays alongside the new one until it is freed, while retired images are still to be freed
+        // waiting for them keeps both within the budget
+        if (residentBytes + texture.rangeBytes[result.levels.firstLevel] > budget &&
+            (!replacedImages.empty() || !retiredImages.empty()))
+            return false;
+
+        const Ktx2Levels& levels = result.levels;
+        const vk::DeviceSize size = levels.data.size();
+
+        vk::Buffer staging_buffer;
+        vk::DeviceSize buffer_offset = 0;
+        if (size > texture_staging_size)
+        {
+            // Only alone, so a huge read cannot hold up the small ones queued behind it for long
+            if (staging_offset > 0)
+                return false;
+
+            auto staging = createStagingBuffer(size, "texture staging (oversized)");
+            void* mapping = staging.second.mapMemory(0, size);
+            std::memcpy(mapping, levels.data.data(), size);
+            staging.second.unmapMemory();
+            staging_buffer = *staging.first;
+            oversizedStaging.push_back(std::move(staging));
+            staging_offset = texture_staging_size;
+        }
+        else
+        {
+            buffer_offset = (staging_offset + staging_alignment - 1) & ~(staging_alignment - 1);
+            if (buffer_offset + size > texture_staging_size)
+                return false;
+
+            std::memcpy(static_cast<std::byte*>(stagingMappings[frame_slot]) + buffer_offset, levels.data.data(), size);
+            staging_buffer = *stagingBuffers[frame_slot];
+            staging_offset = buffer_offset + size;
+        }
+
+        replaceImage(command_buffer, texture, levels.firstLevel, staging_buffer, buffer_offset, &levels);
+        texture.loading = false;
+        loadingCount--;
+        return true;
+    }
+
+    void TextureStreamer::replaceImage(const vk::raii::CommandBuffer& command_buffer, Texture& texture,
+                                       const uint32_t first_level, const vk::Buffer staging_buffer,
+                                       const vk::DeviceSize buffer_offset, const Ktx2Levels* levels)
+    {
+        const uint32_t level_count = texture.file.getLevelCount() - first_level;
+        const uint32_t previous_level = texture.residentLevel;
+
+        vk::raii::Image image(device, getImageInfo(texture, first_level), allocator);
+
+        const vk::MemoryRequirements requirements = image.getMemoryRequirements();
+        const vk::MemoryAllocateInfo allocate_info(
+            requirements.size, renderer::find_memory_type(physicalDevice.getMemoryProperties(),
+                                                          requirements.memoryTypeBits,
+                                                          vk::MemoryPropertyFlagBits::eDeviceLocal));
+        renderer::TrackedDeviceMemory memory(device, allocate_info, memoryTracker, renderer::MemoryCategory::Textures,
+                                             texture.path.filename().string(), allocator);
+        image.bindMemory(*memory, 0);
+
+        const vk::ImageSubresourceRange subresource_range(vk::ImageAspectFlagBits::eColor, 0, level_count, 0, 1);
+
+        const vk::ImageMemoryBarrier2 to_transfer({}, {}, vk::PipelineStageFlagBits2::eCopy,
+                                                  vk::AccessFlagBits2::eTransferWrite, vk::ImageLayout::eUndefined,
+                                                  vk::ImageLayout::eTransferDstOptimal, vk::QueueFamilyIgnored,
+                                                  vk::QueueFamilyIgnored, *image, subresource_range);
+        command_buffer.pipelineBarrier2(vk::DependencyInfo({}, {}, {}, to_transfer));
+
+        const auto new_levels = levels ? static_cast<uint32_t>(levels->offsets.size()) : 0;
+        for (uint32_t level = 0; level < new_levels; level++)
+        {
+            const vk::BufferImageCopy region(buffer_offset + levels->offsets[level], 0, 0,
+                                             vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level, 0, 1),
+                                             {}, vk::Extent3D(texture.file.getLevelExtent(first_level + level), 1));
+            command_buffer.copyBufferToImage(staging_buffer, *image, vk::ImageLayout::eTransferDstOptimal, region);
+        }
+
+        // Frames in flight only sample the old image, so copying from it alongside them needs no barrier
+        for (uint32_t level = first_level + new_levels; level < texture.file.getLevelCount(); level++)
+        {
+            const vk::ImageCopy region(
+                vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level - previous_level, 0, 1), {},
+                vk::ImageSubresourceLayers(vk::ImageAspectFlagBits::eColor, level - first_level, 0, 1), {},
+                vk::Extent3D(texture.file.getLevelExtent(level), 1));
+            command_buffer.copyImage(*texture.image, vk::ImageLayout::eGeneral, *image,
+                                     vk::ImageLayout::eTransferDstOptimal, region);
+        }
+
+        // Later copies on this queue read it as the source of the next replacement. Graphics waits for the submit's
+        // semaphore before sampling, which also orders this transition.
+        const vk::ImageMemoryBarrier2 to_general(vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferWrite,
+                                                 vk::PipelineStageFlagBits2::eCopy, vk::AccessFlagBits2::eTransferRead,
+                                                 vk::ImageLayout::eTransferDstOptimal, vk::ImageLayout::eGeneral,
+                                                 vk::QueueFamilyIgnored, vk::QueueFamilyIgnored, *image,
+                                                 subresource_range);
+        command_buffer.pipelineBarrier2(vk::DependencyInfo({}, {}, {}, to_general));
+
+        vk::raii::ImageView view(device, vk::ImageViewCreateInfo({}, *image, vk::ImageViewType::e2D,
+                                                                 texture.file.format, {}, subresource_range),
+                                 allocator);
+
+        // Frames already submitted may still sample the old image, the ones recorded from now on use the new one
+        if (*texture.image)
+        {
+            replacedImages.push_back({0, 0, texture.imageBytes, std::move(texture.image), std::move(texture.memory),
+                                      std::move(texture.view)});
+        }
+
+        if (first_level < previous_level)
+            streamedLevels += previous_level - first_level;
+        else
+            evictedLevels += first_level - previous_level;
+        residentBytes += requirements.size;
+
+        texture.image = std::move(image);
+        texture.memory = std::move(memory);
+        texture.view = std::move(view);
+        texture.imageBytes = requirements.size;
+        texture.residentLevel = first_level;
+    }
+
+    std::pair<vk::raii::Buffer, renderer::TrackedDeviceMemory> TextureStreamer::createStagingBuffer(
+        const vk::DeviceSize size, const std::string_view owner) const
+    {
+        vk::raii::Buffer buffer(device, vk::BufferCreateInfo({}, size, vk::BufferUsageFlagBits::eTransferSrc),
+                                allocator);
+        const vk::MemoryRequirements requirements = buffer.getMemoryRequirements();
+        const vk::MemoryAllocateInfo allocate_info(
+            requirements.size, renderer::find_memory_type(physicalDevice.getMemoryProperties(),
+                                                          requirements.memoryTypeBits,
+                                                          vk::MemoryPropertyFlagBits::eHostVisible |
+                                                          vk::MemoryPropertyFlagBits::eHostCoherent));
+        renderer::TrackedDeviceMemory memory(device, allocate_info, memoryTracker, renderer::MemoryCategory::Staging,
+                                             owner, allocator);
+        buffer.bindMemory(*memory, 0);
+        return {std::move(buffer), std::move(memory)};
+    }
+
+    void TextureStreamer::readLoop()
+    {
+        while (true)
+        {
+            ReadRequest request;
+            {
+                std::unique_lock lock(mutex);
+                readCondition.wait(lock, [this] { return stopping || !requests.empty(); });
+                if (stopping)
+                    return;
+
+                request = std::move(requests.front());
+                requests.pop_front();
+            }
+
+            ReadResult result{request.texture, false, {}};
+            try
+            {
+                TRACE_SCOPE("read texture");
+                result.levels = read_ktx2_levels(request.path, request.file, request.firstLevel, request.endLevel);
+            }
+            catch (const std::runtime_error& error)
+            {
+                std::cerr << error.what() << std::endl;
+                result.failed = true;
+            }
+
+            std::lock_guard lock(mutex);
+            results.push_back(std::move(result));
+        }
+    }
+} // textures
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <vulkan/vulkan_raii.hpp>
+
+#include "Ktx2.h"
+#include "../Renderer/MemoryTracker.h"
+#include "../Renderer/TimelineScheduler.h"
+
+namespace textures
+{
+    struct TextureHandle
+    {
+        uint32_t index = UINT32_MAX;
+
+        [[nodiscard]] bool isValid() const
+        {
+            return index != UINT32_MAX;
+        }
+    };
+
+    // Block-compressed KTX2 textures whose mips stream in as they are needed.
+    // A texture starts with only its mip tail resident. Every frame the renderer reports how large each texture is on
+    // screen, and the levels that size needs are read from disk on a background thread, then copied on the transfer
+    // queue. The images of all textures stay within a fixed budget, when it is exceeded the least recently seen
+    // textures give up their largest levels first.
+    // Without sparse residency a texture's levels live in one image, so changing them creates a new image holding the
+    // new range and retires the old one once the frames still sampling it are done. Levels the old image already has
+    // are copied from it on the GPU, only new ones are read from disk and giving levels up reads nothing. Images stay
+    // in the general layout so they can be copied from while frames in flight sample them.
+    class TextureStreamer
+    {
+    public:
+        struct Stats
+        {
+            uint32_t textures = 0;
+            vk::DeviceSize residentBytes = 0; // Allocated for images, retired ones included until they are freed
+            vk::DeviceSize budget = 0;
+            uint64_t streamedLevels = 0;
+            uint64_t evictedLevels = 0;
+        };
+
+        // Images are shared between the graphics family and the transfer family recording the uploads. Retired images
+        // wait for both timelines, oversized staging buffers for transfer_timeline.
+        TextureStreamer(const vk::raii::Device& device, const vk::raii::PhysicalDevice& physical_device,
+                        renderer::MemoryTracker& memory_tracker, renderer::TimelineScheduler& graphics_timeline,
+                        renderer::TimelineScheduler& transfer_timeline, std::span<const uint32_t> queue_families,
+                        uint32_t frames_in_flight, vk::DeviceSize budget,
+                        vk::Optional<const vk::AllocationCallbacks> allocator = nullptr);
+        // Waits for the reads still in progress
+        ~TextureStreamer();
+
+        TextureStreamer(const TextureStreamer&) = delete;
+        TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+        // Device features to enable for the block-compressed formats this device can sample
+        [[nodiscard]] static vk::PhysicalDeviceFeatures getCompressionFeatures(
+            const vk::raii::PhysicalDevice& physical_device);
+
+        // Picks the variant of path the device supports, path.bc7.ktx2, path.astc.ktx2 or path.etc2.ktx2 when they
+        // exist next to it, path itself otherwise. Only reads the header, the mip tail is queued right away.
+        TextureHandle load(const std::filesystem::path& path);
+
+        // Largest on-screen size in pixels the texture was drawn at this frame
+        void requestSize(TextureHandle handle, float pixels);
+
+        // Decides the levels every texture should have, queues the reads and records the copies of finished reads.
+        // Images created here are in use once command_buffer has run. Returns whether anything was recorded.
+        bool recordUploads(const vk::raii::CommandBuffer& command_buffer, uint32_t frame_slot);
+
+        // Null until the mip tail has been uploaded, sampled in the general layout
+        [[nodiscard]] vk::ImageView getView(TextureHandle handle) const;
+
+        // First level of the texture's resident range, its level count when nothing is resident yet
+        [[nodiscard]] uint32_t getResidentLevel(TextureHandle handle) const;
+
+        // Whether reads are queued or in flight, frames keep allocating while they are
+        [[nodiscard]] bool isStreaming() const;
+
+        [[nodiscard]] Stats getStats() const;
+
+    private:
+        struct Texture
+        {
+            std::filesystem::path path;
+            Ktx2File file;
+            uint32_t tailLevel = 0; // First level of the mip tail, never evicted
+            // Per first level, what an image holding the levels from there on allocates
+            std::vector<vk::DeviceSize> rangeBytes;
+
+            vk::raii::Image image = nullptr;
+            renderer::TrackedDeviceMemory memory = nullptr;
+            vk::raii::ImageView view = nullptr;
+            vk::DeviceSize imageBytes = 0;
+            uint32_t residentLevel = 0;
+
+            uint32_t wantedLevel = 0;
+            float requestedPixels = 0.0f;
+            uint64_t lastSeenFrame = 0;
+            bool loading = false;
+            bool failed = false; // A read failed, the texture keeps what it has
+        };
+
+        // Carries copies of what the reader needs, textures may reallocate while it reads
+        struct ReadRequest
+        {
+            uint32_t texture;
+            uint32_t firstLevel;
+            uint32_t endLevel; // The resident levels from here on are copied from the current image
+            std::filesystem::path path;
+            Ktx2File file;
+        };
+
+        struct ReadResult
+        {
+            uint32_t texture;
+            bool failed;
+            Ktx2Levels levels;
+        };
+
+        // Freed once graphics is done sampling it and the transfer queue is done copying from it
+        struct RetiredImage
+        {
+            uint64_t graphicsValue;
+            uint64_t transferValue;
+            vk::DeviceSize bytes;
+            vk::raii::Image image;
+            renderer::TrackedDeviceMemory memory;
+            vk::raii::ImageView view;
+        };
+
+        const vk::raii::Device& device;
+        const vk::raii::PhysicalDevice& physicalDevice;
+        renderer::MemoryTracker& memoryTracker;
+        renderer::TimelineScheduler& graphicsTimeline;
+        renderer::TimelineScheduler& transferTimeline;
+        std::vector<uint32_t> queueFamilies;
+        vk::DeviceSize budget;
+        vk::Optional<const vk::AllocationCallbacks> allocator;
+
+        // Preferred first
+        std::vector<std::string> supportedVariants;
+
+        std::vector<Texture> textures;
+        // Reused by recordUploads() so deciding costs no allocations while nothing changes
+        std::vector<uint32_t> evictionOrder;
+        uint64_t frame = 0;
+        uint32_t loadingCount = 0;
+        vk::DeviceSize residentBytes = 0;
+        uint64_t streamedLevels = 0;
+        uint64_t evictedLevels = 0;
+
+        // Persistently mapped, one per frame in flight
+        std::vector<vk::raii::Buffer> stagingBuffers;
+        std::vector<renderer::TrackedDeviceMemory> stagingMemories;
+        std::vector<void*> stagingMappings;
+        // Staging for reads larger than a whole staging buffer, retired to the transfer timeline once submitted
+        std::vector<std::pair<vk::raii::Buffer, renderer::TrackedDeviceMemory>> oversizedStaging;
+        // Replaced by this frame's copies, the submits they wait for are made after recordUploads() returns
+        std::vector<RetiredImage> replacedImages;
+        std::deque<RetiredImage> retiredImages; // Ordered by both values
+
+        std::mutex mutex; // Guards the queues and stopping
+        std::condition_variable readCondition;
+        std::deque<ReadRequest> requests;
+        std::deque<ReadResult> results;
+        bool stopping = false;
+        // Declared last, so it starts after everything it uses
+        std::thread reader;
+
+        // Levels [first_level, level count) of the texture as one image
+        [[nodiscard]] vk::ImageCreateInfo getImageInfo(const Texture& texture, uint32_t first_level) const;
+
+        void chooseLevels();
+
+        // Reads the levels from first_level up to the resident ones
+        void queueRead(uint32_t index, uint32_t first_level);
+
+        // Stages the levels that were read and replaces the texture's image, returns false if they do not fit in the
+        // staging space left or the new image has to wait for retired ones to be freed to fit in the budget
+        bool upload(const vk::raii::CommandBuffer& command_buffer, uint32_t frame_slot, vk::DeviceSize& staging_offset,
+                    const ReadResult& result);
+
+        // Creates an image holding levels [first_level, level count), copies them from levels at staging_buffer and
+        // from the texture's image, then retires the old one. Giving levels up passes no levels.
+        void replaceImage(const vk::raii::CommandBuffer& command_buffer, Texture& texture, uint32_t first_level,
+                          vk::Buffer staging_buffer, vk::DeviceSize buffer_offset, const Ktx2Levels* levels);
+
+        [[nodiscard]] std::pair<vk::raii::Buffer, renderer::TrackedDeviceMemory> createStagingBuffer(
+            vk::DeviceSize size, std::string_view owner) const;
+
+        void readLoop();
+    };
+} // textures
@@ -0,0 +1,175 @@
+#include "Trace.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Per track, older events are overwritten once it is full
+constexpr size_t track_capacity = 1 << 15;
+
+namespace trace
+{
+    struct Event
+    {
+        const char* name;
+        int64_t beginNs;
+        int64_t endNs;
+    };
+
+    struct Track
+    {
+        explicit Track(const uint32_t id, std::string name) : id(id), name(std::move(name))
+        {
+        }
+
+        uint32_t id;
+        std::string name;
+        std::unique_ptr<Event[]> events; // Allocated by the first event, threads that only get named cost nothing
+        std::atomic<uint64_t> written = 0;
+    };
+} // trace
+
+namespace
+{
+    struct Registry
+    {
+        std::mutex mutex; // Guards tracks and names, only taken when a track is created or a name interned
+        std::vector<std::unique_ptr<trace::Track>> tracks;
+        std::unordered_set<std::string> names;
+    };
+
+    Registry& registry()
+    {
+        static Registry instance;
+        return instance;
+    }
+
+    // Unnamed tracks are named after their id
+    trace::Track& add_track(std::string name)
+    {
+        Registry& tracks = registry();
+        std::lock_guard lock(tracks.mutex);
+        const auto id = static_cast<uint32_t>(tracks.tracks.size());
+        if (name.empty())
+            name = "thread " + std::to_string(id);
+        return *tracks.tracks.emplace_back(std::make_unique<trace::Track>(id, std::move(name)));
+    }
+
+    trace::Track& thread_track()
+    {
+        thread_local trace::Track* track = nullptr;
+        if (!track)
+            track = &add_track({});
+        return *track;
+    }
+
+    [[nodiscard]] int64_t to_nanoseconds(const trace::clock::time_point time)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+    }
+
+    void write_json_string(std::ostream& output, const std::string_view value)
+    {
+        output << '"';
+        for (const char c : value)
+        {
+            if (c == '"' || c == '\\')
+                output << '\\';
+            output << c;
+        }
+        output << '"';
+    }
+}
+
+namespace trace
+{
+    void set_enabled(const bool enabled)
+    {
+        detail::enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    void set_thread_name(const std::string_view name)
+    {
+        Track& track = thread_track();
+        std::lock_guard lock(registry().mutex);
+        track.name = name;
+    }
+
+    Track& create_track(const std::string_view name)
+    {
+        return add_track(std::string(name));
+    }
+
+    const char* intern(const std::string_view name)
+    {
+        Registry& names = registry();
+        std::lock_guard lock(names.mutex);
+        return names.names.emplace(name).first->c_str();
+    }
+
+    void record(const char* name, const clock::time_point begin, const clock::time_point end)
+    {
+        record(thread_track(), name, begin, end);
+    }
+
+    void record(Track& track, const char* name, const clock::time_point begin, const clock::time_point end)
+    {
+        if (!track.events)
+            track.events = std::make_unique<Event[]>(track_capacity);
+
+        const uint64_t index = track.written.load(std::memory_order_relaxed);
+        track.events[index % track_capacity] = {name, to_nanoseconds(begin), to_nanoseconds(end)};
+        track.written.store(index + 1, std::memory_order_release);
+    }
+
+    void write_chrome_trace(const std::filesystem::path& path)
+    {
+        std::ofstream file(path);
+        if (!file)
+            throw std::runtime_error("Failed to open " + path.string());
+
+        Registry& tracks = registry();
+        std::lock_guard lock(tracks.mutex);
+
+        // Timestamps start at the earliest event so they stay readable
+        int64_t origin_ns = INT64_MAX;
+        for (const auto& track : tracks.tracks)
+        {
+            const uint64_t written = track->written.load(std::memory_order_acquire);
+            for (uint64_t i = written > track_capacity ? written - track_capacity : 0; i < written; i++)
+            {
+                origin_ns = std::min(origin_ns, track->events[i % track_capacity].beginNs);
+            }
+        }
+
+        file << std::fixed << std::setprecision(3);
+        file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        for (const auto& track : tracks.tracks)
+        {
+            file << (first ? "" : ",") << "{\"ph\":\"M\",\"pid\":1,\"tid\":" << track->id
+                << ",\"name\":\"thread_name\",\"args\":{\"name\":";
+            write_json_string(file, track->name);
+            file << "}}";
+            first = false;
+
+            const uint64_t written = track->written.load(std::memory_order_acquire);
+            for (uint64_t i = written > track_capacity ? written - track_capacity : 0; i < written; i++)
+            {
+                const Event& event = track->events[i % track_capacity];
+                file << ",{\"ph\":\"X\",\"pid\":1,\"tid\":" << track->id << ",\"name\":";
+                write_json_string(file, event.name);
+                // Microseconds, with the nanoseconds kept as decimals
+                file << ",\"ts\":" << static_cast<double>(event.beginNs - origin_ns) / 1e3 << ",\"dur\":"
+                    << static_cast<double>(event.endNs - event.beginNs) / 1e3 << "}";
+            }
+        }
+        file << "]}\n";
+    }
+} // trace
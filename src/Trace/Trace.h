@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+namespace trace
+{
+    using clock = std::chrono::steady_clock;
+
+    // Timeline of one thread, or of a GPU queue. Written by a single thread without locks, as a ring keeping the most
+    // recent events.
+    struct Track;
+
+    namespace detail
+    {
+        inline std::atomic<bool> enabled = false;
+    }
+
+    // Off by default, scopes then cost one relaxed load
+    void set_enabled(bool enabled);
+
+    [[nodiscard]] inline bool is_enabled()
+    {
+        return detail::enabled.load(std::memory_order_relaxed);
+    }
+
+    // Names the calling thread's track in the trace
+    void set_thread_name(std::string_view name);
+
+    // Track for events timed elsewhere, like GPU queues. Lives until exit, only one thread may record into it.
+    [[nodiscard]] Track& create_track(std::string_view name);
+
+    // Event names are kept by pointer, names that are not string literals need a copy that outlives the trace
+    [[nodiscard]] const char* intern(std::string_view name);
+
+    // Records into the calling thread's track
+    void record(const char* name, clock::time_point begin, clock::time_point end);
+    void record(Track& track, const char* name, clock::time_point begin, clock::time_point end);
+
+    // Chrome trace event JSON, opens in chrome://tracing and ui.perfetto.dev. Only call once the recording threads
+    // are done, events recorded meanwhile may be torn.
+    void write_chrome_trace(const std::filesystem::path& path);
+
+    // Records the time from construction to destruction, when tracing is enabled
+    class Scope
+    {
+    public:
+        explicit Scope(const char* name) : name(is_enabled() ? name : nullptr)
+        {
+            if (this->name)
+                begin = clock::now();
+        }
+
+        ~Scope()
+        {
+            if (name)
+                record(name, begin, clock::now());
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        const char* name;
+        clock::time_point begin;
+    };
+} // trace
+
+#define TRACE_CONCAT_IMPL(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+
+// Times the rest of the enclosing block, name has to outlive the trace
+#define TRACE_SCOPE(name) ::trace::Scope TRACE_CONCAT(trace_scope_, __LINE__)(name)
@@ -0,0 +1,60 @@
+#include "HeadlessWindow.h"
+
+#include <thread>
+
+namespace window
+{
+    HeadlessWindow::HeadlessWindow(const glm::ivec2 size, const std::function<void(events::event)>& event_handler) :
+        Window(event_handler), size(size)
+    {
+    }
+
+    bool HeadlessWindow::isOpen()
+    {
+        return true;
+    }
+
+    bool HeadlessWindow::isHdrSupported()
+    {
+        return false;
+    }
+
+    glm::ivec2 HeadlessWindow::getSize()
+    {
+        return size;
+    }
+
+    void HeadlessWindow::setSize(const glm::ivec2 new_size)
+    {
+        size = new_size;
+        eventHandler(events::Resize{size});
+    }
+
+    void HeadlessWindow::pollEvents()
+    {
+    }
+
+    void HeadlessWindow::waitEvents(const std::chrono::milliseconds timeout)
+    {
+        std::this_thread::sleep_for(timeout);
+    }
+
+    vk::raii::SurfaceKHR HeadlessWindow::createVulkanSurface(vk::raii::Instance const& instance,
+                                                             vk::Optional<const vk::AllocationCallbacks> allocator)
+    {
+        constexpr vk::HeadlessSurfaceCreateInfoEXT create_info;
+        return instance.createHeadlessSurfaceEXT(create_info, allocator);
+    }
+
+    constexpr std::vector<std::string_view> HeadlessWindow::getVulkanRequiredInstanceExtensions()
+    {
+        return {vk::KHRSurfaceExtensionName, vk::EXTHeadlessSurfaceExtensionName};
+    }
+
+#ifdef WIN32
+    HWND HeadlessWindow::getHwnd()
+    {
+        return nullptr;
+    }
+#endif
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Window.h"
+
+namespace window
+{
+    // Window-less surface from VK_EXT_headless_surface, for CI, benchmarks and CPU-only machines running lavapipe.
+    // Presenting to it only hands the image back, so frame rates are not tied to any display.
+    class HeadlessWindow : public Window
+    {
+    public:
+        HeadlessWindow(glm::ivec2 size, const std::function<void(events::event)>& event_handler);
+
+        bool isOpen() override;
+        bool isHdrSupported() override;
+        glm::ivec2 getSize() override;
+        void setSize(glm::ivec2 size) override;
+
+        void pollEvents() override;
+        void waitEvents(std::chrono::milliseconds timeout) override;
+
+        vk::raii::SurfaceKHR createVulkanSurface(vk::raii::Instance const& instance,
+                                                 vk::Optional<const vk::AllocationCallbacks> allocator) override;
+
+        constexpr std::vector<std::string_view> getVulkanRequiredInstanceExtensions() override;
+
+#ifdef WIN32
+        HWND getHwnd() override;
+#endif
+
+    private:
+        glm::ivec2 size;
+    };
+}
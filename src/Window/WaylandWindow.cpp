@@ -0,0 +1,352 @@
+#include "WaylandWindow.h"
+
+#include <algorithm>
+#include <poll.h>
+#include <stdexcept>
+
+#include "xdg-shell-client-protocol.h"
+#include "presentation-time-client-protocol.h"
+
+// Version 6 reports when the compositor stops showing the window, older protocol headers stop at version 1 events
+#ifdef XDG_TOPLEVEL_STATE_SUSPENDED_SINCE_VERSION
+constexpr uint32_t xdg_wm_base_version = 6;
+#else
+constexpr uint32_t xdg_wm_base_version = 1;
+#endif
+
+[[nodiscard]] static uint64_t to_nanoseconds(const timespec& time)
+{
+    return static_cast<uint64_t>(time.tv_sec) * 1'000'000'000 + static_cast<uint64_t>(time.tv_nsec);
+}
+
+namespace window
+{
+    WaylandWindow::WaylandWindow(const glm::ivec2 size, const std::string& title,
+                                 const std::function<void(events::event)>& event_handler) :
+        Window(event_handler), size(size)
+    {
+        display = wl_display_connect(nullptr);
+        if (!display)
+            throw std::runtime_error("Failed to connect to the Wayland display");
+
+        static constexpr wl_registry_listener registry_listener{registryGlobal, registryGlobalRemove};
+        registry = wl_display_get_registry(display);
+        wl_registry_add_listener(registry, &registry_listener, this);
+        wl_display_roundtrip(display);
+
+        if (!compositor || !wmBase)
+            throw std::runtime_error("Wayland compositor does not support xdg-shell");
+
+        static constexpr xdg_wm_base_listener wm_base_listener{wmBasePing};
+        xdg_wm_base_add_listener(wmBase, &wm_base_listener, this);
+
+        if (presentation)
+        {
+            static constexpr wp_presentation_listener presentation_listener{presentationClockId};
+            wp_presentation_add_listener(presentation, &presentation_listener, this);
+        }
+
+        surface = wl_compositor_create_surface(compositor);
+
+        static constexpr xdg_surface_listener surface_listener{surfaceConfigure};
+        xdgSurface = xdg_wm_base_get_xdg_surface(wmBase, surface);
+        xdg_surface_add_listener(xdgSurface, &surface_listener, this);
+
+        static constexpr xdg_toplevel_listener toplevel_listener{
+            .configure = toplevelConfigure,
+            .close = toplevelClose,
+#ifdef XDG_TOPLEVEL_STATE_SUSPENDED_SINCE_VERSION
+            .configure_bounds = [](void*, xdg_toplevel*, int32_t, int32_t)
+            {
+            },
+            .wm_capabilities = [](void*, xdg_toplevel*, wl_array*)
+            {
+            },
+#endif
+        };
+        toplevel = xdg_surface_get_toplevel(xdgSurface);
+        xdg_toplevel_add_listener(toplevel, &toplevel_listener, this);
+        xdg_toplevel_set_title(toplevel, title.c_str());
+        xdg_toplevel_set_app_id(toplevel, "VulkanTest");
+
+        // The surface may only get a buffer, and so a swapchain, once the first configure has been acknowledged
+        wl_surface_commit(surface);
+        while (!configured)
+        {
+            if (wl_display_dispatch(display) < 0)
+                throw std::runtime_error("Lost the Wayland connection before the window was configured");
+        }
+
+        for (auto& pending : pendingFeedback)
+        {
+            pending.window = this;
+        }
+    }
+
+    WaylandWindow::~WaylandWindow()
+    {
+        for (const auto& pending : pendingFeedback)
+        {
+            if (pending.feedback)
+                wp_presentation_feedback_destroy(pending.feedback);
+        }
+
+        if (toplevel)
+            xdg_toplevel_destroy(toplevel);
+        if (xdgSurface)
+            xdg_surface_destroy(xdgSurface);
+        if (surface)
+            wl_surface_destroy(surface);
+        if (presentation)
+            wp_presentation_destroy(presentation);
+        if (wmBase)
+            xdg_wm_base_destroy(wmBase);
+        if (compositor)
+            wl_compositor_destroy(compositor);
+        if (registry)
+            wl_registry_destroy(registry);
+        if (display)
+            wl_display_disconnect(display);
+    }
+
+    bool WaylandWindow::isOpen()
+    {
+        return open;
+    }
+
+    bool WaylandWindow::isHdrSupported()
+    {
+        return false;
+    }
+
+    glm::ivec2 WaylandWindow::getSize()
+    {
+        return size.load();
+    }
+
+    void WaylandWindow::setSize(const glm::ivec2 new_size)
+    {
+        // Toplevels choose their own size unless the compositor imposes one in a configure
+        size = new_size;
+        eventHandler(events::Resize{new_size});
+    }
+
+    void WaylandWindow::pollEvents()
+    {
+        dispatch(0);
+    }
+
+    void WaylandWindow::waitEvents(const std::chrono::milliseconds timeout)
+    {
+        dispatch(static_cast<int>(timeout.count()));
+    }
+
+    void WaylandWindow::beforePresent()
+    {
+        if (!presentation)
+            return;
+
+        std::lock_guard lock(feedbackMutex);
+
+        for (auto& pending : pendingFeedback)
+        {
+            if (pending.feedback)
+                continue;
+
+            timespec now{};
+            clock_gettime(presentationClock, &now);
+            pending.queuedNs = to_nanoseconds(now);
+
+            // Attaches to the next commit of the surface, which is the one the present is about to make
+            static constexpr wp_presentation_feedback_listener feedback_listener{
+                feedbackSyncOutput, feedbackPresented, feedbackDiscarded
+            };
+            pending.feedback = wp_presentation_feedback(presentation, surface);
+            wp_presentation_feedback_add_listener(pending.feedback, &feedback_listener, &pending);
+            return;
+        }
+    }
+
+    std::optional<PresentationStats> WaylandWindow::getPresentationStats()
+    {
+        if (!presentation)
+            return std::nullopt;
+
+        std::lock_guard lock(feedbackMutex);
+        return stats;
+    }
+
+    vk::raii::SurfaceKHR WaylandWindow::createVulkanSurface(vk::raii::Instance const& instance,
+                                                            vk::Optional<const vk::AllocationCallbacks> allocator)
+    {
+        const vk::WaylandSurfaceCreateInfoKHR create_info({}, display, surface);
+        return instance.createWaylandSurfaceKHR(create_info, allocator);
+    }
+
+    constexpr std::vector<std::string_view> WaylandWindow::getVulkanRequiredInstanceExtensions()
+    {
+        return {vk::KHRSurfaceExtensionName, vk::KHRWaylandSurfaceExtensionName};
+    }
+
+    void WaylandWindow::dispatch(const int timeout_ms)
+    {
+        if (!open)
+            return;
+
+        // Reading events may race with the Vulkan driver doing the same, prepare_read makes that safe
+        while (wl_display_prepare_read(display) != 0)
+        {
+            if (wl_display_dispatch_pending(display) < 0)
+                return close();
+        }
+        wl_display_flush(display);
+
+        pollfd descriptor{wl_display_get_fd(display), POLLIN, 0};
+        if (poll(&descriptor, 1, timeout_ms) > 0)
+        {
+            if (wl_display_read_events(display) < 0)
+                return close();
+        }
+        else
+        {
+            wl_display_cancel_read(display);
+        }
+
+        if (wl_display_dispatch_pending(display) < 0)
+            close();
+    }
+
+    void WaylandWindow::close()
+    {
+        if (!open)
+            return;
+
+        open = false;
+        eventHandler(events::Close{});
+    }
+
+    void WaylandWindow::registryGlobal(void* data, wl_registry* registry, const uint32_t name,
+                                       const char* interface, const uint32_t version)
+    {
+        auto* window = static_cast<WaylandWindow*>(data);
+        const std::string_view interface_name(interface);
+
+        if (interface_name == wl_compositor_interface.name)
+        {
+            window->compositor = static_cast<wl_compositor*>(
+                wl_registry_bind(registry, name, &wl_compositor_interface, std::min(version, 4u)));
+        }
+        else if (interface_name == xdg_wm_base_interface.name)
+        {
+            window->wmBase = static_cast<xdg_wm_base*>(
+                wl_registry_bind(registry, name, &xdg_wm_base_interface, std::min(version, xdg_wm_base_version)));
+        }
+        else if (interface_name == wp_presentation_interface.name)
+        {
+            window->presentation = static_cast<wp_presentation*>(
+                wl_registry_bind(registry, name, &wp_presentation_interface, 1));
+        }
+    }
+
+    void WaylandWindow::registryGlobalRemove(void*, wl_registry*, uint32_t)
+    {
+    }
+
+    void WaylandWindow::wmBasePing(void*, xdg_wm_base* wm_base, const uint32_t serial)
+    {
+        xdg_wm_base_pong(wm_base, serial);
+    }
+
+    void WaylandWindow::surfaceConfigure(void* data, xdg_surface* shell_surface, const uint32_t serial)
+    {
+        auto* window = static_cast<WaylandWindow*>(data);
+        xdg_surface_ack_configure(shell_surface, serial);
+
+        // Zero means the compositor leaves the size to us
+        const glm::ivec2 new_size = window->configuredSize;
+        if (new_size.x > 0 && new_size.y > 0 && new_size != window->size.load())
+        {
+            window->size = new_size;
+            if (window->configured)
+                window->eventHandler(events::Resize{new_size});
+        }
+
+        window->configured = true;
+    }
+
+    void WaylandWindow::toplevelConfigure(void* data, xdg_toplevel*, const int32_t width, const int32_t height,
+                                          wl_array* states)
+    {
+        auto* window = static_cast<WaylandWindow*>(data);
+        window->configuredSize = {width, height};
+
+#ifdef XDG_TOPLEVEL_STATE_SUSPENDED_SINCE_VERSION
+        bool suspended = false;
+        const auto* state = static_cast<const uint32_t*>(states->data);
+        for (size_t i = 0; i < states->size / sizeof(uint32_t); i++)
+        {
+            suspended |= state[i] == XDG_TOPLEVEL_STATE_SUSPENDED;
+        }
+
+        if (suspended != window->suspended)
+        {
+            window->suspended = suspended;
+            window->eventHandler(events::VisibilityChange{!suspended});
+        }
+#else
+        (void)states;
+#endif
+    }
+
+    void WaylandWindow::toplevelClose(void* data, xdg_toplevel*)
+    {
+        static_cast<WaylandWindow*>(data)->close();
+    }
+
+    void WaylandWindow::presentationClockId(void* data, wp_presentation*, const uint32_t clock_id)
+    {
+        auto* window = static_cast<WaylandWindow*>(data);
+        std::lock_guard lock(window->feedbackMutex);
+        window->presentationClock = static_cast<clockid_t>(clock_id);
+    }
+
+    void WaylandWindow::feedbackSyncOutput(void*, struct wp_presentation_feedback*, wl_output*)
+    {
+    }
+
+    void WaylandWindow::feedbackPresented(void* data, struct wp_presentation_feedback* feedback, const uint32_t tv_sec_hi,
+                                          const uint32_t tv_sec_lo, const uint32_t tv_nsec, const uint32_t refresh,
+                                          uint32_t, uint32_t, uint32_t)
+    {
+        auto& pending = *static_cast<PendingFeedback*>(data);
+        WaylandWindow& window = *pending.window;
+        std::lock_guard lock(window.feedbackMutex);
+
+        const uint64_t presented_ns = ((static_cast<uint64_t>(tv_sec_hi) << 32 | tv_sec_lo) * 1'000'000'000) +
+            tv_nsec;
+        const double latency_ms = presented_ns > pending.queuedNs
+                                      ? static_cast<double>(presented_ns - pending.queuedNs) / 1e6
+                                      : 0.0;
+
+        PresentationStats& stats = window.stats;
+        stats.presented++;
+        window.totalLatencyMs += latency_ms;
+        stats.meanLatencyMs = window.totalLatencyMs / static_cast<double>(stats.presented);
+        stats.maxLatencyMs = std::max(stats.maxLatencyMs, latency_ms);
+        stats.refreshMs = static_cast<double>(refresh) / 1e6;
+
+        wp_presentation_feedback_destroy(feedback);
+        pending.feedback = nullptr;
+    }
+
+    void WaylandWindow::feedbackDiscarded(void* data, struct wp_presentation_feedback* feedback)
+    {
+        auto& pending = *static_cast<PendingFeedback*>(data);
+        std::lock_guard lock(pending.window->feedbackMutex);
+
+        pending.window->stats.discarded++;
+
+        wp_presentation_feedback_destroy(feedback);
+        pending.feedback = nullptr;
+    }
+}
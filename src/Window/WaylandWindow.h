@@ -0,0 +1,110 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <ctime>
+#include <mutex>
+#include <string>
+
+#include <wayland-client.h>
+
+#include "Window.h"
+
+struct xdg_wm_base;
+struct xdg_surface;
+struct xdg_toplevel;
+struct wp_presentation;
+struct wp_presentation_feedback;
+
+namespace window
+{
+    // Native xdg-shell window, the Vulkan surface is created straight on its wl_surface.
+    // When the compositor supports wp_presentation, every present is matched with feedback telling when it reached
+    // the display, measured on the compositor's own presentation clock.
+    // Events are dispatched on the thread calling pollEvents()/waitEvents(), presents may come from any other thread.
+    class WaylandWindow : public Window
+    {
+    public:
+        WaylandWindow(glm::ivec2 size, const std::string& title,
+                      const std::function<void(events::event)>& event_handler);
+        ~WaylandWindow() override;
+
+        WaylandWindow(const WaylandWindow&) = delete;
+        WaylandWindow& operator=(const WaylandWindow&) = delete;
+
+        bool isOpen() override;
+        bool isHdrSupported() override;
+        glm::ivec2 getSize() override;
+        void setSize(glm::ivec2 size) override;
+
+        void pollEvents() override;
+        void waitEvents(std::chrono::milliseconds timeout) override;
+
+        void beforePresent() override;
+        [[nodiscard]] std::optional<PresentationStats> getPresentationStats() override;
+
+        vk::raii::SurfaceKHR createVulkanSurface(vk::raii::Instance const& instance,
+                                                 vk::Optional<const vk::AllocationCallbacks> allocator) override;
+
+        constexpr std::vector<std::string_view> getVulkanRequiredInstanceExtensions() override;
+
+    private:
+        // Presents waiting for feedback, more than this in flight are not measured
+        static constexpr size_t max_pending_feedback = 16;
+
+        struct PendingFeedback
+        {
+            WaylandWindow* window = nullptr;
+            wp_presentation_feedback* feedback = nullptr;
+            uint64_t queuedNs = 0;
+        };
+
+        wl_display* display = nullptr;
+        wl_registry* registry = nullptr;
+        wl_compositor* compositor = nullptr;
+        xdg_wm_base* wmBase = nullptr;
+        wp_presentation* presentation = nullptr;
+
+        wl_surface* surface = nullptr;
+        xdg_surface* xdgSurface = nullptr;
+        xdg_toplevel* toplevel = nullptr;
+
+        // Read by the render thread while the event thread handles configures
+        std::atomic<glm::ivec2> size;
+        glm::ivec2 configuredSize{0, 0};
+        bool configured = false;
+        bool suspended = false;
+        bool open = true;
+
+        clockid_t presentationClock = CLOCK_MONOTONIC;
+
+        std::mutex feedbackMutex; // Guards everything below, feedback arrives on the event thread
+        std::array<PendingFeedback, max_pending_feedback> pendingFeedback;
+        PresentationStats stats;
+        double totalLatencyMs = 0.0;
+
+        void dispatch(int timeout_ms);
+
+        void close();
+
+        static void registryGlobal(void* data, wl_registry* registry, uint32_t name, const char* interface,
+                                   uint32_t version);
+        static void registryGlobalRemove(void* data, wl_registry* registry, uint32_t name);
+
+        static void wmBasePing(void* data, xdg_wm_base* wm_base, uint32_t serial);
+
+        static void surfaceConfigure(void* data, xdg_surface* shell_surface, uint32_t serial);
+
+        static void toplevelConfigure(void* data, xdg_toplevel* toplevel, int32_t width, int32_t height,
+                                      wl_array* states);
+        static void toplevelClose(void* data, xdg_toplevel* toplevel);
+
+        static void presentationClockId(void* data, wp_presentation* presentation, uint32_t clock_id);
+
+        static void feedbackSyncOutput(void* data, struct wp_presentation_feedback* feedback, wl_output* output);
+        static void feedbackPresented(void* data, struct wp_presentation_feedback* feedback, uint32_t tv_sec_hi,
+                                      uint32_t tv_sec_lo, uint32_t tv_nsec, uint32_t refresh, uint32_t seq_hi,
+                                      uint32_t seq_lo, uint32_t flags);
+        static void feedbackDiscarded(void* data, struct wp_presentation_feedback* feedback);
+    };
+}
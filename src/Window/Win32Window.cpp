@@ -127,6 +127,12 @@ namespace window
         }
     }
 
+    void Win32Window::waitEvents(const std::chrono::milliseconds timeout)
+    {
+        MsgWaitForMultipleObjects(0, nullptr, FALSE, static_cast<DWORD>(timeout.count()), QS_ALLINPUT);
+        pollEvents();
+    }
+
     HWND Win32Window::getHwnd()
     {
         return this->hwnd;
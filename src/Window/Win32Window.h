@@ -26,6 +26,7 @@ namespace window
         void setSize(glm::ivec2 size) override;
 
         void pollEvents() override;
+        void waitEvents(std::chrono::milliseconds timeout) override;
 
         vk::raii::SurfaceKHR createVulkanSurface(vk::raii::Instance const& instance,
                                                  vk::Optional<const vk::AllocationCallbacks> allocator) override;
@@ -7,7 +7,10 @@
 
 #include <glm/vec2.hpp>
 #include <vulkan/vulkan_raii.hpp>
+#include <chrono>
+#include <cstdint>
 #include <functional>
+#include <optional>
 
 #ifdef WIN32
 #include <windef.h>
@@ -17,6 +20,16 @@
 
 namespace window
 {
+    // Time from queueing a present to the image reaching the display, as reported by the compositor
+    struct PresentationStats
+    {
+        uint64_t presented = 0;
+        uint64_t discarded = 0;
+        double meanLatencyMs = 0.0;
+        double maxLatencyMs = 0.0;
+        double refreshMs = 0.0;
+    };
+
     class Window
     {
     public:
@@ -28,6 +41,19 @@ namespace window
         virtual void setSize(glm::ivec2 size) = 0;
 
         virtual void pollEvents() = 0;
+        // Sleeps until an event arrives or the timeout expires, then dispatches whatever is pending
+        virtual void waitEvents(std::chrono::milliseconds timeout) = 0;
+
+        // Called on the render thread right before each present, so backends can match it with display feedback
+        virtual void beforePresent()
+        {
+        }
+
+        // Empty when the backend cannot observe when presents reach the display
+        [[nodiscard]] virtual std::optional<PresentationStats> getPresentationStats()
+        {
+            return std::nullopt;
+        }
 
         virtual vk::raii::SurfaceKHR createVulkanSurface(vk::raii::Instance const& instance)
         {
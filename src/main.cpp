@@ -1,8 +1,35 @@
+#include <iostream>
+
 #include "Application.h"
+#include "Benchmark.h"
+#include "GeometryBake.h"
 
-int main([[maybe_unused]] int argv, [[maybe_unused]] char** args)
+int main(const int argv, char** args)
 {
-    Application app;
+    ApplicationSettings settings;
+    try
+    {
+        settings = ApplicationSettings(argv, args);
+    }
+    catch (const std::invalid_argument& error)
+    {
+        std::cerr << error.what() << std::endl;
+        return 1;
+    }
+
+    if (settings.benchmark)
+        return run_renderer_benchmark(settings);
+
+    if (settings.benchmarkParticles)
+        return run_particle_benchmark(settings);
+
+    if (!settings.bakeGeometryPath.empty())
+        return run_geometry_bake(settings);
+
+    if (settings.softwareRenderer)
+        return run_software_renderer(settings);
+
+    Application app(settings);
     app.run();
     return 0;
 }
@@ -0,0 +1,12 @@
+#pragma once
+
+// SSE2 is part of the x86-64 baseline, other targets use the scalar code paths
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VKT_SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace simd
+{
+    constexpr unsigned int lane_count = 4;
+}
@@ -1,7 +1,8 @@
 #include "utils.h"
 
-std::vector<const char *> to_c_strings(const std::vector<std::string_view> &strings) {
-    std::vector<const char *> c_strings;
+std::pmr::vector<const char *> to_c_strings(const std::span<const std::string_view> strings,
+                                            std::pmr::memory_resource *resource) {
+    std::pmr::vector<const char *> c_strings(resource);
     c_strings.reserve(strings.size());
     for (auto &string : strings) {
         c_strings.push_back(string.data());
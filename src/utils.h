@@ -1,6 +1,10 @@
 #pragma once
 
+#include <memory_resource>
+#include <span>
 #include <string_view>
 #include <vector>
 
-std::vector<const char *> to_c_strings(const std::vector<std::string_view> &strings);
\ No newline at end of file
+// The views have to end at a null terminator, like the layer and extension name constants
+std::pmr::vector<const char *> to_c_strings(std::span<const std::string_view> strings,
+                                            std::pmr::memory_resource *resource = std::pmr::get_default_resource());
\ No newline at end of file